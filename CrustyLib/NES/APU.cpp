@@ -158,6 +158,7 @@ public:
 
 	virtual void Reset(bool isHardReset) override;
 	virtual void SetCpu(CPU::Cpu6502* pCpu) override;
+	virtual void SetIrqLine(Scheduler* pScheduler, InterruptController* pInterrupts) override;
 	//virtual void AddCycles(uint32_t cpuCycles) override;
 	virtual void WriteMemory8(uint16_t offset, uint8_t value) override;
 	virtual uint8_t ReadStatus() override;
@@ -227,6 +228,12 @@ void Apu::SetCpu(CPU::Cpu6502* pCpu)
 }
 
 
+void Apu::SetIrqLine(Scheduler* pScheduler, InterruptController* pInterrupts)
+{
+	// No frame counter or DMC here, so never any IRQ to raise
+}
+
+
 inline int GetPulseFrequencyFromTimerValue(uint32_t timerPeriod)
 {
 	return c_cpuFrequency / (16 * (timerPeriod + 1));
@@ -9,6 +9,11 @@ namespace CPU {
 	class Cpu6502;
 }
 
+namespace NES {
+	class Scheduler;
+	class InterruptController;
+}
+
 namespace NES { namespace APU {
 
 const int c_cpuFrequency = 1789773; // Hz (cycles/second), i.e. 1.789773 MHz
@@ -20,6 +25,10 @@ public:
 
 	virtual void SetCpu(CPU::Cpu6502* pCpu) = 0;
 
+	// Where the frame counter/DMC IRQ goes.  The APU schedules an ApuFrameIrq event for when its IRQ is next due, and
+	// drops the line itself when the game acknowledges it.
+	virtual void SetIrqLine(Scheduler* pScheduler, InterruptController* pInterrupts) = 0;
+
 	virtual void Reset(bool isHardReset) = 0;
 	virtual void WriteMemory8(uint16_t offset, uint8_t value) = 0;
 	virtual uint8_t ReadStatus() = 0;
@@ -7,6 +7,8 @@
 #include "../Util/IAudioDevice.h"
 #include "APU.h"
 #include "Cpu6502.h"
+#include "Scheduler.h"
+#include "InterruptController.h"
 
 namespace NES { namespace APU { namespace blargg {
 
@@ -19,6 +21,7 @@ public:
 
 	virtual void Reset(bool isHardReset) override;
 	virtual void SetCpu(CPU::Cpu6502* pCpu) override;
+	virtual void SetIrqLine(Scheduler* pScheduler, InterruptController* pInterrupts) override;
 	virtual void WriteMemory8(uint16_t offset, uint8_t value) override;
 	virtual uint8_t ReadStatus() override;
 	virtual void PushAudio() override;
@@ -27,6 +30,8 @@ public:
 
 private:
 	cpu_time_t GetElapsedCpuTime() const;
+	void CreateAudioSource();
+	void OnIrqChanged();
 
 	std::shared_ptr<IAudioDevice> m_spAudioDevice;
 
@@ -37,8 +42,11 @@ private:
 	uint32_t m_audioWriteOffset = 0;
 
 	std::shared_ptr<IAudioSource> m_spAudioSource;
+	bool m_isSoundEnabled = true;
 
 	CPU::Cpu6502* m_pCpu;
+	Scheduler* m_pScheduler = nullptr;
+	InterruptController* m_pInterrupts = nullptr;
 	Blip_Buffer m_blipBuf;
 	Nes_Apu m_nesApu;
 };
@@ -46,37 +54,48 @@ private:
 
 Apu::Apu()
 {
-	m_spAudioDevice = CreateXAudioDevice();
-	m_spAudioSource = m_spAudioDevice->AddAudioSource();
-
 	m_blipBuf.sample_rate(44100);
 	m_blipBuf.clock_rate(c_cpuCyclesPerSecond);
 
 	m_nesApu.output(&m_blipBuf);
 
-	m_nesApu.dmc_reader( [](void*, cpu_addr_t addr)->int
-	{
-		// TODO: Hook up to real CPU reads so DMC sound works correctly
-		return 0;
-	});
 }
 
 
 void Apu::SetCpu(CPU::Cpu6502* pCpu)
 {
 	m_pCpu = pCpu;
+
+	// DMC samples are read straight out of PRG memory, and the DMA controller charges the CPU for the fetches
+	m_nesApu.dmc_reader([](void* pUserData, cpu_addr_t address)->int
+	{
+		return static_cast<CPU::DmaController*>(pUserData)->ReadDmcSample(static_cast<uint16_t>(address));
+	}, &pCpu->GetDma());
+}
+
+
+void Apu::SetIrqLine(Scheduler* pScheduler, InterruptController* pInterrupts)
+{
+	m_pScheduler = pScheduler;
+	m_pInterrupts = pInterrupts;
+
+	m_nesApu.irq_notifier([](void* pUserData)
+	{
+		static_cast<Apu*>(pUserData)->OnIrqChanged();
+	}, this);
 }
 
 
 void Apu::Reset(bool isHardReset)
 {
-	m_nesApu.reset();
 	m_cpuCyclesBias = 0;
+	m_nesApu.reset();
 }
 
 
 void Apu::EnableSound(bool isEnabled)
 {
+	m_isSoundEnabled = isEnabled;
 	if (isEnabled)
 		m_nesApu.output(&m_blipBuf);
 	else
@@ -95,16 +114,11 @@ void Apu::PushAudio()
 	m_nesApu.end_frame(static_cast<cpu_time_t>(elapsedCycles));
 	m_blipBuf.end_frame(static_cast<cpu_time_t>(elapsedCycles));
 
-	if (m_spAudioData == nullptr)
+	if (m_isSoundEnabled && m_blipBuf.samples_avail() > 0)
 	{
-		// Allocate a full second worth of audio data for now
-		m_cbAudioData = m_spAudioSource->GetSamplesPerSecond() * m_spAudioSource->GetBytesPerSample();
-		m_spAudioData =	std::make_unique<uint8_t[]>(m_cbAudioData);
-		m_audioWriteOffset = 0;
-	}
+		if (m_spAudioSource == nullptr)
+			CreateAudioSource();
 
-	if (m_blipBuf.samples_avail() > 0)
-	{
 		auto samplesAvail = m_blipBuf.samples_avail();
 
 		uint32_t cbBufferData = samplesAvail * m_spAudioSource->GetBytesPerSample();
@@ -122,9 +136,42 @@ void Apu::PushAudio()
 		m_spAudioSource->SetChannelData(pBufferData, cbBufferData, false /*shouldLoop*/);
 		m_spAudioSource->Play();
 	}
+	else
+	{
+		// Nothing's listening, but the buffer still fills up with silence
+		m_blipBuf.remove_samples(m_blipBuf.samples_avail());
+	}
 	m_cpuCyclesBias += elapsedCycles;
 }
 
+// The audio device is only opened once there's something to play, so consoles which never enable sound (such as
+// the ones in an NESBatch) don't each hold a device and a second of buffer
+void Apu::CreateAudioSource()
+{
+	m_spAudioDevice = CreateXAudioDevice();
+	m_spAudioSource = m_spAudioDevice->AddAudioSource();
+
+	// Allocate a full second worth of audio data for now
+	m_cbAudioData = m_spAudioSource->GetSamplesPerSecond() * m_spAudioSource->GetBytesPerSample();
+	m_spAudioData =	std::make_unique<uint8_t[]>(m_cbAudioData);
+	m_audioWriteOffset = 0;
+}
+
+// Nes_Apu predicts when its IRQ will next be asserted, and calls this whenever a register access changes that.
+// It only reports the frame counter and DMC IRQs combined, so both come through as ApuFrameIrq.
+void Apu::OnIrqChanged()
+{
+	// Whatever was asserted has either been acknowledged or gets asserted again right away by the event
+	m_pInterrupts->Clear(InterruptSource::ApuFrameIrq);
+
+	const cpu_time_t earliestIrq = m_nesApu.earliest_irq();
+	if (earliestIrq == Nes_Apu::no_irq)
+		m_pScheduler->Cancel(SchedulerEvent::ApuFrameIrq);
+	else
+		m_pScheduler->Schedule(SchedulerEvent::ApuFrameIrq, m_cpuCyclesBias + earliestIrq);
+}
+
+
 uint8_t Apu::ReadStatus()
 {
 	return m_nesApu.read_status(GetElapsedCpuTime());
@@ -0,0 +1,60 @@
+#include "stdafx.h"
+#include "ChrTileCache.h"
+
+namespace PPU
+{
+
+const uint32_t c_cbTile = 16;
+
+
+void ChrTileCache::Reset()
+{
+	m_pages.clear();
+}
+
+
+const DecodedChrPage& ChrTileCache::GetPage(const uint8_t* pChrPage)
+{
+	if (pChrPage == nullptr)
+	{
+		static const DecodedChrPage s_emptyPage = {};
+		return s_emptyPage;
+	}
+
+	std::unique_ptr<DecodedChrPage>& spPage = m_pages[pChrPage];
+	if (!spPage)
+		spPage = std::make_unique<DecodedChrPage>();
+
+	if (!spPage->isValid)
+		DecodePage(pChrPage, *spPage);
+
+	return *spPage;
+}
+
+
+void ChrTileCache::DecodePage(const uint8_t* pChrPage, DecodedChrPage& page)
+{
+	for (uint32_t iTile = 0; iTile != c_tilesPerChrPage; ++iTile)
+	{
+		const uint8_t* pTile = pChrPage + iTile * c_cbTile;
+		for (uint32_t iRow = 0; iRow != 8; ++iRow)
+		{
+			// The low bit of each pixel is in the first 8 bytes of the tile, and the high bit in the next 8
+			const uint8_t plane0 = pTile[iRow];
+			const uint8_t plane1 = pTile[iRow + 8];
+
+			for (uint32_t iPixel = 0; iPixel != 8; ++iPixel)
+			{
+				const uint32_t bit = 7 - iPixel;
+				const uint8_t colorIndex = static_cast<uint8_t>(((plane0 >> bit) & 1) | (((plane1 >> bit) & 1) << 1));
+
+				page.rows[iTile][iRow][iPixel] = colorIndex;
+				page.flippedRows[iTile][iRow][7 - iPixel] = colorIndex;
+			}
+		}
+	}
+
+	page.isValid = true;
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <unordered_map>
+
+// Cache of pre-decoded pattern table tiles, so the renderer copies pixel indices instead of pulling them out of
+// the two bit planes one at a time.
+//
+// Tiles are decoded a 1KB CHR page (64 tiles) at a time, and pages are keyed by the host address of the memory
+// behind them, so a CHR ROM bank is decoded once and stays valid across bank switches.  Pages backed by CHR RAM
+// have to be invalidated when the PPU writes to them.
+
+namespace PPU
+{
+
+const uint32_t c_cbChrPage = 0x400;
+const uint32_t c_tilesPerChrPage = c_cbChrPage / 16;
+
+struct DecodedChrPage
+{
+	// Each tile row as eight 2-bit color indices, one per byte with the leftmost pixel first, and the same row
+	// mirrored for horizontally flipped sprites
+	uint8_t rows[c_tilesPerChrPage][8][8];
+	uint8_t flippedRows[c_tilesPerChrPage][8][8];
+	bool isValid;
+};
+
+class ChrTileCache
+{
+public:
+	ChrTileCache() = default;
+
+	ChrTileCache(const ChrTileCache&) = delete;
+	ChrTileCache& operator=(const ChrTileCache&) = delete;
+
+	void Reset();
+
+	// Returns the decoded tiles for the 1KB page at pChrPage, decoding it first if needed.  A null page (unmapped
+	// CHR memory) reads as all zeros.
+	const DecodedChrPage& GetPage(const uint8_t* pChrPage);
+
+	// The memory at pChrPage has been written to
+	void Invalidate(const uint8_t* pChrPage)
+	{
+		auto it = m_pages.find(pChrPage);
+		if (it != m_pages.end())
+			it->second->isValid = false;
+	}
+
+private:
+	static void DecodePage(const uint8_t* pChrPage, DecodedChrPage& page);
+
+	std::unordered_map<const uint8_t*, std::unique_ptr<DecodedChrPage>> m_pages;
+};
+
+}
@@ -28,6 +28,8 @@ void Controller::WriteData(uint8_t value)
 
 uint8_t Controller::ReadData()
 {
+	m_wasPolled = true;
+
 	uint8_t result = m_readInputOffset < (int)ControllerInput::_Max ? m_inputs[m_readInputOffset] : 0;
 	
 	// The top bits of the data aren't set by the controller, so should retain the previous bytes of the bus
@@ -28,11 +28,16 @@ public:
 	void WriteData(uint8_t value);
 	uint8_t ReadData();
 
+	// Tracks whether the game read the controller at all, for lag frame detection
+	void ClearPolled() { m_wasPolled = false; }
+	bool WasPolled() const { return m_wasPolled; }
+
 private:
 	bool m_strobeOn = false;
+	bool m_wasPolled = false;
 	int m_readInputOffset = 0;
 
-	uint8_t m_inputs[static_cast<size_t>(ControllerInput::_Max)];
+	uint8_t m_inputs[static_cast<size_t>(ControllerInput::_Max)] = {};
 
 };
 
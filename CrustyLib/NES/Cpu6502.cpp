@@ -2,16 +2,20 @@
 #include "Cpu6502.h"
 #include "Ppu.h"
 #include "NES.h"
+#include "DecodedBlockCache.h"
+#include "CpuTrace.h"
+#include "CpuProfiler.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <iomanip>
-#include <algorithm>
 
 namespace CPU
 {
 
 const uint16_t c_stackOffset = 0x100;
+const uint32_t c_interruptCycles = 7;
 
 // BranchFlagSelector
 enum BranchFlagSelector
@@ -24,24 +28,73 @@ enum BranchFlagSelector
 
 
 Cpu6502::Cpu6502(NES::NES& nes)
-	: m_nes(nes)
+	: m_spBlockCache(std::make_shared<DecodedBlockCache>())
+	, m_scheduler(nes.GetScheduler())
+	, m_interrupts(nes.GetInterruptController())
 	, m_ppu(nes.GetPpu())
+	, m_nes(nes)
 	, m_apu(nes.GetApu())
+	, m_dma(*this, nes.GetPpu(), nes.GetScheduler())
+{
+	ResetMemoryMap();
+	SetTiming(CpuTiming::PerInstruction);
+}
+
+
+Cpu6502::~Cpu6502() = default;
+
+
+// Devices raise their interrupt lines part way through an instruction (when caught up on a register access or
+// scheduler event), so the lines are only looked at between instructions.
+bool Cpu6502::IsInterruptDue() const
 {
+	const uint32_t pending = m_interrupts.GetPending();
+	if (pending == 0)
+		return false;
+
+	return m_interrupts.IsRaised(NES::InterruptSource::Nmi) ||
+		((pending & static_cast<uint32_t>(NES::c_irqSources)) != 0 && !(m_status & static_cast<uint8_t>(CpuStatusFlag::InterruptDisabled)));
 }
 
 
-void Cpu6502::GenerateNonMaskableInterrupt()
+void Cpu6502::ServiceInterrupt()
 {
+	// NMI wins over IRQ, and is edge triggered so it's taken once per raise.  IRQs are left raised until the device
+	// is acknowledged, and are masked by the I flag set below until the handler returns.
+	const bool isNmi = m_interrupts.IsRaised(NES::InterruptSource::Nmi);
+	if (isNmi)
+		m_interrupts.Clear(NES::InterruptSource::Nmi);
+
+	m_lastProfiledOpCode = -1;
 	PushValueOntoStack16(m_pc);
-	PushValueOntoStack8(m_status);
-	m_pc = ReadMemory16(static_cast<uint16_t>(0xFFFA));
+	PushValueOntoStack8(GetStatus() & ~static_cast<uint8_t>(CpuStatusFlag::BreakCommand)); // B is only set when pushed by BRK/PHP
+	SetStatusFlags(CpuStatusFlag::InterruptDisabled, CpuStatusFlag::InterruptDisabled);
+	m_pc = ReadMemory16(static_cast<uint16_t>(isNmi ? 0xFFFA : 0xFFFE));
+
+	m_totalCycles += c_interruptCycles;
 }
 
 
 void Cpu6502::SetRomMapper(NES::IMapper* pMapper)
 {
 	m_pMapper = pMapper;
+	ResetBlockCache();
+
+	// Start the page table over, and let the new mapper point it at its PRG banks
+	ResetMemoryMap();
+	m_pMapper->SetCpuMemoryMap(&m_memoryMap);
+}
+
+
+void Cpu6502::ResetMemoryMap()
+{
+	m_memoryMap.Reset();
+
+	// $0800-$1FFF are all mirrors of the 2KB of CPU RAM
+	for (uint32_t mirrorOffset = 0; mirrorOffset != 0x2000; mirrorOffset += sizeof(m_cpuRam))
+	{
+		m_memoryMap.MapReadWrite(static_cast<uint16_t>(mirrorOffset), sizeof(m_cpuRam), m_cpuRam);
+	}
 }
 
 uint16_t MapIoRegisterMemoryOffset(uint16_t offset)
@@ -51,6 +104,17 @@ uint16_t MapIoRegisterMemoryOffset(uint16_t offset)
 }
 
 uint8_t Cpu6502::ReadMemory8(uint16_t offset) const
+{
+	// Fast path: RAM, PRG ROM and PRG RAM are directly backed by memory
+	const uint8_t* pPage = m_memoryMap.GetReadPage(offset);
+	const uint8_t value = (pPage != nullptr) ? pPage[offset & NES::c_cpuPageMask] : ReadRegister8(offset);
+
+	m_memoryMap.SetOpenBus(value);
+	return value;
+}
+
+
+uint8_t Cpu6502::ReadRegister8(uint16_t offset) const
 {
 	if (offset >= 0x4020) // PRG ROM
 	{
@@ -66,6 +130,7 @@ uint8_t Cpu6502::ReadMemory8(uint16_t offset) const
 		//offset &= 0x2007;
 
 		// PPU I/O registeres
+		m_ppu.SyncToCpuCycle(GetElapsedCycles());
 		uint16_t mappedOffset = MapIoRegisterMemoryOffset(offset);
 		if (mappedOffset == 0x2002)
 		{
@@ -75,17 +140,14 @@ uint8_t Cpu6502::ReadMemory8(uint16_t offset) const
 		{
 			return m_ppu.ReadOamData();
 		}
-		else if (mappedOffset == 0x2005 || mappedOffset == 0x2006)
-		{
-			throw std::runtime_error("Unexpected read of VRAM Address register");
-		}
 		else if (mappedOffset == 0x2007)
 		{
 			return m_ppu.ReadCpuDataRegister();
 		}
 		else
 		{
-			throw std::runtime_error("Unexpected read location");
+			// The rest are write only
+			return m_memoryMap.ReadUnmapped();
 		}
 	}
 	else if (offset == 0x4016)
@@ -103,12 +165,28 @@ uint8_t Cpu6502::ReadMemory8(uint16_t offset) const
 	}
 	else
 	{
-		throw std::runtime_error("Unexpected read location");
+		// APU registers other than $4015 are write only, and $4018-$401F are unused
+		return m_memoryMap.ReadUnmapped();
+	}
+}
+
+
+void Cpu6502::WriteMemory8(uint16_t offset, uint8_t value, int64_t busCycle)
+{
+	m_memoryMap.SetOpenBus(value);
+
+	uint8_t* pPage = m_memoryMap.GetWritePage(offset);
+	if (pPage != nullptr)
+	{
+		pPage[offset & NES::c_cpuPageMask] = value;
+		return;
 	}
+
+	WriteRegister8(offset, value, busCycle);
 }
 
 
-void Cpu6502::WriteMemory8(uint16_t offset, uint8_t value)
+void Cpu6502::WriteRegister8(uint16_t offset, uint8_t value, int64_t busCycle)
 {
 	if (offset < 0x800) // CPU RAM
 	{
@@ -117,6 +195,7 @@ void Cpu6502::WriteMemory8(uint16_t offset, uint8_t value)
 	else if (offset >= 0x2000 && offset < 0x4000)
 	{
 		// PPU I/O registeres
+		m_ppu.SyncToCpuCycle(GetElapsedCycles());
 		uint16_t mappedOffset = MapIoRegisterMemoryOffset(offset);
 		if (mappedOffset == 0x2000)
 		{
@@ -129,8 +208,8 @@ void Cpu6502::WriteMemory8(uint16_t offset, uint8_t value)
 		}
 		else if (mappedOffset == 0x2002)
 		{
-			// Arkanoid apparently tries to do this... not sure what the expected result is.  Lets try skipping it for now
-			//throw std::runtime_error("Unexpected write of PPU status register");
+			// Read only, though Arkanoid writes it anyway
+			m_memoryMap.WriteUnmapped();
 		}
 		else if (mappedOffset == 0x2003)
 		{
@@ -154,7 +233,8 @@ void Cpu6502::WriteMemory8(uint16_t offset, uint8_t value)
 		}
 		else
 		{
-			throw std::runtime_error("Not handled yet");
+			// MapIoRegisterMemoryOffset only leaves $2000-$2007, so this can't be reached
+			m_memoryMap.WriteUnmapped();
 		}
 	}
 	else if (offset >= 0x4000 && offset < 0x4014)
@@ -164,24 +244,8 @@ void Cpu6502::WriteMemory8(uint16_t offset, uint8_t value)
 	else if (offset == 0x4014)
 	{
 		// PPU sprite DMA (OAMDMA)
-
-		uint16_t baseOffset = static_cast<uint16_t>(value) << 8;
-		if (baseOffset < 0x800) // CPU RAM
-		{
-			m_ppu.TriggerOamDMA(m_cpuRam + baseOffset);
-		}
-		else
-		{
-			// REVIEW: Get real contiguous byte*?
-			uint16_t baseOffset = static_cast<uint16_t>(value) << 8;
-			uint8_t dmaData[256];
-			for (uint16_t i=0; i != 256; ++i)
-			{
-				dmaData[i] = ReadMemory8(baseOffset + i);
-			}
-
-			m_ppu.TriggerOamDMA(dmaData);
-		}
+		m_ppu.SyncToCpuCycle(GetElapsedCycles());
+		AddCycles(m_dma.RunOamDma(value, busCycle));
 	}
 	else if (offset == 0x4015)
 	{
@@ -199,11 +263,14 @@ void Cpu6502::WriteMemory8(uint16_t offset, uint8_t value)
 	}
 	else if (offset >= 0x4020)
 	{
-		m_pMapper->WriteAddress(offset, value);
+		// Mapper writes can switch CHR banks, so the PPU needs to be caught up first
+		m_ppu.SyncToCpuCycle(GetElapsedCycles());
+		m_pMapper->WriteAddress(offset, value, GetElapsedCycles());
 	}
 	else
 	{
-		throw std::runtime_error("Not handled yet");
+		// $4018-$401F
+		m_memoryMap.WriteUnmapped();
 	}
 }
 
@@ -240,50 +307,104 @@ void Cpu6502::Reset()
 
 	// REVIEW: Push something on to stack?  Initial stack pointer should be FD
 	
-	m_status = static_cast<uint8_t>(CpuStatusFlag::Bit5 | CpuStatusFlag::InterruptDisabled); // Bit 5 doesn't exist, so pin it in the '1' state.  Not sure why interrupts start disabled
+	SetStatus(static_cast<uint8_t>(CpuStatusFlag::Bit5 | CpuStatusFlag::InterruptDisabled)); // Bit 5 doesn't exist, so pin it in the '1' state.  Not sure why interrupts start disabled
 
 	m_totalCycles = 0;
-	m_cyclesRemaining = 0;
+	m_instructionCount = 0;
+	m_fusedInstructionCount = 0;
+	m_lastProfiledOpCode = -1;
+	m_idleLoop = IdleLoopState();
+	m_skippedIdleCycles = 0;
+	m_lastTraceCycle = -1;
+	m_dma.Reset();
+}
+
+/*----- Timing policies
+
+ The instruction handlers, addressing modes and run loops are templated on one of these, so each timing model
+ gets its own copy of the core with the policy calls inlined away.  Cpu6502::SetTiming picks which copy runs.
+
+ PerInstructionTiming charges an instruction's cycles when it completes, and register accesses see the cycle the
+ instruction started on.  PerAccessTiming also counts every bus access (including the dummy reads the 6502 makes
+ while indexing) as it happens, so PPU/APU/mapper accesses see the exact cycle they land on.  Both charge the
+ same total cycles per instruction. -----*/
+
+struct PerInstructionTiming
+{
+	static const bool c_allowsFusion = true;
+	static const bool c_allowsNativeBlocks = true;
+
+	static void BeginInstruction(Cpu6502&) {}
+	static void AddBusCycle(Cpu6502&) {}
+	static void EndInstruction(Cpu6502&) {}
+
+	// Instructions write on their last cycle
+	static int64_t GetBusCycle(const Cpu6502& cpu) { return cpu.m_totalCycles + cpu.m_currentInstructionCycleCount - 1; }
+};
+
+struct PerAccessTiming
+{
+	// Fused handlers commit the first half's cycles themselves, which would skip the bus cycle bookkeeping
+	static const bool c_allowsFusion = false;
+
+	// Native code charges whole instructions at a time
+	static const bool c_allowsNativeBlocks = false;
+
+	static void BeginInstruction(Cpu6502& cpu) { cpu.m_busCycle = 1; } // The opcode fetch
+	static void AddBusCycle(Cpu6502& cpu) { cpu.m_busCycle++; }
+	static void EndInstruction(Cpu6502& cpu) { cpu.m_busCycle = 0; }
 
-	// Override to allow for execution of code segment of nestest
-	//m_pc = 0xc000;
+	static int64_t GetBusCycle(const Cpu6502& cpu) { return cpu.m_totalCycles + cpu.m_busCycle; }
+};
+
+
+template <typename TTiming>
+uint8_t Cpu6502::BusRead8(uint16_t offset)
+{
+	const uint8_t value = ReadMemory8(offset);
+	TTiming::AddBusCycle(*this);
+	return value;
 }
 
-uint8_t Cpu6502::ReadUInt8(AddressingMode mode)
+template <typename TTiming>
+uint16_t Cpu6502::BusRead16(uint16_t offset)
 {
-	if (mode == AddressingMode::IMM)
-	{
-		return ReadMemory8(m_pc++);
-	}
-	else if (mode == AddressingMode::ACC)
-	{
-		return m_acc;
-	}
-	else
-	{
-		return ReadMemory8(GetAddressingModeOffset_Read(mode));
-	}
+	const uint16_t lowByte = BusRead8<TTiming>(offset);
+	const uint16_t highByte = BusRead8<TTiming>(offset + 1);
+
+	return (highByte << 8) | lowByte;
+}
+
+template <typename TTiming>
+void Cpu6502::BusWrite8(uint16_t offset, uint8_t value)
+{
+	WriteMemory8(offset, value, TTiming::GetBusCycle(*this));
+	TTiming::AddBusCycle(*this);
 }
 
+
+template <typename TTiming>
 uint16_t Cpu6502::GetIndexedIndirectOffset()
 {
-	uint8_t zpOffset = ReadMemory8(m_pc++);
+	uint8_t zpOffset = BusRead8<TTiming>(m_pc++);
+	TTiming::AddBusCycle(*this); // Dummy read while adding X
 	zpOffset += m_x;
 
 	// We have to make sure to continue zero page indexing for the 16-bit offset so we wrap at $00FF
-	uint8_t indirectOffsetLow = ReadMemory8(zpOffset++);
-	uint8_t indirectOffsetHigh = ReadMemory8(zpOffset);
+	uint8_t indirectOffsetLow = BusRead8<TTiming>(zpOffset++);
+	uint8_t indirectOffsetHigh = BusRead8<TTiming>(zpOffset);
 	uint16_t indirectOffset = (indirectOffsetHigh << 8) | indirectOffsetLow;
 	return indirectOffset;
 }
 
+template <typename TTiming>
 uint16_t Cpu6502::GetIndirectIndexedOffset_Read()
 {
-	uint8_t zpOffset = ReadMemory8(m_pc++);
+	uint8_t zpOffset = BusRead8<TTiming>(m_pc++);
 
 	// We have to make sure to continue zero page indexing for the 16-bit offset so we wrap at $00FF
-	uint8_t indirectOffsetLow = ReadMemory8(zpOffset++);
-	uint8_t indirectOffsetHigh = ReadMemory8(zpOffset);
+	uint8_t indirectOffsetLow = BusRead8<TTiming>(zpOffset++);
+	uint8_t indirectOffsetHigh = BusRead8<TTiming>(zpOffset);
 	uint16_t indirectOffset = (indirectOffsetHigh << 8) | indirectOffsetLow;
 	uint16_t indirectOffsetAdjusted = indirectOffset + m_y;
 
@@ -292,192 +413,167 @@ uint16_t Cpu6502::GetIndirectIndexedOffset_Read()
 		// When the addressing crosses pages, we need an additional cycle to handle the
 		// add on the most significant byte
 		AddCycles(1);
+		TTiming::AddBusCycle(*this);
 	}
 	return indirectOffsetAdjusted;
 }
 
 
+template <typename TTiming>
 uint16_t Cpu6502::GetIndirectIndexedOffset_ReadWrite()
 {
-	uint8_t zpOffset = ReadMemory8(m_pc++);
+	uint8_t zpOffset = BusRead8<TTiming>(m_pc++);
 
 	// We have to make sure to continue zero page indexing for the 16-bit offset so we wrap at $00FF
-	uint8_t indirectOffsetLow = ReadMemory8(zpOffset++);
-	uint8_t indirectOffsetHigh = ReadMemory8(zpOffset);
+	uint8_t indirectOffsetLow = BusRead8<TTiming>(zpOffset++);
+	uint8_t indirectOffsetHigh = BusRead8<TTiming>(zpOffset);
 	uint16_t indirectOffset = (indirectOffsetHigh << 8) | indirectOffsetLow;
 	uint16_t indirectOffsetAdjusted = indirectOffset + m_y;
+	TTiming::AddBusCycle(*this); // Always reads the unfixed address first
 	return indirectOffsetAdjusted;
 }
 
-uint16_t Cpu6502::ReadUInt16(AddressingMode mode)
-{
-	if (mode == AddressingMode::ABS)
-	{
-		uint16_t value = ReadMemory16(m_pc);
-		m_pc += 2;
-		return value;
-	}
-	else if (mode == AddressingMode::ZPX)
-	{
-		return ReadMemory16(GetAddressingModeOffset_Read(mode));
-	}
-	else if (mode == AddressingMode::ZP)
-	{
-		return ReadMemory16(GetAddressingModeOffset_Read(mode));
-	}
-	else
-	{
-		throw UnhandledInstruction(0);
-	}
-}
-
-template <typename Func>
-void Cpu6502::ReadModifyWriteUint8(AddressingMode mode, Func func)
-{
-	uint8_t value;
-	uint16_t address;
-
-	if (mode == AddressingMode::ACC)
-	{
-		value = m_acc;
-	}
-	else
-	{
-		address = GetAddressingModeOffset_ReadWrite(mode);
-		value = ReadMemory8(address);
-
-		// Read-Modify-Write operations actually do a write back of the original value,
-		// this is important for suppressing multiple writes to certain mappers (MMC1)
-		WriteMemory8(address, value);
-	}
-
-	func(value);
-
-	if (mode == AddressingMode::ACC)
-		m_acc = value;
-	else
-		WriteMemory8(address, value);
 
-}
+/*-----------------------------------------------------------------------------
+	Addressing mode resolution
 
-uint16_t Cpu6502::GetAddressingModeOffset_Read(AddressingMode mode)
+	'mode' is a template parameter, so the switches below are resolved at compile time
+	and every opcode handler in the dispatch table is instantiated with straight-line
+	address calculation code.  The default cases are only reached for addressing modes
+	which don't make sense for the given operation.
+-------------------------------------------------------------------------------*/
+template <typename TTiming, AddressingMode mode>
+uint16_t Cpu6502::GetAddressingModeOffset_Read()
 {
-	if (mode == AddressingMode::ABS)
+	switch (mode)
 	{
-		uint16_t value = ReadMemory16(m_pc);
-		m_pc += 2;
-		return value;
-	}
-	else if (mode == AddressingMode::ABSX)
+	case AddressingMode::ABS:
 	{
-		uint16_t value = ReadMemory16(m_pc);
+		uint16_t value = BusRead16<TTiming>(m_pc);
 		m_pc += 2;
-		uint16_t adjustedValue = value + m_x;
-		if (((value ^ adjustedValue) & 0x100) != 0)
-			AddCycles(1); // Reads which have to adjust the most significant bit of the read address incur an additional cycle
-		return adjustedValue;
+		return value;
 	}
-	else if (mode == AddressingMode::ABSY)
+
+	case AddressingMode::ABSX:
+	case AddressingMode::ABSY:
 	{
-		uint16_t value = ReadMemory16(m_pc);
+		uint16_t value = BusRead16<TTiming>(m_pc);
 		m_pc += 2;
-		uint16_t adjustedValue = value + m_y;
+		uint16_t adjustedValue = value + ((mode == AddressingMode::ABSX) ? m_x : m_y);
 		if (((value ^ adjustedValue) & 0x100) != 0)
+		{
 			AddCycles(1); // Reads which have to adjust the most significant bit of the read address incur an additional cycle
+			TTiming::AddBusCycle(*this);
+		}
 		return adjustedValue;
 	}
-	else if (mode == AddressingMode::ZP)
+
+	case AddressingMode::ZP:
 	{
-		uint8_t zpOffset = ReadMemory8(m_pc++);
+		uint8_t zpOffset = BusRead8<TTiming>(m_pc++);
 		return static_cast<uint16_t>(zpOffset);
 	}
-	else if (mode == AddressingMode::ZPX)
-	{
-		uint8_t zpOffset = ReadMemory8(m_pc++);
-		uint8_t memoryOffset = zpOffset + m_x;
-		return memoryOffset;
-	}
-	else if (mode == AddressingMode::ZPY)
+
+	case AddressingMode::ZPX:
+	case AddressingMode::ZPY:
 	{
-		uint8_t zpOffset = ReadMemory8(m_pc++);
-		uint8_t memoryOffset = zpOffset + m_y;
+		uint8_t zpOffset = BusRead8<TTiming>(m_pc++);
+		TTiming::AddBusCycle(*this); // Dummy read while adding the index
+		uint8_t memoryOffset = zpOffset + ((mode == AddressingMode::ZPX) ? m_x : m_y);
 		return memoryOffset;
 	}
-	else if (mode == AddressingMode::_ZPX_)
-	{
-		return GetIndexedIndirectOffset();
-	}
-	else if (mode == AddressingMode::_ZP_Y)
-	{
-		return GetIndirectIndexedOffset_Read();
-	}
-	else if (mode == AddressingMode::IMM)
-	{
-		throw InvalidInstruction(0);  // Found in nestest.rom, invalid addressing mode for the given instructions
-	}
-	else
-	{
+
+	case AddressingMode::_ZPX_:
+		return GetIndexedIndirectOffset<TTiming>();
+
+	case AddressingMode::_ZP_Y:
+		return GetIndirectIndexedOffset_Read<TTiming>();
+
+	default:
 		throw UnhandledInstruction(0);
 	}
 }
 
-uint16_t Cpu6502::GetAddressingModeOffset_ReadWrite(AddressingMode mode)
+
+// Writes (and read-modify-writes) always pay for the page cross, so the base cycle count
+// in the opcode table already includes it and we don't adjust the cycle count here.
+template <typename TTiming, AddressingMode mode>
+uint16_t Cpu6502::GetAddressingModeOffset_ReadWrite()
 {
-	if (mode == AddressingMode::ABS)
+	switch (mode)
 	{
-		uint16_t value = ReadMemory16(m_pc);
-		m_pc += 2;
-		return value;
-	}
-	else if (mode == AddressingMode::ABSX)
-	{
-		uint16_t value = ReadMemory16(m_pc);
-		m_pc += 2;
-		value += m_x;
-		return value;
-	}
-	else if (mode == AddressingMode::ABSY)
+	case AddressingMode::ABSX:
+	case AddressingMode::ABSY:
 	{
-		uint16_t value = ReadMemory16(m_pc);
+		uint16_t value = BusRead16<TTiming>(m_pc);
 		m_pc += 2;
-		value += m_y;
+		value += (mode == AddressingMode::ABSX) ? m_x : m_y;
+		TTiming::AddBusCycle(*this); // Always reads the unfixed address first
 		return value;
 	}
-	else if (mode == AddressingMode::ZPX)
-	{
-		uint8_t zpOffset = ReadMemory8(m_pc++);
-		uint8_t memoryOffset = zpOffset + m_x;
-		return memoryOffset;
-	}
-	else if (mode == AddressingMode::ZPY)
-	{
-		uint8_t zpOffset = ReadMemory8(m_pc++);
-		uint8_t memoryOffset = zpOffset + m_y;
-		return memoryOffset;
-	}
-	else if (mode == AddressingMode::ZP)
-	{
-		uint8_t zpOffset = ReadMemory8(m_pc++);
-		return static_cast<uint16_t>(zpOffset);
-	}
-	else if (mode == AddressingMode::_ZPX_)
-	{
-		return GetIndexedIndirectOffset();
+
+	case AddressingMode::_ZP_Y:
+		return GetIndirectIndexedOffset_ReadWrite<TTiming>();
+
+	default:
+		// ABS, ZP, ZPX, ZPY and (ZP,X) have no page crossing penalty, so they are identical to reads
+		return GetAddressingModeOffset_Read<TTiming, mode>();
 	}
-	else if (mode == AddressingMode::_ZP_Y)
+}
+
+
+template <typename TTiming, AddressingMode mode>
+uint8_t Cpu6502::ReadUInt8()
+{
+	switch (mode)
 	{
-		return GetIndirectIndexedOffset_ReadWrite();
+	case AddressingMode::IMM:
+		return BusRead8<TTiming>(m_pc++);
+
+	case AddressingMode::ACC:
+		return m_acc;
+
+	default:
+		return BusRead8<TTiming>(GetAddressingModeOffset_Read<TTiming, mode>());
 	}
-	else if (mode == AddressingMode::IMM)
+}
+
+
+template <typename TTiming, AddressingMode mode>
+uint16_t Cpu6502::ReadUInt16()
+{
+	if (mode == AddressingMode::ABS)
 	{
-		throw InvalidInstruction(0);  // Found in nestest.rom, invalid addressing mode for the given instructions
+		uint16_t value = BusRead16<TTiming>(m_pc);
+		m_pc += 2;
+		return value;
 	}
-	else
+
+	return BusRead16<TTiming>(GetAddressingModeOffset_Read<TTiming, mode>());
+}
+
+
+template <typename TTiming, AddressingMode mode, typename Func>
+void Cpu6502::ReadModifyWriteUint8(Func func)
+{
+	// 'mode' is a template parameter, so the accumulator check is resolved at compile time
+	if (mode == AddressingMode::ACC)
 	{
-		throw UnhandledInstruction(0);
+		func(m_acc);
+		return;
 	}
-}
 
+	const uint16_t address = GetAddressingModeOffset_ReadWrite<TTiming, mode>();
+	uint8_t value = BusRead8<TTiming>(address);
+
+	// Read-Modify-Write operations actually do a write back of the original value,
+	// this is important for suppressing multiple writes to certain mappers (MMC1)
+	BusWrite8<TTiming>(address, value);
+
+	func(value);
+
+	BusWrite8<TTiming>(address, value);
+}
 
 bool IsNegative(uint8_t val)
 {
@@ -486,23 +582,33 @@ bool IsNegative(uint8_t val)
 
 void Cpu6502::SetStatusFlagsFromValue(uint8_t value)
 {
-	// Set the zero and negative flags of the cpu
-	
-	// Mask off the status bits we're setting, and or in the new status bits
-	CpuStatusFlag newFlags = CpuStatusFlag::None;
-	
-	if (IsNegative(value))
-		newFlags = newFlags | CpuStatusFlag::Negative;
-	else if (value == 0)
-		newFlags = newFlags | CpuStatusFlag::Zero;
+	// Set the zero and negative flags of the cpu.  These are only evaluated when someone looks at them.
+	m_negativeResult = value;
+	m_zeroResult = value;
+}
+
+uint8_t Cpu6502::GetStatus() const
+{
+	return (m_status & ~static_cast<uint8_t>(CpuStatusFlag::Negative | CpuStatusFlag::Zero))
+		| (m_negativeResult & static_cast<uint8_t>(CpuStatusFlag::Negative))
+		| (IsZeroFlagSet() ? static_cast<uint8_t>(CpuStatusFlag::Zero) : 0);
+}
 
-	SetStatusFlags(newFlags, (CpuStatusFlag::Negative | CpuStatusFlag::Zero));
+void Cpu6502::SetStatus(uint8_t status)
+{
+	m_status = status;
+	SetStatusFlags(static_cast<CpuStatusFlag>(status), CpuStatusFlag::Negative | CpuStatusFlag::Zero);
 }
 
 void Cpu6502::SetStatusFlags(CpuStatusFlag flags, CpuStatusFlag mask)
 {
 	m_status = (m_status & ~static_cast<uint8_t>(mask)) | static_cast<uint8_t>(flags);
 
+	if ((mask & CpuStatusFlag::Negative) != CpuStatusFlag::None)
+		m_negativeResult = static_cast<uint8_t>(flags & CpuStatusFlag::Negative);
+	if ((mask & CpuStatusFlag::Zero) != CpuStatusFlag::None)
+		m_zeroResult = ((flags & CpuStatusFlag::Zero) != CpuStatusFlag::None) ? 0 : 1;
+
 }
 
 static uint8_t AddressingModeFromInstruction(uint8_t instruction)
@@ -585,10 +691,13 @@ uint16_t Cpu6502::ReadValueFromStack16()
 const char* Cpu6502::GetDebugState() const
 {
 	static char s_debugStateBuffer[128];
-	const uint8_t instruction = ReadMemory8(m_pc);
+
+	// Peeked rather than read, so showing the state doesn't change the open bus value; PCs in I/O space show 00
+	uint8_t instruction = 0;
+	PeekMemory8(m_pc, &instruction);
 
 	sprintf_s(s_debugStateBuffer, _countof(s_debugStateBuffer), "%04hX  %02hhX A:%02hhX X:%02hhX Y:%02hhX P:%02hhX SP:%02hhX CYC:%3d SL:%d\n", m_pc, instruction,
-		m_acc, m_x, m_y, m_status, m_sp, m_ppu.GetCycles(), m_ppu.GetScanline());
+		m_acc, m_x, m_y, GetStatus(), m_sp, m_ppu.GetCycles(), m_ppu.GetScanline());
 
 	return s_debugStateBuffer;
 }
@@ -596,16 +705,8 @@ const char* Cpu6502::GetDebugState() const
 
 void Cpu6502::CompareValues(uint8_t minuend, uint8_t subtrahend)
 {
-	CpuStatusFlag newFlags = CpuStatusFlag::None;
-
-	if (minuend >= subtrahend) // Carry flags
-		newFlags = newFlags | CpuStatusFlag::Carry;
-	if (minuend == subtrahend)
-		newFlags = newFlags | CpuStatusFlag::Zero;
-	if (((minuend - subtrahend) & 0x80) != 0)
-		newFlags = newFlags | CpuStatusFlag::Negative;
-
-	SetStatusFlags(newFlags, CpuStatusFlag::Carry | CpuStatusFlag::Zero | CpuStatusFlag::Negative);
+	SetStatusFlagsFromValue(static_cast<uint8_t>(minuend - subtrahend));
+	SetStatusFlags((minuend >= subtrahend) ? CpuStatusFlag::Carry : CpuStatusFlag::None, CpuStatusFlag::Carry);
 }
 
 /*-----------------------------------------------------------------------------
@@ -631,10 +732,6 @@ void Cpu6502::AddWithCarry(uint8_t x, uint8_t y)
 
 	if (wideSignedResult < -128 || wideSignedResult > 127) // Signed overflow
 		newStatusFlags |= CpuStatusFlag::Overflow;
-	if (IsNegative(result))
-		newStatusFlags |= CpuStatusFlag::Negative;
-	if (result == 0)
-		newStatusFlags |= CpuStatusFlag::Zero;
 
 	if (wideUnsignedResult >= 256)
 	{
@@ -642,290 +739,408 @@ void Cpu6502::AddWithCarry(uint8_t x, uint8_t y)
 		newStatusFlags |= CpuStatusFlag::Carry;
 	}
 
-	SetStatusFlags(newStatusFlags, CpuStatusFlag::Overflow | CpuStatusFlag::Carry | CpuStatusFlag::Negative | CpuStatusFlag::Zero);
+	SetStatusFlags(newStatusFlags, CpuStatusFlag::Overflow | CpuStatusFlag::Carry);
 	m_acc = result;
 }
 
-Cpu6502::OpCodeTableEntry* Cpu6502::DoOpcodeStuff(uint8_t opCode)
+// Dense opcode table (one per timing policy), indexed directly by the opcode byte so that
+// dispatch is a single indexed load.  Undefined/unofficial opcodes route to Instruction_Unhandled.
+template <typename TTiming>
+const Cpu6502::OpCodeTableEntry* Cpu6502::GetOpCodeTable()
 {
-	static Cpu6502::OpCodeTableEntry s_opCodeTable[] = {
+	static const OpCodeTableEntry s_opCodeTable[256] = {
 		{ 0x00 /*BRK*/, 7, &Cpu6502::Instruction_Break, AddressingMode::IMP},
-		{ 0x01 /*ORA*/, 6, &Cpu6502::Instruction_OrWithAccumulator, AddressingMode::_ZPX_},
-		{ 0x05 /*ORA*/, 3, &Cpu6502::Instruction_OrWithAccumulator, AddressingMode::ZP},
-		{ 0x06 /*ASL*/, 5, &Cpu6502::Instruction_ArithmeticShiftLeft, AddressingMode::ZP},
+		{ 0x01 /*ORA*/, 6, &Cpu6502::Instruction_OrWithAccumulator<TTiming, AddressingMode::_ZPX_>, AddressingMode::_ZPX_},
+		{ 0x02 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x03 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x04 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x05 /*ORA*/, 3, &Cpu6502::Instruction_OrWithAccumulator<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x06 /*ASL*/, 5, &Cpu6502::Instruction_ArithmeticShiftLeft<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x07 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x08 /*PHP*/, 3, &Cpu6502::Instruction_PushProcessorStatus, AddressingMode::IMP},
-		{ 0x09 /*ORA*/, 2, &Cpu6502::Instruction_OrWithAccumulator, AddressingMode::IMM},
-		{ 0x0A /*ASL*/, 2, &Cpu6502::Instruction_ArithmeticShiftLeft, AddressingMode::ACC},
-		{ 0x0D /*ORA*/, 4, &Cpu6502::Instruction_OrWithAccumulator, AddressingMode::ABS},
-		{ 0x0E /*ASL*/, 6, &Cpu6502::Instruction_ArithmeticShiftLeft, AddressingMode::ABS},
+		{ 0x09 /*ORA*/, 2, &Cpu6502::Instruction_OrWithAccumulator<TTiming, AddressingMode::IMM>, AddressingMode::IMM},
+		{ 0x0A /*ASL*/, 2, &Cpu6502::Instruction_ArithmeticShiftLeft<TTiming, AddressingMode::ACC>, AddressingMode::ACC},
+		{ 0x0B /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x0C /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x0D /*ORA*/, 4, &Cpu6502::Instruction_OrWithAccumulator<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x0E /*ASL*/, 6, &Cpu6502::Instruction_ArithmeticShiftLeft<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x0F /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x10 /*BPL*/, 2, &Cpu6502::Instruction_BranchOnPlus, AddressingMode::IMP},
-		{ 0x11 /*ORA*/, 5, &Cpu6502::Instruction_OrWithAccumulator, AddressingMode::_ZP_Y},
-		{ 0x15 /*ORA*/, 4, &Cpu6502::Instruction_OrWithAccumulator, AddressingMode::ZPX},
-		{ 0x16 /*ASL*/, 6, &Cpu6502::Instruction_ArithmeticShiftLeft, AddressingMode::ZPX},
+		{ 0x11 /*ORA*/, 5, &Cpu6502::Instruction_OrWithAccumulator<TTiming, AddressingMode::_ZP_Y>, AddressingMode::_ZP_Y},
+		{ 0x12 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x13 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x14 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x15 /*ORA*/, 4, &Cpu6502::Instruction_OrWithAccumulator<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0x16 /*ASL*/, 6, &Cpu6502::Instruction_ArithmeticShiftLeft<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0x17 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x18 /*CLC*/, 2, &Cpu6502::Instruction_ClearCarry, AddressingMode::IMP},
-		{ 0x19 /*ORA*/, 4, &Cpu6502::Instruction_OrWithAccumulator, AddressingMode::ABSY},
-		{ 0x1D /*ORA*/, 4, &Cpu6502::Instruction_OrWithAccumulator, AddressingMode::ABSX},
-		{ 0x1E /*ASL*/, 7, &Cpu6502::Instruction_ArithmeticShiftLeft, AddressingMode::ABSX},
-		{ 0x20 /*JSR*/, 6, &Cpu6502::Instruction_JumpToSubroutine, AddressingMode::ABS},
-		{ 0x21 /*AND*/, 6, &Cpu6502::Instruction_And, AddressingMode::_ZPX_},
-		{ 0x24 /*BIT*/, 3, &Cpu6502::Instruction_TestBits, AddressingMode::ZP},
-		{ 0x25 /*AND*/, 3, &Cpu6502::Instruction_And, AddressingMode::ZP},
-		{ 0x26 /*ROL*/, 5, &Cpu6502::Instruction_RotateLeft, AddressingMode::ZP},
+		{ 0x19 /*ORA*/, 4, &Cpu6502::Instruction_OrWithAccumulator<TTiming, AddressingMode::ABSY>, AddressingMode::ABSY},
+		{ 0x1A /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x1B /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x1C /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x1D /*ORA*/, 4, &Cpu6502::Instruction_OrWithAccumulator<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0x1E /*ASL*/, 7, &Cpu6502::Instruction_ArithmeticShiftLeft<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0x1F /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x20 /*JSR*/, 6, &Cpu6502::Instruction_JumpToSubroutine<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x21 /*AND*/, 6, &Cpu6502::Instruction_And<TTiming, AddressingMode::_ZPX_>, AddressingMode::_ZPX_},
+		{ 0x22 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x23 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x24 /*BIT*/, 3, &Cpu6502::Instruction_TestBits<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x25 /*AND*/, 3, &Cpu6502::Instruction_And<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x26 /*ROL*/, 5, &Cpu6502::Instruction_RotateLeft<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x27 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x28 /*PLP*/, 4, &Cpu6502::Instruction_PullProcessorStatus, AddressingMode::IMP},
-		{ 0x29 /*AND*/, 2, &Cpu6502::Instruction_And, AddressingMode::IMM},
-		{ 0x2A /*ROL*/, 2, &Cpu6502::Instruction_RotateLeft, AddressingMode::ACC},
-		{ 0x2C /*BIT*/, 4, &Cpu6502::Instruction_TestBits, AddressingMode::ABS},
-		{ 0x2D /*AND*/, 4, &Cpu6502::Instruction_And, AddressingMode::ABS},
-		{ 0x2E /*ROL*/, 6, &Cpu6502::Instruction_RotateLeft, AddressingMode::ABS},
+		{ 0x29 /*AND*/, 2, &Cpu6502::Instruction_And<TTiming, AddressingMode::IMM>, AddressingMode::IMM},
+		{ 0x2A /*ROL*/, 2, &Cpu6502::Instruction_RotateLeft<TTiming, AddressingMode::ACC>, AddressingMode::ACC},
+		{ 0x2B /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x2C /*BIT*/, 4, &Cpu6502::Instruction_TestBits<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x2D /*AND*/, 4, &Cpu6502::Instruction_And<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x2E /*ROL*/, 6, &Cpu6502::Instruction_RotateLeft<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x2F /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x30 /*BMI*/, 2, &Cpu6502::Instruction_BranchOnMinus, AddressingMode::IMP},
-		{ 0x31 /*AND*/, 5, &Cpu6502::Instruction_And, AddressingMode::_ZP_Y},
-		{ 0x35 /*AND*/, 4, &Cpu6502::Instruction_And, AddressingMode::ZPX},
-		{ 0x36 /*ROL*/, 6, &Cpu6502::Instruction_RotateLeft, AddressingMode::ZPX},
+		{ 0x31 /*AND*/, 5, &Cpu6502::Instruction_And<TTiming, AddressingMode::_ZP_Y>, AddressingMode::_ZP_Y},
+		{ 0x32 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x33 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x34 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x35 /*AND*/, 4, &Cpu6502::Instruction_And<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0x36 /*ROL*/, 6, &Cpu6502::Instruction_RotateLeft<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0x37 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x38 /*SEC*/, 2, &Cpu6502::Instruction_SetCarry, AddressingMode::IMP},
-		{ 0x39 /*AND*/, 4, &Cpu6502::Instruction_And, AddressingMode::ABSY},
-		{ 0x3D /*AND*/, 4, &Cpu6502::Instruction_And, AddressingMode::ABSX},
-		{ 0x3E /*ROL*/, 7, &Cpu6502::Instruction_RotateLeft, AddressingMode::ABSX},
+		{ 0x39 /*AND*/, 4, &Cpu6502::Instruction_And<TTiming, AddressingMode::ABSY>, AddressingMode::ABSY},
+		{ 0x3A /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x3B /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x3C /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x3D /*AND*/, 4, &Cpu6502::Instruction_And<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0x3E /*ROL*/, 7, &Cpu6502::Instruction_RotateLeft<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0x3F /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x40 /*RTI*/, 6, &Cpu6502::Instruction_ReturnFromInterrupt, AddressingMode::IMP},
-		{ 0x41 /*EOR*/, 6, &Cpu6502::Instruction_ExclusiveOr, AddressingMode::_ZPX_},
-		{ 0x45 /*EOR*/, 3, &Cpu6502::Instruction_ExclusiveOr, AddressingMode::ZP},
-		{ 0x46 /*LSR*/, 5, &Cpu6502::Instruction_LogicalShiftRight, AddressingMode::ZP},
+		{ 0x41 /*EOR*/, 6, &Cpu6502::Instruction_ExclusiveOr<TTiming, AddressingMode::_ZPX_>, AddressingMode::_ZPX_},
+		{ 0x42 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x43 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x44 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x45 /*EOR*/, 3, &Cpu6502::Instruction_ExclusiveOr<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x46 /*LSR*/, 5, &Cpu6502::Instruction_LogicalShiftRight<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x47 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x48 /*PHA*/, 3, &Cpu6502::Instruction_PushAccumulator, AddressingMode::IMP},
-		{ 0x49 /*EOR*/, 2, &Cpu6502::Instruction_ExclusiveOr, AddressingMode::IMM},
-		{ 0x4A /*LSR*/, 2, &Cpu6502::Instruction_LogicalShiftRight, AddressingMode::ACC},
-		{ 0x4C /*JMP*/, 3, &Cpu6502::Instruction_Jump, AddressingMode::ABS},
-		{ 0x4D /*EOR*/, 4, &Cpu6502::Instruction_ExclusiveOr, AddressingMode::ABS},
-		{ 0x4E /*LSR*/, 6, &Cpu6502::Instruction_LogicalShiftRight, AddressingMode::ABS},
+		{ 0x49 /*EOR*/, 2, &Cpu6502::Instruction_ExclusiveOr<TTiming, AddressingMode::IMM>, AddressingMode::IMM},
+		{ 0x4A /*LSR*/, 2, &Cpu6502::Instruction_LogicalShiftRight<TTiming, AddressingMode::ACC>, AddressingMode::ACC},
+		{ 0x4B /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x4C /*JMP*/, 3, &Cpu6502::Instruction_Jump<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x4D /*EOR*/, 4, &Cpu6502::Instruction_ExclusiveOr<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x4E /*LSR*/, 6, &Cpu6502::Instruction_LogicalShiftRight<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x4F /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x50 /*BVC*/, 2, &Cpu6502::Instruction_BranchOnOverflowClear, AddressingMode::IMP},
-		{ 0x51 /*EOR*/, 5, &Cpu6502::Instruction_ExclusiveOr, AddressingMode::_ZP_Y},
-		{ 0x55 /*EOR*/, 4, &Cpu6502::Instruction_ExclusiveOr, AddressingMode::ZPX},
-		{ 0x56 /*LSR*/, 6, &Cpu6502::Instruction_LogicalShiftRight, AddressingMode::ZPX},
+		{ 0x51 /*EOR*/, 5, &Cpu6502::Instruction_ExclusiveOr<TTiming, AddressingMode::_ZP_Y>, AddressingMode::_ZP_Y},
+		{ 0x52 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x53 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x54 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x55 /*EOR*/, 4, &Cpu6502::Instruction_ExclusiveOr<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0x56 /*LSR*/, 6, &Cpu6502::Instruction_LogicalShiftRight<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0x57 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x58 /*CLI*/, 2, &Cpu6502::Instruction_ClearInterrupt, AddressingMode::IMP},
-		{ 0x59 /*EOR*/, 4, &Cpu6502::Instruction_ExclusiveOr, AddressingMode::ABSY},
-		{ 0x5D /*EOR*/, 4, &Cpu6502::Instruction_ExclusiveOr, AddressingMode::ABSX},
-		{ 0x5E /*LSR*/, 7, &Cpu6502::Instruction_LogicalShiftRight, AddressingMode::ABSX},
+		{ 0x59 /*EOR*/, 4, &Cpu6502::Instruction_ExclusiveOr<TTiming, AddressingMode::ABSY>, AddressingMode::ABSY},
+		{ 0x5A /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x5B /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x5C /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x5D /*EOR*/, 4, &Cpu6502::Instruction_ExclusiveOr<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0x5E /*LSR*/, 7, &Cpu6502::Instruction_LogicalShiftRight<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0x5F /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x60 /*RTS*/, 6, &Cpu6502::Instruction_ReturnFromSubroutine, AddressingMode::IMP},
-		{ 0x61 /*ADC*/, 6, &Cpu6502::Instruction_AddWithCarry, AddressingMode::_ZPX_},
-		{ 0x65 /*ADC*/, 3, &Cpu6502::Instruction_AddWithCarry, AddressingMode::ZP},
-		{ 0x66 /*ROR*/, 5, &Cpu6502::Instruction_RotateRight, AddressingMode::ZP},
+		{ 0x61 /*ADC*/, 6, &Cpu6502::Instruction_AddWithCarry<TTiming, AddressingMode::_ZPX_>, AddressingMode::_ZPX_},
+		{ 0x62 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x63 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x64 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x65 /*ADC*/, 3, &Cpu6502::Instruction_AddWithCarry<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x66 /*ROR*/, 5, &Cpu6502::Instruction_RotateRight<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x67 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x68 /*PLA*/, 4, &Cpu6502::Instruction_PullAccumulator, AddressingMode::IMP},
-		{ 0x69 /*ADC*/, 2, &Cpu6502::Instruction_AddWithCarry, AddressingMode::IMM},
-		{ 0x6A /*ROR*/, 2, &Cpu6502::Instruction_RotateRight, AddressingMode::ACC},
-		{ 0x6C /*JMP*/, 5, &Cpu6502::Instruction_JumpIndirect, AddressingMode::ABS},
-		{ 0x6D /*ADC*/, 4, &Cpu6502::Instruction_AddWithCarry, AddressingMode::ABS},
-		{ 0x6E /*ROR*/, 6, &Cpu6502::Instruction_RotateRight, AddressingMode::ABS},
+		{ 0x69 /*ADC*/, 2, &Cpu6502::Instruction_AddWithCarry<TTiming, AddressingMode::IMM>, AddressingMode::IMM},
+		{ 0x6A /*ROR*/, 2, &Cpu6502::Instruction_RotateRight<TTiming, AddressingMode::ACC>, AddressingMode::ACC},
+		{ 0x6B /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x6C /*JMP*/, 5, &Cpu6502::Instruction_JumpIndirect<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x6D /*ADC*/, 4, &Cpu6502::Instruction_AddWithCarry<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x6E /*ROR*/, 6, &Cpu6502::Instruction_RotateRight<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x6F /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x70 /*BVS*/, 2, &Cpu6502::Instruction_BranchOnOverflowSet, AddressingMode::IMP},
-		{ 0x71 /*ADC*/, 5, &Cpu6502::Instruction_AddWithCarry, AddressingMode::_ZP_Y},
-		{ 0x75 /*ADC*/, 4, &Cpu6502::Instruction_AddWithCarry, AddressingMode::ZPX},
-		{ 0x76 /*ROR*/, 6, &Cpu6502::Instruction_RotateRight, AddressingMode::ZPX},
+		{ 0x71 /*ADC*/, 5, &Cpu6502::Instruction_AddWithCarry<TTiming, AddressingMode::_ZP_Y>, AddressingMode::_ZP_Y},
+		{ 0x72 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x73 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x74 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x75 /*ADC*/, 4, &Cpu6502::Instruction_AddWithCarry<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0x76 /*ROR*/, 6, &Cpu6502::Instruction_RotateRight<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0x77 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x78 /*SEI*/, 2, &Cpu6502::Instruction_SetInterrupt, AddressingMode::IMP},
-		{ 0x79 /*ADC*/, 4, &Cpu6502::Instruction_AddWithCarry, AddressingMode::ABSY},
-		{ 0x7D /*ADC*/, 4, &Cpu6502::Instruction_AddWithCarry, AddressingMode::ABSX},
-		{ 0x7E /*ROR*/, 7, &Cpu6502::Instruction_RotateRight, AddressingMode::ABSX},
-		{ 0x81 /*STA*/, 6, &Cpu6502::Instruction_StoreAccumulator, AddressingMode::_ZPX_},
-		{ 0x84 /*STY*/, 3, &Cpu6502::Instruction_StoreY, AddressingMode::ZP},
-		{ 0x85 /*STA*/, 3, &Cpu6502::Instruction_StoreAccumulator, AddressingMode::ZP},
-		{ 0x86 /*STX*/, 3, &Cpu6502::Instruction_StoreX, AddressingMode::ZP},
+		{ 0x79 /*ADC*/, 4, &Cpu6502::Instruction_AddWithCarry<TTiming, AddressingMode::ABSY>, AddressingMode::ABSY},
+		{ 0x7A /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x7B /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x7C /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x7D /*ADC*/, 4, &Cpu6502::Instruction_AddWithCarry<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0x7E /*ROR*/, 7, &Cpu6502::Instruction_RotateRight<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0x7F /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x80 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x81 /*STA*/, 6, &Cpu6502::Instruction_StoreAccumulator<TTiming, AddressingMode::_ZPX_>, AddressingMode::_ZPX_},
+		{ 0x82 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x83 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x84 /*STY*/, 3, &Cpu6502::Instruction_StoreY<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x85 /*STA*/, 3, &Cpu6502::Instruction_StoreAccumulator<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x86 /*STX*/, 3, &Cpu6502::Instruction_StoreX<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0x87 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x88 /*DEY*/, 2, &Cpu6502::Instruction_DecrementY, AddressingMode::IMP},
+		{ 0x89 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x8A /*TXA*/, 2, &Cpu6502::Instruction_TransferXtoA, AddressingMode::IMP},
-		{ 0x8C /*STY*/, 4, &Cpu6502::Instruction_StoreY, AddressingMode::ABS},
-		{ 0x8D /*STA*/, 4, &Cpu6502::Instruction_StoreAccumulator, AddressingMode::ABS},
-		{ 0x8E /*STX*/, 4, &Cpu6502::Instruction_StoreX, AddressingMode::ABS},
+		{ 0x8B /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x8C /*STY*/, 4, &Cpu6502::Instruction_StoreY<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x8D /*STA*/, 4, &Cpu6502::Instruction_StoreAccumulator<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x8E /*STX*/, 4, &Cpu6502::Instruction_StoreX<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0x8F /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x90 /*BCC*/, 2, &Cpu6502::Instruction_BranchOnCarryClear, AddressingMode::IMP},
-		{ 0x91 /*STA*/, 6, &Cpu6502::Instruction_StoreAccumulator, AddressingMode::_ZP_Y},
-		{ 0x94 /*STY*/, 4, &Cpu6502::Instruction_StoreY, AddressingMode::ZPX},
-		{ 0x95 /*STA*/, 4, &Cpu6502::Instruction_StoreAccumulator, AddressingMode::ZPX},
-		{ 0x96 /*STX*/, 4, &Cpu6502::Instruction_StoreX, AddressingMode::ZPY},
+		{ 0x91 /*STA*/, 6, &Cpu6502::Instruction_StoreAccumulator<TTiming, AddressingMode::_ZP_Y>, AddressingMode::_ZP_Y},
+		{ 0x92 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x93 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x94 /*STY*/, 4, &Cpu6502::Instruction_StoreY<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0x95 /*STA*/, 4, &Cpu6502::Instruction_StoreAccumulator<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0x96 /*STX*/, 4, &Cpu6502::Instruction_StoreX<TTiming, AddressingMode::ZPY>, AddressingMode::ZPY},
+		{ 0x97 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0x98 /*TYA*/, 2, &Cpu6502::Instruction_TransferYtoA, AddressingMode::IMP},
-		{ 0x99 /*STA*/, 5, &Cpu6502::Instruction_StoreAccumulator, AddressingMode::ABSY},
+		{ 0x99 /*STA*/, 5, &Cpu6502::Instruction_StoreAccumulator<TTiming, AddressingMode::ABSY>, AddressingMode::ABSY},
 		{ 0x9A /*TXS*/, 2, &Cpu6502::Instruction_TransferXToStack, AddressingMode::IMP},
-		{ 0x9D /*STA*/, 5, &Cpu6502::Instruction_StoreAccumulator, AddressingMode::ABSX},
-		{ 0xA0 /*LDY*/, 2, &Cpu6502::Instruction_LoadY, AddressingMode::IMM},
-		{ 0xA1 /*LDA*/, 6, &Cpu6502::Instruction_LoadAccumulator, AddressingMode::_ZPX_},
-		{ 0xA2 /*LDX*/, 2, &Cpu6502::Instruction_LoadX, AddressingMode::IMM},
-		{ 0xA4 /*LDY*/, 3, &Cpu6502::Instruction_LoadY, AddressingMode::ZP},
-		{ 0xA5 /*LDA*/, 3, &Cpu6502::Instruction_LoadAccumulator, AddressingMode::ZP},
-		{ 0xA6 /*LDX*/, 3, &Cpu6502::Instruction_LoadX, AddressingMode::ZP},
+		{ 0x9B /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x9C /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x9D /*STA*/, 5, &Cpu6502::Instruction_StoreAccumulator<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0x9E /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0x9F /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xA0 /*LDY*/, 2, &Cpu6502::Instruction_LoadY<TTiming, AddressingMode::IMM>, AddressingMode::IMM},
+		{ 0xA1 /*LDA*/, 6, &Cpu6502::Instruction_LoadAccumulator<TTiming, AddressingMode::_ZPX_>, AddressingMode::_ZPX_},
+		{ 0xA2 /*LDX*/, 2, &Cpu6502::Instruction_LoadX<TTiming, AddressingMode::IMM>, AddressingMode::IMM},
+		{ 0xA3 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xA4 /*LDY*/, 3, &Cpu6502::Instruction_LoadY<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0xA5 /*LDA*/, 3, &Cpu6502::Instruction_LoadAccumulator<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0xA6 /*LDX*/, 3, &Cpu6502::Instruction_LoadX<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0xA7 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0xA8 /*TAY*/, 2, &Cpu6502::Instruction_TransferAtoY, AddressingMode::IMP},
-		{ 0xA9 /*LDA*/, 2, &Cpu6502::Instruction_LoadAccumulator, AddressingMode::IMM},
+		{ 0xA9 /*LDA*/, 2, &Cpu6502::Instruction_LoadAccumulator<TTiming, AddressingMode::IMM>, AddressingMode::IMM},
 		{ 0xAA /*TAX*/, 2, &Cpu6502::Instruction_TransferAtoX, AddressingMode::IMP},
-		{ 0xAC /*LDY*/, 4, &Cpu6502::Instruction_LoadY, AddressingMode::ABS},
-		{ 0xAD /*LDA*/, 4, &Cpu6502::Instruction_LoadAccumulator, AddressingMode::ABS},
-		{ 0xAE /*LDX*/, 4, &Cpu6502::Instruction_LoadX, AddressingMode::ABS},
+		{ 0xAB /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xAC /*LDY*/, 4, &Cpu6502::Instruction_LoadY<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0xAD /*LDA*/, 4, &Cpu6502::Instruction_LoadAccumulator<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0xAE /*LDX*/, 4, &Cpu6502::Instruction_LoadX<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0xAF /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0xB0 /*BCS*/, 2, &Cpu6502::Instruction_BranchOnCarrySet, AddressingMode::IMP},
-		{ 0xB1 /*LDA*/, 5, &Cpu6502::Instruction_LoadAccumulator, AddressingMode::_ZP_Y},
-		{ 0xB4 /*LDY*/, 4, &Cpu6502::Instruction_LoadY, AddressingMode::ZPX},
-		{ 0xB5 /*LDA*/, 4, &Cpu6502::Instruction_LoadAccumulator, AddressingMode::ZPX},
-		{ 0xB6 /*LDX*/, 4, &Cpu6502::Instruction_LoadX, AddressingMode::ZPY},
+		{ 0xB1 /*LDA*/, 5, &Cpu6502::Instruction_LoadAccumulator<TTiming, AddressingMode::_ZP_Y>, AddressingMode::_ZP_Y},
+		{ 0xB2 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xB3 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xB4 /*LDY*/, 4, &Cpu6502::Instruction_LoadY<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0xB5 /*LDA*/, 4, &Cpu6502::Instruction_LoadAccumulator<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0xB6 /*LDX*/, 4, &Cpu6502::Instruction_LoadX<TTiming, AddressingMode::ZPY>, AddressingMode::ZPY},
+		{ 0xB7 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0xB8 /*CLV*/, 2, &Cpu6502::Instruction_ClearOverflow, AddressingMode::IMP},
-		{ 0xB9 /*LDA*/, 4, &Cpu6502::Instruction_LoadAccumulator, AddressingMode::ABSY},
+		{ 0xB9 /*LDA*/, 4, &Cpu6502::Instruction_LoadAccumulator<TTiming, AddressingMode::ABSY>, AddressingMode::ABSY},
 		{ 0xBA /*TSX*/, 2, &Cpu6502::Instruction_TransferStackToX, AddressingMode::IMP},
-		{ 0xBC /*LDX*/, 4, &Cpu6502::Instruction_LoadY, AddressingMode::ABSX},
-		{ 0xBD /*LDA*/, 4, &Cpu6502::Instruction_LoadAccumulator, AddressingMode::ABSX},
-		{ 0xBE /*LDX*/, 4, &Cpu6502::Instruction_LoadX, AddressingMode::ABSY},
-		{ 0xC0 /*CPY*/, 2, &Cpu6502::Instruction_CompareYRegister, AddressingMode::IMM},
-		{ 0xC1 /*CMP*/, 6, &Cpu6502::Instruction_Compare, AddressingMode::_ZPX_},
-		{ 0xC4 /*CPY*/, 3, &Cpu6502::Instruction_CompareYRegister, AddressingMode::ZP},
-		{ 0xC5 /*CMP*/, 3, &Cpu6502::Instruction_Compare, AddressingMode::ZP},
-		{ 0xC6 /*DEC*/, 5, &Cpu6502::Instruction_DecrementMemory, AddressingMode::ZP},
+		{ 0xBB /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xBC /*LDY*/, 4, &Cpu6502::Instruction_LoadY<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0xBD /*LDA*/, 4, &Cpu6502::Instruction_LoadAccumulator<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0xBE /*LDX*/, 4, &Cpu6502::Instruction_LoadX<TTiming, AddressingMode::ABSY>, AddressingMode::ABSY},
+		{ 0xBF /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xC0 /*CPY*/, 2, &Cpu6502::Instruction_CompareYRegister<TTiming, AddressingMode::IMM>, AddressingMode::IMM},
+		{ 0xC1 /*CMP*/, 6, &Cpu6502::Instruction_Compare<TTiming, AddressingMode::_ZPX_>, AddressingMode::_ZPX_},
+		{ 0xC2 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xC3 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xC4 /*CPY*/, 3, &Cpu6502::Instruction_CompareYRegister<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0xC5 /*CMP*/, 3, &Cpu6502::Instruction_Compare<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0xC6 /*DEC*/, 5, &Cpu6502::Instruction_DecrementMemory<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0xC7 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0xC8 /*INY*/, 2, &Cpu6502::Instruction_IncrementY, AddressingMode::IMP},
-		{ 0xC9 /*CMP*/, 2, &Cpu6502::Instruction_Compare, AddressingMode::IMM},
-		{ 0xCA /*DEY*/, 2, &Cpu6502::Instruction_DecrementX, AddressingMode::IMP},
-		{ 0xCC /*CPY*/, 4, &Cpu6502::Instruction_CompareYRegister, AddressingMode::ABS},
-		{ 0xCD /*CMP*/, 4, &Cpu6502::Instruction_Compare, AddressingMode::ABS},
-		{ 0xCE /*DEC*/, 6, &Cpu6502::Instruction_DecrementMemory, AddressingMode::ABS},
+		{ 0xC9 /*CMP*/, 2, &Cpu6502::Instruction_Compare<TTiming, AddressingMode::IMM>, AddressingMode::IMM},
+		{ 0xCA /*DEX*/, 2, &Cpu6502::Instruction_DecrementX, AddressingMode::IMP},
+		{ 0xCB /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xCC /*CPY*/, 4, &Cpu6502::Instruction_CompareYRegister<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0xCD /*CMP*/, 4, &Cpu6502::Instruction_Compare<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0xCE /*DEC*/, 6, &Cpu6502::Instruction_DecrementMemory<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0xCF /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0xD0 /*BNE*/, 2, &Cpu6502::Instruction_BranchOnNotEqual, AddressingMode::IMP},
-		{ 0xD1 /*CMP*/, 5, &Cpu6502::Instruction_Compare, AddressingMode::_ZP_Y},
-		{ 0xD5 /*CMP*/, 4, &Cpu6502::Instruction_Compare, AddressingMode::ZPX},
-		{ 0xD6 /*DEC*/, 6, &Cpu6502::Instruction_DecrementMemory, AddressingMode::ZPX},
+		{ 0xD1 /*CMP*/, 5, &Cpu6502::Instruction_Compare<TTiming, AddressingMode::_ZP_Y>, AddressingMode::_ZP_Y},
+		{ 0xD2 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xD3 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xD4 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xD5 /*CMP*/, 4, &Cpu6502::Instruction_Compare<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0xD6 /*DEC*/, 6, &Cpu6502::Instruction_DecrementMemory<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0xD7 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0xD8 /*CLD*/, 2, &Cpu6502::Instruction_ClearDecimal, AddressingMode::IMP},
-		{ 0xD9 /*CMP*/, 4, &Cpu6502::Instruction_Compare, AddressingMode::ABSY},
-		{ 0xDD /*CMP*/, 4, &Cpu6502::Instruction_Compare, AddressingMode::ABSX},
-		{ 0xDE /*DEC*/, 7, &Cpu6502::Instruction_DecrementMemory, AddressingMode::ABSX},
-		{ 0xE0 /*CPX*/, 2, &Cpu6502::Instruction_CompareXRegister, AddressingMode::IMM},
-		{ 0xE1 /*SBC*/, 6, &Cpu6502::Instruction_SubtractWithCarry, AddressingMode::_ZPX_},
-		{ 0xE4 /*CPX*/, 3, &Cpu6502::Instruction_CompareXRegister, AddressingMode::ZP},
-		{ 0xE5 /*SBC*/, 3, &Cpu6502::Instruction_SubtractWithCarry, AddressingMode::ZP},
-		{ 0xE6 /*INC*/, 5, &Cpu6502::Instruction_IncrementMemory, AddressingMode::ZP},
-		{ 0xE8 /*INY*/, 2, &Cpu6502::Instruction_IncrementX, AddressingMode::IMP},
-		{ 0xE9 /*SBC*/, 2, &Cpu6502::Instruction_SubtractWithCarry, AddressingMode::IMM},
+		{ 0xD9 /*CMP*/, 4, &Cpu6502::Instruction_Compare<TTiming, AddressingMode::ABSY>, AddressingMode::ABSY},
+		{ 0xDA /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xDB /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xDC /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xDD /*CMP*/, 4, &Cpu6502::Instruction_Compare<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0xDE /*DEC*/, 7, &Cpu6502::Instruction_DecrementMemory<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0xDF /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xE0 /*CPX*/, 2, &Cpu6502::Instruction_CompareXRegister<TTiming, AddressingMode::IMM>, AddressingMode::IMM},
+		{ 0xE1 /*SBC*/, 6, &Cpu6502::Instruction_SubtractWithCarry<TTiming, AddressingMode::_ZPX_>, AddressingMode::_ZPX_},
+		{ 0xE2 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xE3 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xE4 /*CPX*/, 3, &Cpu6502::Instruction_CompareXRegister<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0xE5 /*SBC*/, 3, &Cpu6502::Instruction_SubtractWithCarry<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0xE6 /*INC*/, 5, &Cpu6502::Instruction_IncrementMemory<TTiming, AddressingMode::ZP>, AddressingMode::ZP},
+		{ 0xE7 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xE8 /*INX*/, 2, &Cpu6502::Instruction_IncrementX, AddressingMode::IMP},
+		{ 0xE9 /*SBC*/, 2, &Cpu6502::Instruction_SubtractWithCarry<TTiming, AddressingMode::IMM>, AddressingMode::IMM},
 		{ 0xEA /*NOP*/, 2, &Cpu6502::Instruction_Noop, AddressingMode::IMP},
-		{ 0xEC /*CPX*/, 4, &Cpu6502::Instruction_CompareXRegister, AddressingMode::ABS},
-		{ 0xED /*SBC*/, 4, &Cpu6502::Instruction_SubtractWithCarry, AddressingMode::ABS},
-		{ 0xEE /*INC*/, 6, &Cpu6502::Instruction_IncrementMemory, AddressingMode::ABS},
+		{ 0xEB /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xEC /*CPX*/, 4, &Cpu6502::Instruction_CompareXRegister<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0xED /*SBC*/, 4, &Cpu6502::Instruction_SubtractWithCarry<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0xEE /*INC*/, 6, &Cpu6502::Instruction_IncrementMemory<TTiming, AddressingMode::ABS>, AddressingMode::ABS},
+		{ 0xEF /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0xF0 /*BEQ*/, 2, &Cpu6502::Instruction_BranchOnEqual, AddressingMode::IMP},
-		{ 0xF1 /*SBC*/, 5, &Cpu6502::Instruction_SubtractWithCarry, AddressingMode::_ZP_Y},
-		{ 0xF5 /*SBC*/, 4, &Cpu6502::Instruction_SubtractWithCarry, AddressingMode::ZPX},
-		{ 0xF6 /*INC*/, 6, &Cpu6502::Instruction_IncrementMemory, AddressingMode::ZPX},
+		{ 0xF1 /*SBC*/, 5, &Cpu6502::Instruction_SubtractWithCarry<TTiming, AddressingMode::_ZP_Y>, AddressingMode::_ZP_Y},
+		{ 0xF2 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xF3 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xF4 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xF5 /*SBC*/, 4, &Cpu6502::Instruction_SubtractWithCarry<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0xF6 /*INC*/, 6, &Cpu6502::Instruction_IncrementMemory<TTiming, AddressingMode::ZPX>, AddressingMode::ZPX},
+		{ 0xF7 /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 		{ 0xF8 /*SED*/, 2, &Cpu6502::Instruction_SetDecimal, AddressingMode::IMP},
-		{ 0xF9 /*SBC*/, 4, &Cpu6502::Instruction_SubtractWithCarry, AddressingMode::ABSY},
-		{ 0xFD /*SBC*/, 4, &Cpu6502::Instruction_SubtractWithCarry, AddressingMode::ABSX},
-		{ 0xFE /*INC*/, 7, &Cpu6502::Instruction_IncrementMemory, AddressingMode::ABSX},
+		{ 0xF9 /*SBC*/, 4, &Cpu6502::Instruction_SubtractWithCarry<TTiming, AddressingMode::ABSY>, AddressingMode::ABSY},
+		{ 0xFA /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xFB /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xFC /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
+		{ 0xFD /*SBC*/, 4, &Cpu6502::Instruction_SubtractWithCarry<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0xFE /*INC*/, 7, &Cpu6502::Instruction_IncrementMemory<TTiming, AddressingMode::ABSX>, AddressingMode::ABSX},
+		{ 0xFF /*???*/, 0, &Cpu6502::Instruction_Unhandled, AddressingMode::IMP},
 	};
 
-	auto iter = std::lower_bound(std::begin(s_opCodeTable), std::end(s_opCodeTable), opCode, [](const OpCodeTableEntry& entry, uint8_t opCode)
-	{
-		return entry.opCode < opCode;
-	});
+	return s_opCodeTable;
+}
 
-	if (iter == std::end(s_opCodeTable) || iter->opCode != opCode)
-		throw UnhandledInstruction(opCode);
-	else
-		return &*iter;
+
+const Cpu6502::OpCodeTableEntry* Cpu6502::GetPerInstructionOpCodeTable()
+{
+	return GetOpCodeTable<PerInstructionTiming>();
 }
 
 
-void Cpu6502::Instruction_Unhandled(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_Unhandled()
 {
-	throw InvalidInstruction(0);
+	// The opcode has already been consumed, so step back to report which one we choked on
+	throw UnhandledInstruction(ReadMemory8(m_pc - 1));
 }
 
-void Cpu6502::Instruction_Noop(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_Noop()
 {
 	// no-op
 }
 
-void Cpu6502::Instruction_Break(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_Break()
 {
-	m_pc++;
-	GenerateNonMaskableInterrupt();
+	// BRK skips a padding byte, and otherwise enters the IRQ handler like an IRQ does (with B set in the pushed status)
+	PushValueOntoStack16(m_pc + 1);
+	PushValueOntoStack8(GetStatus() | static_cast<uint8_t>(CpuStatusFlag::BreakCommand));
+	SetStatusFlags(CpuStatusFlag::InterruptDisabled, CpuStatusFlag::InterruptDisabled);
+	m_pc = ReadMemory16(static_cast<uint16_t>(0xFFFE));
 }
 
-void Cpu6502::Instruction_LoadAccumulator(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_LoadAccumulator()
 {
-	m_acc = ReadUInt8(addressingMode);
+	m_acc = ReadUInt8<TTiming, mode>();
 	SetStatusFlagsFromValue(m_acc);
 }
 
-void Cpu6502::Instruction_LoadX(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_LoadX()
 {
-	m_x = ReadUInt8(addressingMode);
+	m_x = ReadUInt8<TTiming, mode>();
 	SetStatusFlagsFromValue(m_x);
 }
 
-void Cpu6502::Instruction_LoadY(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_LoadY()
 {
-	m_y = ReadUInt8(addressingMode);
+	m_y = ReadUInt8<TTiming, mode>();
 	SetStatusFlagsFromValue(m_y);
 }
 
-void Cpu6502::Instruction_StoreAccumulator(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_StoreAccumulator()
 {
-	uint16_t writeOffset = GetAddressingModeOffset_ReadWrite(addressingMode);
-	WriteMemory8(writeOffset, m_acc);
+	uint16_t writeOffset = GetAddressingModeOffset_ReadWrite<TTiming, mode>();
+	BusWrite8<TTiming>(writeOffset, m_acc);
 }
 
-void Cpu6502::Instruction_Compare(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_Compare()
 {
-	CompareValues(m_acc, ReadUInt8(addressingMode));
+	CompareValues(m_acc, ReadUInt8<TTiming, mode>());
 }
 
-void Cpu6502::Instruction_CompareXRegister(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_CompareXRegister()
 {
-	CompareValues(m_x, ReadUInt8(addressingMode));
+	CompareValues(m_x, ReadUInt8<TTiming, mode>());
 }
 
-void Cpu6502::Instruction_CompareYRegister(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_CompareYRegister()
 {
-	CompareValues(m_y, ReadUInt8(addressingMode));
+	CompareValues(m_y, ReadUInt8<TTiming, mode>());
 }
 
-void Cpu6502::Instruction_TestBits(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_TestBits()
 {
-	uint8_t val = ReadUInt8(addressingMode);
-	CpuStatusFlag resultStatusFlags = CpuStatusFlag::None;
-	if ((val & m_acc) == 0)
-		resultStatusFlags |= CpuStatusFlag::Zero;
+	uint8_t val = ReadUInt8<TTiming, mode>();
 
-	if ((val & 0x80) != 0)
-		resultStatusFlags |= CpuStatusFlag::Negative;
-	if ((val & 0x40) != 0)
-		resultStatusFlags |= CpuStatusFlag::Overflow;
-
-	SetStatusFlags(resultStatusFlags, CpuStatusFlag::Zero | CpuStatusFlag::Negative | CpuStatusFlag::Overflow);
+	// N and V come straight from the memory value, Z from the masked value
+	m_negativeResult = val;
+	m_zeroResult = val & m_acc;
+	SetStatusFlags(((val & 0x40) != 0) ? CpuStatusFlag::Overflow : CpuStatusFlag::None, CpuStatusFlag::Overflow);
 }
 
 
-void Cpu6502::Instruction_And(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_And()
 {
-	const uint8_t memValue = ReadUInt8(addressingMode);
+	const uint8_t memValue = ReadUInt8<TTiming, mode>();
 	m_acc = memValue & m_acc;
 	SetStatusFlagsFromValue(m_acc);
 }
 
-void Cpu6502::Instruction_OrWithAccumulator(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_OrWithAccumulator()
 {
-	const uint8_t memValue = ReadUInt8(addressingMode);
+	const uint8_t memValue = ReadUInt8<TTiming, mode>();
 	m_acc = memValue | m_acc;
 	SetStatusFlagsFromValue(m_acc);
 }
 
-void Cpu6502::Instruction_ExclusiveOr(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_ExclusiveOr()
 {
-	const uint8_t memValue = ReadUInt8(addressingMode);
+	const uint8_t memValue = ReadUInt8<TTiming, mode>();
 	m_acc = memValue ^ m_acc;
 	SetStatusFlagsFromValue(m_acc);
 }
 
-void Cpu6502::Instruction_AddWithCarry(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_AddWithCarry()
 {
-	const uint8_t memValue = ReadUInt8(addressingMode);
+	const uint8_t memValue = ReadUInt8<TTiming, mode>();
 	AddWithCarry(m_acc, memValue);
 }
 
-void Cpu6502::Instruction_SubtractWithCarry(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_SubtractWithCarry()
 {
 	static bool shouldUsedOnesComplementAddition = true;
 
 	if (shouldUsedOnesComplementAddition)
 	{
 		// Subtraction can be performed by taking the ones complement of the subtrahend and then performing an add
-		const uint8_t m = ReadUInt8(addressingMode);
+		const uint8_t m = ReadUInt8<TTiming, mode>();
 		AddWithCarry(m_acc, ~m);
 	}
 	else
 	{
 		// REVIEW: This whole method is also gross
-		const uint8_t m = ReadUInt8(addressingMode);
+		const uint8_t m = ReadUInt8<TTiming, mode>();
 		const int8_t signedM = static_cast<int8_t>(m);
 		const int8_t signedAcc = static_cast<int8_t>(m_acc);
 
@@ -956,9 +1171,10 @@ void Cpu6502::Instruction_SubtractWithCarry(AddressingMode addressingMode)
 	}
 }
 
-void Cpu6502::Instruction_RotateLeft(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_RotateLeft()
 {
-	ReadModifyWriteUint8(addressingMode, [this](uint8_t& value)
+	ReadModifyWriteUint8<TTiming, mode>([this](uint8_t& value)
 	{
 		const bool oldCarrySet = (m_status & static_cast<uint8_t>(CpuStatusFlag::Carry)) != 0;
 		const bool oldBit7Set = (value & 0x80) != 0;
@@ -972,9 +1188,10 @@ void Cpu6502::Instruction_RotateLeft(AddressingMode addressingMode)
 	});
 }
 
-void Cpu6502::Instruction_RotateRight(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_RotateRight()
 {
-	ReadModifyWriteUint8(addressingMode, [this](uint8_t& value)
+	ReadModifyWriteUint8<TTiming, mode>([this](uint8_t& value)
 	{
 		const bool oldCarrySet = (m_status & static_cast<uint8_t>(CpuStatusFlag::Carry)) != 0;
 		const bool oldBit0Set = (value & 0x01) != 0;
@@ -988,9 +1205,10 @@ void Cpu6502::Instruction_RotateRight(AddressingMode addressingMode)
 	});
 }
 
-void Cpu6502::Instruction_ArithmeticShiftLeft(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_ArithmeticShiftLeft()
 {
-	ReadModifyWriteUint8(addressingMode, [this](uint8_t& value)
+	ReadModifyWriteUint8<TTiming, mode>([this](uint8_t& value)
 	{
 		bool oldBit7Set = (value & 0x80) != 0;
 		value <<= 1;
@@ -999,9 +1217,10 @@ void Cpu6502::Instruction_ArithmeticShiftLeft(AddressingMode addressingMode)
 	});
 }
 
-void Cpu6502::Instruction_LogicalShiftRight(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_LogicalShiftRight()
 {
-	ReadModifyWriteUint8(addressingMode, [this](uint8_t& value)
+	ReadModifyWriteUint8<TTiming, mode>([this](uint8_t& value)
 	{
 		bool oldBit0Set = (value & 0x01) != 0;
 		value >>= 1;
@@ -1010,150 +1229,152 @@ void Cpu6502::Instruction_LogicalShiftRight(AddressingMode addressingMode)
 	});
 }
 
-void Cpu6502::Instruction_DecrementX(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_DecrementX()
 {
 	SetStatusFlagsFromValue(--m_x); // Doesn't touch overflow
 }
 
-void Cpu6502::Instruction_IncrementX(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_IncrementX()
 {
 	SetStatusFlagsFromValue(++m_x); // Doesn't touch overflow
 }
 
-void Cpu6502::Instruction_DecrementY(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_DecrementY()
 {
 	SetStatusFlagsFromValue(--m_y); // Doesn't touch overflow
 }
 
-void Cpu6502::Instruction_IncrementY(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_IncrementY()
 {
 	SetStatusFlagsFromValue(++m_y); // Doesn't touch overflow
 }
 
-void Cpu6502::Instruction_DecrementMemory(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_DecrementMemory()
 {
-	ReadModifyWriteUint8(addressingMode, [this](uint8_t& value)
+	ReadModifyWriteUint8<TTiming, mode>([this](uint8_t& value)
 	{
 		--value;
 		SetStatusFlagsFromValue(value);
 	});
 }
 
-void Cpu6502::Instruction_IncrementMemory(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_IncrementMemory()
 {
-	ReadModifyWriteUint8(addressingMode, [this](uint8_t& value)
+	ReadModifyWriteUint8<TTiming, mode>([this](uint8_t& value)
 	{
 		++value;
 		SetStatusFlagsFromValue(value);
 	});
 }
 
-void Cpu6502::Instruction_SetInterrupt(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_SetInterrupt()
 {
 	SetStatusFlags(CpuStatusFlag::InterruptDisabled, CpuStatusFlag::InterruptDisabled); // Set Interrupt Disable
 }
 
-void Cpu6502::Instruction_ClearInterrupt(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_ClearInterrupt()
 {
 	SetStatusFlags(CpuStatusFlag::None, CpuStatusFlag::InterruptDisabled); // Clear Interrupt Disable
 }
 
-void Cpu6502::Instruction_SetDecimal(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_SetDecimal()
 {
 	SetStatusFlags(CpuStatusFlag::DecimalMode, CpuStatusFlag::DecimalMode); // Set Decimal Mode
 }
 
-void Cpu6502::Instruction_ClearDecimal(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_ClearDecimal()
 {
 	SetStatusFlags(CpuStatusFlag::None, CpuStatusFlag::DecimalMode); // Clear Decimal Mode
 }
 
-void Cpu6502::Instruction_SetCarry(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_SetCarry()
 {
 	SetStatusFlags(CpuStatusFlag::Carry, CpuStatusFlag::Carry); // Set Carry Flag
 }
 
-void Cpu6502::Instruction_ClearCarry(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_ClearCarry()
 {
 	SetStatusFlags(CpuStatusFlag::None, CpuStatusFlag::Carry); // Clear Carry Flag
 }
 
-void Cpu6502::Instruction_ClearOverflow(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_ClearOverflow()
 {
 	SetStatusFlags(CpuStatusFlag::None, CpuStatusFlag::Overflow); // Clear Overflow Flag
 }
 
-void Cpu6502::Instruction_TransferXToStack(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_TransferXToStack()
 {
 	m_sp = m_x;
 }
 
-void Cpu6502::Instruction_TransferStackToX(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_TransferStackToX()
 {
 	m_x = m_sp;
 	SetStatusFlagsFromValue(m_x);
 }
 
-void Cpu6502::Instruction_PushAccumulator(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_PushAccumulator()
 {
 	PushValueOntoStack8(m_acc);
 }
 
-void Cpu6502::Instruction_PullAccumulator(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_PullAccumulator()
 {
 	m_acc = ReadValueFromStack8();
 	SetStatusFlagsFromValue(m_acc);
 }
 
-void Cpu6502::Instruction_PushProcessorStatus(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_PushProcessorStatus()
 {
 	// PHP pushes the cpu status with the break status bit set (http://visual6502.org/wiki/index.php?title=6502_BRK_and_B_bit)
-	PushValueOntoStack8(m_status | static_cast<uint8_t>(CpuStatusFlag::BreakCommand));
+	PushValueOntoStack8(GetStatus() | static_cast<uint8_t>(CpuStatusFlag::BreakCommand));
 }
 
-void Cpu6502::Instruction_PullProcessorStatus(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_PullProcessorStatus()
 {
 	const uint8_t statusLoadMask = static_cast<uint8_t>(CpuStatusFlag::BreakCommand | CpuStatusFlag::Bit5);
 	const uint8_t statusFromStack = ReadValueFromStack8();
-	m_status = (m_status & statusLoadMask) | (statusFromStack & ~statusLoadMask);
+	SetStatus((m_status & statusLoadMask) | (statusFromStack & ~statusLoadMask));
 }
 
-void Cpu6502::Instruction_BranchOnEqual(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_BranchOnEqual()
 {
-	Helper_ExecuteBranch((m_status & static_cast<uint8_t>(CpuStatusFlag::Zero)) != 0);
+	Helper_ExecuteBranch(IsZeroFlagSet());
 }
 
-void Cpu6502::Instruction_BranchOnNotEqual(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_BranchOnNotEqual()
 {
-	Helper_ExecuteBranch((m_status & static_cast<uint8_t>(CpuStatusFlag::Zero)) == 0);
+	Helper_ExecuteBranch(!IsZeroFlagSet());
 }
 
-void Cpu6502::Instruction_BranchOnPlus(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_BranchOnPlus()
 {
-	Helper_ExecuteBranch((m_status & static_cast<uint8_t>(CpuStatusFlag::Negative)) == 0);
+	Helper_ExecuteBranch(!IsNegativeFlagSet());
 }
 
-void Cpu6502::Instruction_BranchOnMinus(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_BranchOnMinus()
 {
-	Helper_ExecuteBranch((m_status & static_cast<uint8_t>(CpuStatusFlag::Negative)) != 0);
+	Helper_ExecuteBranch(IsNegativeFlagSet());
 }
 
-void Cpu6502::Instruction_BranchOnOverflowClear(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_BranchOnOverflowClear()
 {
 	Helper_ExecuteBranch((m_status & static_cast<uint8_t>(CpuStatusFlag::Overflow)) == 0);
 }
 
-void Cpu6502::Instruction_BranchOnOverflowSet(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_BranchOnOverflowSet()
 {
 	Helper_ExecuteBranch((m_status & static_cast<uint8_t>(CpuStatusFlag::Overflow)) != 0);
 }
 
-void Cpu6502::Instruction_BranchOnCarryClear(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_BranchOnCarryClear()
 {
 	Helper_ExecuteBranch((m_status & static_cast<uint8_t>(CpuStatusFlag::Carry)) == 0);
 }
 
-void Cpu6502::Instruction_BranchOnCarrySet(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_BranchOnCarrySet()
 {
 	Helper_ExecuteBranch((m_status & static_cast<uint8_t>(CpuStatusFlag::Carry)) != 0);
 }
@@ -1173,77 +1394,82 @@ void Cpu6502::Helper_ExecuteBranch(bool shouldBranch)
 	}
 }
 
-void Cpu6502::Instruction_JumpToSubroutine(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_JumpToSubroutine()
 {
-	uint16_t jumpAddress = ReadUInt16(addressingMode);
+	uint16_t jumpAddress = ReadUInt16<TTiming, mode>();
 	PushValueOntoStack16(m_pc - 1);
 	m_pc = jumpAddress;
 }
 
-void Cpu6502::Instruction_ReturnFromSubroutine(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_ReturnFromSubroutine()
 {
 	const uint16_t returnAddress = ReadValueFromStack16() + 1;
 	m_pc = returnAddress;
 }
 
-void Cpu6502::Instruction_ReturnFromInterrupt(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_ReturnFromInterrupt()
 {
 	const uint8_t statusLoadMask = static_cast<uint8_t>(CpuStatusFlag::BreakCommand | CpuStatusFlag::Bit5);
 	const uint8_t statusFromStack = ReadValueFromStack8();
 	uint16_t returnAddress = ReadValueFromStack16();
 
-	m_status = (m_status & statusLoadMask) | (statusFromStack & ~statusLoadMask);
+	SetStatus((m_status & statusLoadMask) | (statusFromStack & ~statusLoadMask));
 	m_pc = returnAddress;
 }
 
-void Cpu6502::Instruction_Jump(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_Jump()
 {
-	m_pc = ReadUInt16(addressingMode);
+	m_pc = ReadUInt16<TTiming, mode>();
 }
 
-void Cpu6502::Instruction_JumpIndirect(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_JumpIndirect()
 {
 	// REVIEW: eww, gross
 	// Dealing with the fact that the 16-bit address can't cross pages, so we need some awkward 
 	// modulo math
-	uint16_t jumpAddressIndirect = ReadUInt16(addressingMode);
-	uint16_t jumpAddress = ReadMemory8(jumpAddressIndirect);
+	uint16_t jumpAddressIndirect = ReadUInt16<TTiming, mode>();
+	uint16_t jumpAddress = BusRead8<TTiming>(jumpAddressIndirect);
 	jumpAddressIndirect = (jumpAddressIndirect & 0xFF00) | ((jumpAddressIndirect + 1) & 0x00FF);
-	jumpAddress = jumpAddress | (ReadMemory8(jumpAddressIndirect) << 8);
+	jumpAddress = jumpAddress | (BusRead8<TTiming>(jumpAddressIndirect) << 8);
 	m_pc = jumpAddress;
 }
 
-void Cpu6502::Instruction_StoreX(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_StoreX()
 {
-	uint16_t writeOffset = GetAddressingModeOffset_ReadWrite(addressingMode);
-	WriteMemory8(writeOffset, m_x);
+	uint16_t writeOffset = GetAddressingModeOffset_ReadWrite<TTiming, mode>();
+	BusWrite8<TTiming>(writeOffset, m_x);
 }
 
-void Cpu6502::Instruction_StoreY(AddressingMode addressingMode)
+template <typename TTiming, AddressingMode mode>
+void Cpu6502::Instruction_StoreY()
 {
-	uint16_t writeOffset = GetAddressingModeOffset_ReadWrite(addressingMode);
-	WriteMemory8(writeOffset, m_y);
+	uint16_t writeOffset = GetAddressingModeOffset_ReadWrite<TTiming, mode>();
+	BusWrite8<TTiming>(writeOffset, m_y);
 }
 
-void Cpu6502::Instruction_TransferAtoX(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_TransferAtoX()
 {
 	m_x = m_acc;
 	SetStatusFlagsFromValue(m_x);
 }
 
-void Cpu6502::Instruction_TransferXtoA(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_TransferXtoA()
 {
 	m_acc = m_x;
 	SetStatusFlagsFromValue(m_acc);
 }
 
-void Cpu6502::Instruction_TransferAtoY(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_TransferAtoY()
 {
 	m_y = m_acc;
 	SetStatusFlagsFromValue(m_y);
 }
 
-void Cpu6502::Instruction_TransferYtoA(AddressingMode /*addressingMode*/)
+void Cpu6502::Instruction_TransferYtoA()
 {
 	m_acc = m_y;
 	SetStatusFlagsFromValue(m_acc);
@@ -1257,46 +1483,902 @@ void Cpu6502::AddCycles(uint32_t cycles)
 
 int64_t Cpu6502::GetElapsedCycles() const
 {
-	return m_totalCycles - m_cyclesRemaining;
+	// While an instruction is executing this is the cycle it started on, plus the bus cycles it has made so far with
+	// PerAccessTiming (m_busCycle stays 0 with PerInstructionTiming)
+	return m_totalCycles + m_busCycle;
 }
 
 
-uint32_t Cpu6502::RunInstructions(int targetCycles)
+void Cpu6502::SetTiming(CpuTiming timing)
 {
-	m_cyclesRemaining += targetCycles;
-	m_totalCycles += targetCycles;
-	uint32_t totalRunCycles = 0;
+	m_timing = timing;
+	SelectCore();
+
+	// Decoded blocks point at the other core's handlers
+	ResetBlockCache();
+}
 
-	while (m_cyclesRemaining > 0)
-	{
-		m_pMapper->SetTick(m_totalCycles - m_cyclesRemaining);
 
-		uint8_t instruction = ReadMemory8(m_pc++);
+void Cpu6502::SelectCore()
+{
+	const bool isInstrumented = IsInstrumented();
+
+	switch (m_timing)
+	{
+	case CpuTiming::PerInstruction:
+		isInstrumented ? SetCore<PerInstructionTiming, true>() : SetCore<PerInstructionTiming, false>();
+		break;
 
-		auto opCodeEntry = DoOpcodeStuff(instruction);
-		m_currentInstructionCycleCount = opCodeEntry->baseCycles;
-		((*this).*(opCodeEntry->func))(opCodeEntry->addrMode);
+	case CpuTiming::PerAccess:
+		isInstrumented ? SetCore<PerAccessTiming, true>() : SetCore<PerAccessTiming, false>();
+		break;
 
-		m_cyclesRemaining -= m_currentInstructionCycleCount;
-		totalRunCycles += m_currentInstructionCycleCount;
+	default:
+		throw std::runtime_error("Unknown CPU timing");
 	}
+}
 
-	return totalRunCycles;
+
+template <typename TTiming, bool isInstrumented>
+void Cpu6502::SetCore()
+{
+	m_pfnRunUntil = &Cpu6502::RunUntilWithTiming<TTiming, isInstrumented>;
+	m_pfnRunStep = &Cpu6502::RunStepWithTiming<TTiming, isInstrumented>;
+	m_pfnRunNextInstruction = &Cpu6502::RunNextInstructionWithTiming<TTiming, isInstrumented>;
+}
+
+
+uint32_t Cpu6502::RunUntil(int64_t targetCycle)
+{
+	return ((*this).*m_pfnRunUntil)(targetCycle);
 }
 
 
 uint32_t Cpu6502::RunNextInstruction()
 {
-	m_pMapper->SetTick(m_totalCycles);
+	return ((*this).*m_pfnRunNextInstruction)();
+}
 
-	// Instruction is of the form aaabbbcc.  See: http://www.llx.com/~nparker/a2/opcodes.html
-	uint8_t instruction = ReadMemory8(m_pc++);
 
-	auto opCodeEntry = DoOpcodeStuff(instruction);
-	m_currentInstructionCycleCount = opCodeEntry->baseCycles;
-	((*this).*(opCodeEntry->func))(opCodeEntry->addrMode);
+void Cpu6502::BeginRun()
+{
+	// Whatever happened since the last run (NMI, scanline, etc.) may have changed what an idle loop would see
+	m_idleLoop.loopPc = c_noIdleLoop;
+}
 
-	m_totalCycles += m_currentInstructionCycleCount;
+
+void Cpu6502::RunStep(int64_t targetCycle)
+{
+	((*this).*m_pfnRunStep)(targetCycle);
+}
+
+
+template <typename TTiming, bool isInstrumented>
+uint32_t Cpu6502::RunUntilWithTiming(int64_t targetCycle)
+{
+	const int64_t startCycle = m_totalCycles;
+
+	BeginRun();
+
+	// Anything scheduled part way through the run (e.g. by an APU register write) can bring the end forward
+	while (m_totalCycles < targetCycle && m_totalCycles < m_scheduler.GetNextEventCycle())
+		RunStepWithTiming<TTiming, isInstrumented>(targetCycle);
+
+	return static_cast<uint32_t>(m_totalCycles - startCycle);
+}
+
+
+template <typename TTiming, bool isInstrumented>
+void Cpu6502::RunStepWithTiming(int64_t targetCycle)
+{
+	if (IsInterruptDue())
+		ServiceInterrupt();
+
+	// Instrumentation needs to see every instruction, unless it's only tracing the backend's steps
+	const bool useBlocks = (!isInstrumented || IsTracingBackendSteps()) && (m_backend != CpuBackend::Interpreter);
+	const DecodedBlock* pBlock = useBlocks ? GetDecodedBlock<TTiming>(m_pc) : nullptr;
+
+	uint16_t instructionPc = m_pc;
+	if (pBlock != nullptr)
+	{
+		if (isInstrumented)
+			AppendTraceRecord(m_pc, pBlock->pCode[0]);
+
+		instructionPc = (TTiming::c_allowsNativeBlocks && pBlock->pNativeCode != nullptr) ?
+			RunNativeBlock(*pBlock, targetCycle) : RunBlock<TTiming>(*pBlock, targetCycle);
+	}
+	else
+	{
+		RunNextInstructionWithTiming<TTiming, isInstrumented>();
+	}
+
+	// Only a backwards jump/branch can close a loop
+	if (!isInstrumented && m_pc <= instructionPc && m_idleLoopSkipping)
+		TrySkipIdleLoop(instructionPc, std::min(targetCycle, m_scheduler.GetNextEventCycle()));
+}
+
+
+/*----- Decoded blocks
+
+ Hot code in read-only pages is run from DecodedBlockCache, skipping the opcode fetch and table lookup
+ for every instruction.  Operands are still read by the handlers through the page table as usual, which is
+ only an indexed load for ROM.  A block is cut short if the target cycle is reached, an interrupt is due, or
+ an instruction changes the memory map (a bank switch may have swapped out the rest of the block).  Blocks which
+ only touch RAM and fit before the target don't need to check for any of those between instructions.  -----*/
+
+uint32_t Cpu6502::GetInstructionLength(uint8_t opCode, AddressingMode addrMode)
+{
+	// Branches (xxy10000) are tagged as implied, but carry a relative offset
+	if ((opCode & 0x1F) == 0x10)
+		return 2;
+
+	switch (addrMode)
+	{
+	case AddressingMode::IMP:
+	case AddressingMode::ACC:
+		return 1;
+	case AddressingMode::ABS:
+	case AddressingMode::ABSX:
+	case AddressingMode::ABSY:
+		return 3;
+	default:
+		return 2;
+	}
+}
+
+static bool EndsBlock(uint8_t opCode)
+{
+	switch (opCode)
+	{
+	case 0x00: // BRK
+	case 0x20: // JSR
+	case 0x40: // RTI
+	case 0x4C: // JMP
+	case 0x60: // RTS
+	case 0x6C: // JMP (indirect)
+		return true;
+	default:
+		return (opCode & 0x1F) == 0x10; // Branches
+	}
+}
+
+
+// Whether an instruction can only ever read or write CPU RAM ($0000-$1FFF) and leaves the I flag alone, so it
+// can't touch an I/O register or mapper, or let an interrupt in
+static bool IsRamOnly(uint8_t opCode, AddressingMode addrMode, const uint8_t* pOperands)
+{
+	const uint32_t c_ramEnd = 0x2000;
+
+	switch (opCode)
+	{
+	case 0x00: // BRK
+	case 0x28: // PLP
+	case 0x40: // RTI
+	case 0x58: // CLI
+	case 0x6C: // JMP (indirect)
+		return false;
+	case 0x20: // JSR
+	case 0x4C: // JMP
+		return true; // The operand is only where to go
+	default:
+		break;
+	}
+
+	switch (addrMode)
+	{
+	case AddressingMode::ABS:
+		return (pOperands[0] | (pOperands[1] << 8)) < c_ramEnd;
+	case AddressingMode::ABSX:
+	case AddressingMode::ABSY:
+		return (pOperands[0] | (pOperands[1] << 8)) + 0xFF < c_ramEnd;
+	case AddressingMode::_ZPX_:
+	case AddressingMode::_ZP_Y:
+		return false;
+	default:
+		return true; // Zero page (and the stack) is always RAM
+	}
+}
+
+
+template <typename TTiming>
+const DecodedBlock* Cpu6502::GetDecodedBlock(uint16_t pc)
+{
+	// Only read-only pages are safe to cache, anything writable might be modified under us
+	const uint8_t* pPage = m_memoryMap.GetReadPage(pc);
+	if (pPage == nullptr || m_memoryMap.GetWritePage(pc) != nullptr)
+		return nullptr;
+
+	const uint8_t* pCode = pPage + (pc & NES::c_cpuPageMask);
+	DecodedBlock* pBlock = m_spBlockCache->Find(pc, pCode);
+	if (pBlock == nullptr)
+	{
+		// Interpret cold code, rather than spending time decoding blocks which only run a few times
+		if (!m_spBlockCache->IsHot(pc))
+			return nullptr;
+
+		pBlock = m_spBlockCache->Allocate(pc, pCode);
+		DecodeBlock<TTiming>(pCode, pc, pBlock);
+	}
+
+	if (pBlock->instructionCount == 0)
+		return nullptr;
+
+	if (TTiming::c_allowsNativeBlocks && m_backend == CpuBackend::Native && pBlock->pNativeCode == nullptr)
+	{
+		// Out of room for native code, so start over (dropping pBlock with everything else)
+		if (!CompileNativeBlock(pBlock, pc))
+		{
+			m_spBlockCache->Reset();
+			return nullptr;
+		}
+	}
+
+	return pBlock;
+}
+
+
+template <typename TTiming>
+void Cpu6502::DecodeBlock(const uint8_t* pCode, uint16_t pc, DecodedBlock* pBlock) const
+{
+	const OpCodeTableEntry* const pOpCodeTable = GetOpCodeTable<TTiming>();
+
+	const uint32_t cbRemainingInPage = NES::c_cbCpuPage - (pc & NES::c_cpuPageMask);
+
+	pBlock->pCode = pCode;
+	pBlock->instructionCount = 0;
+	pBlock->maxCycles = 0;
+	pBlock->isRamOnly = true;
+
+	uint32_t codeOffset = 0;
+	int32_t previousOpCode = -1; // Still unfused, so a candidate for the first half of a pair
+	while (pBlock->instructionCount != c_maxDecodedBlockInstructions && codeOffset < cbRemainingInPage)
+	{
+		const uint8_t opCode = pCode[codeOffset];
+		const OpCodeTableEntry& opCodeEntry = pOpCodeTable[opCode];
+
+		// Leave unhandled opcodes, and instructions straddling the end of the page, to RunNextInstruction
+		const uint32_t instructionLength = GetInstructionLength(opCode, opCodeEntry.addrMode);
+		if (opCodeEntry.func == &Cpu6502::Instruction_Unhandled || codeOffset + instructionLength > cbRemainingInPage)
+			break;
+
+		// Fold this instruction into the previous one if they're a known pair
+		const InstrunctionFunc fusedFunc = (previousOpCode != -1) ? FindFusedInstruction(static_cast<uint8_t>(previousOpCode), opCode) : nullptr;
+		if (fusedFunc != nullptr)
+		{
+			pBlock->instructions[pBlock->instructionCount - 1].func = fusedFunc;
+			previousOpCode = -1;
+		}
+		else
+		{
+			DecodedInstruction& decodedInstruction = pBlock->instructions[pBlock->instructionCount++];
+			decodedInstruction.func = opCodeEntry.func;
+			decodedInstruction.baseCycles = opCodeEntry.baseCycles;
+			previousOpCode = (TTiming::c_allowsFusion && m_instructionFusion) ? opCode : -1;
+		}
+
+		pBlock->maxCycles += opCodeEntry.baseCycles + c_maxInstructionExtraCycles;
+		pBlock->isRamOnly &= IsRamOnly(opCode, opCodeEntry.addrMode, pCode + codeOffset + 1);
+
+		codeOffset += instructionLength;
+
+		if (EndsBlock(opCode))
+			break;
+	}
+}
+
+
+template <typename TTiming>
+uint16_t Cpu6502::RunBlock(const DecodedBlock& block, int64_t targetCycle)
+{
+	m_blockTargetCycle = targetCycle;
+	m_blockMemoryMapGeneration = m_memoryMap.GetGeneration();
+
+	const DecodedInstruction* pInstruction = block.instructions;
+	const DecodedInstruction* const pEnd = block.instructions + block.instructionCount;
+
+	// Nothing in a RAM only block can end it early (RunStep has just taken any interrupt which was due), so if all
+	// of it fits it runs straight through
+	if (block.isRamOnly && m_totalCycles + block.maxCycles < std::min(targetCycle, m_scheduler.GetNextEventCycle()))
+	{
+		do
+		{
+			RunDecodedInstruction<TTiming>(*pInstruction);
+		} while (++pInstruction != pEnd);
+
+		return m_blockInstructionPc;
+	}
+
+	for (;;)
+	{
+		RunDecodedInstruction<TTiming>(*pInstruction);
+
+		if (++pInstruction == pEnd || ShouldLeaveBlock())
+			return m_blockInstructionPc;
+	}
+}
+
+
+template <typename TTiming>
+void Cpu6502::RunDecodedInstruction(const DecodedInstruction& instruction)
+{
+	m_blockInstructionPc = m_pc++;
+	TTiming::BeginInstruction(*this);
+
+	m_currentInstructionCycleCount = instruction.baseCycles;
+	((*this).*(instruction.func))();
+
+	m_totalCycles += m_currentInstructionCycleCount;
+	m_instructionCount++;
+	TTiming::EndInstruction(*this);
+}
+
+
+bool Cpu6502::ShouldLeaveBlock() const
+{
+	return m_totalCycles >= m_blockTargetCycle || m_totalCycles >= m_scheduler.GetNextEventCycle() || IsInterruptDue() ||
+		m_memoryMap.GetGeneration() != m_blockMemoryMapGeneration;
+}
+
+
+/*----- Native blocks
+
+ With CpuBackend::Native, decoded blocks are also compiled to x86-64 the first time they run (see
+ NativeBlockCompiler.h).  Native code only checks whether to stop after calling a handler, so a block is only
+ entered when all of it will fit before the target cycle and next event; otherwise the decoded block runs.
+ Everything else (interrupts, idle loop skipping) happens in RunUntil as usual.  -----*/
+
+void Cpu6502::SetBackend(CpuBackend backend)
+{
+	if (!IsBackendSupported(backend))
+		throw std::runtime_error("The native CPU backend isn't supported on this platform");
+
+	m_backend = backend;
+}
+
+
+bool Cpu6502::IsBackendSupported(CpuBackend backend)
+{
+#ifdef CPU_NATIVE_BLOCKS
+	(void)backend;
+	return true;
+#else
+	return backend != CpuBackend::Native;
+#endif
+}
+
+
+#ifdef CPU_NATIVE_BLOCKS
+
+bool Cpu6502::CompileNativeBlock(DecodedBlock* pBlock, uint16_t pc)
+{
+	// The same instructions DecodeBlock took, unfused
+	const OpCodeTableEntry* const pOpCodeTable = GetOpCodeTable<PerInstructionTiming>();
+	const uint32_t cbRemainingInPage = NES::c_cbCpuPage - (pc & NES::c_cpuPageMask);
+
+	NativeInstruction instructions[c_maxDecodedBlockInstructions];
+	uint32_t instructionCount = 0;
+	uint32_t codeOffset = 0;
+	while (instructionCount != c_maxDecodedBlockInstructions && codeOffset < cbRemainingInPage)
+	{
+		const uint8_t opCode = pBlock->pCode[codeOffset];
+		const OpCodeTableEntry& opCodeEntry = pOpCodeTable[opCode];
+
+		const uint32_t instructionLength = GetInstructionLength(opCode, opCodeEntry.addrMode);
+		if (opCodeEntry.func == &Cpu6502::Instruction_Unhandled || codeOffset + instructionLength > cbRemainingInPage)
+			break;
+
+		NativeInstruction& instruction = instructions[instructionCount++];
+		instruction.pc = static_cast<uint16_t>(pc + codeOffset);
+		instruction.opCode = opCode;
+		instruction.operands[0] = (instructionLength > 1) ? pBlock->pCode[codeOffset + 1] : 0;
+		instruction.operands[1] = (instructionLength > 2) ? pBlock->pCode[codeOffset + 2] : 0;
+		instruction.length = static_cast<uint8_t>(instructionLength);
+		instruction.baseCycles = opCodeEntry.baseCycles;
+
+		codeOffset += instructionLength;
+
+		if (EndsBlock(opCode))
+			break;
+	}
+
+	const NativeBlockFunc pfnBlock = NativeBlockCompiler::Compile(*this, instructions, instructionCount,
+		m_spBlockCache->UseNativeCode(), &pBlock->nativeMaxCycles);
+	if (pfnBlock == nullptr)
+		return false;
+
+	pBlock->pNativeCode = reinterpret_cast<const void*>(pfnBlock);
+	return true;
+}
+
+
+uint16_t Cpu6502::RunNativeBlock(const DecodedBlock& block, int64_t targetCycle)
+{
+	if (m_totalCycles + block.nativeMaxCycles >= std::min(targetCycle, m_scheduler.GetNextEventCycle()))
+		return RunBlock<PerInstructionTiming>(block, targetCycle);
+
+	m_blockTargetCycle = targetCycle;
+	m_blockMemoryMapGeneration = m_memoryMap.GetGeneration();
+
+	const uint16_t instructionPc = reinterpret_cast<NativeBlockFunc>(const_cast<void*>(block.pNativeCode))(this);
+
+	if (m_nativeException)
+	{
+		std::exception_ptr spException = m_nativeException;
+		m_nativeException = nullptr;
+		std::rethrow_exception(spException);
+	}
+
+	return instructionPc;
+}
+
+
+// Called from native code to run an instruction it doesn't translate.  Returns whether the block has to stop
+// here: where RunBlock would have, or if the rest of the block might not fit before the target any more.
+bool Cpu6502::RunNativeCalledInstruction(Cpu6502* pCpu, uint32_t opCode, uint32_t remainingMaxCycles)
+{
+	Cpu6502& cpu = *pCpu;
+
+	// Exceptions can't unwind through generated code, so carry them over to RunNativeBlock
+	try
+	{
+		const OpCodeTableEntry& opCodeEntry = GetOpCodeTable<PerInstructionTiming>()[opCode];
+
+		// Everything the translated instructions did has been written back, so the state is complete here.  The
+		// block's first instruction was already recorded as the block started.
+		if (cpu.m_pTraceBuffer != nullptr && cpu.m_totalCycles != cpu.m_lastTraceCycle)
+			cpu.AppendTraceRecord(cpu.m_pc, static_cast<uint8_t>(opCode));
+
+		cpu.m_blockInstructionPc = cpu.m_pc++;
+		cpu.m_currentInstructionCycleCount = opCodeEntry.baseCycles;
+		((cpu).*(opCodeEntry.func))();
+
+		cpu.m_totalCycles += cpu.m_currentInstructionCycleCount;
+		cpu.m_instructionCount++;
+	}
+	catch (...)
+	{
+		cpu.m_nativeException = std::current_exception();
+		return true;
+	}
+
+	return cpu.ShouldLeaveBlock() ||
+		cpu.m_totalCycles + remainingMaxCycles >= std::min(cpu.m_blockTargetCycle, cpu.m_scheduler.GetNextEventCycle());
+}
+
+#else
+
+bool Cpu6502::CompileNativeBlock(DecodedBlock*, uint16_t)
+{
+	return false;
+}
+
+
+uint16_t Cpu6502::RunNativeBlock(const DecodedBlock& block, int64_t targetCycle)
+{
+	return RunBlock<PerInstructionTiming>(block, targetCycle);
+}
+
+
+bool Cpu6502::RunNativeCalledInstruction(Cpu6502*, uint32_t, uint32_t)
+{
+	return true;
+}
+
+#endif
+
+
+/*----- Fused instructions
+
+ Pairs of instructions which commonly run back to back (DEX; BNE, LDA $2002; BPL, etc.) are decoded into a
+ single handler, saving the dispatch of the second.  The pairs come from profiling real games with
+ EnableOpCodePairProfiling (see CrustyTool's pairstats command).
+
+ Both halves are still accounted separately: the first instruction's cycles are committed before the second
+ starts, so anything the second does (PPU register access, mapper writes) sees the right cycle.  If RunBlock
+ would have stopped in between, the fused handler stops there too, and the second instruction runs normally
+ as the first instruction of the next block.  -----*/
+
+template <Cpu6502::InstrunctionFunc first, Cpu6502::InstrunctionFunc second, uint8_t secondOpCode>
+void Cpu6502::Instruction_Fused()
+{
+	((*this).*first)();
+
+	m_totalCycles += m_currentInstructionCycleCount;
+	if (ShouldLeaveBlock())
+	{
+		// RunBlock accounts for one instruction when we return
+		m_currentInstructionCycleCount = 0;
+		return;
+	}
+
+	m_instructionCount++;
+	m_fusedInstructionCount++;
+
+	m_blockInstructionPc = m_pc++;
+	m_currentInstructionCycleCount = GetOpCodeTable<PerInstructionTiming>()[secondOpCode].baseCycles;
+	((*this).*second)();
+}
+
+
+const Cpu6502::FusedInstructionEntry Cpu6502::s_fusedInstructionTable[] = {
+	// Picked with pairstats (3600 frames each) over Donkey Kong Jr., the only commercial ROM profiled so far, and the
+	// small bank switching, IRQ, DMC, sprite 0 and CHR RAM test programs used to check the core.  Pairs which were
+	// only hot in one of them are kept only where they're a standard idiom; sequences particular to one game's code
+	// (Donkey Kong Jr.'s random number routine: ROR;ROR, AND;EOR;CLC;BEQ) are left out.  Rerun pairstats over a
+	// wider set of games before adding to this.
+
+	// Hot in more than one: polling $2002 for vblank
+	{ 0x2C /*BIT*/, 0x10 /*BPL*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_TestBits<PerInstructionTiming, AddressingMode::ABS>, &Cpu6502::Instruction_BranchOnPlus, 0x10> },
+
+	// Hot in one: waiting on a flag set by the NMI handler, counted loops, masking a variable, walking a pointer,
+	// and compare and branch
+	{ 0xA5 /*LDA*/, 0xF0 /*BEQ*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_LoadAccumulator<PerInstructionTiming, AddressingMode::ZP>, &Cpu6502::Instruction_BranchOnEqual, 0xF0> },
+	{ 0x88 /*DEY*/, 0xD0 /*BNE*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_DecrementY, &Cpu6502::Instruction_BranchOnNotEqual, 0xD0> },
+	{ 0xE8 /*INX*/, 0xD0 /*BNE*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_IncrementX, &Cpu6502::Instruction_BranchOnNotEqual, 0xD0> },
+	{ 0xA5 /*LDA*/, 0x29 /*AND*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_LoadAccumulator<PerInstructionTiming, AddressingMode::ZP>, &Cpu6502::Instruction_And<PerInstructionTiming, AddressingMode::IMM>, 0x29> },
+	{ 0x29 /*AND*/, 0x85 /*STA*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_And<PerInstructionTiming, AddressingMode::IMM>, &Cpu6502::Instruction_StoreAccumulator<PerInstructionTiming, AddressingMode::ZP>, 0x85> },
+	{ 0x85 /*STA*/, 0xA5 /*LDA*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_StoreAccumulator<PerInstructionTiming, AddressingMode::ZP>, &Cpu6502::Instruction_LoadAccumulator<PerInstructionTiming, AddressingMode::ZP>, 0xA5> },
+	{ 0x85 /*STA*/, 0xC8 /*INY*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_StoreAccumulator<PerInstructionTiming, AddressingMode::ZP>, &Cpu6502::Instruction_IncrementY, 0xC8> },
+	{ 0xC8 /*INY*/, 0xB1 /*LDA*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_IncrementY, &Cpu6502::Instruction_LoadAccumulator<PerInstructionTiming, AddressingMode::_ZP_Y>, 0xB1> },
+	{ 0xC5 /*CMP*/, 0x90 /*BCC*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_Compare<PerInstructionTiming, AddressingMode::ZP>, &Cpu6502::Instruction_BranchOnCarryClear, 0x90> },
+	{ 0xC9 /*CMP*/, 0xF0 /*BEQ*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_Compare<PerInstructionTiming, AddressingMode::IMM>, &Cpu6502::Instruction_BranchOnEqual, 0xF0> },
+
+	// Not hot in the ROMs above, but common everywhere: copying to registers, compare and branch, counted loops
+	{ 0xA5 /*LDA*/, 0x8D /*STA*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_LoadAccumulator<PerInstructionTiming, AddressingMode::ZP>, &Cpu6502::Instruction_StoreAccumulator<PerInstructionTiming, AddressingMode::ABS>, 0x8D> },
+	{ 0xAD /*LDA*/, 0x10 /*BPL*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_LoadAccumulator<PerInstructionTiming, AddressingMode::ABS>, &Cpu6502::Instruction_BranchOnPlus, 0x10> },
+	{ 0xC9 /*CMP*/, 0xD0 /*BNE*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_Compare<PerInstructionTiming, AddressingMode::IMM>, &Cpu6502::Instruction_BranchOnNotEqual, 0xD0> },
+	{ 0xCA /*DEX*/, 0xD0 /*BNE*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_DecrementX, &Cpu6502::Instruction_BranchOnNotEqual, 0xD0> },
+	{ 0xC0 /*CPY*/, 0xD0 /*BNE*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_CompareYRegister<PerInstructionTiming, AddressingMode::IMM>, &Cpu6502::Instruction_BranchOnNotEqual, 0xD0> },
+	{ 0xE0 /*CPX*/, 0xD0 /*BNE*/, &Cpu6502::Instruction_Fused<&Cpu6502::Instruction_CompareXRegister<PerInstructionTiming, AddressingMode::IMM>, &Cpu6502::Instruction_BranchOnNotEqual, 0xD0> },
+};
+
+
+Cpu6502::InstrunctionFunc Cpu6502::FindFusedInstruction(uint8_t firstOpCode, uint8_t secondOpCode)
+{
+	for (const FusedInstructionEntry& entry : s_fusedInstructionTable)
+	{
+		if (entry.firstOpCode == firstOpCode && entry.secondOpCode == secondOpCode)
+			return entry.func;
+	}
+
+	return nullptr;
+}
+
+
+void Cpu6502::ShareDecodedBlocks(const Cpu6502& other)
+{
+	// Blocks hold the handlers of one core, decoded with or without fusion
+	if (other.m_timing != m_timing || other.m_instructionFusion != m_instructionFusion)
+		throw std::runtime_error("Can only share decoded blocks between CPUs with the same timing and fusion settings");
+
+	m_spBlockCache = other.m_spBlockCache;
+}
+
+
+void Cpu6502::ResetBlockCache()
+{
+	// The cache may be shared with other CPUs, so start a new one of our own rather than clearing theirs
+	m_spBlockCache = std::make_shared<DecodedBlockCache>();
+}
+
+
+void Cpu6502::EnableInstructionFusion(bool isEnabled)
+{
+	if (isEnabled == m_instructionFusion)
+		return;
+
+	// Blocks which are already decoded were built the other way
+	m_instructionFusion = isEnabled;
+	ResetBlockCache();
+}
+
+
+void Cpu6502::EnableOpCodePairProfiling(bool isEnabled)
+{
+	if (!isEnabled)
+	{
+		m_spOpCodePairCounts.reset();
+	}
+	else if (!m_spOpCodePairCounts)
+	{
+		m_spOpCodePairCounts = std::make_unique<uint64_t[]>(256 * 256);
+		m_lastProfiledOpCode = -1;
+	}
+
+	SelectCore();
+}
+
+
+uint64_t Cpu6502::GetOpCodePairCount(uint8_t firstOpCode, uint8_t secondOpCode) const
+{
+	return m_spOpCodePairCounts ? m_spOpCodePairCounts[(firstOpCode << 8) | secondOpCode] : 0;
+}
+
+
+/*----- Tracing and profiling -----*/
+
+void Cpu6502::SetTraceBuffer(CpuTraceBuffer* pTraceBuffer, CpuTraceDetail detail)
+{
+	m_pTraceBuffer = pTraceBuffer;
+	m_traceDetail = detail;
+	SelectCore();
+}
+
+
+void Cpu6502::SetProfiler(CpuProfiler* pProfiler)
+{
+	m_pProfiler = pProfiler;
+	SelectCore();
+}
+
+
+// Whether the trace is all there is to instrument, so blocks can still run (the profilers need every instruction)
+bool Cpu6502::IsTracingBackendSteps() const
+{
+	return (m_pTraceBuffer != nullptr) && (m_traceDetail == CpuTraceDetail::BackendSteps) && !m_spOpCodePairCounts &&
+		(m_pProfiler == nullptr);
+}
+
+
+void Cpu6502::AppendTraceRecord(uint16_t pc, uint8_t opCode)
+{
+	CpuTraceRecord record = {};
+	record.cycle = m_totalCycles;
+	record.pc = pc;
+	record.opCode = opCode;
+	record.detail = m_traceDetail;
+
+	// Operands are nearly always in ROM/RAM; anything in I/O space is left zero rather than read twice
+	PeekMemory8(pc + 1, &record.operands[0]);
+	PeekMemory8(pc + 2, &record.operands[1]);
+
+	record.a = m_acc;
+	record.x = m_x;
+	record.y = m_y;
+	record.p = GetStatus();
+	record.sp = m_sp;
+
+	// The PPU is only caught up lazily, so work out where it would be
+	uint32_t dot;
+	int scanline;
+	m_ppu.GetPositionAtCpuCycle(m_totalCycles, &dot, &scanline);
+	record.ppuDot = static_cast<uint16_t>(dot);
+	record.ppuScanline = static_cast<int16_t>(scanline);
+
+	m_pTraceBuffer->Append(record);
+	m_lastTraceCycle = m_totalCycles;
+}
+
+
+void Cpu6502::ProfileInstruction(uint16_t pc, uint8_t opCode)
+{
+	const uint8_t* pPage = m_memoryMap.GetReadPage(pc);
+	const uint8_t* pCode = (pPage != nullptr) ? pPage + (pc & NES::c_cpuPageMask) : nullptr;
+
+	// Only branches and JMP close loops; returns and interrupts can go backwards too
+	const bool isLoop = (m_pc <= pc) && (((opCode & 0x1F) == 0x10) || opCode == 0x4C);
+
+	m_pProfiler->RecordInstruction(pCode, pc, m_currentInstructionCycleCount, isLoop ? m_pc : CpuProfiler::c_notALoop);
+}
+
+
+/*----- Idle loop skipping
+
+ Games commonly spin waiting for an NMI or for the PPU status to change, e.g.
+
+    loop: LDA $2002        loop: LDA nmiFlag        loop: JMP loop
+          BPL loop               BEQ loop
+
+ Within a single RunUntil the only things able to end such a loop are the CPU itself and the scheduler
+ events we're running up to (interrupts are only raised by those), so once an iteration of a loop which only reads memory comes back around
+ with every register unchanged, all further iterations before the target are identical.  Those are
+ skipped in one step, accounting for their cycles exactly.
+
+ PPU status ($2002) reads are only allowed as LDA/BIT $2002 immediately followed by the BPL/BMI closing the loop,
+ so only the vblank flag decides when it ends.  That's set by the PpuVBlank event we stop at.  Sprite 0 hit and
+ overflow change part way through the frame with no event of their own (as does the vblank flag being cleared on
+ the pre-render line), so loops waiting on them (BIT $2002; BVC, LDA $2002; AND #$40; BEQ) are never skipped. -----*/
+
+enum class IdleLoopOp
+{
+	Invalid,    // Anything with side effects (stores, stack, flow control out of the loop, etc.)
+	Implied,    // Register only
+	Immediate,
+	ZeroPage,
+	Absolute,
+	Branch,
+	Jump,
+};
+
+static IdleLoopOp ClassifyIdleLoopOp(uint8_t opCode)
+{
+	switch (opCode)
+	{
+	// TAX, TXA, TAY, TYA, CLC, SEC, CLV, NOP
+	case 0xAA: case 0x8A: case 0xA8: case 0x98: case 0x18: case 0x38: case 0xB8: case 0xEA:
+		return IdleLoopOp::Implied;
+
+	// LDA, LDX, LDY, CMP, CPX, CPY, AND, ORA, EOR
+	case 0xA9: case 0xA2: case 0xA0: case 0xC9: case 0xE0: case 0xC0: case 0x29: case 0x09: case 0x49:
+		return IdleLoopOp::Immediate;
+
+	// LDA, LDX, LDY, BIT, CMP, CPX, CPY, AND, ORA, EOR
+	case 0xA5: case 0xA6: case 0xA4: case 0x24: case 0xC5: case 0xE4: case 0xC4: case 0x25: case 0x05: case 0x45:
+		return IdleLoopOp::ZeroPage;
+	case 0xAD: case 0xAE: case 0xAC: case 0x2C: case 0xCD: case 0xEC: case 0xCC: case 0x2D: case 0x0D: case 0x4D:
+		return IdleLoopOp::Absolute;
+
+	// BPL, BMI, BVC, BVS, BCC, BCS, BNE, BEQ
+	case 0x10: case 0x30: case 0x50: case 0x70: case 0x90: case 0xB0: case 0xD0: case 0xF0:
+		return IdleLoopOp::Branch;
+
+	case 0x4C:
+		return IdleLoopOp::Jump;
+
+	default:
+		return IdleLoopOp::Invalid;
+	}
+}
+
+
+bool Cpu6502::PeekMemory8(uint16_t offset, uint8_t* pValue) const
+{
+	// Only memory backed pages, so peeking never has side effects
+	const uint8_t* pPage = m_memoryMap.GetReadPage(offset);
+	if (pPage == nullptr)
+		return false;
+
+	*pValue = pPage[offset & NES::c_cpuPageMask];
+	return true;
+}
+
+
+bool Cpu6502::IsIdleLoop(uint16_t loopPc, uint16_t branchPc) const
+{
+	const int c_maxIdleLoopInstructions = 8;
+
+	uint16_t pc = loopPc;
+	for (int iInstruction = 0; iInstruction != c_maxIdleLoopInstructions; ++iInstruction)
+	{
+		uint8_t opCode, operandLow, operandHigh;
+		if (!PeekMemory8(pc, &opCode) || !PeekMemory8(pc + 1, &operandLow) || !PeekMemory8(pc + 2, &operandHigh))
+			return false;
+
+		switch (ClassifyIdleLoopOp(opCode))
+		{
+		case IdleLoopOp::Implied:
+			pc += 1;
+			break;
+
+		case IdleLoopOp::Immediate:
+		case IdleLoopOp::ZeroPage:
+			pc += 2;
+			break;
+
+		case IdleLoopOp::Absolute:
+		{
+			const uint16_t address = (static_cast<uint16_t>(operandHigh) << 8) | operandLow;
+			if (m_memoryMap.GetReadPage(address) == nullptr)
+			{
+				// Besides plain memory, only a vblank flag test closing the loop is safe to repeat (see above)
+				const bool isPpuStatus = address >= 0x2000 && address < 0x4000 && MapIoRegisterMemoryOffset(address) == 0x2002;
+				const bool isLoadOrTest = (opCode == 0xAD /*LDA*/ || opCode == 0x2C /*BIT*/);
+				if (!isPpuStatus || !isLoadOrTest || pc + 3 != branchPc)
+					return false;
+
+				uint8_t branchOpCode;
+				if (!PeekMemory8(branchPc, &branchOpCode) || (branchOpCode != 0x10 /*BPL*/ && branchOpCode != 0x30 /*BMI*/))
+					return false;
+			}
+
+			pc += 3;
+			break;
+		}
+
+		case IdleLoopOp::Branch:
+		{
+			// Branches have to stay within the loop
+			const uint16_t target = static_cast<uint16_t>(pc + 2 + static_cast<int8_t>(operandLow));
+			if (pc == branchPc)
+				return target == loopPc;
+			if (target < loopPc || target > branchPc)
+				return false;
+
+			pc += 2;
+			break;
+		}
+
+		case IdleLoopOp::Jump:
+			return pc == branchPc && ((static_cast<uint16_t>(operandHigh) << 8) | operandLow) == loopPc;
+
+		default:
+			return false;
+		}
+
+		if (pc > branchPc)
+			return false;
+	}
+
+	return false;
+}
+
+
+void Cpu6502::TrySkipIdleLoop(uint16_t branchPc, int64_t targetCycle)
+{
+	IdleLoopState& loop = m_idleLoop;
+
+	if (loop.loopPc == m_pc && loop.branchPc == branchPc)
+	{
+		if (loop.acc == m_acc && loop.x == m_x && loop.y == m_y && loop.status == GetStatus() && loop.sp == m_sp)
+		{
+			// Stop short of the target, and let the last partial iteration run normally
+			const int64_t iterationCycles = m_totalCycles - loop.startCycle;
+			const uint64_t iterationInstructions = m_instructionCount - loop.startInstructionCount;
+			const int64_t iterationCount = (targetCycle - m_totalCycles) / iterationCycles;
+
+			m_totalCycles += iterationCount * iterationCycles;
+			m_instructionCount += iterationCount * iterationInstructions;
+			m_skippedIdleCycles += iterationCount * iterationCycles;
+
+			loop.startCycle = m_totalCycles;
+			loop.startInstructionCount = m_instructionCount;
+			return;
+		}
+	}
+	else if (!IsIdleLoop(m_pc, branchPc))
+	{
+		loop.loopPc = c_noIdleLoop;
+		return;
+	}
+
+	// First time around (or the registers are still settling), so remember where this iteration started
+	loop.loopPc = m_pc;
+	loop.branchPc = branchPc;
+	loop.startCycle = m_totalCycles;
+	loop.startInstructionCount = m_instructionCount;
+	loop.acc = m_acc;
+	loop.x = m_x;
+	loop.y = m_y;
+	loop.status = GetStatus();
+	loop.sp = m_sp;
+}
+
+
+template <typename TTiming, bool isInstrumented>
+uint32_t Cpu6502::RunNextInstructionWithTiming()
+{
+	if (IsInterruptDue())
+		ServiceInterrupt();
+
+	// Instruction is of the form aaabbbcc.  See: http://www.llx.com/~nparker/a2/opcodes.html
+	const uint16_t instructionPc = m_pc;
+	uint8_t instruction = ReadMemory8(m_pc++);
+
+	if (isInstrumented)
+	{
+		if (m_spOpCodePairCounts)
+		{
+			if (m_lastProfiledOpCode != -1)
+				m_spOpCodePairCounts[(m_lastProfiledOpCode << 8) | instruction]++;
+			m_lastProfiledOpCode = EndsBlock(instruction) ? -1 : instruction;
+		}
+
+		if (m_pTraceBuffer != nullptr)
+			AppendTraceRecord(instructionPc, instruction);
+	}
+
+	TTiming::BeginInstruction(*this);
+
+	const OpCodeTableEntry& opCodeEntry = GetOpCodeTable<TTiming>()[instruction];
+	m_currentInstructionCycleCount = opCodeEntry.baseCycles;
+	((*this).*(opCodeEntry.func))();
+
+	m_totalCycles += m_currentInstructionCycleCount;
+	m_instructionCount++;
+	TTiming::EndInstruction(*this);
+
+	if (isInstrumented && m_pProfiler != nullptr)
+		ProfileInstruction(instructionPc, instruction);
 
 	return m_currentInstructionCycleCount;
 }
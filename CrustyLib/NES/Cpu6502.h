@@ -2,8 +2,13 @@
 
 #include <stdint.h>
 #include <string>
+#include <memory>
+#include <exception>
 
 #include "NESRom.h"
+#include "CpuMemoryMap.h"
+#include "DmaController.h"
+#include "CpuTrace.h"
 #include "..\Util\CoreUtils.h"
 
 namespace PPU
@@ -14,6 +19,8 @@ namespace PPU
 namespace NES
 {
 	class NES;
+	class Scheduler;
+	class InterruptController;
 
 	namespace APU
 	{
@@ -24,6 +31,16 @@ namespace NES
 namespace CPU
 {
 
+class DecodedBlockCache;
+struct DecodedBlock;
+struct DecodedInstruction;
+class CpuProfiler;
+class CpuLockstep;
+class NativeBlockEmitter;
+struct NativeCpuLayout;
+struct PerInstructionTiming;
+struct PerAccessTiming;
+
 class InvalidInstruction : public std::runtime_error
 {
 public:
@@ -78,6 +95,21 @@ enum class CpuStatusFlag
 
 DEFINE_ENUM_BITWISE_OPERANDS(CpuStatusFlag);
 
+// How RunUntil executes code.  All produce identical results, so they can be swapped at any point to compare.
+enum class CpuBackend
+{
+	Interpreter,   // Fetch and decode every instruction
+	DecodedBlocks, // Hot PRG ROM code runs from pre-decoded blocks, everything else is interpreted
+	Native,        // As DecodedBlocks, but the blocks are compiled to x86-64 (x64 desktop builds only, see NativeBlockCompiler.h)
+};
+
+// When an instruction's cycles are charged.  Each is a separate instantiation of the core.
+enum class CpuTiming
+{
+	PerInstruction, // All at once as the instruction completes; register accesses see the cycle it started on (fastest)
+	PerAccess,      // A cycle per bus access as it happens, so mid-instruction PPU/APU/mapper accesses land on the exact cycle
+};
+
 
 // Memory Regions
 //  Interrupts ($FFFA-$FFFF)
@@ -87,6 +119,7 @@ class Cpu6502
 {
 public:
 	Cpu6502(NES::NES& nes); //REVIEW: Should cpu depend on ram, or abstract the PRG/CHR loading?
+	~Cpu6502();
 	Cpu6502(const Cpu6502&) = delete;
 	Cpu6502& operator=(const Cpu6502&) = delete;
 
@@ -95,17 +128,68 @@ public:
 	void Reset();
 
 	uint32_t RunNextInstruction();
-	uint32_t RunInstructions(int targetCycles);
+	uint32_t RunUntil(int64_t targetCycle); // Runs whole instructions until at least targetCycle or the next scheduled event, returns cycles ran
+
+	// RunUntil a step at a time, for running several CPUs interleaved (see NESBatch).  BeginRun starts what would be
+	// one RunUntil call, then each RunStep services any interrupt due and runs one block (or instruction) towards
+	// targetCycle.  The caller stops once the target or the next scheduled event is reached.
+	void BeginRun();
+	void RunStep(int64_t targetCycle);
+
+	// Halts the CPU for cycles, between instructions (for DMA)
+	void Stall(uint32_t cycles) { m_totalCycles += cycles; }
+	DmaController& GetDma() { return m_dma; }
+
+	// Reads and writes of addresses nothing responds to.  Reads see open bus (the last value on the data bus).
+	uint64_t GetUnmappedAccessCount() const { return m_memoryMap.GetUnmappedAccessCount(); }
 
 	int64_t GetElapsedCycles() const;
+	uint64_t GetInstructionCount() const { return m_instructionCount; }
+
+	// Fast forwarding through loops which are just waiting on an NMI/PPU status change (on by default)
+	void EnableIdleLoopSkipping(bool isEnabled) { m_idleLoopSkipping = isEnabled; }
+	int64_t GetSkippedIdleCycles() const { return m_skippedIdleCycles; }
+
+	// Chosen when loading a ROM.  Switching resets the decoded block cache.
+	void SetTiming(CpuTiming timing);
+	CpuTiming GetTiming() const { return m_timing; }
+
+	// Single stepping (RunNextInstruction) always interprets.  The native backend only runs with per instruction
+	// timing (it falls back to decoded blocks otherwise), and throws where it isn't built in.
+	void SetBackend(CpuBackend backend);
+	CpuBackend GetBackend() const { return m_backend; }
+	static bool IsBackendSupported(CpuBackend backend);
+
+	// Common instruction pairs run from a single handler in decoded blocks (on by default)
+	void EnableInstructionFusion(bool isEnabled);
+	uint64_t GetFusedInstructionCount() const { return m_fusedInstructionCount; } // Instructions which didn't need a dispatch of their own
+
+	// Uses (and adds to) the other CPU's decoded blocks rather than decoding our own, for consoles running the same ROM.
+	// Blocks only match code at the same host address, so this only helps once both have loaded the same NESRom.  Both must
+	// have the same timing and fusion settings; changing either, or the mapper, goes back to a cache of our own.
+	void ShareDecodedBlocks(const Cpu6502& other);
+
+	// Counts how often each opcode is followed by another in straight line code, for choosing which pairs to fuse.
+	// Everything runs through the interpreter while this is on.
+	void EnableOpCodePairProfiling(bool isEnabled);
+	uint64_t GetOpCodePairCount(uint8_t firstOpCode, uint8_t secondOpCode) const;
+
+	// Appends a CpuTraceRecord to pTraceBuffer before every instruction (null to stop).  Everything runs through the
+	// interpreter, and idle loops aren't skipped, while tracing.  With CpuTraceDetail::BackendSteps the backend runs
+	// as usual instead, and only the state between its blocks (and native code's handler calls) is recorded; that's
+	// still every instruction with CpuBackend::Interpreter.
+	void SetTraceBuffer(CpuTraceBuffer* pTraceBuffer, CpuTraceDetail detail = CpuTraceDetail::EveryInstruction);
+
+	// Counts every instruction's executions and cycles into pProfiler (null to stop).  Like tracing, this runs
+	// everything through the interpreter.
+	void SetProfiler(CpuProfiler* pProfiler);
 
 	const char* GetDebugState() const;
 	uint16_t GetProgramCounter() const { return m_pc; }
-
-	void GenerateNonMaskableInterrupt();
+	void SetProgramCounter(uint16_t pc) { m_pc = pc; } // e.g. to $C000 after a reset, for nestest's automated mode
 
 	//enum class OpCode : uint16_t;
-	typedef void (Cpu6502::*InstrunctionFunc)(AddressingMode addressingMode);
+	typedef void (Cpu6502::*InstrunctionFunc)();
 	struct OpCodeTableEntry
 	{
 		uint8_t opCode;
@@ -114,94 +198,158 @@ public:
 		AddressingMode addrMode;
 	};
 private:
-
-	OpCodeTableEntry* DoOpcodeStuff(uint8_t opCode);
-
-	void Instruction_Unhandled(AddressingMode addressingMode);
-	void Instruction_Noop(AddressingMode addressingMode);
-	void Instruction_Break(AddressingMode addressingMode);
-
-	void Instruction_LoadAccumulator(AddressingMode addressingMode);
-	void Instruction_LoadX(AddressingMode addressingMode);
-	void Instruction_LoadY(AddressingMode addressingMode);
-	void Instruction_StoreAccumulator(AddressingMode addressingMode);
-	void Instruction_StoreX(AddressingMode addressingMode);
-	void Instruction_StoreY(AddressingMode addressingMode);
-	void Instruction_Compare(AddressingMode addressingMode);
-	void Instruction_CompareXRegister(AddressingMode addressingMode);
-	void Instruction_CompareYRegister(AddressingMode addressingMode);
-	void Instruction_TestBits(AddressingMode addressingMode);
-	void Instruction_And(AddressingMode addressingMode);
-	void Instruction_OrWithAccumulator(AddressingMode addressingMode);
-	void Instruction_ExclusiveOr(AddressingMode addressingMode);
-	void Instruction_AddWithCarry(AddressingMode addressingMode);
-	void Instruction_SubtractWithCarry(AddressingMode addressingMode);
-	void Instruction_RotateLeft(AddressingMode addressingMode);
-	void Instruction_RotateRight(AddressingMode addressingMode);
-	void Instruction_ArithmeticShiftLeft(AddressingMode addressingMode);
-	void Instruction_LogicalShiftRight(AddressingMode addressingMode);
-	void Instruction_DecrementX(AddressingMode addressingMode);
-	void Instruction_IncrementX(AddressingMode addressingMode);
-	void Instruction_DecrementY(AddressingMode addressingMode);
-	void Instruction_IncrementY(AddressingMode addressingMode);
-	void Instruction_TransferAtoX(AddressingMode addressingMode);
-	void Instruction_TransferXtoA(AddressingMode addressingMode);
-	void Instruction_TransferAtoY(AddressingMode addressingMode);
-	void Instruction_TransferYtoA(AddressingMode addressingMode);
-	void Instruction_SetInterrupt(AddressingMode addressingMode);
-	void Instruction_ClearInterrupt(AddressingMode addressingMode);
-	void Instruction_SetDecimal(AddressingMode addressingMode);
-	void Instruction_ClearDecimal(AddressingMode addressingMode);
-	void Instruction_SetCarry(AddressingMode addressingMode);
-	void Instruction_ClearCarry(AddressingMode addressingMode);
-	void Instruction_ClearOverflow(AddressingMode addressingMode);
-	void Instruction_TransferXToStack(AddressingMode addressingMode);
-	void Instruction_TransferStackToX(AddressingMode addressingMode);
-	void Instruction_PushAccumulator(AddressingMode addressingMode);
-	void Instruction_PullAccumulator(AddressingMode addressingMode);
-	void Instruction_PushProcessorStatus(AddressingMode addressingMode);
-	void Instruction_PullProcessorStatus(AddressingMode addressingMode);
-	void Instruction_BranchOnPlus(AddressingMode addressingMode);
-	void Instruction_BranchOnMinus(AddressingMode addressingMode);
-	void Instruction_BranchOnOverflowClear(AddressingMode addressingMode);
-	void Instruction_BranchOnOverflowSet(AddressingMode addressingMode);
-	void Instruction_BranchOnCarryClear(AddressingMode addressingMode);
-	void Instruction_BranchOnCarrySet(AddressingMode addressingMode);
-	void Instruction_BranchOnNotEqual(AddressingMode addressingMode);
-	void Instruction_BranchOnEqual(AddressingMode addressingMode);
-	void Instruction_DecrementMemory(AddressingMode addressingMode);
-	void Instruction_IncrementMemory(AddressingMode addressingMode);
-	void Instruction_JumpToSubroutine(AddressingMode addressingMode);
-	void Instruction_ReturnFromSubroutine(AddressingMode addressingMode);
-	void Instruction_ReturnFromInterrupt(AddressingMode addressingMode);
-	void Instruction_Jump(AddressingMode addressingMode);
-	void Instruction_JumpIndirect(AddressingMode addressingMode);
+	friend struct PerInstructionTiming;
+	friend struct PerAccessTiming;
+	friend class DmaController;
+	friend class CpuLockstep;
+	friend class NativeBlockEmitter;
+	friend struct NativeCpuLayout;
+
+	template <typename TTiming> static const OpCodeTableEntry* GetOpCodeTable();
+	static const OpCodeTableEntry* GetPerInstructionOpCodeTable(); // For CpuLockstep, which can't see the timing policies
+
+	void Instruction_Unhandled();
+	void Instruction_Noop();
+	void Instruction_Break();
+
+	// Handlers with a memory operand are instantiated per timing policy, the register only ones are shared
+	template <typename TTiming, AddressingMode mode> void Instruction_LoadAccumulator();
+	template <typename TTiming, AddressingMode mode> void Instruction_LoadX();
+	template <typename TTiming, AddressingMode mode> void Instruction_LoadY();
+	template <typename TTiming, AddressingMode mode> void Instruction_StoreAccumulator();
+	template <typename TTiming, AddressingMode mode> void Instruction_StoreX();
+	template <typename TTiming, AddressingMode mode> void Instruction_StoreY();
+	template <typename TTiming, AddressingMode mode> void Instruction_Compare();
+	template <typename TTiming, AddressingMode mode> void Instruction_CompareXRegister();
+	template <typename TTiming, AddressingMode mode> void Instruction_CompareYRegister();
+	template <typename TTiming, AddressingMode mode> void Instruction_TestBits();
+	template <typename TTiming, AddressingMode mode> void Instruction_And();
+	template <typename TTiming, AddressingMode mode> void Instruction_OrWithAccumulator();
+	template <typename TTiming, AddressingMode mode> void Instruction_ExclusiveOr();
+	template <typename TTiming, AddressingMode mode> void Instruction_AddWithCarry();
+	template <typename TTiming, AddressingMode mode> void Instruction_SubtractWithCarry();
+	template <typename TTiming, AddressingMode mode> void Instruction_RotateLeft();
+	template <typename TTiming, AddressingMode mode> void Instruction_RotateRight();
+	template <typename TTiming, AddressingMode mode> void Instruction_ArithmeticShiftLeft();
+	template <typename TTiming, AddressingMode mode> void Instruction_LogicalShiftRight();
+	void Instruction_DecrementX();
+	void Instruction_IncrementX();
+	void Instruction_DecrementY();
+	void Instruction_IncrementY();
+	void Instruction_TransferAtoX();
+	void Instruction_TransferXtoA();
+	void Instruction_TransferAtoY();
+	void Instruction_TransferYtoA();
+	void Instruction_SetInterrupt();
+	void Instruction_ClearInterrupt();
+	void Instruction_SetDecimal();
+	void Instruction_ClearDecimal();
+	void Instruction_SetCarry();
+	void Instruction_ClearCarry();
+	void Instruction_ClearOverflow();
+	void Instruction_TransferXToStack();
+	void Instruction_TransferStackToX();
+	void Instruction_PushAccumulator();
+	void Instruction_PullAccumulator();
+	void Instruction_PushProcessorStatus();
+	void Instruction_PullProcessorStatus();
+	void Instruction_BranchOnPlus();
+	void Instruction_BranchOnMinus();
+	void Instruction_BranchOnOverflowClear();
+	void Instruction_BranchOnOverflowSet();
+	void Instruction_BranchOnCarryClear();
+	void Instruction_BranchOnCarrySet();
+	void Instruction_BranchOnNotEqual();
+	void Instruction_BranchOnEqual();
+	template <typename TTiming, AddressingMode mode> void Instruction_DecrementMemory();
+	template <typename TTiming, AddressingMode mode> void Instruction_IncrementMemory();
+	template <typename TTiming, AddressingMode mode> void Instruction_JumpToSubroutine();
+	void Instruction_ReturnFromSubroutine();
+	void Instruction_ReturnFromInterrupt();
+	template <typename TTiming, AddressingMode mode> void Instruction_Jump();
+	template <typename TTiming, AddressingMode mode> void Instruction_JumpIndirect();
 
 	void Helper_ExecuteBranch(bool shouldBranch);
 
+	template <InstrunctionFunc first, InstrunctionFunc second, uint8_t secondOpCode> void Instruction_Fused();
+
+	struct FusedInstructionEntry
+	{
+		uint8_t firstOpCode;
+		uint8_t secondOpCode;
+		InstrunctionFunc func;
+	};
+
+	static const FusedInstructionEntry s_fusedInstructionTable[];
+	static InstrunctionFunc FindFusedInstruction(uint8_t firstOpCode, uint8_t secondOpCode);
+
+	bool IsInterruptDue() const;
+	void ServiceInterrupt();
+
+	// The core is instantiated per timing policy, and again with instrumentation (pair profiling, tracing, the
+	// profiler) so the normal core doesn't test for any of it
+	void SelectCore();
+	bool IsInstrumented() const { return m_spOpCodePairCounts || (m_pTraceBuffer != nullptr) || (m_pProfiler != nullptr); }
+	template <typename TTiming, bool isInstrumented> void SetCore();
+	template <typename TTiming, bool isInstrumented> uint32_t RunNextInstructionWithTiming();
+	template <typename TTiming, bool isInstrumented> uint32_t RunUntilWithTiming(int64_t targetCycle);
+	template <typename TTiming, bool isInstrumented> void RunStepWithTiming(int64_t targetCycle);
+
+	// Decoded block execution
+	static uint32_t GetInstructionLength(uint8_t opCode, AddressingMode addrMode);
+	void ResetBlockCache();
+	template <typename TTiming> const DecodedBlock* GetDecodedBlock(uint16_t pc);
+	template <typename TTiming> void DecodeBlock(const uint8_t* pCode, uint16_t pc, DecodedBlock* pBlock) const;
+	template <typename TTiming> uint16_t RunBlock(const DecodedBlock& block, int64_t targetCycle);
+	template <typename TTiming> void RunDecodedInstruction(const DecodedInstruction& instruction);
+	bool ShouldLeaveBlock() const;
+
+	// Native blocks (CpuBackend::Native)
+	bool CompileNativeBlock(DecodedBlock* pBlock, uint16_t pc);
+	uint16_t RunNativeBlock(const DecodedBlock& block, int64_t targetCycle);
+	static bool RunNativeCalledInstruction(Cpu6502* pCpu, uint32_t opCode, uint32_t remainingMaxCycles);
+
+	bool IsTracingBackendSteps() const;
+	void AppendTraceRecord(uint16_t pc, uint8_t opCode);
+	void ProfileInstruction(uint16_t pc, uint8_t opCode);
+
+	// Idle loop skipping
+	bool PeekMemory8(uint16_t offset, uint8_t* pValue) const;
+	bool IsIdleLoop(uint16_t loopPc, uint16_t branchPc) const;
+	void TrySkipIdleLoop(uint16_t branchPc, int64_t targetCycle);
+
 	void AddCycles(uint32_t cycles);
 
 	// Read stuff
 	uint8_t ReadMemory8(uint16_t offset) const;
+	uint8_t ReadRegister8(uint16_t offset) const;
 	uint16_t ReadMemory16(uint8_t /*offset*/) const { throw std::runtime_error("Oh shit"); }
 	uint16_t ReadMemory16(uint16_t offset) const;
 
+	// Memory accesses made by instructions, which tick the bus under PerAccessTiming
+	template <typename TTiming> uint8_t BusRead8(uint16_t offset);
+	template <typename TTiming> uint16_t BusRead16(uint16_t offset);
+	template <typename TTiming> void BusWrite8(uint16_t offset, uint8_t val);
+
 	// Addressing mode resolution
-	template <typename Func>
-	void ReadModifyWriteUint8(AddressingMode mode, Func func);
+	template <typename TTiming, AddressingMode mode, typename Func>
+	void ReadModifyWriteUint8(Func func);
 
-	uint8_t ReadUInt8(AddressingMode mode);
-	uint16_t ReadUInt16(AddressingMode mode);
-	uint16_t GetAddressingModeOffset_Read(AddressingMode mode);
-	uint16_t GetAddressingModeOffset_ReadWrite(AddressingMode mode);
+	template <typename TTiming, AddressingMode mode> uint8_t ReadUInt8();
+	template <typename TTiming, AddressingMode mode> uint16_t ReadUInt16();
+	template <typename TTiming, AddressingMode mode> uint16_t GetAddressingModeOffset_Read();
+	template <typename TTiming, AddressingMode mode> uint16_t GetAddressingModeOffset_ReadWrite();
 
-	uint16_t GetIndexedIndirectOffset();
-	uint16_t GetIndirectIndexedOffset_Read();
-	uint16_t GetIndirectIndexedOffset_ReadWrite();
+	template <typename TTiming> uint16_t GetIndexedIndirectOffset();
+	template <typename TTiming> uint16_t GetIndirectIndexedOffset_Read();
+	template <typename TTiming> uint16_t GetIndirectIndexedOffset_ReadWrite();
 
 	// Write stuff
 	byte* MapWritableMemoryOffset(uint16_t offset);
-	void WriteMemory8(uint16_t offset, uint8_t val);
+	void WriteMemory8(uint16_t offset, uint8_t val, int64_t busCycle);
+	void WriteRegister8(uint16_t offset, uint8_t val, int64_t busCycle); // busCycle is the CPU cycle the write lands on
+
+	void ResetMemoryMap();
 
 	// Stack stuff
 	void PushValueOntoStack8(uint8_t val);
@@ -210,30 +358,20 @@ private:
 	uint8_t ReadValueFromStack8();
 
 	// Status flag
+	uint8_t GetStatus() const;
+	void SetStatus(uint8_t status);
 	void SetStatusFlagsFromValue(uint8_t value);
 	void SetStatusFlags(CpuStatusFlag flags, CpuStatusFlag mask);
+	bool IsNegativeFlagSet() const { return (m_negativeResult & 0x80) != 0; }
+	bool IsZeroFlagSet() const { return m_zeroResult == 0; }
 
 	// Random instruction helpers
 	void CompareValues(uint8_t minuend, uint8_t subtrahend);
 	void AddWithCarry(uint8_t val1, uint8_t val2);
 
-	// REVIEW: Simulate memory bus?
-	byte m_cpuRam[2*1024 /*2KB*/];
-
-	NES::NES& m_nes;
-	PPU::Ppu& m_ppu;
-	NES::APU::IApu& m_apu;
-	NES::IMapper* m_pMapper;
-
-	// PPU stuff
-	uint8_t m_ppuCtrlReg1;
-	uint8_t m_ppuCtrlReg2;
-	uint8_t m_ppuStatusReg;
-
-	uint32_t m_currentInstructionCycleCount = 0;
-	//uint64_t m_totalCycles = 0;
-	int64_t m_totalCycles = 0;
-	int64_t m_cyclesRemaining = 0;
+	// Members are laid out hot to cold.  Registers and everything the run loops touch on every instruction come
+	// first, followed by the page table and RAM, so the per instruction state (with the PPU's registers just ahead
+	// of it in the NES) is a few contiguous KB.  Pointers out to other devices and the debugging state follow.
 
 	// CPU Registers
 	uint16_t m_pc = 0; // Program counter
@@ -242,6 +380,76 @@ private:
 	uint8_t m_x = 0; // Index Register X
 	uint8_t m_y = 0; // Index Register Y
 	uint8_t m_status; // (P) processor status (NV.BDIZC) (N)egative,o(V)erflow,(B)reak,(D)ecimal,(I)nterrupt disable, (Z)ero Flag
+
+	// N and Z are evaluated lazily from the last result which set them, since they change on nearly every instruction
+	// but are rarely looked at.  The N/Z bits of m_status are stale; use GetStatus() for the real P register.
+	uint8_t m_negativeResult = 0; // N = bit 7
+	uint8_t m_zeroResult = 1;     // Z = (value == 0)
+
+	uint32_t m_currentInstructionCycleCount = 0;
+	uint32_t m_busCycle = 0; // Bus accesses made so far by the current instruction (PerAccessTiming only)
+	int64_t m_totalCycles = 0;
+	uint64_t m_instructionCount = 0;
+	uint64_t m_fusedInstructionCount = 0;
+
+	// State of the block being run, for fused instructions to stop between their halves exactly where RunBlock would
+	int64_t m_blockTargetCycle = 0;
+	uint32_t m_blockMemoryMapGeneration = 0;
+	uint16_t m_blockInstructionPc = 0; // PC of the last instruction started
+	std::shared_ptr<DecodedBlockCache> m_spBlockCache;
+
+	NES::Scheduler& m_scheduler;
+	NES::InterruptController& m_interrupts;
+	PPU::Ppu& m_ppu;
+
+	static const int32_t c_noIdleLoop = -1;
+
+	struct IdleLoopState
+	{
+		int32_t loopPc = c_noIdleLoop;
+		uint16_t branchPc = 0;
+		int64_t startCycle = 0;
+		uint64_t startInstructionCount = 0;
+
+		// Registers at the start of the last iteration
+		uint8_t acc = 0;
+		uint8_t x = 0;
+		uint8_t y = 0;
+		uint8_t status = 0;
+		uint8_t sp = 0;
+	};
+
+	bool m_idleLoopSkipping = true;
+	IdleLoopState m_idleLoop;
+
+	NES::CpuMemoryMap m_memoryMap;
+	byte m_cpuRam[2*1024 /*2KB*/];
+
+	// Only needed once per RunUntil, or on the slow (register) path
+	CpuTiming m_timing = CpuTiming::PerInstruction;
+	uint32_t (Cpu6502::*m_pfnRunUntil)(int64_t targetCycle) = nullptr;
+	void (Cpu6502::*m_pfnRunStep)(int64_t targetCycle) = nullptr;
+	uint32_t (Cpu6502::*m_pfnRunNextInstruction)() = nullptr;
+
+	CpuBackend m_backend = CpuBackend::DecodedBlocks;
+	bool m_instructionFusion = true;
+	std::exception_ptr m_nativeException; // Thrown by a handler called from native code, to be rethrown once out of it
+
+	NES::NES& m_nes;
+	NES::APU::IApu& m_apu;
+	NES::IMapper* m_pMapper;
+	DmaController m_dma;
+
+	int64_t m_skippedIdleCycles = 0;
+
+	// Debugging and profiling
+	std::unique_ptr<uint64_t[]> m_spOpCodePairCounts; // [first << 8 | second], null unless profiling
+	int32_t m_lastProfiledOpCode = -1;                 // -1 if the last instruction doesn't fall through to the next
+
+	CpuTraceBuffer* m_pTraceBuffer = nullptr;
+	CpuTraceDetail m_traceDetail = CpuTraceDetail::EveryInstruction;
+	int64_t m_lastTraceCycle = -1;
+	CpuProfiler* m_pProfiler = nullptr;
 };
 
 }
@@ -0,0 +1,812 @@
+#include "stdafx.h"
+#include "CpuLockstep.h"
+#include "Cpu6502.h"
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace CPU
+{
+
+const uint16_t c_lockstepStackOffset = 0x100;
+const uint16_t c_lockstepRamEnd = 0x2000; // CPU RAM and its mirrors
+const uint16_t c_lockstepRamMask = 0x07FF;
+
+// Most cycles an instruction can take past its base cycles (a taken branch to another page)
+const int64_t c_maxExtraCycles = 2;
+
+namespace
+{
+
+// What an opcode does when run in lockstep.  The addressing mode and cycles come from the CPU's opcode table.
+enum class LockstepOp : uint8_t
+{
+	None, // Has to run on each CPU alone
+
+	// Read a memory (or immediate) operand
+	LoadA, LoadX, LoadY, And, Or, ExclusiveOr, AddWithCarry, SubtractWithCarry, CompareA, CompareX, CompareY, TestBits,
+
+	// Write a memory operand
+	StoreA, StoreX, StoreY,
+
+	// Read-modify-write, of memory or the accumulator
+	Increment, Decrement, ShiftLeft, ShiftRight, RotateLeft, RotateRight,
+
+	// Registers, flags and the stack
+	IncrementX, DecrementX, IncrementY, DecrementY,
+	TransferAtoX, TransferXtoA, TransferAtoY, TransferYtoA, TransferStackToX, TransferXToStack,
+	ClearCarry, SetCarry, ClearOverflow, ClearDecimal, SetDecimal, Noop,
+	PushA, PullA, PushStatus,
+
+	// Only while they leave the I flag as it was
+	SetInterrupt, ClearInterrupt, PullStatus,
+
+	// Flow control
+	Branch, Jump, JumpToSubroutine, ReturnFromSubroutine,
+};
+
+LockstepOp GetLockstepOp(uint8_t opCode)
+{
+	switch (opCode)
+	{
+	case 0xA9: case 0xA5: case 0xB5: case 0xAD: case 0xBD: case 0xB9: case 0xA1: case 0xB1: return LockstepOp::LoadA;
+	case 0xA2: case 0xA6: case 0xB6: case 0xAE: case 0xBE: return LockstepOp::LoadX;
+	case 0xA0: case 0xA4: case 0xB4: case 0xAC: case 0xBC: return LockstepOp::LoadY;
+	case 0x29: case 0x25: case 0x35: case 0x2D: case 0x3D: case 0x39: case 0x21: case 0x31: return LockstepOp::And;
+	case 0x09: case 0x05: case 0x15: case 0x0D: case 0x1D: case 0x19: case 0x01: case 0x11: return LockstepOp::Or;
+	case 0x49: case 0x45: case 0x55: case 0x4D: case 0x5D: case 0x59: case 0x41: case 0x51: return LockstepOp::ExclusiveOr;
+	case 0x69: case 0x65: case 0x75: case 0x6D: case 0x7D: case 0x79: case 0x61: case 0x71: return LockstepOp::AddWithCarry;
+	case 0xE9: case 0xE5: case 0xF5: case 0xED: case 0xFD: case 0xF9: case 0xE1: case 0xF1: return LockstepOp::SubtractWithCarry;
+	case 0xC9: case 0xC5: case 0xD5: case 0xCD: case 0xDD: case 0xD9: case 0xC1: case 0xD1: return LockstepOp::CompareA;
+	case 0xE0: case 0xE4: case 0xEC: return LockstepOp::CompareX;
+	case 0xC0: case 0xC4: case 0xCC: return LockstepOp::CompareY;
+	case 0x24: case 0x2C: return LockstepOp::TestBits;
+
+	case 0x85: case 0x95: case 0x8D: case 0x9D: case 0x99: case 0x81: case 0x91: return LockstepOp::StoreA;
+	case 0x86: case 0x96: case 0x8E: return LockstepOp::StoreX;
+	case 0x84: case 0x94: case 0x8C: return LockstepOp::StoreY;
+
+	case 0xE6: case 0xF6: case 0xEE: case 0xFE: return LockstepOp::Increment;
+	case 0xC6: case 0xD6: case 0xCE: case 0xDE: return LockstepOp::Decrement;
+	case 0x0A: case 0x06: case 0x16: case 0x0E: case 0x1E: return LockstepOp::ShiftLeft;
+	case 0x4A: case 0x46: case 0x56: case 0x4E: case 0x5E: return LockstepOp::ShiftRight;
+	case 0x2A: case 0x26: case 0x36: case 0x2E: case 0x3E: return LockstepOp::RotateLeft;
+	case 0x6A: case 0x66: case 0x76: case 0x6E: case 0x7E: return LockstepOp::RotateRight;
+
+	case 0xE8: return LockstepOp::IncrementX;
+	case 0xCA: return LockstepOp::DecrementX;
+	case 0xC8: return LockstepOp::IncrementY;
+	case 0x88: return LockstepOp::DecrementY;
+	case 0xAA: return LockstepOp::TransferAtoX;
+	case 0x8A: return LockstepOp::TransferXtoA;
+	case 0xA8: return LockstepOp::TransferAtoY;
+	case 0x98: return LockstepOp::TransferYtoA;
+	case 0xBA: return LockstepOp::TransferStackToX;
+	case 0x9A: return LockstepOp::TransferXToStack;
+	case 0x18: return LockstepOp::ClearCarry;
+	case 0x38: return LockstepOp::SetCarry;
+	case 0xB8: return LockstepOp::ClearOverflow;
+	case 0xD8: return LockstepOp::ClearDecimal;
+	case 0xF8: return LockstepOp::SetDecimal;
+	case 0xEA: return LockstepOp::Noop;
+	case 0x48: return LockstepOp::PushA;
+	case 0x68: return LockstepOp::PullA;
+	case 0x08: return LockstepOp::PushStatus;
+	case 0x78: return LockstepOp::SetInterrupt;
+	case 0x58: return LockstepOp::ClearInterrupt;
+	case 0x28: return LockstepOp::PullStatus;
+
+	case 0x10: case 0x30: case 0x50: case 0x70: case 0x90: case 0xB0: case 0xD0: case 0xF0: return LockstepOp::Branch;
+	case 0x4C: return LockstepOp::Jump;
+	case 0x20: return LockstepOp::JumpToSubroutine;
+	case 0x60: return LockstepOp::ReturnFromSubroutine;
+
+	default:
+		// BRK and RTI change the I flag, and JMP (indirect) is rare enough not to bother
+		return LockstepOp::None;
+	}
+}
+
+template <typename T>
+std::unique_ptr<T[]> AllocateByCpu(uint32_t cpuCount)
+{
+	return std::unique_ptr<T[]>(new T[cpuCount]());
+}
+
+}
+
+
+// What an opcode does in lockstep, along with what the CPU's opcode table says about it
+struct CpuLockstep::Instruction
+{
+	LockstepOp op;
+	AddressingMode addrMode;
+	uint8_t baseCycles;
+	uint8_t length;
+};
+
+
+CpuLockstep::CpuLockstep(uint32_t maxCpuCount)
+	: m_maxCpuCount(maxCpuCount)
+	, m_instructions(new Instruction[256])
+	, m_pc(AllocateByCpu<uint16_t>(maxCpuCount))
+	, m_acc(AllocateByCpu<uint8_t>(maxCpuCount))
+	, m_x(AllocateByCpu<uint8_t>(maxCpuCount))
+	, m_y(AllocateByCpu<uint8_t>(maxCpuCount))
+	, m_sp(AllocateByCpu<uint8_t>(maxCpuCount))
+	, m_status(AllocateByCpu<uint8_t>(maxCpuCount))
+	, m_negativeResult(AllocateByCpu<uint8_t>(maxCpuCount))
+	, m_zeroResult(AllocateByCpu<uint8_t>(maxCpuCount))
+	, m_openBus(AllocateByCpu<uint8_t>(maxCpuCount))
+	, m_cycles(AllocateByCpu<int64_t>(maxCpuCount))
+	, m_targetCycles(AllocateByCpu<int64_t>(maxCpuCount))
+	, m_pRam(AllocateByCpu<uint8_t*>(maxCpuCount))
+	, m_address(AllocateByCpu<uint16_t>(maxCpuCount))
+	, m_pRead(AllocateByCpu<const uint8_t*>(maxCpuCount))
+	, m_pWrite(AllocateByCpu<uint8_t*>(maxCpuCount))
+	, m_value(AllocateByCpu<uint8_t>(maxCpuCount))
+	, m_extraCycles(AllocateByCpu<uint8_t>(maxCpuCount))
+{
+	const Cpu6502::OpCodeTableEntry* const pOpCodeTable = Cpu6502::GetPerInstructionOpCodeTable();
+	for (uint32_t opCode = 0; opCode != 256; ++opCode)
+	{
+		const Cpu6502::OpCodeTableEntry& opCodeEntry = pOpCodeTable[opCode];
+		Instruction& instruction = m_instructions[opCode];
+		instruction.op = (opCodeEntry.func != &Cpu6502::Instruction_Unhandled) ? GetLockstepOp(static_cast<uint8_t>(opCode)) : LockstepOp::None;
+		instruction.addrMode = opCodeEntry.addrMode;
+		instruction.baseCycles = static_cast<uint8_t>(opCodeEntry.baseCycles);
+		instruction.length = static_cast<uint8_t>(Cpu6502::GetInstructionLength(static_cast<uint8_t>(opCode), opCodeEntry.addrMode));
+	}
+}
+
+
+CpuLockstep::~CpuLockstep()
+{
+}
+
+
+bool CpuLockstep::CanRun(const Cpu6502& cpu)
+{
+	return cpu.m_timing == CpuTiming::PerInstruction && cpu.m_backend != CpuBackend::Interpreter && !cpu.IsInstrumented() &&
+		!cpu.IsInterruptDue();
+}
+
+
+uint32_t CpuLockstep::Run(Cpu6502* const* ppCpus, const int64_t* pTargetCycles, uint32_t cpuCount)
+{
+	if (cpuCount > m_maxCpuCount)
+		throw std::runtime_error("Too many CPUs for a lockstep run");
+
+	Gather(ppCpus, pTargetCycles, cpuCount);
+
+	uint16_t pc = ppCpus[0]->m_pc;
+	const uint8_t* pCodePage = nullptr;
+	uint32_t codePageNumber = 0;
+
+	// The fewest cycles any CPU has left before its target.  Only exact when just looked up; in between it's
+	// lowered by the most each instruction could have taken.
+	int64_t cyclesLeft = GetFewestCyclesLeft();
+
+	uint32_t instructionCount = 0;
+	bool hasJumpedBack = false;
+	RunResult result = RunResult::Continue;
+	while (result == RunResult::Continue)
+	{
+		if (cyclesLeft <= 0)
+		{
+			cyclesLeft = GetFewestCyclesLeft();
+			if (cyclesLeft <= 0)
+				break;
+		}
+
+		// Every CPU has to have the same code here, which also rules out code in RAM
+		if (pCodePage == nullptr || (pc >> NES::c_cpuPageShift) != codePageNumber)
+		{
+			pCodePage = GetSharedCodePage(pc);
+			if (pCodePage == nullptr)
+				break;
+			codePageNumber = pc >> NES::c_cpuPageShift;
+		}
+
+		const uint32_t codeOffset = pc & NES::c_cpuPageMask;
+		const uint8_t opCode = pCodePage[codeOffset];
+		const Instruction& instruction = m_instructions[opCode];
+
+		// Instructions straddling the end of the page are left to the interpreter, as in decoded blocks
+		if (instruction.op == LockstepOp::None || codeOffset + instruction.length > NES::c_cbCpuPage)
+			break;
+
+		const uint16_t instructionPc = pc;
+		result = RunInstruction(instruction, opCode, pCodePage + codeOffset + 1, &pc);
+		if (result == RunResult::Stop)
+			break;
+
+		// As RunUntil, any jump back other than an idle loop's (which stops the run) starts the search for one over
+		hasJumpedBack |= (result == RunResult::Diverged) || (pc <= instructionPc);
+		instructionCount++;
+		cyclesLeft -= instruction.baseCycles + c_maxExtraCycles;
+	}
+
+	Scatter(pc, result == RunResult::Diverged, instructionCount, hasJumpedBack);
+	return instructionCount;
+}
+
+
+CpuLockstep::RunResult CpuLockstep::RunInstruction(const Instruction& instruction, uint8_t opCode, const uint8_t* pOperands, uint16_t* pPc)
+{
+	const LockstepOp op = instruction.op;
+	const AddressingMode addrMode = instruction.addrMode;
+	const uint16_t instructionPc = *pPc;
+	const uint16_t nextPc = static_cast<uint16_t>(instructionPc + instruction.length);
+
+	const uint32_t n = m_cpuCount;
+	uint8_t* const acc = m_acc.get();
+	uint8_t* const x = m_x.get();
+	uint8_t* const y = m_y.get();
+	uint8_t* const sp = m_sp.get();
+	uint8_t* const status = m_status.get();
+	uint8_t* const negativeResult = m_negativeResult.get();
+	uint8_t* const zeroResult = m_zeroResult.get();
+	uint8_t* const openBus = m_openBus.get();
+	int64_t* const cycles = m_cycles.get();
+	uint8_t* const* const pRam = m_pRam.get();
+	const uint8_t* const* const pRead = m_pRead.get();
+	uint8_t* const* const pWrite = m_pWrite.get();
+	uint8_t* const value = m_value.get();
+	uint8_t* const extraCycles = m_extraCycles.get();
+
+	const uint8_t baseCycles = instruction.baseCycles;
+	const uint8_t carry = static_cast<uint8_t>(CpuStatusFlag::Carry);
+	const uint8_t overflow = static_cast<uint8_t>(CpuStatusFlag::Overflow);
+
+	auto setResult = [=](uint32_t i, uint8_t result) { negativeResult[i] = result; zeroResult[i] = result; };
+	auto setCarry = [=](uint32_t i, uint8_t isSet) { status[i] = static_cast<uint8_t>((status[i] & ~carry) | isSet); };
+	auto addCycles = [=]() { for (uint32_t i = 0; i != n; ++i) cycles[i] += baseCycles + extraCycles[i]; };
+
+	// Everything which can stop the instruction is checked before any CPU is changed
+	if (op >= LockstepOp::LoadA && op <= LockstepOp::TestBits)
+	{
+		if (addrMode == AddressingMode::IMM)
+		{
+			std::fill(value, value + n, pOperands[0]);
+			std::fill(extraCycles, extraCycles + n, static_cast<uint8_t>(0));
+		}
+		else
+		{
+			ResolveAddresses(addrMode, pOperands, true);
+			if (!MapMemory(true, false))
+				return RunResult::Stop;
+
+			for (uint32_t i = 0; i != n; ++i)
+				value[i] = *pRead[i];
+		}
+
+		switch (op)
+		{
+		case LockstepOp::LoadA: for (uint32_t i = 0; i != n; ++i) { acc[i] = value[i]; setResult(i, acc[i]); } break;
+		case LockstepOp::LoadX: for (uint32_t i = 0; i != n; ++i) { x[i] = value[i]; setResult(i, x[i]); } break;
+		case LockstepOp::LoadY: for (uint32_t i = 0; i != n; ++i) { y[i] = value[i]; setResult(i, y[i]); } break;
+		case LockstepOp::And: for (uint32_t i = 0; i != n; ++i) { acc[i] &= value[i]; setResult(i, acc[i]); } break;
+		case LockstepOp::Or: for (uint32_t i = 0; i != n; ++i) { acc[i] |= value[i]; setResult(i, acc[i]); } break;
+		case LockstepOp::ExclusiveOr: for (uint32_t i = 0; i != n; ++i) { acc[i] ^= value[i]; setResult(i, acc[i]); } break;
+
+		case LockstepOp::SubtractWithCarry:
+			// A - M - (1 - C) is A + ~M + C
+			for (uint32_t i = 0; i != n; ++i)
+				value[i] = static_cast<uint8_t>(~value[i]);
+			// Fall through
+		case LockstepOp::AddWithCarry:
+			for (uint32_t i = 0; i != n; ++i)
+			{
+				const uint32_t sum = acc[i] + value[i] + (status[i] & carry);
+				const uint8_t result = static_cast<uint8_t>(sum);
+
+				// Signed overflow is when both inputs have the same sign, and the result doesn't
+				const uint8_t signedOverflow = static_cast<uint8_t>((~(acc[i] ^ value[i]) & (acc[i] ^ result) & 0x80) >> 1);
+				status[i] = static_cast<uint8_t>((status[i] & ~(carry | overflow)) | (sum >> 8) | signedOverflow);
+				acc[i] = result;
+				setResult(i, result);
+			}
+			break;
+
+		case LockstepOp::CompareA: for (uint32_t i = 0; i != n; ++i) { setResult(i, static_cast<uint8_t>(acc[i] - value[i])); setCarry(i, acc[i] >= value[i]); } break;
+		case LockstepOp::CompareX: for (uint32_t i = 0; i != n; ++i) { setResult(i, static_cast<uint8_t>(x[i] - value[i])); setCarry(i, x[i] >= value[i]); } break;
+		case LockstepOp::CompareY: for (uint32_t i = 0; i != n; ++i) { setResult(i, static_cast<uint8_t>(y[i] - value[i])); setCarry(i, y[i] >= value[i]); } break;
+
+		case LockstepOp::TestBits:
+			// N and V come straight from the memory value, Z from the masked value
+			for (uint32_t i = 0; i != n; ++i)
+			{
+				negativeResult[i] = value[i];
+				zeroResult[i] = value[i] & acc[i];
+				status[i] = static_cast<uint8_t>((status[i] & ~overflow) | (value[i] & overflow));
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		std::copy(value, value + n, openBus);
+		addCycles();
+		*pPc = nextPc;
+		return RunResult::Continue;
+	}
+
+	if (op >= LockstepOp::StoreA && op <= LockstepOp::StoreY)
+	{
+		ResolveAddresses(addrMode, pOperands, false);
+		if (!MapMemory(false, true))
+			return RunResult::Stop;
+
+		const uint8_t* const source = (op == LockstepOp::StoreA) ? acc : (op == LockstepOp::StoreX) ? x : y;
+		for (uint32_t i = 0; i != n; ++i)
+			*pWrite[i] = source[i];
+
+		std::copy(source, source + n, openBus);
+		addCycles();
+		*pPc = nextPc;
+		return RunResult::Continue;
+	}
+
+	if (op >= LockstepOp::Increment && op <= LockstepOp::RotateRight)
+	{
+		const bool isAccumulator = (addrMode == AddressingMode::ACC);
+		if (isAccumulator)
+		{
+			std::copy(acc, acc + n, value);
+		}
+		else
+		{
+			ResolveAddresses(addrMode, pOperands, false);
+			if (!MapMemory(true, true))
+				return RunResult::Stop;
+
+			for (uint32_t i = 0; i != n; ++i)
+				value[i] = *pRead[i];
+		}
+
+		switch (op)
+		{
+		case LockstepOp::Increment: for (uint32_t i = 0; i != n; ++i) { value[i]++; setResult(i, value[i]); } break;
+		case LockstepOp::Decrement: for (uint32_t i = 0; i != n; ++i) { value[i]--; setResult(i, value[i]); } break;
+
+		case LockstepOp::ShiftLeft:
+			for (uint32_t i = 0; i != n; ++i)
+			{
+				setCarry(i, value[i] >> 7);
+				value[i] = static_cast<uint8_t>(value[i] << 1);
+				setResult(i, value[i]);
+			}
+			break;
+
+		case LockstepOp::ShiftRight:
+			for (uint32_t i = 0; i != n; ++i)
+			{
+				setCarry(i, value[i] & 0x01);
+				value[i] >>= 1;
+				setResult(i, value[i]);
+			}
+			break;
+
+		case LockstepOp::RotateLeft:
+			for (uint32_t i = 0; i != n; ++i)
+			{
+				const uint8_t result = static_cast<uint8_t>((value[i] << 1) | (status[i] & carry));
+				setCarry(i, value[i] >> 7);
+				value[i] = result;
+				setResult(i, result);
+			}
+			break;
+
+		case LockstepOp::RotateRight:
+			for (uint32_t i = 0; i != n; ++i)
+			{
+				const uint8_t result = static_cast<uint8_t>((value[i] >> 1) | ((status[i] & carry) << 7));
+				setCarry(i, value[i] & 0x01);
+				value[i] = result;
+				setResult(i, result);
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		if (isAccumulator)
+		{
+			std::copy(value, value + n, acc);
+		}
+		else
+		{
+			// The write back of the original value first makes no difference to plain memory
+			for (uint32_t i = 0; i != n; ++i)
+				*pWrite[i] = value[i];
+			std::copy(value, value + n, openBus);
+		}
+
+		std::fill(extraCycles, extraCycles + n, static_cast<uint8_t>(0));
+		addCycles();
+		*pPc = nextPc;
+		return RunResult::Continue;
+	}
+
+	// Everything else has no memory operand to check, and only flow control adds cycles
+	if (op >= LockstepOp::SetInterrupt && op <= LockstepOp::PullStatus && !IsInterruptFlagKept(opCode))
+		return RunResult::Stop;
+
+	std::fill(extraCycles, extraCycles + n, static_cast<uint8_t>(0));
+	RunResult result = RunResult::Continue;
+	uint16_t newPc = nextPc;
+
+	switch (op)
+	{
+	case LockstepOp::IncrementX: for (uint32_t i = 0; i != n; ++i) { x[i]++; setResult(i, x[i]); } break;
+	case LockstepOp::DecrementX: for (uint32_t i = 0; i != n; ++i) { x[i]--; setResult(i, x[i]); } break;
+	case LockstepOp::IncrementY: for (uint32_t i = 0; i != n; ++i) { y[i]++; setResult(i, y[i]); } break;
+	case LockstepOp::DecrementY: for (uint32_t i = 0; i != n; ++i) { y[i]--; setResult(i, y[i]); } break;
+	case LockstepOp::TransferAtoX: for (uint32_t i = 0; i != n; ++i) { x[i] = acc[i]; setResult(i, x[i]); } break;
+	case LockstepOp::TransferXtoA: for (uint32_t i = 0; i != n; ++i) { acc[i] = x[i]; setResult(i, acc[i]); } break;
+	case LockstepOp::TransferAtoY: for (uint32_t i = 0; i != n; ++i) { y[i] = acc[i]; setResult(i, y[i]); } break;
+	case LockstepOp::TransferYtoA: for (uint32_t i = 0; i != n; ++i) { acc[i] = y[i]; setResult(i, acc[i]); } break;
+	case LockstepOp::TransferStackToX: for (uint32_t i = 0; i != n; ++i) { x[i] = sp[i]; setResult(i, x[i]); } break;
+	case LockstepOp::TransferXToStack: std::copy(x, x + n, sp); break;
+	case LockstepOp::ClearCarry: for (uint32_t i = 0; i != n; ++i) setCarry(i, 0); break;
+	case LockstepOp::SetCarry: for (uint32_t i = 0; i != n; ++i) setCarry(i, carry); break;
+	case LockstepOp::ClearOverflow: for (uint32_t i = 0; i != n; ++i) status[i] &= ~overflow; break;
+	case LockstepOp::ClearDecimal: for (uint32_t i = 0; i != n; ++i) status[i] &= ~static_cast<uint8_t>(CpuStatusFlag::DecimalMode); break;
+	case LockstepOp::SetDecimal: for (uint32_t i = 0; i != n; ++i) status[i] |= static_cast<uint8_t>(CpuStatusFlag::DecimalMode); break;
+	case LockstepOp::Noop: break;
+
+	// The stack is always CPU RAM, and doesn't go through the bus
+	case LockstepOp::PushA:
+		for (uint32_t i = 0; i != n; ++i)
+			pRam[i][c_lockstepStackOffset + sp[i]--] = acc[i];
+		break;
+
+	case LockstepOp::PullA:
+		for (uint32_t i = 0; i != n; ++i)
+		{
+			acc[i] = pRam[i][c_lockstepStackOffset + ++sp[i]];
+			setResult(i, acc[i]);
+		}
+		break;
+
+	case LockstepOp::PushStatus:
+		// As Cpu6502::GetStatus, with B set as PHP pushes it
+		for (uint32_t i = 0; i != n; ++i)
+		{
+			const uint8_t pushedStatus = static_cast<uint8_t>((status[i] & ~static_cast<uint8_t>(CpuStatusFlag::Negative | CpuStatusFlag::Zero))
+				| (negativeResult[i] & static_cast<uint8_t>(CpuStatusFlag::Negative))
+				| ((zeroResult[i] == 0) ? static_cast<uint8_t>(CpuStatusFlag::Zero) : 0)
+				| static_cast<uint8_t>(CpuStatusFlag::BreakCommand));
+			pRam[i][c_lockstepStackOffset + sp[i]--] = pushedStatus;
+		}
+		break;
+
+	case LockstepOp::SetInterrupt:
+	case LockstepOp::ClearInterrupt:
+		// Already checked that the flag is as these would leave it
+		break;
+
+	case LockstepOp::PullStatus:
+		// As Cpu6502::SetStatus, keeping B and bit 5
+		for (uint32_t i = 0; i != n; ++i)
+		{
+			const uint8_t statusLoadMask = static_cast<uint8_t>(CpuStatusFlag::BreakCommand | CpuStatusFlag::Bit5);
+			const uint8_t statusFromStack = pRam[i][c_lockstepStackOffset + ++sp[i]];
+			status[i] = static_cast<uint8_t>((status[i] & statusLoadMask) | (statusFromStack & ~statusLoadMask));
+			negativeResult[i] = status[i] & static_cast<uint8_t>(CpuStatusFlag::Negative);
+			zeroResult[i] = ((status[i] & static_cast<uint8_t>(CpuStatusFlag::Zero)) != 0) ? 0 : 1;
+		}
+		break;
+
+	case LockstepOp::Branch:
+	{
+		// Branches are xxy10000, where xx picks the flag and y the value to branch on
+		const uint32_t flagIndex = opCode >> 6;
+		const uint8_t branchIfSet = (opCode & 0x20) ? 1 : 0;
+		for (uint32_t i = 0; i != n; ++i)
+		{
+			const uint8_t isSet =
+				(flagIndex == 0) ? (negativeResult[i] >> 7) :
+				(flagIndex == 1) ? ((status[i] & overflow) >> 6) :
+				(flagIndex == 2) ? (status[i] & carry) :
+				(zeroResult[i] == 0);
+			value[i] = (isSet == branchIfSet) ? 1 : 0;
+		}
+
+		// Same page crossing test as Cpu6502::Helper_ExecuteBranch
+		const int8_t relativeOffset = static_cast<int8_t>(pOperands[0]);
+		const uint16_t targetPc = static_cast<uint16_t>(nextPc + relativeOffset);
+		const uint8_t takenCycles = ((nextPc + relativeOffset) >> 8 != nextPc >> 8) ? 2 : 1;
+
+		uint32_t takenCount = 0;
+		for (uint32_t i = 0; i != n; ++i)
+		{
+			extraCycles[i] = value[i] * takenCycles;
+			takenCount += value[i];
+		}
+
+		if (takenCount == n && IsIdleLoop(targetPc, instructionPc))
+			return RunResult::Stop;
+
+		std::fill(openBus, openBus + n, pOperands[0]);
+
+		if (takenCount == n)
+		{
+			newPc = targetPc;
+		}
+		else if (takenCount != 0)
+		{
+			for (uint32_t i = 0; i != n; ++i)
+				m_pc[i] = value[i] ? targetPc : nextPc;
+			result = RunResult::Diverged;
+		}
+		break;
+	}
+
+	case LockstepOp::Jump:
+	{
+		const uint16_t targetPc = static_cast<uint16_t>((pOperands[1] << 8) | pOperands[0]);
+		if (IsIdleLoop(targetPc, instructionPc))
+			return RunResult::Stop;
+
+		std::fill(openBus, openBus + n, pOperands[1]);
+		newPc = targetPc;
+		break;
+	}
+
+	case LockstepOp::JumpToSubroutine:
+		// Pushes the address of its last byte
+		for (uint32_t i = 0; i != n; ++i)
+		{
+			pRam[i][c_lockstepStackOffset + sp[i]--] = static_cast<uint8_t>((nextPc - 1) >> 8);
+			pRam[i][c_lockstepStackOffset + sp[i]--] = static_cast<uint8_t>(nextPc - 1);
+		}
+		std::fill(openBus, openBus + n, pOperands[1]);
+		newPc = static_cast<uint16_t>((pOperands[1] << 8) | pOperands[0]);
+		break;
+
+	case LockstepOp::ReturnFromSubroutine:
+	{
+		bool isSamePc = true;
+		for (uint32_t i = 0; i != n; ++i)
+		{
+			const uint8_t lowByte = pRam[i][c_lockstepStackOffset + ++sp[i]];
+			const uint8_t highByte = pRam[i][c_lockstepStackOffset + ++sp[i]];
+			m_pc[i] = static_cast<uint16_t>(((highByte << 8) | lowByte) + 1);
+			isSamePc &= (m_pc[i] == m_pc[0]);
+		}
+
+		if (isSamePc)
+			newPc = m_pc[0];
+		else
+			result = RunResult::Diverged;
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	addCycles();
+	*pPc = newPc;
+	return result;
+}
+
+
+// Fills in m_address (and m_extraCycles) with each CPU's effective address, as GetAddressingModeOffset_Read
+// (chargesPageCross) or GetAddressingModeOffset_ReadWrite does
+void CpuLockstep::ResolveAddresses(AddressingMode addrMode, const uint8_t* pOperands, bool chargesPageCross)
+{
+	const uint32_t n = m_cpuCount;
+	uint16_t* const address = m_address.get();
+	uint8_t* const extraCycles = m_extraCycles.get();
+	const uint8_t* const x = m_x.get();
+	const uint8_t* const y = m_y.get();
+	uint8_t* const* const pRam = m_pRam.get();
+
+	const uint16_t absoluteAddress = static_cast<uint16_t>((pOperands[1] << 8) | pOperands[0]);
+	const uint8_t zpAddress = pOperands[0];
+
+	std::fill(extraCycles, extraCycles + n, static_cast<uint8_t>(0));
+
+	switch (addrMode)
+	{
+	case AddressingMode::ABS:
+		std::fill(address, address + n, absoluteAddress);
+		break;
+
+	case AddressingMode::ABSX:
+	case AddressingMode::ABSY:
+	{
+		const uint8_t* const index = (addrMode == AddressingMode::ABSX) ? x : y;
+		for (uint32_t i = 0; i != n; ++i)
+		{
+			address[i] = static_cast<uint16_t>(absoluteAddress + index[i]);
+			extraCycles[i] = (chargesPageCross && ((absoluteAddress ^ address[i]) & 0x100) != 0) ? 1 : 0;
+		}
+		break;
+	}
+
+	case AddressingMode::ZP:
+		std::fill(address, address + n, static_cast<uint16_t>(zpAddress));
+		break;
+
+	case AddressingMode::ZPX:
+	case AddressingMode::ZPY:
+	{
+		const uint8_t* const index = (addrMode == AddressingMode::ZPX) ? x : y;
+		for (uint32_t i = 0; i != n; ++i)
+			address[i] = static_cast<uint8_t>(zpAddress + index[i]);
+		break;
+	}
+
+	case AddressingMode::_ZPX_:
+		// The pointer is in zero page (always CPU RAM), and wraps around within it
+		for (uint32_t i = 0; i != n; ++i)
+		{
+			const uint8_t pointer = static_cast<uint8_t>(zpAddress + x[i]);
+			address[i] = static_cast<uint16_t>((pRam[i][static_cast<uint8_t>(pointer + 1)] << 8) | pRam[i][pointer]);
+		}
+		break;
+
+	case AddressingMode::_ZP_Y:
+		for (uint32_t i = 0; i != n; ++i)
+		{
+			const uint16_t baseAddress = static_cast<uint16_t>((pRam[i][static_cast<uint8_t>(zpAddress + 1)] << 8) | pRam[i][zpAddress]);
+			address[i] = static_cast<uint16_t>(baseAddress + y[i]);
+			extraCycles[i] = (chargesPageCross && ((baseAddress ^ address[i]) & 0x100) != 0) ? 1 : 0;
+		}
+		break;
+
+	default:
+		throw UnhandledInstruction(0);
+	}
+}
+
+
+// Looks up each CPU's m_address in its page table, returning false if any of them isn't plain memory
+bool CpuLockstep::MapMemory(bool isRead, bool isWrite)
+{
+	bool isMapped = true;
+	for (uint32_t i = 0; i != m_cpuCount; ++i)
+	{
+		const uint16_t address = m_address[i];
+		if (address < c_lockstepRamEnd)
+		{
+			// Always CPU RAM (and its mirrors), so the page table can be skipped
+			m_pRead[i] = m_pWrite[i] = m_pRam[i] + (address & c_lockstepRamMask);
+			continue;
+		}
+
+		const NES::CpuMemoryMap& memoryMap = m_ppCpus[i]->m_memoryMap;
+		const uint32_t pageOffset = address & NES::c_cpuPageMask;
+
+		if (isRead)
+		{
+			const uint8_t* pPage = memoryMap.GetReadPage(address);
+			isMapped &= (pPage != nullptr);
+			m_pRead[i] = (pPage != nullptr) ? pPage + pageOffset : nullptr;
+		}
+
+		if (isWrite)
+		{
+			uint8_t* pPage = memoryMap.GetWritePage(address);
+			isMapped &= (pPage != nullptr);
+			m_pWrite[i] = (pPage != nullptr) ? pPage + pageOffset : nullptr;
+		}
+	}
+
+	return isMapped;
+}
+
+
+// Whether SEI, CLI or PLP would leave every CPU's I flag as it is, so no interrupt can come due (or stop being due)
+bool CpuLockstep::IsInterruptFlagKept(uint8_t opCode) const
+{
+	const uint8_t interruptDisabled = static_cast<uint8_t>(CpuStatusFlag::InterruptDisabled);
+	for (uint32_t i = 0; i != m_cpuCount; ++i)
+	{
+		uint8_t newStatus = 0; // CLI
+		if (opCode == 0x78 /*SEI*/)
+			newStatus = interruptDisabled;
+		else if (opCode == 0x28 /*PLP*/)
+			newStatus = m_pRam[i][c_lockstepStackOffset + static_cast<uint8_t>(m_sp[i] + 1)];
+
+		if (((newStatus ^ m_status[i]) & interruptDisabled) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+
+// Whether the loop closed by the branch or JMP at branchPc is one the CPUs would skip through on their own.  The
+// run stops there, so each CPU's RunStep takes the branch and sees the loop, which is much quicker than running
+// it in lockstep.
+bool CpuLockstep::IsIdleLoop(uint16_t loopPc, uint16_t branchPc) const
+{
+	const Cpu6502& cpu = *m_ppCpus[0];
+	return loopPc <= branchPc && cpu.m_idleLoopSkipping && cpu.IsIdleLoop(loopPc, branchPc);
+}
+
+
+// Returns the read-only page holding pc, if it's the same one for every CPU
+const uint8_t* CpuLockstep::GetSharedCodePage(uint16_t pc) const
+{
+	const uint8_t* pCodePage = m_ppCpus[0]->m_memoryMap.GetReadPage(pc);
+	if (pCodePage == nullptr)
+		return nullptr;
+
+	for (uint32_t i = 0; i != m_cpuCount; ++i)
+	{
+		const NES::CpuMemoryMap& memoryMap = m_ppCpus[i]->m_memoryMap;
+		if (memoryMap.GetReadPage(pc) != pCodePage || memoryMap.GetWritePage(pc) != nullptr)
+			return nullptr;
+	}
+
+	return pCodePage;
+}
+
+
+int64_t CpuLockstep::GetFewestCyclesLeft() const
+{
+	int64_t cyclesLeft = m_targetCycles[0] - m_cycles[0];
+	for (uint32_t i = 1; i != m_cpuCount; ++i)
+		cyclesLeft = std::min(cyclesLeft, m_targetCycles[i] - m_cycles[i]);
+	return cyclesLeft;
+}
+
+
+void CpuLockstep::Gather(Cpu6502* const* ppCpus, const int64_t* pTargetCycles, uint32_t cpuCount)
+{
+	m_ppCpus = ppCpus;
+	m_cpuCount = cpuCount;
+
+	for (uint32_t i = 0; i != cpuCount; ++i)
+	{
+		const Cpu6502& cpu = *ppCpus[i];
+		m_acc[i] = cpu.m_acc;
+		m_x[i] = cpu.m_x;
+		m_y[i] = cpu.m_y;
+		m_sp[i] = cpu.m_sp;
+		m_status[i] = cpu.m_status;
+		m_negativeResult[i] = cpu.m_negativeResult;
+		m_zeroResult[i] = cpu.m_zeroResult;
+		m_openBus[i] = cpu.m_memoryMap.GetOpenBus();
+		m_cycles[i] = cpu.m_totalCycles;
+		m_targetCycles[i] = std::min(pTargetCycles[i], cpu.m_scheduler.GetNextEventCycle());
+		m_pRam[i] = ppCpus[i]->m_cpuRam;
+	}
+}
+
+
+void CpuLockstep::Scatter(uint16_t sharedPc, bool hasDiverged, uint32_t instructionCount, bool hasJumpedBack)
+{
+	for (uint32_t i = 0; i != m_cpuCount; ++i)
+	{
+		Cpu6502& cpu = *m_ppCpus[i];
+		cpu.m_pc = hasDiverged ? m_pc[i] : sharedPc;
+		cpu.m_acc = m_acc[i];
+		cpu.m_x = m_x[i];
+		cpu.m_y = m_y[i];
+		cpu.m_sp = m_sp[i];
+		cpu.m_status = m_status[i];
+		cpu.m_negativeResult = m_negativeResult[i];
+		cpu.m_zeroResult = m_zeroResult[i];
+		cpu.m_memoryMap.SetOpenBus(m_openBus[i]);
+		cpu.m_totalCycles = m_cycles[i];
+		cpu.m_instructionCount += instructionCount;
+
+		if (hasJumpedBack)
+			cpu.m_idleLoop.loopPc = Cpu6502::c_noIdleLoop;
+	}
+
+	m_ppCpus = nullptr;
+	m_cpuCount = 0;
+}
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+
+// Runs several CPUs which are at the same PC in the same PRG ROM bank through the code together, finishing each
+// instruction on every CPU before moving on to the next, rather than each CPU running the code on its own.
+//
+// The CPUs' registers are gathered into an array per register (structure of arrays) for the run.  Each
+// instruction is then fetched and decoded once, and carried out by a plain loop across the CPUs over those
+// arrays, which the compiler can vectorize.  RAM stays in each CPU, where its page table and DMA point, so memory
+// operands are loaded and stored per CPU at the address each one computed.
+//
+// Only instructions which can't be seen outside the CPU run in lockstep: register, flag and stack operations,
+// branches, jumps, subroutine calls and returns, and memory operands which are plain memory (RAM, PRG ROM or PRG
+// RAM) in every CPU's page table.  Nothing run can raise an interrupt or switch banks, and SEI, CLI and PLP only
+// run when they leave every CPU's I flag as it was, so none can come due part way through.  A run stops before
+// anything else (a register access, BRK, RTI), once the CPUs go different ways at a branch or return, at a loop
+// the CPUs' idle loop skipping would take over, and when any of them reaches its target cycle.  Every CPU is left
+// between instructions, in the same state decoded blocks would have left it.
+
+namespace CPU
+{
+
+class Cpu6502;
+enum class AddressingMode;
+
+class CpuLockstep
+{
+public:
+	explicit CpuLockstep(uint32_t maxCpuCount);
+	~CpuLockstep();
+
+	CpuLockstep(const CpuLockstep&) = delete;
+	CpuLockstep& operator=(const CpuLockstep&) = delete;
+
+	// Whether cpu can join a run: it's using the normal core (decoded or native blocks with per instruction timing,
+	// and no tracing or profiling) and has no interrupt due
+	static bool CanRun(const Cpu6502& cpu);
+
+	// Runs cpuCount CPUs, which CanRun and are all at the same PC, until one of them reaches its target cycle or the
+	// run has to stop.  Returns how many instructions each CPU ran, which is 0 if the first one can't run in lockstep.
+	uint32_t Run(Cpu6502* const* ppCpus, const int64_t* pTargetCycles, uint32_t cpuCount);
+
+private:
+	enum class RunResult
+	{
+		Continue, // Every CPU is at the same next instruction
+		Diverged, // The CPUs went different ways, and are at their own PCs in m_pc
+		Stop,     // The instruction can't run in lockstep, and nothing was changed
+	};
+
+	struct Instruction;
+
+	RunResult RunInstruction(const Instruction& instruction, uint8_t opCode, const uint8_t* pOperands, uint16_t* pPc);
+	void ResolveAddresses(AddressingMode addrMode, const uint8_t* pOperands, bool chargesPageCross);
+	bool MapMemory(bool isRead, bool isWrite);
+	bool IsInterruptFlagKept(uint8_t opCode) const;
+	bool IsIdleLoop(uint16_t loopPc, uint16_t branchPc) const;
+	const uint8_t* GetSharedCodePage(uint16_t pc) const;
+	int64_t GetFewestCyclesLeft() const;
+
+	void Gather(Cpu6502* const* ppCpus, const int64_t* pTargetCycles, uint32_t cpuCount);
+	void Scatter(uint16_t sharedPc, bool hasDiverged, uint32_t instructionCount, bool hasJumpedBack);
+
+	const uint32_t m_maxCpuCount;
+	std::unique_ptr<Instruction[]> m_instructions; // By opcode
+
+	// The run's CPUs
+	Cpu6502* const* m_ppCpus = nullptr;
+	uint32_t m_cpuCount = 0;
+
+	// Registers, by CPU
+	std::unique_ptr<uint16_t[]> m_pc; // Only filled in once the CPUs diverge
+	std::unique_ptr<uint8_t[]> m_acc;
+	std::unique_ptr<uint8_t[]> m_x;
+	std::unique_ptr<uint8_t[]> m_y;
+	std::unique_ptr<uint8_t[]> m_sp;
+	std::unique_ptr<uint8_t[]> m_status;
+	std::unique_ptr<uint8_t[]> m_negativeResult;
+	std::unique_ptr<uint8_t[]> m_zeroResult;
+	std::unique_ptr<uint8_t[]> m_openBus;
+	std::unique_ptr<int64_t[]> m_cycles;
+	std::unique_ptr<int64_t[]> m_targetCycles;
+	std::unique_ptr<uint8_t*[]> m_pRam;
+
+	// The current instruction's memory operand, by CPU
+	std::unique_ptr<uint16_t[]> m_address;
+	std::unique_ptr<const uint8_t*[]> m_pRead;
+	std::unique_ptr<uint8_t*[]> m_pWrite;
+	std::unique_ptr<uint8_t[]> m_value;
+	std::unique_ptr<uint8_t[]> m_extraCycles;
+};
+
+}
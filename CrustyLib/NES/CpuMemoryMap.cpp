@@ -0,0 +1,62 @@
+#include "stdafx.h"
+#include "CpuMemoryMap.h"
+
+#include <stdexcept>
+
+namespace NES
+{
+
+CpuMemoryMap::CpuMemoryMap()
+{
+	Reset();
+}
+
+
+void CpuMemoryMap::Reset()
+{
+	for (uint32_t iPage = 0; iPage != c_cpuPageCount; ++iPage)
+	{
+		m_readPages[iPage] = nullptr;
+		m_writePages[iPage] = nullptr;
+	}
+
+	m_generation++;
+}
+
+
+void CpuMemoryMap::MapReadOnly(uint16_t address, uint32_t cbSize, const uint8_t* pData)
+{
+	SetPages(address, cbSize, pData, nullptr);
+}
+
+
+void CpuMemoryMap::MapReadWrite(uint16_t address, uint32_t cbSize, uint8_t* pData)
+{
+	SetPages(address, cbSize, pData, pData);
+}
+
+
+void CpuMemoryMap::Unmap(uint16_t address, uint32_t cbSize)
+{
+	SetPages(address, cbSize, nullptr, nullptr);
+}
+
+
+void CpuMemoryMap::SetPages(uint16_t address, uint32_t cbSize, const uint8_t* pReadData, uint8_t* pWriteData)
+{
+	if ((address & c_cpuPageMask) != 0 || (cbSize & c_cpuPageMask) != 0 || address + cbSize > 0x10000)
+		throw std::runtime_error("Unaligned CPU memory mapping");
+
+	const uint32_t firstPage = address >> c_cpuPageShift;
+	const uint32_t pageCount = cbSize >> c_cpuPageShift;
+	for (uint32_t iPage = 0; iPage != pageCount; ++iPage)
+	{
+		const uint32_t pageOffset = iPage * c_cbCpuPage;
+		m_readPages[firstPage + iPage] = (pReadData != nullptr) ? pReadData + pageOffset : nullptr;
+		m_writePages[firstPage + iPage] = (pWriteData != nullptr) ? pWriteData + pageOffset : nullptr;
+	}
+
+	m_generation++;
+}
+
+}
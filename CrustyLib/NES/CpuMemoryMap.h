@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+// Page table covering the CPU's 64KB address space in 2KB pages.
+//
+// Pages backed by plain memory (CPU RAM and its mirrors, PRG ROM banks, PRG RAM) hold a direct
+// pointer, so reading them is a single indexed load.  Pages which contain memory mapped I/O (PPU
+// and APU registers, mapper registers) are left null, and the CPU falls back to dispatching the
+// access by address.  Mappers re-point their pages whenever they switch banks.
+//
+// The map also holds the last value seen on the data bus.  Nothing drives the bus for an address no device
+// responds to, so reads of those return whatever was last on it (open bus) rather than being treated as errors;
+// they're counted instead, along with writes which go nowhere, for diagnostics.
+
+namespace NES
+{
+
+const uint32_t c_cpuPageShift = 11;
+const uint32_t c_cbCpuPage = 1 << c_cpuPageShift; // 2KB
+const uint32_t c_cpuPageMask = c_cbCpuPage - 1;
+const uint32_t c_cpuPageCount = 0x10000 >> c_cpuPageShift;
+
+class CpuMemoryMap
+{
+public:
+	CpuMemoryMap();
+
+	CpuMemoryMap(const CpuMemoryMap&) = delete;
+	CpuMemoryMap& operator=(const CpuMemoryMap&) = delete;
+
+	void Reset();
+
+	// Map cbSize bytes starting at (page aligned) address onto pData.  cbSize must be a multiple of c_cbCpuPage.
+	void MapReadOnly(uint16_t address, uint32_t cbSize, const uint8_t* pData);
+	void MapReadWrite(uint16_t address, uint32_t cbSize, uint8_t* pData);
+	void Unmap(uint16_t address, uint32_t cbSize);
+
+	// Bumped whenever any page is re-pointed, so cached views of the map can tell they're stale
+	uint32_t GetGeneration() const { return m_generation; }
+
+	// Returns null if the page isn't directly backed by memory
+	const uint8_t* GetReadPage(uint16_t address) const { return m_readPages[address >> c_cpuPageShift]; }
+	uint8_t* GetWritePage(uint16_t address) const { return m_writePages[address >> c_cpuPageShift]; }
+
+	// The CPU sets this on every access
+	void SetOpenBus(uint8_t value) const { m_openBus = value; }
+	uint8_t GetOpenBus() const { return m_openBus; }
+	uint8_t* GetOpenBusAddress() const { return &m_openBus; } // For generated code, which sets it directly
+
+	// For reads/writes of addresses nothing responds to
+	uint8_t ReadUnmapped() const { m_unmappedAccessCount++; return m_openBus; }
+	void WriteUnmapped() const { m_unmappedAccessCount++; }
+
+	// Since the console was created (not reset by Reset)
+	uint64_t GetUnmappedAccessCount() const { return m_unmappedAccessCount; }
+
+private:
+	void SetPages(uint16_t address, uint32_t cbSize, const uint8_t* pReadData, uint8_t* pWriteData);
+
+	const uint8_t* m_readPages[c_cpuPageCount];
+	uint8_t* m_writePages[c_cpuPageCount];
+	uint32_t m_generation = 0;
+
+	mutable uint8_t m_openBus = 0;
+	mutable uint64_t m_unmappedAccessCount = 0;
+};
+
+}
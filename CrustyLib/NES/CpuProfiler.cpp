@@ -0,0 +1,238 @@
+#include "stdafx.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+
+namespace CPU
+{
+
+CpuProfiler::CpuProfiler(const uint8_t* pPrgRom, uint32_t cbPrgRom)
+	: m_pPrgRom(pPrgRom)
+	, m_cbPrgRom(cbPrgRom)
+	, m_bankCount((cbPrgRom + c_cbProfiledBank - 1) / c_cbProfiledBank + 1)
+	, m_spCounters(std::make_unique<Counters[]>(GetIndexCount()))
+	, m_spPcs(std::make_unique<uint16_t[]>(GetIndexCount()))
+	, m_spLoopStartPcs(std::make_unique<uint16_t[]>(GetIndexCount()))
+{
+	Reset();
+}
+
+
+void CpuProfiler::Reset()
+{
+	std::fill(m_spCounters.get(), m_spCounters.get() + GetIndexCount(), Counters());
+
+	m_currentFrame = ProfiledFrame();
+	m_currentFrame.bankCycles.resize(m_bankCount, 0);
+	m_frames.clear();
+	m_totalCycles = 0;
+}
+
+
+void CpuProfiler::EndFrame()
+{
+	m_totalCycles += m_currentFrame.cycles;
+	m_frames.push_back(m_currentFrame);
+
+	m_currentFrame.instructions = 0;
+	m_currentFrame.cycles = 0;
+	std::fill(m_currentFrame.bankCycles.begin(), m_currentFrame.bankCycles.end(), 0);
+}
+
+
+ProfiledAddress CpuProfiler::GetProfiledAddress(uint32_t index) const
+{
+	ProfiledAddress address;
+	address.prgOffset = (index < m_cbPrgRom) ? index : c_notInPrgRom;
+	address.bank = GetBank(index);
+	address.pc = m_spPcs[index];
+	address.executions = m_spCounters[index].executions;
+	address.cycles = m_spCounters[index].cycles;
+	return address;
+}
+
+
+std::vector<ProfiledAddress> CpuProfiler::GetHotAddresses(size_t maxCount) const
+{
+	std::vector<ProfiledAddress> addresses;
+	for (uint32_t index = 0; index != GetIndexCount(); ++index)
+	{
+		if (m_spCounters[index].executions != 0)
+			addresses.push_back(GetProfiledAddress(index));
+	}
+
+	std::sort(addresses.begin(), addresses.end(), [](const ProfiledAddress& left, const ProfiledAddress& right) { return left.cycles > right.cycles; });
+	if (addresses.size() > maxCount)
+		addresses.resize(maxCount);
+
+	return addresses;
+}
+
+
+std::vector<ProfiledLoop> CpuProfiler::GetHotLoops(size_t maxCount) const
+{
+	std::vector<ProfiledLoop> loops;
+	for (uint32_t index = 0; index != GetIndexCount(); ++index)
+	{
+		if (m_spCounters[index].loopIterations == 0)
+			continue;
+
+		ProfiledLoop loop;
+		loop.prgOffset = (index < m_cbPrgRom) ? index : c_notInPrgRom;
+		loop.bank = GetBank(index);
+		loop.startPc = m_spLoopStartPcs[index];
+		loop.endPc = m_spPcs[index];
+		loop.iterations = m_spCounters[index].loopIterations;
+
+		// The body is assumed to be in the same bank as the branch.  Outside of ROM, indices are CPU addresses anyway.
+		const uint32_t bodyLength = loop.endPc - loop.startPc;
+		const uint32_t firstIndex = (index < m_cbPrgRom) ? index - std::min(bodyLength, index) : m_cbPrgRom + loop.startPc;
+
+		loop.cycles = 0;
+		for (uint32_t bodyIndex = firstIndex; bodyIndex <= index; ++bodyIndex)
+			loop.cycles += m_spCounters[bodyIndex].cycles;
+
+		loops.push_back(loop);
+	}
+
+	std::sort(loops.begin(), loops.end(), [](const ProfiledLoop& left, const ProfiledLoop& right) { return left.cycles > right.cycles; });
+	if (loops.size() > maxCount)
+		loops.resize(maxCount);
+
+	return loops;
+}
+
+
+/*----- Export -----*/
+
+static void WriteHexField(std::ostream& output, uint32_t value, int digits)
+{
+	static const char c_hexDigits[] = "0123456789ABCDEF";
+	for (int iDigit = digits - 1; iDigit >= 0; --iDigit)
+		output << c_hexDigits[(value >> (iDigit * 4)) & 0xF];
+}
+
+
+static void WritePrgOffset(std::ostream& output, uint32_t prgOffset, bool isQuoted)
+{
+	if (prgOffset == CpuProfiler::c_notInPrgRom)
+	{
+		output << (isQuoted ? "null" : "");
+		return;
+	}
+
+	if (isQuoted)
+		output << '"';
+	WriteHexField(output, prgOffset, 6);
+	if (isQuoted)
+		output << '"';
+}
+
+
+static void WritePc(std::ostream& output, uint16_t pc, bool isQuoted)
+{
+	if (isQuoted)
+		output << '"';
+	WriteHexField(output, pc, 4);
+	if (isQuoted)
+		output << '"';
+}
+
+
+void CpuProfiler::WriteJson(std::ostream& output, size_t maxCount) const
+{
+	const uint64_t totalCycles = GetTotalCycles();
+
+	output << "{\n  \"totalCycles\": " << totalCycles << ",\n  \"hotAddresses\": [";
+	const char* szSeparator = "\n";
+	for (const ProfiledAddress& address : GetHotAddresses(maxCount))
+	{
+		output << szSeparator << "    {\"prgOffset\": ";
+		WritePrgOffset(output, address.prgOffset, true);
+		output << ", \"bank\": " << address.bank << ", \"pc\": ";
+		WritePc(output, address.pc, true);
+		output << ", \"executions\": " << address.executions << ", \"cycles\": " << address.cycles << "}";
+		szSeparator = ",\n";
+	}
+
+	output << "\n  ],\n  \"loops\": [";
+	szSeparator = "\n";
+	for (const ProfiledLoop& loop : GetHotLoops(maxCount))
+	{
+		output << szSeparator << "    {\"prgOffset\": ";
+		WritePrgOffset(output, loop.prgOffset, true);
+		output << ", \"bank\": " << loop.bank << ", \"startPc\": ";
+		WritePc(output, loop.startPc, true);
+		output << ", \"endPc\": ";
+		WritePc(output, loop.endPc, true);
+		output << ", \"iterations\": " << loop.iterations << ", \"cycles\": " << loop.cycles << "}";
+		szSeparator = ",\n";
+	}
+
+	output << "\n  ],\n  \"frames\": [";
+	szSeparator = "\n";
+	for (const ProfiledFrame& frame : m_frames)
+	{
+		output << szSeparator << "    {\"instructions\": " << frame.instructions << ", \"cycles\": " << frame.cycles << ", \"bankCycles\": [";
+		for (size_t iBank = 0; iBank != frame.bankCycles.size(); ++iBank)
+			output << (iBank == 0 ? "" : ", ") << frame.bankCycles[iBank];
+		output << "]}";
+		szSeparator = ",\n";
+	}
+
+	output << "\n  ]\n}\n";
+}
+
+
+void CpuProfiler::WriteCsv(ProfileTable table, std::ostream& output, size_t maxCount) const
+{
+	switch (table)
+	{
+	case ProfileTable::HotAddresses:
+		output << "prgOffset,bank,pc,executions,cycles\n";
+		for (const ProfiledAddress& address : GetHotAddresses(maxCount))
+		{
+			WritePrgOffset(output, address.prgOffset, false);
+			output << ',' << address.bank << ',';
+			WritePc(output, address.pc, false);
+			output << ',' << address.executions << ',' << address.cycles << '\n';
+		}
+		break;
+
+	case ProfileTable::Loops:
+		output << "prgOffset,bank,startPc,endPc,iterations,cycles\n";
+		for (const ProfiledLoop& loop : GetHotLoops(maxCount))
+		{
+			WritePrgOffset(output, loop.prgOffset, false);
+			output << ',' << loop.bank << ',';
+			WritePc(output, loop.startPc, false);
+			output << ',';
+			WritePc(output, loop.endPc, false);
+			output << ',' << loop.iterations << ',' << loop.cycles << '\n';
+		}
+		break;
+
+	case ProfileTable::Frames:
+		output << "frame,instructions,cycles";
+		for (uint32_t iBank = 0; iBank != m_bankCount; ++iBank)
+		{
+			if (iBank + 1 == m_bankCount)
+				output << ",otherCycles";
+			else
+				output << ",bank" << iBank << "Cycles";
+		}
+		output << '\n';
+
+		for (size_t iFrame = 0; iFrame != m_frames.size(); ++iFrame)
+		{
+			const ProfiledFrame& frame = m_frames[iFrame];
+			output << iFrame << ',' << frame.instructions << ',' << frame.cycles;
+			for (uint64_t bankCycles : frame.bankCycles)
+				output << ',' << bankCycles;
+			output << '\n';
+		}
+		break;
+	}
+}
+
+}
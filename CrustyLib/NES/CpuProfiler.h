@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+// Guest code profiler.
+//
+// While attached to the CPU (Cpu6502::SetProfiler), every instruction is counted against the address it ran
+// from: its offset into PRG ROM for code in ROM, so each bank is counted separately, or its CPU address for
+// anything else (code copied to RAM).  Counters are flat arrays indexed by that, so recording is a couple of
+// adds.  Branches and jumps going backwards are counted as loop iterations at the branch.
+//
+// The owner calls EndFrame after each frame for the per frame breakdown, and exports a report when done.
+// Banks are reported in 16KB units of PRG ROM whatever the mapper's bank size, with everything outside ROM
+// as one last bank.
+
+namespace CPU
+{
+
+struct ProfiledAddress
+{
+	uint32_t prgOffset;  // Offset into PRG ROM, or c_notInPrgRom
+	uint32_t bank;
+	uint16_t pc;         // Last CPU address the code ran at
+	uint64_t executions;
+	uint64_t cycles;
+};
+
+struct ProfiledLoop
+{
+	uint32_t prgOffset;  // Of the branch closing the loop
+	uint32_t bank;
+	uint16_t startPc;    // Branch target
+	uint16_t endPc;      // The branch
+	uint64_t iterations; // Times the branch was taken
+	uint64_t cycles;     // Spent anywhere in the body, including runs through it which didn't loop
+};
+
+struct ProfiledFrame
+{
+	uint64_t instructions = 0;
+	uint64_t cycles = 0;
+	std::vector<uint64_t> bankCycles;
+};
+
+enum class ProfileTable
+{
+	HotAddresses,
+	Loops,
+	Frames,
+};
+
+class CpuProfiler
+{
+public:
+	static const uint32_t c_notInPrgRom = UINT32_MAX;
+	static const uint32_t c_cbProfiledBank = 16 * 1024;
+
+	CpuProfiler(const uint8_t* pPrgRom, uint32_t cbPrgRom);
+
+	CpuProfiler(const CpuProfiler&) = delete;
+	CpuProfiler& operator=(const CpuProfiler&) = delete;
+
+	void Reset();
+
+	// pCode is the host address the opcode was read from (null if it wasn't memory backed).  loopStartPc is the branch
+	// target for a branch/jump which was taken backwards, otherwise c_notALoop.
+	static const int32_t c_notALoop = -1;
+	void RecordInstruction(const uint8_t* pCode, uint16_t pc, uint32_t cycles, int32_t loopStartPc)
+	{
+		const uint32_t index = GetIndex(pCode, pc);
+		Counters& counters = m_spCounters[index];
+		counters.executions++;
+		counters.cycles += cycles;
+		m_spPcs[index] = pc;
+
+		if (loopStartPc != c_notALoop)
+		{
+			counters.loopIterations++;
+			m_spLoopStartPcs[index] = static_cast<uint16_t>(loopStartPc);
+		}
+
+		m_currentFrame.instructions++;
+		m_currentFrame.cycles += cycles;
+		m_currentFrame.bankCycles[GetBank(index)] += cycles;
+	}
+
+	void EndFrame();
+
+	// Sorted hottest first (by cycles), at most maxCount of them
+	std::vector<ProfiledAddress> GetHotAddresses(size_t maxCount) const;
+	std::vector<ProfiledLoop> GetHotLoops(size_t maxCount) const;
+	const std::vector<ProfiledFrame>& GetFrames() const { return m_frames; }
+
+	uint64_t GetTotalCycles() const { return m_totalCycles + m_currentFrame.cycles; }
+
+	// One object with an array per table
+	void WriteJson(std::ostream& output, size_t maxCount) const;
+	void WriteCsv(ProfileTable table, std::ostream& output, size_t maxCount) const;
+
+private:
+	struct Counters
+	{
+		uint64_t executions;
+		uint64_t cycles;
+		uint64_t loopIterations;
+	};
+
+	// PRG ROM offsets come first, then the whole CPU address space for code anywhere else
+	uint32_t GetIndex(const uint8_t* pCode, uint16_t pc) const
+	{
+		const uintptr_t prgOffset = reinterpret_cast<uintptr_t>(pCode) - reinterpret_cast<uintptr_t>(m_pPrgRom);
+		return (prgOffset < m_cbPrgRom) ? static_cast<uint32_t>(prgOffset) : m_cbPrgRom + pc;
+	}
+
+	uint32_t GetBank(uint32_t index) const
+	{
+		return (index < m_cbPrgRom) ? index / c_cbProfiledBank : m_bankCount - 1;
+	}
+
+	ProfiledAddress GetProfiledAddress(uint32_t index) const;
+	uint32_t GetIndexCount() const { return m_cbPrgRom + 0x10000; }
+
+	const uint8_t* m_pPrgRom;
+	uint32_t m_cbPrgRom;
+	uint32_t m_bankCount;
+
+	std::unique_ptr<Counters[]> m_spCounters;
+	std::unique_ptr<uint16_t[]> m_spPcs;
+	std::unique_ptr<uint16_t[]> m_spLoopStartPcs;
+
+	ProfiledFrame m_currentFrame;
+	std::vector<ProfiledFrame> m_frames;
+	uint64_t m_totalCycles = 0; // Of the finished frames
+};
+
+}
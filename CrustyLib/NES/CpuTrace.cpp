@@ -0,0 +1,215 @@
+#include "stdafx.h"
+#include "CpuTrace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace CPU
+{
+
+CpuTraceBuffer::CpuTraceBuffer(uint32_t capacityLog2)
+	: m_capacity(1ull << capacityLog2)
+	, m_indexMask((1ull << capacityLog2) - 1)
+	, m_spRecords(std::make_unique<CpuTraceRecord[]>(static_cast<size_t>(1ull << capacityLog2)))
+	, m_writeIndex(0)
+	, m_readIndex(0)
+	, m_droppedCount(0)
+{
+}
+
+
+size_t CpuTraceBuffer::Read(CpuTraceRecord* pRecords, size_t maxCount)
+{
+	const uint64_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+	const uint64_t available = m_writeIndex.load(std::memory_order_acquire) - readIndex;
+	const size_t count = static_cast<size_t>(available < maxCount ? available : maxCount);
+
+	for (size_t iRecord = 0; iRecord != count; ++iRecord)
+		pRecords[iRecord] = m_spRecords[(readIndex + iRecord) & m_indexMask];
+
+	// Hands the slots back to the producer
+	m_readIndex.store(readIndex + count, std::memory_order_release);
+	return count;
+}
+
+
+/*----- nestest.log formatting -----*/
+
+enum class OperandFormat
+{
+	Imp,  // CLC
+	Acc,  // ASL A
+	Imm,  // LDA #$00
+	Zp,   // LDA $00
+	Zpx,  // LDA $00,X
+	Zpy,  // LDX $00,Y
+	Abs,  // LDA $0000
+	Abx,  // LDA $0000,X
+	Aby,  // LDA $0000,Y
+	Ind,  // JMP ($0000)
+	Izx,  // LDA ($00,X)
+	Izy,  // LDA ($00),Y
+	Rel,  // BNE $C000 (shown as the target)
+};
+
+struct DisassemblyEntry
+{
+	const char* szMnemonic;
+	OperandFormat format;
+};
+
+// Only the official opcodes, which are all the CPU runs
+const DisassemblyEntry c_disassemblyTable[256] = {
+	/* 00 */ { "BRK", OperandFormat::Imp }, { "ORA", OperandFormat::Izx }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "ORA", OperandFormat::Zp }, { "ASL", OperandFormat::Zp }, { "???", OperandFormat::Imp },
+	/* 08 */ { "PHP", OperandFormat::Imp }, { "ORA", OperandFormat::Imm }, { "ASL", OperandFormat::Acc }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "ORA", OperandFormat::Abs }, { "ASL", OperandFormat::Abs }, { "???", OperandFormat::Imp },
+	/* 10 */ { "BPL", OperandFormat::Rel }, { "ORA", OperandFormat::Izy }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "ORA", OperandFormat::Zpx }, { "ASL", OperandFormat::Zpx }, { "???", OperandFormat::Imp },
+	/* 18 */ { "CLC", OperandFormat::Imp }, { "ORA", OperandFormat::Aby }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "ORA", OperandFormat::Abx }, { "ASL", OperandFormat::Abx }, { "???", OperandFormat::Imp },
+	/* 20 */ { "JSR", OperandFormat::Abs }, { "AND", OperandFormat::Izx }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "BIT", OperandFormat::Zp }, { "AND", OperandFormat::Zp }, { "ROL", OperandFormat::Zp }, { "???", OperandFormat::Imp },
+	/* 28 */ { "PLP", OperandFormat::Imp }, { "AND", OperandFormat::Imm }, { "ROL", OperandFormat::Acc }, { "???", OperandFormat::Imp }, { "BIT", OperandFormat::Abs }, { "AND", OperandFormat::Abs }, { "ROL", OperandFormat::Abs }, { "???", OperandFormat::Imp },
+	/* 30 */ { "BMI", OperandFormat::Rel }, { "AND", OperandFormat::Izy }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "AND", OperandFormat::Zpx }, { "ROL", OperandFormat::Zpx }, { "???", OperandFormat::Imp },
+	/* 38 */ { "SEC", OperandFormat::Imp }, { "AND", OperandFormat::Aby }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "AND", OperandFormat::Abx }, { "ROL", OperandFormat::Abx }, { "???", OperandFormat::Imp },
+	/* 40 */ { "RTI", OperandFormat::Imp }, { "EOR", OperandFormat::Izx }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "EOR", OperandFormat::Zp }, { "LSR", OperandFormat::Zp }, { "???", OperandFormat::Imp },
+	/* 48 */ { "PHA", OperandFormat::Imp }, { "EOR", OperandFormat::Imm }, { "LSR", OperandFormat::Acc }, { "???", OperandFormat::Imp }, { "JMP", OperandFormat::Abs }, { "EOR", OperandFormat::Abs }, { "LSR", OperandFormat::Abs }, { "???", OperandFormat::Imp },
+	/* 50 */ { "BVC", OperandFormat::Rel }, { "EOR", OperandFormat::Izy }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "EOR", OperandFormat::Zpx }, { "LSR", OperandFormat::Zpx }, { "???", OperandFormat::Imp },
+	/* 58 */ { "CLI", OperandFormat::Imp }, { "EOR", OperandFormat::Aby }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "EOR", OperandFormat::Abx }, { "LSR", OperandFormat::Abx }, { "???", OperandFormat::Imp },
+	/* 60 */ { "RTS", OperandFormat::Imp }, { "ADC", OperandFormat::Izx }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "ADC", OperandFormat::Zp }, { "ROR", OperandFormat::Zp }, { "???", OperandFormat::Imp },
+	/* 68 */ { "PLA", OperandFormat::Imp }, { "ADC", OperandFormat::Imm }, { "ROR", OperandFormat::Acc }, { "???", OperandFormat::Imp }, { "JMP", OperandFormat::Ind }, { "ADC", OperandFormat::Abs }, { "ROR", OperandFormat::Abs }, { "???", OperandFormat::Imp },
+	/* 70 */ { "BVS", OperandFormat::Rel }, { "ADC", OperandFormat::Izy }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "ADC", OperandFormat::Zpx }, { "ROR", OperandFormat::Zpx }, { "???", OperandFormat::Imp },
+	/* 78 */ { "SEI", OperandFormat::Imp }, { "ADC", OperandFormat::Aby }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "ADC", OperandFormat::Abx }, { "ROR", OperandFormat::Abx }, { "???", OperandFormat::Imp },
+	/* 80 */ { "???", OperandFormat::Imp }, { "STA", OperandFormat::Izx }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "STY", OperandFormat::Zp }, { "STA", OperandFormat::Zp }, { "STX", OperandFormat::Zp }, { "???", OperandFormat::Imp },
+	/* 88 */ { "DEY", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "TXA", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "STY", OperandFormat::Abs }, { "STA", OperandFormat::Abs }, { "STX", OperandFormat::Abs }, { "???", OperandFormat::Imp },
+	/* 90 */ { "BCC", OperandFormat::Rel }, { "STA", OperandFormat::Izy }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "STY", OperandFormat::Zpx }, { "STA", OperandFormat::Zpx }, { "STX", OperandFormat::Zpy }, { "???", OperandFormat::Imp },
+	/* 98 */ { "TYA", OperandFormat::Imp }, { "STA", OperandFormat::Aby }, { "TXS", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "STA", OperandFormat::Abx }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp },
+	/* A0 */ { "LDY", OperandFormat::Imm }, { "LDA", OperandFormat::Izx }, { "LDX", OperandFormat::Imm }, { "???", OperandFormat::Imp }, { "LDY", OperandFormat::Zp }, { "LDA", OperandFormat::Zp }, { "LDX", OperandFormat::Zp }, { "???", OperandFormat::Imp },
+	/* A8 */ { "TAY", OperandFormat::Imp }, { "LDA", OperandFormat::Imm }, { "TAX", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "LDY", OperandFormat::Abs }, { "LDA", OperandFormat::Abs }, { "LDX", OperandFormat::Abs }, { "???", OperandFormat::Imp },
+	/* B0 */ { "BCS", OperandFormat::Rel }, { "LDA", OperandFormat::Izy }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "LDY", OperandFormat::Zpx }, { "LDA", OperandFormat::Zpx }, { "LDX", OperandFormat::Zpy }, { "???", OperandFormat::Imp },
+	/* B8 */ { "CLV", OperandFormat::Imp }, { "LDA", OperandFormat::Aby }, { "TSX", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "LDY", OperandFormat::Abx }, { "LDA", OperandFormat::Abx }, { "LDX", OperandFormat::Aby }, { "???", OperandFormat::Imp },
+	/* C0 */ { "CPY", OperandFormat::Imm }, { "CMP", OperandFormat::Izx }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "CPY", OperandFormat::Zp }, { "CMP", OperandFormat::Zp }, { "DEC", OperandFormat::Zp }, { "???", OperandFormat::Imp },
+	/* C8 */ { "INY", OperandFormat::Imp }, { "CMP", OperandFormat::Imm }, { "DEX", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "CPY", OperandFormat::Abs }, { "CMP", OperandFormat::Abs }, { "DEC", OperandFormat::Abs }, { "???", OperandFormat::Imp },
+	/* D0 */ { "BNE", OperandFormat::Rel }, { "CMP", OperandFormat::Izy }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "CMP", OperandFormat::Zpx }, { "DEC", OperandFormat::Zpx }, { "???", OperandFormat::Imp },
+	/* D8 */ { "CLD", OperandFormat::Imp }, { "CMP", OperandFormat::Aby }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "CMP", OperandFormat::Abx }, { "DEC", OperandFormat::Abx }, { "???", OperandFormat::Imp },
+	/* E0 */ { "CPX", OperandFormat::Imm }, { "SBC", OperandFormat::Izx }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "CPX", OperandFormat::Zp }, { "SBC", OperandFormat::Zp }, { "INC", OperandFormat::Zp }, { "???", OperandFormat::Imp },
+	/* E8 */ { "INX", OperandFormat::Imp }, { "SBC", OperandFormat::Imm }, { "NOP", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "CPX", OperandFormat::Abs }, { "SBC", OperandFormat::Abs }, { "INC", OperandFormat::Abs }, { "???", OperandFormat::Imp },
+	/* F0 */ { "BEQ", OperandFormat::Rel }, { "SBC", OperandFormat::Izy }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "SBC", OperandFormat::Zpx }, { "INC", OperandFormat::Zpx }, { "???", OperandFormat::Imp },
+	/* F8 */ { "SED", OperandFormat::Imp }, { "SBC", OperandFormat::Aby }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "???", OperandFormat::Imp }, { "SBC", OperandFormat::Abx }, { "INC", OperandFormat::Abx }, { "???", OperandFormat::Imp },
+};
+
+
+uint32_t GetInstructionLength(OperandFormat format)
+{
+	switch (format)
+	{
+	case OperandFormat::Imp:
+	case OperandFormat::Acc:
+		return 1;
+
+	case OperandFormat::Abs:
+	case OperandFormat::Abx:
+	case OperandFormat::Aby:
+	case OperandFormat::Ind:
+		return 3;
+
+	default:
+		return 2;
+	}
+}
+
+
+std::string FormatTraceRecord(const CpuTraceRecord& record)
+{
+	const DisassemblyEntry& entry = c_disassemblyTable[record.opCode];
+	const uint8_t operand8 = record.operands[0];
+	const uint16_t operand16 = static_cast<uint16_t>((record.operands[1] << 8) | record.operands[0]);
+
+	char szOperand[16] = "";
+	switch (entry.format)
+	{
+	case OperandFormat::Imp: break;
+	case OperandFormat::Acc: sprintf_s(szOperand, _countof(szOperand), "A"); break;
+	case OperandFormat::Imm: sprintf_s(szOperand, _countof(szOperand), "#$%02X", operand8); break;
+	case OperandFormat::Zp:  sprintf_s(szOperand, _countof(szOperand), "$%02X", operand8); break;
+	case OperandFormat::Zpx: sprintf_s(szOperand, _countof(szOperand), "$%02X,X", operand8); break;
+	case OperandFormat::Zpy: sprintf_s(szOperand, _countof(szOperand), "$%02X,Y", operand8); break;
+	case OperandFormat::Abs: sprintf_s(szOperand, _countof(szOperand), "$%04X", operand16); break;
+	case OperandFormat::Abx: sprintf_s(szOperand, _countof(szOperand), "$%04X,X", operand16); break;
+	case OperandFormat::Aby: sprintf_s(szOperand, _countof(szOperand), "$%04X,Y", operand16); break;
+	case OperandFormat::Ind: sprintf_s(szOperand, _countof(szOperand), "($%04X)", operand16); break;
+	case OperandFormat::Izx: sprintf_s(szOperand, _countof(szOperand), "($%02X,X)", operand8); break;
+	case OperandFormat::Izy: sprintf_s(szOperand, _countof(szOperand), "($%02X),Y", operand8); break;
+	case OperandFormat::Rel:
+		sprintf_s(szOperand, _countof(szOperand), "$%04X", static_cast<uint16_t>(record.pc + 2 + static_cast<int8_t>(operand8)));
+		break;
+	}
+
+	const uint32_t length = GetInstructionLength(entry.format);
+	char szBytes[16];
+	if (length == 1)
+		sprintf_s(szBytes, _countof(szBytes), "%02X", record.opCode);
+	else if (length == 2)
+		sprintf_s(szBytes, _countof(szBytes), "%02X %02X", record.opCode, record.operands[0]);
+	else
+		sprintf_s(szBytes, _countof(szBytes), "%02X %02X %02X", record.opCode, record.operands[0], record.operands[1]);
+
+	char szDisassembly[32];
+	sprintf_s(szDisassembly, _countof(szDisassembly), "%s %s", entry.szMnemonic, szOperand);
+
+	char szLine[128];
+	sprintf_s(szLine, _countof(szLine), "%04X  %-8s  %-31s A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%lld",
+		record.pc, szBytes, szDisassembly, record.a, record.x, record.y, record.p, record.sp,
+		record.ppuScanline, record.ppuDot, static_cast<long long>(record.cycle));
+
+	return szLine;
+}
+
+
+bool ParseTraceLine(const char* szLine, CpuTraceRecord* pRecord)
+{
+	*pRecord = CpuTraceRecord();
+
+	unsigned int pc;
+	if (sscanf_s(szLine, "%4X", &pc) != 1 || strlen(szLine) < 16)
+		return false;
+	pRecord->pc = static_cast<uint16_t>(pc);
+
+	// Instruction bytes are in columns 6, 9 and 12
+	unsigned int bytes[3] = {};
+	if (sscanf_s(szLine + 6, "%2X %2X %2X", &bytes[0], &bytes[1], &bytes[2]) < 1)
+		return false;
+	pRecord->opCode = static_cast<uint8_t>(bytes[0]);
+	pRecord->operands[0] = static_cast<uint8_t>(bytes[1]);
+	pRecord->operands[1] = static_cast<uint8_t>(bytes[2]);
+
+	// Don't trip over the disassembly column, which may contain anything
+	const char* szRegisters = strstr(szLine, "A:");
+	unsigned int a, x, y, p, sp;
+	if (szRegisters == nullptr || sscanf_s(szRegisters, "A:%2X X:%2X Y:%2X P:%2X SP:%2X", &a, &x, &y, &p, &sp) != 5)
+		return false;
+	pRecord->a = static_cast<uint8_t>(a);
+	pRecord->x = static_cast<uint8_t>(x);
+	pRecord->y = static_cast<uint8_t>(y);
+	pRecord->p = static_cast<uint8_t>(p);
+	pRecord->sp = static_cast<uint8_t>(sp);
+
+	int scanline, dot;
+	long long cycle;
+	const char* szPpu = strstr(szRegisters, "PPU:");
+	const char* szCycle = strstr(szRegisters, "CYC:");
+	if (szPpu != nullptr && sscanf_s(szPpu, "PPU:%d,%d", &scanline, &dot) == 2 && szCycle != nullptr && sscanf_s(szCycle, "CYC:%lld", &cycle) == 1)
+	{
+		pRecord->cycle = cycle;
+	}
+	else if (szCycle != nullptr && sscanf_s(szCycle, "CYC:%d SL:%d", &dot, &scanline) == 2)
+	{
+		pRecord->cycle = -1;
+	}
+	else
+	{
+		return false;
+	}
+
+	pRecord->ppuDot = static_cast<uint16_t>(dot);
+	pRecord->ppuScanline = static_cast<int16_t>(scanline);
+	return true;
+}
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+// Binary instruction trace.
+//
+// While tracing, the CPU appends a fixed size record of its state before each instruction (or each step of its
+// backend, see CpuTraceDetail) to a CpuTraceBuffer.  Nothing is formatted while the game runs; whoever owns the buffer drains it (e.g. to a
+// file once a frame), and the records are turned into text offline with FormatTraceRecord, in the layout
+// of nestest.log so traces can be diffed against reference logs from other emulators.
+
+namespace CPU
+{
+
+// How much of a run a trace records
+enum class CpuTraceDetail : uint8_t
+{
+	EveryInstruction, // Everything runs through the interpreter, with a record before every instruction
+	BackendSteps,     // The CPU's backend runs as usual, with a record between its steps: before each interpreted instruction
+	                  // and decoded block, and each instruction native code calls a handler for.  Instructions run inside a
+	                  // block in between aren't recorded.
+};
+
+struct CpuTraceRecord
+{
+	int64_t cycle;         // CPU cycle the instruction started on
+	uint16_t pc;
+	uint8_t opCode;
+	uint8_t operands[2];   // The two bytes after the opcode, whether or not the instruction uses them
+	uint8_t a;
+	uint8_t x;
+	uint8_t y;
+	uint8_t p;
+	uint8_t sp;
+	uint16_t ppuDot;
+	int16_t ppuScanline;   // -1 for the pre-render scanline
+	CpuTraceDetail detail; // What the trace was recording, so whether instructions before this one may be missing
+	uint8_t reserved;
+};
+
+static_assert(sizeof(CpuTraceRecord) == 24, "Trace records are written to files as is");
+
+// Single producer/single consumer ring of trace records.  The CPU appends from the emulation thread, and
+// Read may be called from any one other thread (or the same one between frames) without locking.  If the
+// reader falls a whole buffer behind, new records are dropped (and counted) rather than stalling the CPU.
+class CpuTraceBuffer
+{
+public:
+	static const uint32_t c_defaultCapacityLog2 = 20; // 1M records (24MB), comfortably more than a frame
+
+	explicit CpuTraceBuffer(uint32_t capacityLog2 = c_defaultCapacityLog2);
+
+	CpuTraceBuffer(const CpuTraceBuffer&) = delete;
+	CpuTraceBuffer& operator=(const CpuTraceBuffer&) = delete;
+
+	void Append(const CpuTraceRecord& record)
+	{
+		const uint64_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+		if (writeIndex - m_cachedReadIndex == m_capacity)
+		{
+			// Only go back to the reader's index when the last one we saw says we're full
+			m_cachedReadIndex = m_readIndex.load(std::memory_order_acquire);
+			if (writeIndex - m_cachedReadIndex == m_capacity)
+			{
+				m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+
+		m_spRecords[writeIndex & m_indexMask] = record;
+		m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+	}
+
+	// Copies out up to maxCount of the oldest unread records, returning how many there were
+	size_t Read(CpuTraceRecord* pRecords, size_t maxCount);
+
+	uint64_t GetDroppedCount() const { return m_droppedCount.load(std::memory_order_relaxed); }
+
+private:
+	const uint64_t m_capacity;
+	const uint64_t m_indexMask;
+	std::unique_ptr<CpuTraceRecord[]> m_spRecords;
+
+	// Free running indices; the record for index i lives at [i & m_indexMask]
+	std::atomic<uint64_t> m_writeIndex;
+	std::atomic<uint64_t> m_readIndex;
+	uint64_t m_cachedReadIndex = 0; // Producer's last look at m_readIndex
+	std::atomic<uint64_t> m_droppedCount;
+};
+
+// Formats a record as a line of nestest.log (without the newline), e.g.
+//   C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+// The memory contents nestest.log shows for some operands ("LDA $0200 = 5A") aren't part of the record, so
+// that column only has the disassembly.  Compare traces with ParseTraceLine rather than as text.
+std::string FormatTraceRecord(const CpuTraceRecord& record);
+
+// Reads the fields of a record back out of a line of nestest.log (or of FormatTraceRecord).  Logs in the older
+// "CYC:dot SL:scanline" layout don't have the CPU cycle, so it comes back as -1.
+bool ParseTraceLine(const char* szLine, CpuTraceRecord* pRecord);
+
+}
@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include "DecodedBlockCache.h"
+
+#include <algorithm>
+
+namespace CPU
+{
+
+const uint32_t c_addressSpaceSize = 0x10000;
+
+
+DecodedBlockCache::DecodedBlockCache()
+	: m_blockIndices(std::make_unique<uint16_t[]>(c_addressSpaceSize))
+	, m_heat(std::make_unique<uint8_t[]>(c_addressSpaceSize))
+{
+	Reset();
+}
+
+
+void DecodedBlockCache::Reset()
+{
+	m_blocks.clear();
+	std::fill(m_blockIndices.get(), m_blockIndices.get() + c_addressSpaceSize, static_cast<uint16_t>(0));
+	std::fill(m_heat.get(), m_heat.get() + c_addressSpaceSize, static_cast<uint8_t>(0));
+
+#ifdef CPU_NATIVE_BLOCKS
+	m_spNativeCode.reset();
+#endif
+}
+
+
+DecodedBlock* DecodedBlockCache::FindOlder(const DecodedBlock& newestBlock, const uint8_t* pCode)
+{
+	for (uint16_t blockIndex = newestBlock.nextBlockIndex; blockIndex != 0; )
+	{
+		DecodedBlock& block = m_blocks[blockIndex - 1];
+		if (block.pCode == pCode)
+			return &block;
+
+		blockIndex = block.nextBlockIndex;
+	}
+
+	return nullptr;
+}
+
+
+DecodedBlock* DecodedBlockCache::Allocate(uint16_t pc, const uint8_t* pCode)
+{
+	// Look for a block to reuse: one already decoded from this code, or the oldest once the PC has its fill
+	uint16_t blockIndex = 0;
+	uint16_t previousBlockIndex = 0;
+	uint32_t blockCount = 0;
+	for (uint16_t index = m_blockIndices[pc]; index != 0; index = m_blocks[index - 1].nextBlockIndex)
+	{
+		if (m_blocks[index - 1].pCode == pCode || ++blockCount == c_maxDecodedBlocksPerPc)
+		{
+			blockIndex = index;
+			break;
+		}
+
+		previousBlockIndex = index;
+	}
+
+	if (blockIndex != 0)
+	{
+		// Unlink it, to go back in at the front
+		if (previousBlockIndex != 0)
+			m_blocks[previousBlockIndex - 1].nextBlockIndex = m_blocks[blockIndex - 1].nextBlockIndex;
+		else
+			m_blockIndices[pc] = m_blocks[blockIndex - 1].nextBlockIndex;
+	}
+	else
+	{
+		// Start over if we've run out of indices (a game would have to be switching a lot of banks through the same PCs)
+		if (m_blocks.size() == UINT16_MAX)
+			Reset();
+
+		m_blocks.emplace_back();
+		blockIndex = static_cast<uint16_t>(m_blocks.size());
+	}
+
+	DecodedBlock* pBlock = &m_blocks[blockIndex - 1];
+	*pBlock = DecodedBlock();
+	pBlock->nextBlockIndex = m_blockIndices[pc];
+	m_blockIndices[pc] = blockIndex;
+	return pBlock;
+}
+
+
+#ifdef CPU_NATIVE_BLOCKS
+NativeCodeBuffer& DecodedBlockCache::UseNativeCode()
+{
+	if (!m_spNativeCode)
+		m_spNativeCode = std::make_unique<NativeCodeBuffer>();
+
+	return *m_spNativeCode;
+}
+#endif
+
+}
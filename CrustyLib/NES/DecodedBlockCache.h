@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "Cpu6502.h"
+#include "NativeBlockCompiler.h"
+
+// Cache of pre-decoded basic blocks for code running out of read-only (PRG ROM) pages.
+//
+// A block is a straight run of instructions ending at the first branch/jump/return, and never crosses a
+// CPU page boundary.  Blocks are keyed by PC and the host address of their first byte, so a block only matches
+// while the same bank is mapped at that PC.  Each PC keeps up to c_maxDecodedBlocksPerPc blocks (one per bank
+// seen there), so code at the same PC in banks which are switched back and forth stays decoded; past that the
+// least recently decoded one is reused.  RAM (and any other writable page) is never cached, and cold code is
+// left to the interpreter.
+//
+// Each block also records the most cycles it can take and whether it only ever touches CPU RAM.  Such a block
+// can't reach an I/O register, so it can't bring an event forward, raise an interrupt or switch banks; when all
+// of it fits before the target cycle and next event, RunBlock runs it without checking between instructions.
+
+namespace CPU
+{
+
+const uint32_t c_maxDecodedBlockInstructions = 32;
+const uint8_t c_hotBlockThreshold = 8; // Times a PC is reached before it's worth decoding a block there
+const uint32_t c_maxDecodedBlocksPerPc = 4;
+const uint32_t c_maxInstructionExtraCycles = 2; // A taken branch to another page
+
+struct DecodedInstruction
+{
+	Cpu6502::InstrunctionFunc func;
+	uint16_t baseCycles;
+};
+
+struct DecodedBlock
+{
+	const uint8_t* pCode = nullptr; // Host address of the first opcode
+	uint32_t instructionCount = 0;   // 0 if the code at this address can't be run from a block
+	uint16_t nextBlockIndex = 0;     // Index + 1 of the next (older) block at the same PC, or 0
+	uint32_t maxCycles = 0;          // Most cycles the block can take: its base cycles, plus page crossings and taken branches
+	bool isRamOnly = false;          // Never touches anything but CPU RAM, nor changes the I flag
+	uint32_t nativeMaxCycles = 0;    // Most cycles the native code can run for
+	const void* pNativeCode = nullptr; // Compiled on first use by CpuBackend::Native
+	DecodedInstruction instructions[c_maxDecodedBlockInstructions];
+};
+
+class DecodedBlockCache
+{
+public:
+	DecodedBlockCache();
+
+	DecodedBlockCache(const DecodedBlockCache&) = delete;
+	DecodedBlockCache& operator=(const DecodedBlockCache&) = delete;
+
+	void Reset();
+
+	// Returns the cached block for pc if one was decoded from pCode, otherwise null
+	DecodedBlock* Find(uint16_t pc, const uint8_t* pCode)
+	{
+		const uint16_t blockIndex = m_blockIndices[pc];
+		if (blockIndex == 0)
+			return nullptr;
+
+		// Nearly always the newest one, unless the game is switching banks under this PC
+		DecodedBlock& block = m_blocks[blockIndex - 1];
+		return (block.pCode == pCode) ? &block : FindOlder(block, pCode);
+	}
+
+	// Counts another arrival at pc, and returns whether it's been reached often enough to decode
+	bool IsHot(uint16_t pc)
+	{
+		uint8_t& heat = m_heat[pc];
+		if (heat < c_hotBlockThreshold)
+			heat++;
+		return heat == c_hotBlockThreshold;
+	}
+
+	// Returns a (reused or new) block for the code at pCode, mapped at pc, to be filled in by the caller
+	DecodedBlock* Allocate(uint16_t pc, const uint8_t* pCode);
+
+#ifdef CPU_NATIVE_BLOCKS
+	// Where the blocks' native code goes.  Reset throws it all away with the blocks.
+	NativeCodeBuffer& UseNativeCode();
+#endif
+
+private:
+	DecodedBlock* FindOlder(const DecodedBlock& newestBlock, const uint8_t* pCode);
+
+	std::vector<DecodedBlock> m_blocks;
+	std::unique_ptr<uint16_t[]> m_blockIndices; // Index + 1 into m_blocks of the newest block at each PC
+	std::unique_ptr<uint8_t[]> m_heat;          // Arrivals at each PC, saturating at c_hotBlockThreshold
+
+#ifdef CPU_NATIVE_BLOCKS
+	std::unique_ptr<NativeCodeBuffer> m_spNativeCode;
+#endif
+};
+
+}
@@ -0,0 +1,73 @@
+#include "stdafx.h"
+#include "DmaController.h"
+#include "Cpu6502.h"
+#include "Ppu.h"
+#include "Scheduler.h"
+
+namespace CPU
+{
+
+const uint32_t c_cbOamDma = 256;
+const uint32_t c_oamDmaCycles = 513;  // Plus one to line up with a read cycle when starting on an odd cycle
+const uint32_t c_dmcFetchCycles = 4;  // Usually; fewer when the fetch lands on a write cycle, which we don't track
+
+
+DmaController::DmaController(Cpu6502& cpu, PPU::Ppu& ppu, NES::Scheduler& scheduler)
+	: m_cpu(cpu)
+	, m_ppu(ppu)
+	, m_scheduler(scheduler)
+{
+}
+
+
+void DmaController::Reset()
+{
+	// The scheduler is reset along with us, taking any DmcDma event with it
+	m_pendingStallCycles = 0;
+}
+
+
+uint32_t DmaController::RunOamDma(uint8_t page, int64_t writeCycle)
+{
+	const uint16_t address = static_cast<uint16_t>(page) << 8;
+
+	// A 256 byte page never straddles a page of the memory map, so memory backed pages can be copied straight out
+	const uint8_t* pPage = m_cpu.m_memoryMap.GetReadPage(address);
+	if (pPage != nullptr)
+	{
+		m_ppu.TriggerOamDMA(pPage + (address & NES::c_cpuPageMask));
+	}
+	else
+	{
+		uint8_t dmaData[c_cbOamDma];
+		for (uint32_t offset = 0; offset != c_cbOamDma; ++offset)
+			dmaData[offset] = m_cpu.ReadMemory8(static_cast<uint16_t>(address + offset));
+
+		m_ppu.TriggerOamDMA(dmaData);
+	}
+
+	return c_oamDmaCycles + static_cast<uint32_t>(writeCycle & 1);
+}
+
+
+uint8_t DmaController::ReadDmcSample(uint16_t address)
+{
+	if (m_pendingStallCycles == 0)
+		m_scheduler.Schedule(NES::SchedulerEvent::DmcDma, m_cpu.GetElapsedCycles());
+	m_pendingStallCycles += c_dmcFetchCycles;
+
+	const uint8_t* pPage = m_cpu.m_memoryMap.GetReadPage(address);
+	if (pPage != nullptr)
+		return pPage[address & NES::c_cpuPageMask];
+
+	return m_cpu.ReadMemory8(address);
+}
+
+
+void DmaController::ChargeStallCycles()
+{
+	m_cpu.Stall(m_pendingStallCycles);
+	m_pendingStallCycles = 0;
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+// The CPU's DMA units: sprite (OAM) DMA, started by writing a page number to $4014, and the APU's DMC sample
+// fetches.
+//
+// Both read through the CPU's page table, so copying from RAM or PRG ROM is a memcpy or a single load; pages
+// with registers in them fall back to real bus reads.  While a DMA runs the CPU is halted.  OAM DMA happens
+// in the middle of the $4014 write, so its 513/514 cycles are simply added to that instruction.  DMC fetches
+// happen whenever the APU is caught up, so their stall cycles are collected and charged to the CPU from a
+// DmcDma scheduler event at the next instruction boundary.
+
+namespace PPU
+{
+	class Ppu;
+}
+
+namespace NES
+{
+	class Scheduler;
+}
+
+namespace CPU
+{
+
+class Cpu6502;
+
+class DmaController
+{
+public:
+	DmaController(Cpu6502& cpu, PPU::Ppu& ppu, NES::Scheduler& scheduler);
+
+	DmaController(const DmaController&) = delete;
+	DmaController& operator=(const DmaController&) = delete;
+
+	void Reset();
+
+	// Copies the page to sprite RAM, returning the cycles the CPU is halted for.  writeCycle is the CPU cycle the
+	// $4014 write landed on, whose parity decides the extra alignment cycle.
+	uint32_t RunOamDma(uint8_t page, int64_t writeCycle);
+
+	// A sample byte for the DMC, read from PRG memory at address ($8000-$FFFF)
+	uint8_t ReadDmcSample(uint16_t address);
+
+	// Halts the CPU for the DMC fetches made since the last call (on the DmcDma event)
+	void ChargeStallCycles();
+
+private:
+	Cpu6502& m_cpu;
+	PPU::Ppu& m_ppu;
+	NES::Scheduler& m_scheduler;
+
+	uint32_t m_pendingStallCycles = 0;
+};
+
+}
@@ -8,6 +8,8 @@ namespace NES
 
 // Forward declarations
 class NESRom;
+class CpuMemoryMap;
+class PpuMemoryMap;
 
 class IMapper
 {
@@ -16,13 +18,17 @@ public:
 
 	virtual void LoadFromRom(const NESRom& rom) = 0;
 
-	virtual void WriteAddress(uint16_t address, uint8_t value) = 0;
-	virtual uint8_t ReadAddress(uint16_t address) = 0;
+	// Hands the mapper the CPU's page table, so it can map its PRG banks directly (and re-map them on bank switches).
+	// Addresses the mapper leaves unmapped are routed through ReadAddress/WriteAddress.
+	virtual void SetCpuMemoryMap(CpuMemoryMap* pMemoryMap) = 0;
 
-	virtual void WriteChrAddress(uint16_t address, uint8_t value) = 0;
-	virtual uint8_t ReadChrAddress(uint16_t address) = 0;
+	// cpuCycle is the CPU clock of the instruction doing the write, for mappers sensitive to write timing
+	virtual void WriteAddress(uint16_t address, uint8_t value, int64_t cpuCycle) = 0;
+	virtual uint8_t ReadAddress(uint16_t address) = 0;
 
-	virtual void SetTick(uint64_t tickCount) = 0;
+	// Hands the mapper the PPU's page table, so it can map its CHR banks into the pattern tables (re-mapping them on
+	// bank switches) and set the nametable mirroring.
+	virtual void SetPpuMemoryMap(PpuMemoryMap* pMemoryMap) = 0;
 };
 
 
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <type_traits>
+
+#include "..\Util\CoreUtils.h"
+
+// The CPU's interrupt inputs, gathered into a single word.
+//
+// Devices raise and clear their own bit whenever their output changes (usually while being caught up on
+// a scheduler event or a register access), and the CPU looks at the word once per instruction boundary
+// rather than being called back.  NMI is edge triggered, so the CPU clears it when taking the interrupt.
+// The IRQ sources are level triggered and stay raised until the device is acknowledged, and are only
+// taken while the I flag is clear.
+
+namespace NES
+{
+
+enum class InterruptSource : uint32_t
+{
+	None        = 0x0,
+	Nmi         = 0x1,  // PPU vblank
+	ApuFrameIrq = 0x2,  // APU frame counter
+	DmcIrq      = 0x4,  // APU DMC sample finished
+	MapperIrq   = 0x8,  // Scanline/cycle counting mapper
+};
+DEFINE_ENUM_BITWISE_OPERANDS(InterruptSource);
+
+const InterruptSource c_irqSources = InterruptSource::ApuFrameIrq | InterruptSource::DmcIrq | InterruptSource::MapperIrq;
+
+class InterruptController
+{
+public:
+	InterruptController() = default;
+
+	InterruptController(const InterruptController&) = delete;
+	InterruptController& operator=(const InterruptController&) = delete;
+
+	void Reset() { m_pending = 0; }
+
+	void Raise(InterruptSource source) { m_pending |= static_cast<uint32_t>(source); }
+	void Clear(InterruptSource source) { m_pending &= ~static_cast<uint32_t>(source); }
+
+	bool IsRaised(InterruptSource source) const { return (m_pending & static_cast<uint32_t>(source)) != 0; }
+
+	// Zero when nothing is raised, which is nearly always
+	uint32_t GetPending() const { return m_pending; }
+
+private:
+	uint32_t m_pending = 0;
+};
+
+}
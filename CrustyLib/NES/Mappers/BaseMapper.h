@@ -1,14 +1,40 @@
 #pragma once
 
 #include "../IMapper.h"
+#include "../CpuMemoryMap.h"
+#include "../PpuMemoryMap.h"
 
 namespace NES
 {
 
 class BaseMapper : public IMapper
 {
-	virtual void SetTick(uint64_t /*tickCount*/) override {}
+public:
+	virtual void SetCpuMemoryMap(CpuMemoryMap* pMemoryMap) override
+	{
+		m_pCpuMemoryMap = pMemoryMap;
+		UpdateCpuMemoryMap();
+	}
 
+	virtual void SetPpuMemoryMap(PpuMemoryMap* pMemoryMap) override
+	{
+		m_pPpuMemoryMap = pMemoryMap;
+		m_pPpuMemoryMap->SetMirroringMode(m_mirroringMode);
+		UpdatePpuMemoryMap();
+	}
+
+protected:
+	// Point the CPU page table at the current PRG banks.  Called on attach, and by mappers whenever they switch banks.
+	virtual void UpdateCpuMemoryMap() {}
+
+	// Same for the PPU page table and CHR banks
+	virtual void UpdatePpuMemoryMap() {}
+
+	CpuMemoryMap* m_pCpuMemoryMap = nullptr;
+	PpuMemoryMap* m_pPpuMemoryMap = nullptr;
+
+	// From the ROM header, unless the mapper controls mirroring itself
+	PPU::MirroringMode m_mirroringMode{};
 };
 
-}
\ No newline at end of file
+}
@@ -2,7 +2,6 @@
 
 #include "../IMapper.h"
 #include "../NESRom.h"
-#include "BasePpuMemoryMap.h"
 #include "BaseMapper.h"
 
 #include <stdexcept>
@@ -17,11 +16,12 @@ class UxROM : public BaseMapper
 {
 public:
 	virtual void LoadFromRom(const NESRom& rom) override;
-	virtual void WriteAddress(uint16_t address, uint8_t value) override;
+	virtual void WriteAddress(uint16_t address, uint8_t value, int64_t cpuCycle) override;
 	virtual uint8_t ReadAddress(uint16_t address) override;
 
-	virtual void WriteChrAddress(uint16_t address, uint8_t value) override;
-	virtual uint8_t ReadChrAddress(uint16_t address) override;
+protected:
+	virtual void UpdateCpuMemoryMap() override;
+	virtual void UpdatePpuMemoryMap() override;
 
 private:
 	const byte* m_prgRom;
@@ -31,8 +31,6 @@ private:
 	const uint8_t* m_pBank2Rom = nullptr;
 
 	uint8_t m_chrRAM[c_cbChrRam];
-
-	BasePpuMemoryMap m_basePpuMemory;
 };
 
 
@@ -50,27 +48,32 @@ void UxROM::LoadFromRom(const NESRom& rom)
 	m_pBank1Rom = m_prgRom;
 	m_pBank2Rom = m_prgRom + (m_cbPrgRom - c_cb16RomBank);
 
-	m_basePpuMemory.LoadRomData(rom);
+	m_mirroringMode = rom.GetMirroringMode();
+}
+
+void UxROM::UpdateCpuMemoryMap()
+{
+	// Cartridge RAM isn't supported, so $6000-$7FFF stays unmapped
+	m_pCpuMemoryMap->MapReadOnly(0x8000, c_cb16RomBank, m_pBank1Rom);
+	m_pCpuMemoryMap->MapReadOnly(0xC000, c_cb16RomBank, m_pBank2Rom);
 }
 
-void UxROM::WriteAddress(uint16_t address, uint8_t value)
+void UxROM::UpdatePpuMemoryMap()
+{
+	m_pPpuMemoryMap->MapChrReadWrite(0x0000, c_cbChrRam, m_chrRAM);
+}
+
+void UxROM::WriteAddress(uint16_t address, uint8_t value, int64_t /*cpuCycle*/)
 {
 	if (address >= 0x8000)
 	{
 		m_pBank1Rom = m_prgRom + (c_cb16RomBank * (value & 0x7));
-	}
-	else if (address >= 4020 && address < 0x6000)
-	{
-		// Nothing here, just no-op
-	}
-	else if (address >= 0x6000 && address < 0x8000)
-	{
-		throw std::runtime_error("Cartridge RAM currently unsupported");
+		UpdateCpuMemoryMap();
 	}
 	else
 	{
-		// Hrm, why does anyone do this?
-		throw std::runtime_error("Unexpected mapper address");
+		// Nothing below $8000, since cartridge RAM isn't supported
+		m_pCpuMemoryMap->WriteUnmapped();
 	}
 }
 
@@ -80,28 +83,8 @@ uint8_t UxROM::ReadAddress(uint16_t address)
 		return m_pBank2Rom[address - 0xC000];
 	else if (address >= 0x8000)
 		return m_pBank1Rom[address - 0x8000];
-	else if (address >= 0x6000)
-		throw std::runtime_error("Cartridge RAM currently unsupported");
-	else
-		return 0;
-}
-
-
-void UxROM::WriteChrAddress(uint16_t address, uint8_t value)
-{
-	if (address >= 0x0000 && address < 0x2000)
-		m_chrRAM[address - 0x0000] = value;
-	else
-		m_basePpuMemory.WriteMemory(address, value);
-}
-
-
-uint8_t UxROM::ReadChrAddress(uint16_t address)
-{
-	if (address >= 0x0000 && address < 0x2000)
-		return m_chrRAM[address - 0x0000];
 	else
-		return m_basePpuMemory.ReadMemory(address);
+		return m_pCpuMemoryMap->ReadUnmapped();
 }
 
 
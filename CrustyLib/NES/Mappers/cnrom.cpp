@@ -2,7 +2,6 @@
 
 #include "../IMapper.h"
 #include "../NESRom.h"
-#include "BasePpuMemoryMap.h"
 #include "BaseMapper.h"
 
 #include <stdexcept>
@@ -19,16 +18,14 @@ public:
 	CNROMMapper& operator=(const CNROMMapper& other) = delete;
 
 	virtual void LoadFromRom(const NESRom& rom) override;
-	virtual void WriteAddress(uint16_t address, uint8_t value) override;
+	virtual void WriteAddress(uint16_t address, uint8_t value, int64_t cpuCycle) override;
 	virtual uint8_t ReadAddress(uint16_t address) override;
 
-	virtual void WriteChrAddress(uint16_t address, uint8_t value) override;
-	virtual uint8_t ReadChrAddress(uint16_t address) override;
+protected:
+	virtual void UpdateCpuMemoryMap() override;
+	virtual void UpdatePpuMemoryMap() override;
 
 private:
-
-	BasePpuMemoryMap m_basePpuMemory;
-
 	const byte* m_chrRomActiveBank = nullptr;
 	const byte* m_chrRomData = nullptr;
 	uint32_t m_cbChrRomData = 0;
@@ -43,24 +40,50 @@ void CNROMMapper::LoadFromRom(const NESRom& rom)
 {
 	m_chrRomData = rom.GetChrRom();
 	m_cbChrRomData = rom.CbChrRomData();
+	if (m_cbChrRomData < c_cbChrRomBank)
+		throw std::runtime_error("CNROM requires at least 8K of CHR ROM");
+
+	m_chrRomActiveBank = m_chrRomData;
 
 	m_cbPrgRom = rom.GetCbPrgRom();
 	m_prgRom = rom.GetPrgRom();
 
-	m_basePpuMemory.LoadRomData(rom);
+	m_mirroringMode = rom.GetMirroringMode();
+}
+
+
+void CNROMMapper::UpdateCpuMemoryMap()
+{
+	// Only CHR is banked, so PRG ROM is mapped once up front (16K carts mirror into $C000-$FFFF)
+	if (m_cbPrgRom == 32 * 1024)
+	{
+		m_pCpuMemoryMap->MapReadOnly(0x8000, m_cbPrgRom, m_prgRom);
+	}
+	else if (m_cbPrgRom == 16 * 1024)
+	{
+		m_pCpuMemoryMap->MapReadOnly(0x8000, m_cbPrgRom, m_prgRom);
+		m_pCpuMemoryMap->MapReadOnly(0xC000, m_cbPrgRom, m_prgRom);
+	}
+}
+
+
+void CNROMMapper::UpdatePpuMemoryMap()
+{
+	m_pPpuMemoryMap->MapChrReadOnly(0x0000, c_cbChrRomBank, m_chrRomActiveBank);
 }
 
 
-void CNROMMapper::WriteAddress(uint16_t address, uint8_t value)
+void CNROMMapper::WriteAddress(uint16_t address, uint8_t value, int64_t /*cpuCycle*/)
 {
 	if (address >= 0x8000)
 	{
-		m_chrRomActiveBank = m_chrRomData + c_cbChrRomBank * (value & 0x3);
+		// Banks past the end of CHR wrap around, as the unconnected high bank bits are ignored
+		m_chrRomActiveBank = m_chrRomData + (c_cbChrRomBank * (value & 0x3)) % m_cbChrRomData;
+		UpdatePpuMemoryMap();
 	}
 	else
 	{
-		// Hrm, why does anyone do this?  Maybe for Famicom Disk System integration?
-		//throw std::runtime_error("Unexpected mapper address");
+		m_pCpuMemoryMap->WriteUnmapped();
 	}
 }
 
@@ -79,37 +102,12 @@ uint8_t CNROMMapper::ReadAddress(uint16_t address)
 			else
 				return m_prgRom[address - 0x8000];
 		}
-		else
-		{
-			throw std::runtime_error("Unexpected mapper address");
-		}
-	}
-	else
-	{
-		throw std::runtime_error("Unexpected mapper address");
 	}
-}
 
-
-void CNROMMapper::WriteChrAddress(uint16_t address, uint8_t value)
-{
-	if (address >= 0x0000 && address < 0x2000)
-		throw std::runtime_error("Unexpected mapper chr write");
-	else
-		m_basePpuMemory.WriteMemory(address, value);
+	return m_pCpuMemoryMap->ReadUnmapped();
 }
 
 
-uint8_t CNROMMapper::ReadChrAddress(uint16_t address)
-{
-	if (address >= 0x0000 && address < 0x2000)
-		return m_chrRomActiveBank[address];
-	else
-		return m_basePpuMemory.ReadMemory(address);
-}
-
-
-
 MapperPtr CreateCNROMMapper()
 {
 	return std::make_unique<CNROMMapper>();
@@ -2,7 +2,6 @@
 
 #include "../IMapper.h"
 #include "../NESRom.h"
-#include "BasePpuMemoryMap.h"
 #include "BaseMapper.h"
 
 #include <stdexcept>
@@ -15,15 +14,17 @@ class MMC0Mapper : public BaseMapper
 public:
 	virtual void LoadFromRom(const NESRom& rom) override;
 	
-	virtual void WriteAddress(uint16_t address, uint8_t value) override;
+	virtual void WriteAddress(uint16_t address, uint8_t value, int64_t cpuCycle) override;
 	virtual uint8_t ReadAddress(uint16_t address) override;
-	virtual void WriteChrAddress(uint16_t address, uint8_t value) override;
-	virtual uint8_t ReadChrAddress(uint16_t address) override;
+
+protected:
+	virtual void UpdateCpuMemoryMap() override;
+	virtual void UpdatePpuMemoryMap() override;
 
 private:
 	static const uint16_t c_cbVROM = 8*1024; // 0x2000
-	uint8_t m_vrom[c_cbVROM]; // 8KB of video ram
-	BasePpuMemoryMap m_basePpuMemory;
+	const byte* m_chrRom = nullptr; // The ROM's own 8KB of CHR, mapped read-only
+	uint8_t m_vram[c_cbVROM]; // Otherwise CHR RAM, loaded with whatever CHR the ROM has
 
 	uint8_t m_prgRam[0x2000]; // 8k
 	const byte* m_prgRom;
@@ -32,21 +33,49 @@ private:
 
 void MMC0Mapper::LoadFromRom(const NESRom& rom)
 {
-	// Copy pattern tables into vrom
 	const byte* pChrRom = rom.GetChrRom();
 	const uint32_t cbChrRom = rom.CbChrRomData();
 	if (cbChrRom > c_cbVROM)
 		throw std::runtime_error("Mapper0 doesn't support > 8K memory");
 
-	memcpy_s(m_vrom, _countof(m_vrom), pChrRom, cbChrRom);
+	// A full 8KB of CHR is ROM, so the pages (and their decoded tiles) are shared with every console running this ROM
+	if (cbChrRom == c_cbVROM)
+		m_chrRom = pChrRom;
+	else
+		memcpy_s(m_vram, _countof(m_vram), pChrRom, cbChrRom);
 
 	m_cbPrgRom = rom.GetCbPrgRom();
 	m_prgRom = rom.GetPrgRom();
 
-	m_basePpuMemory.LoadRomData(rom);
+	m_mirroringMode = rom.GetMirroringMode();
+}
+
+void MMC0Mapper::UpdateCpuMemoryMap()
+{
+	m_pCpuMemoryMap->MapReadWrite(0x6000, sizeof(m_prgRam), m_prgRam);
+
+	// NROM-128 mirrors its 16K of PRG ROM into both halves of $8000-$FFFF
+	if (m_cbPrgRom == 32 * 1024)
+	{
+		m_pCpuMemoryMap->MapReadOnly(0x8000, m_cbPrgRom, m_prgRom);
+	}
+	else if (m_cbPrgRom == 16 * 1024)
+	{
+		m_pCpuMemoryMap->MapReadOnly(0x8000, m_cbPrgRom, m_prgRom);
+		m_pCpuMemoryMap->MapReadOnly(0xC000, m_cbPrgRom, m_prgRom);
+	}
+}
+
+void MMC0Mapper::UpdatePpuMemoryMap()
+{
+	// Carts declared as NROM without CHR ROM have CHR RAM
+	if (m_chrRom != nullptr)
+		m_pPpuMemoryMap->MapChrReadOnly(0x0000, c_cbVROM, m_chrRom);
+	else
+		m_pPpuMemoryMap->MapChrReadWrite(0x0000, c_cbVROM, m_vram);
 }
 
-void MMC0Mapper::WriteAddress(uint16_t address, uint8_t value)
+void MMC0Mapper::WriteAddress(uint16_t address, uint8_t value, int64_t /*cpuCycle*/)
 {
 	if (address >= 0x6000 && address < 0x8000)
 	{
@@ -54,8 +83,8 @@ void MMC0Mapper::WriteAddress(uint16_t address, uint8_t value)
 	}
 	else
 	{
-		// TODO: Letting this through to test Ms Pacman.  Hrm, that works.  Need to figure out why this is happening and if its valid
-		// throw std::runtime_error("Unexpected mapper write");
+		// No registers on NROM (Ms. Pac-Man writes to ROM anyway)
+		m_pCpuMemoryMap->WriteUnmapped();
 	}
 }
 
@@ -65,6 +94,10 @@ uint8_t MMC0Mapper::ReadAddress(uint16_t address)
 	{
 		return m_prgRam[address - 0x6000];
 	}
+	else if (address < 0x8000)
+	{
+		return m_pCpuMemoryMap->ReadUnmapped();
+	}
 
 	// For now, only support NROM mapper NES-NROM-128 and NES-NROM-256 (iNes Mapper 0)
 	if (m_cbPrgRom == 32 * 1024)
@@ -80,27 +113,10 @@ uint8_t MMC0Mapper::ReadAddress(uint16_t address)
 	}
 	else
 	{
-		throw std::runtime_error("Unexpected read location");
+		return m_pCpuMemoryMap->ReadUnmapped();
 	}
 }
 
-void MMC0Mapper::WriteChrAddress(uint16_t address, uint8_t value)
-{
-	if (address < 0x2000)
-		//throw std::runtime_error("Writing to VROM?");
-		m_vrom[address] = value;
-	else
-		m_basePpuMemory.WriteMemory(address, value);
-}
-
-uint8_t MMC0Mapper::ReadChrAddress(uint16_t address)
-{
-	if (address < 0x2000)
-		return m_vrom[address];
-	else
-		return m_basePpuMemory.ReadMemory(address);
-}
-
 MapperPtr CreateMMC0Mapper()
 {
 	return std::make_unique<MMC0Mapper>();
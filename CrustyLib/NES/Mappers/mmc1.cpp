@@ -2,8 +2,8 @@
 
 #include "../IMapper.h"
 #include "../NESRom.h"
-#include "BasePpuMemoryMap.h"
 #include "BaseMapper.h"
+#include "../Ppu.h"
 
 #include <stdexcept>
 #include <vector>
@@ -41,16 +41,16 @@ public:
 	MMC1Mapper& operator=(const MMC1Mapper& other) = delete;
 
 	virtual void LoadFromRom(const NESRom& rom) override;
-	virtual void WriteAddress(uint16_t address, uint8_t value) override;
+	virtual void WriteAddress(uint16_t address, uint8_t value, int64_t cpuCycle) override;
 	virtual uint8_t ReadAddress(uint16_t address) override;
 
-	virtual void WriteChrAddress(uint16_t address, uint8_t value) override;
-	virtual uint8_t ReadChrAddress(uint16_t address) override;
-
-	virtual void SetTick(uint64_t tickCount) override;
+protected:
+	virtual void UpdateCpuMemoryMap() override;
+	virtual void UpdatePpuMemoryMap() override;
 
 private:
 	void SetRegister(uint16_t address, uint8_t value);
+	void MapChrBank(uint16_t address, const uint8_t* pBank);
 
 	std::vector<byte> m_vram;
 	bool m_isVRAM = false;
@@ -58,6 +58,10 @@ private:
 	uint32_t m_cbVROM = 0;
 	const uint32_t c_cbVRAM = 8 * 1024;
 
+	// The ROM's CHR, which is mapped read-only straight from the ROM, or else m_vram
+	const byte* m_chr = nullptr;
+	uint32_t m_cbChr = 0;
+
 	const byte* m_prgRom;
 	uint32_t m_cbPrgRom;
 
@@ -69,23 +73,19 @@ private:
 		MMC0ControlFlags m_controlFlags;
 	};
 
-	uint64_t m_timestamp = 0;
-	uint64_t m_lastWriteTimestamp = 0;
+	int64_t m_lastWriteCycle = -2; // Not next to any real write, so the first one is never ignored
 
 	const uint8_t* m_pPrgRomBank1 = nullptr;
 	const uint8_t* m_pPrgRomBank2 = nullptr;
-	uint8_t* m_pChrBank1 = nullptr;
-	uint8_t* m_pChrBank2 = nullptr;
+	const uint8_t* m_pChrBank1 = nullptr;
+	const uint8_t* m_pChrBank2 = nullptr;
 
 	uint8_t m_prgRam[8 * 1024]; // 8K (battery backed) RAM
-
-	BasePpuMemoryMap m_basePpuMemory;
 };
 
 
 void MMC1Mapper::LoadFromRom(const NESRom& rom)
 {
-	// Copy pattern tables into vram
 	m_cbVROM = rom.CbChrRomData();
 
 	// No CHR ROM indicates CHR RAM
@@ -94,16 +94,18 @@ void MMC1Mapper::LoadFromRom(const NESRom& rom)
 		// Just allocate 8k of RAM instead
 		m_isVRAM = true;
 		m_vram.resize(c_cbVRAM);
+		m_chr = m_vram.data();
+		m_cbChr = c_cbVRAM;
 	}
 	else
 	{
-		m_vram.resize(m_cbVROM);
-		const byte* pChrRom = rom.GetChrRom();
-		memcpy_s(&m_vram[0], m_vram.size(), pChrRom, m_cbVROM);
+		// Not copied, so the pages (and their decoded tiles) are shared with every console running this ROM
+		m_chr = rom.GetChrRom();
+		m_cbChr = m_cbVROM;
 	}
-	
-	m_pChrBank1 = m_vram.data();
-	m_pChrBank2 = m_vram.data() + c_cbChrRomBank;
+
+	m_pChrBank1 = m_chr;
+	m_pChrBank2 = m_chr + c_cbChrRomBank;
 
 	m_cbPrgRom = rom.GetCbPrgRom();
 	m_prgRom = rom.GetPrgRom();
@@ -111,20 +113,41 @@ void MMC1Mapper::LoadFromRom(const NESRom& rom)
 	m_pPrgRomBank1 = m_prgRom;
 	m_pPrgRomBank2 = m_prgRom + (m_cbPrgRom - c_cb16RomBank);
 
-	m_basePpuMemory.LoadRomData(rom);
+	m_mirroringMode = rom.GetMirroringMode();
+}
+
+void MMC1Mapper::UpdateCpuMemoryMap()
+{
+	m_pCpuMemoryMap->MapReadWrite(0x6000, sizeof(m_prgRam), m_prgRam);
+	m_pCpuMemoryMap->MapReadOnly(0x8000, c_cb16RomBank, m_pPrgRomBank1);
+	m_pCpuMemoryMap->MapReadOnly(0xC000, c_cb16RomBank, m_pPrgRomBank2);
+}
+
+void MMC1Mapper::UpdatePpuMemoryMap()
+{
+	MapChrBank(0x0000, m_pChrBank1);
+	MapChrBank(0x1000, m_pChrBank2);
 }
 
-void MMC1Mapper::SetTick(uint64_t tickCount)
+void MMC1Mapper::MapChrBank(uint16_t address, const uint8_t* pBank)
 {
-	m_timestamp = tickCount;
+	if (pBank == nullptr)
+		m_pPpuMemoryMap->UnmapChr(address, c_cbChrRomBank);
+	else if (m_isVRAM)
+		m_pPpuMemoryMap->MapChrReadWrite(address, c_cbChrRomBank, m_vram.data() + (pBank - m_vram.data()));
+	else
+		m_pPpuMemoryMap->MapChrReadOnly(address, c_cbChrRomBank, pBank);
 }
 
-void MMC1Mapper::WriteAddress(uint16_t address, uint8_t value)
+void MMC1Mapper::WriteAddress(uint16_t address, uint8_t value, int64_t cpuCycle)
 {
-	uint64_t oldWriteTimestamp = m_lastWriteTimestamp;
-	m_lastWriteTimestamp = m_timestamp;
+	// The serial port ignores all but the first of writes on consecutive cycles (e.g. the double write from INC/DEC).
+	// With per instruction CPU timing both writes of a read-modify-write report the same cycle.  Only exact matches
+	// count, since the CPU's cycle count starts over from 0 on a reset.
+	const int64_t lastWriteCycle = m_lastWriteCycle;
+	m_lastWriteCycle = cpuCycle;
 
-	if (m_timestamp - oldWriteTimestamp == 0)
+	if (cpuCycle == lastWriteCycle || cpuCycle == lastWriteCycle + 1)
 		return;
 
 	if (address >= 0x8000)
@@ -150,19 +173,14 @@ void MMC1Mapper::WriteAddress(uint16_t address, uint8_t value)
 			}
 		}
 	}
-	else if (address >= 4020 && address < 0x6000)
-	{
-		// Nothing here, just no-op
-	}
-	else if (address >= 0x6000 && address < 0x8000)
+	else if (address >= 0x6000)
 	{
 		// Write to cartridge RAM
 		m_prgRam[address - 0x6000] = value;
 	}
 	else
 	{
-		// Hrm, why does anyone do this?
-		throw std::runtime_error("Unexpected mapper address");
+		m_pCpuMemoryMap->WriteUnmapped();
 	}
 }
 
@@ -175,49 +193,7 @@ uint8_t MMC1Mapper::ReadAddress(uint16_t address)
 	else if (address >= 0x6000)
 		return m_prgRam[address - 0x6000];
 	else
-		throw std::runtime_error("Unexpected mapper address");
-}
-
-
-void MMC1Mapper::WriteChrAddress(uint16_t address, uint8_t value)
-{
-	if (address >= 0x0000 && address < 0x1000)
-	{
-		if (m_pChrBank1 != nullptr)
-			m_pChrBank1[address - 0x0000] = value;
-	}
-	else if (address >= 0x1000 && address < 0x2000)
-	{
-		if (m_pChrBank2 != nullptr)
-			m_pChrBank2[address - 0x1000] = value;
-	}
-	else
-	{
-		m_basePpuMemory.WriteMemory(address, value);
-	}
-}
-
-
-uint8_t MMC1Mapper::ReadChrAddress(uint16_t address)
-{
-	if (address >= 0x0000 && address < 0x1000)
-	{
-		if (m_pChrBank1 != nullptr)
-			return m_pChrBank1[address - 0x0000];
-		else
-			return 0;
-	}
-	else if (address >= 0x1000 && address < 0x2000)
-	{
-		if (m_pChrBank2 != nullptr)
-			return m_pChrBank2[address - 0x1000];
-		else
-			return 0;
-	}
-	else
-	{
-		return m_basePpuMemory.ReadMemory(address);
-	}
+		return m_pCpuMemoryMap->ReadUnmapped();
 }
 
 
@@ -227,6 +203,17 @@ void MMC1Mapper::SetRegister(uint16_t address, uint8_t value)
 	if (registerSelector == 0)
 	{
 		m_regControl = value;
+
+		static const PPU::MirroringMode c_mirroringModes[] =
+		{
+			PPU::MirroringMode::SingleScreenLower,
+			PPU::MirroringMode::SingleScreenUpper,
+			PPU::MirroringMode::VerticalMirroring,
+			PPU::MirroringMode::HorizontalMirroring,
+		};
+
+		m_mirroringMode = c_mirroringModes[m_controlFlags.mirroringMode];
+		m_pPpuMemoryMap->SetMirroringMode(m_mirroringMode);
 	}
 	else if (registerSelector == 1)
 	{
@@ -234,15 +221,10 @@ void MMC1Mapper::SetRegister(uint16_t address, uint8_t value)
 		{
 			value &= 0xFE;
 
-			if ((value+1) * c_cbChrRomBank < m_vram.size())
-			{
-				m_pChrBank1 = m_vram.data() + (value * c_cbChrRomBank);
-				m_pChrBank2 = m_vram.data() + ((value + 1) * c_cbChrRomBank);
-			}
-			else
-			{
-				throw std::runtime_error("Switching to more ROM memory than we have");
-			}
+			// Banks past the end of CHR wrap around, as the unconnected high bank bits are ignored
+			const uint32_t offset = (value * c_cbChrRomBank) % m_cbChr;
+			m_pChrBank1 = m_chr + offset;
+			m_pChrBank2 = m_chr + offset + c_cbChrRomBank;
 		}
 		else // if (m_controlFlags.chrRomBankMode == ChrRomBankMode::Switch4K)
 		{
@@ -253,14 +235,17 @@ void MMC1Mapper::SetRegister(uint16_t address, uint8_t value)
 			else
 			{
 				const uint32_t offset = (value * c_cbChrRomBank) % m_cbVROM;
-				m_pChrBank1 = m_vram.data() + offset;
+				m_pChrBank1 = m_chr + offset;
 			}
 		}
+
+		UpdatePpuMemoryMap();
 	}
 	else if (registerSelector == 2)
 	{
+		// The second CHR bank register is ignored in 8K mode
 		if (m_controlFlags.chrRomBankMode == ChrRomBankMode::Switch8K)
-			throw std::runtime_error("Need to ignore this if it happens");
+			return;
 
 		if (m_cbVROM == 0)
 		{
@@ -269,8 +254,10 @@ void MMC1Mapper::SetRegister(uint16_t address, uint8_t value)
 		else
 		{
 			const uint32_t offset = (value * c_cbChrRomBank) % m_cbVROM;
-			m_pChrBank2 = m_vram.data() + offset;
+			m_pChrBank2 = m_chr + offset;
 		}
+
+		UpdatePpuMemoryMap();
 	}
 	else if (registerSelector == 3)
 	{
@@ -289,6 +276,8 @@ void MMC1Mapper::SetRegister(uint16_t address, uint8_t value)
 			m_pPrgRomBank1 = m_prgRom + (prgRomBank * c_cb16RomBank);
 			m_pPrgRomBank2 = m_prgRom + ((prgRomBank + 1)* c_cb16RomBank);
 		}
+
+		UpdateCpuMemoryMap();
 	}
 }
 
@@ -2,7 +2,6 @@
 
 #include "../IMapper.h"
 #include "../NESRom.h"
-#include "BasePpuMemoryMap.h"
 #include "BaseMapper.h"
 
 #include <stdexcept>
@@ -42,12 +41,9 @@ public:
 	MMC5Mapper& operator=(const MMC5Mapper& other) = delete;
 
 	virtual void LoadFromRom(const NESRom& rom) override;
-	virtual void WriteAddress(uint16_t address, uint8_t value) override;
+	virtual void WriteAddress(uint16_t address, uint8_t value, int64_t cpuCycle) override;
 	virtual uint8_t ReadAddress(uint16_t address) override;
 
-	virtual void WriteChrAddress(uint16_t address, uint8_t value) override;
-	virtual uint8_t ReadChrAddress(uint16_t address) override;
-
 private:
 	uint16_t MapPrgAddress(uint16_t address);
 
@@ -74,7 +70,7 @@ uint16_t MMC5Mapper::MapPrgAddress(uint16_t address)
 }
 
 
-void MMC5Mapper::WriteAddress(uint16_t address, uint8_t value)
+void MMC5Mapper::WriteAddress(uint16_t address, uint8_t value, int64_t /*cpuCycle*/)
 {
 	if (address == 0x5100)
 	{
@@ -143,29 +139,16 @@ void MMC5Mapper::WriteAddress(uint16_t address, uint8_t value)
 	}
 	else
 	{
-		// Hrm, why does anyone do this?
-		throw std::runtime_error("Unexpected mapper address");
+		m_pCpuMemoryMap->WriteUnmapped();
 	}
 }
 
 uint8_t MMC5Mapper::ReadAddress(uint16_t address)
 {
-	return 0;
-}
-
-
-void MMC5Mapper::WriteChrAddress(uint16_t address, uint8_t value)
-{
+	return m_pCpuMemoryMap->ReadUnmapped();
 }
 
 
-uint8_t MMC5Mapper::ReadChrAddress(uint16_t address)
-{
-	return 0;
-}
-
-
-
 MapperPtr CreateMMC5Mapper()
 {
 	return std::make_unique<MMC5Mapper>();
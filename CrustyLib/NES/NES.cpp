@@ -2,6 +2,8 @@
 #include "NES.h"
 #include "APU_blargg.h"
 
+#include <algorithm>
+
 namespace NES
 {
 
@@ -11,28 +13,132 @@ NES::NES()
 	: m_spApu(APU::blargg::CreateBlarggApu())
 	, m_cpu(*this)
 {
-	m_ppu.SetCpu(&m_cpu);
+	m_ppu.SetInterruptController(&m_interrupts);
 	m_spApu->SetCpu(&m_cpu);
+	m_spApu->SetIrqLine(&m_scheduler, &m_interrupts);
 }
 
 void NES::RunCycle()
 {
-	const uint32_t cpuCycles = GetCpu().RunNextInstruction();
-	GetPpu().AddCycles(cpuCycles);
+	m_cpu.RunNextInstruction();
+
+	// Single stepping keeps the PPU caught up every instruction, so its debug state is exact
+	m_ppu.SyncToCpuCycle(m_cpu.GetElapsedCycles());
+	DispatchEvents();
 }
 
 void NES::RunCycles(int numCycles)
 {
-	const uint32_t cpuCycles = GetCpu().RunInstructions(numCycles);
-	GetPpu().AddCycles(cpuCycles);
+	const int64_t targetCycle = m_cpu.GetElapsedCycles() + numCycles;
+
+	while (m_cpu.GetElapsedCycles() < targetCycle)
+	{
+		m_cpu.RunUntil(std::min(targetCycle, m_scheduler.GetNextEventCycle()));
+		DispatchEvents();
+	}
+}
+
+FrameStats NES::RunFrame(uint32_t framesToSkip)
+{
+	StartFrame(framesToSkip);
+
+	do
+	{
+		m_cpu.RunUntil(m_scheduler.GetNextEventCycle());
+	} while (!EndCpuRun());
+
+	return FinishFrame();
+}
+
+void NES::StartFrame(uint32_t framesToSkip)
+{
+	m_frameStartCycle = m_cpu.GetElapsedCycles();
+	m_frameStartInstructionCount = m_cpu.GetInstructionCount();
+	m_frameStartFusedCount = m_cpu.GetFusedInstructionCount();
+	m_controller1.ClearPolled();
+
+	m_framesLeftToSkip = framesToSkip;
+	if (framesToSkip != 0)
+		m_ppu.SetPixelOutput(false);
+}
+
+// Every scanline has been drawn (or skipped) by the time the vblank event comes due, so the PPU's pixel output
+// can be switched at either side of this
+bool NES::EndCpuRun()
+{
+	DispatchEvents();
+
+	if (!m_ppu.ShouldRender())
+		return false;
+
+	if (m_framesLeftToSkip != 0)
+	{
+		if (--m_framesLeftToSkip == 0)
+			m_ppu.SetPixelOutput(true);
+		return false;
+	}
+
+	return true;
+}
+
+FrameStats NES::FinishFrame()
+{
+	FrameStats stats;
+	stats.cycles = m_cpu.GetElapsedCycles() - m_frameStartCycle;
+	stats.instructions = m_cpu.GetInstructionCount() - m_frameStartInstructionCount;
+	stats.dispatches = stats.instructions - (m_cpu.GetFusedInstructionCount() - m_frameStartFusedCount);
+	stats.isLagFrame = !m_controller1.WasPolled();
+	return stats;
+}
+
+void NES::DispatchEvents()
+{
+	const int64_t currentCycle = m_cpu.GetElapsedCycles();
+
+	SchedulerEvent event;
+	while (m_scheduler.PopDueEvent(currentCycle, &event))
+	{
+		switch (event)
+		{
+		case SchedulerEvent::PpuVBlank:
+			m_ppu.SyncToCpuCycle(currentCycle);
+			m_scheduler.Schedule(SchedulerEvent::PpuVBlank, m_ppu.GetNextVBlankCpuCycle());
+			break;
+
+		case SchedulerEvent::ApuFrameIrq:
+			// The APU reschedules (and drops the line) itself whenever the game acknowledges the IRQ
+			m_interrupts.Raise(InterruptSource::ApuFrameIrq);
+			break;
+
+		case SchedulerEvent::MapperIrq:
+			// Mappers acknowledge through their register writes, by clearing the line again
+			m_interrupts.Raise(InterruptSource::MapperIrq);
+			break;
+
+		case SchedulerEvent::DmcDma:
+			m_cpu.GetDma().ChargeStallCycles();
+			break;
+
+		default:
+			throw std::runtime_error("Unknown scheduler event");
+		}
+	}
 }
 
 void NES::LoadRomFile(IReadableFile* pRomFile)
 {
-	m_rom.LoadRomFromFile(pRomFile);
+	auto spRom = std::make_shared<NESRom>();
+	spRom->LoadRomFromFile(pRomFile);
+
+	LoadRom(std::move(spRom));
+}
 
-	m_spMapper = CreateMapper(m_rom.GetMapperId());
-	m_spMapper->LoadFromRom(m_rom);
+void NES::LoadRom(std::shared_ptr<const NESRom> spRom)
+{
+	// The mapper keeps pointers into the ROM's data, so it has to go first
+	m_spMapper = CreateMapper(spRom->GetMapperId());
+	m_spRom = std::move(spRom);
+	m_spMapper->LoadFromRom(*m_spRom);
 
 	m_cpu.SetRomMapper(m_spMapper.get());
 	m_ppu.SetRomMapper(m_spMapper.get());
@@ -40,9 +146,15 @@ void NES::LoadRomFile(IReadableFile* pRomFile)
 
 void NES::Reset()
 {
+	// Reset the scheduler and interrupt lines first, since resetting the devices can schedule events and raise lines again
+	m_scheduler.Reset();
+	m_interrupts.Reset();
+
 	m_cpu.Reset();
 	m_ppu.Reset();
 	m_spApu->Reset(false /*isHardReset*/);
+
+	m_scheduler.Schedule(SchedulerEvent::PpuVBlank, m_ppu.GetNextVBlankCpuCycle());
 }
 
 }
\ No newline at end of file
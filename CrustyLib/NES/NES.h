@@ -7,6 +7,8 @@
 #include "APU_blargg.h"
 #include "Controller.h"
 #include "IMapper.h"
+#include "Scheduler.h"
+#include "InterruptController.h"
 
 
 namespace NES
@@ -28,6 +30,14 @@ private:
 	int m_mapperNum;
 };
 
+struct FrameStats
+{
+	int64_t cycles = 0;
+	uint64_t instructions = 0;
+	uint64_t dispatches = 0;  // Instructions less the ones run as the second half of a fused pair
+	bool isLagFrame = false; // The game never read the controller during the frame
+};
+
 //using ApuClass = APU::Apu;
 //using ApuClass = APU::blargg::Apu;
 
@@ -37,11 +47,34 @@ public:
 	NES();
 
 	void LoadRomFile(IReadableFile* pRomFile);
+
+	// Runs a ROM which is already loaded, e.g. by another NES.  The ROM is only ever read, so any number of consoles can share one.
+	void LoadRom(std::shared_ptr<const NESRom> spRom);
 	void Reset();
 
 	void RunCycle();
 	void RunCycles(int numCycles);
 
+	// Runs until the PPU reaches the next vblank.  The finished frame is available from GetPpu().GetDisplayBuffer()
+	//
+	// framesToSkip more frames can be run first without drawing them (for fast forward, or when most frames aren't
+	// looked at), which costs a fraction of drawing them.  The stats cover every frame run, and it's only a lag frame
+	// if the game didn't read the controller in any of them.
+	FrameStats RunFrame(uint32_t framesToSkip = 0);
+
+	// RunFrame in pieces, for NESBatch to run several consoles' CPUs itself.  After StartFrame, run the CPU up to
+	// the next scheduled event and call EndCpuRun, until it returns true (the frame is done).  FinishFrame then
+	// returns the frame's stats.
+	void StartFrame(uint32_t framesToSkip = 0);
+	bool EndCpuRun();
+	FrameStats FinishFrame();
+
+	Scheduler& GetScheduler() { return m_scheduler; }
+	InterruptController& GetInterruptController() { return m_interrupts; }
+
+	const NESRom& GetRom() const { return *m_spRom; }
+	const std::shared_ptr<const NESRom>& GetSharedRom() const { return m_spRom; }
+
 	CPU::Cpu6502& GetCpu() { return m_cpu; }
 	PPU::Ppu& GetPpu() { return m_ppu; }
 	APU::IApu& GetApu() { return *m_spApu; }
@@ -49,10 +82,23 @@ public:
 	Controller& UseController1() { return m_controller1; }
 
 private:
+	void DispatchEvents();
+
 	int m_instructionsRan = 0;
 
-	NESRom m_rom;
+	// The frame being run (StartFrame to FinishFrame)
+	uint32_t m_framesLeftToSkip = 0;
+	int64_t m_frameStartCycle = 0;
+	uint64_t m_frameStartInstructionCount = 0;
+	uint64_t m_frameStartFusedCount = 0;
+
+	Scheduler m_scheduler;
+	InterruptController m_interrupts;
+	std::shared_ptr<const NESRom> m_spRom;
 	std::unique_ptr<APU::IApu> m_spApu;
+
+	// Kept next to each other, so the PPU's registers, OAM and page table run straight into the CPU's hot state
+	// (the PPU's nametable RAM and frame buffers are allocated separately)
 	PPU::Ppu m_ppu;
 	CPU::Cpu6502 m_cpu;
 	Controller m_controller1;
@@ -0,0 +1,257 @@
+#include "stdafx.h"
+#include "NESBatch.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace NES
+{
+
+// A group which stops at the same place after fewer instructions than this is looping on a register
+const uint32_t c_maxRegisterLoopInstructions = 8;
+
+// How far consoles looping on a register run alone before seeing if they can run together again (a scanline)
+const int64_t c_registerLoopSliceCycles = 114;
+
+
+NESBatch::NESBatch(IReadableFile* pRomFile, uint32_t consoleCount)
+	: m_lockstep(consoleCount)
+{
+	if (consoleCount == 0)
+		throw std::runtime_error("A batch needs at least one console");
+
+	m_consoles.reserve(consoleCount);
+	for (uint32_t index = 0; index != consoleCount; ++index)
+	{
+		auto spNes = std::make_unique<NES>();
+		spNes->GetApu().EnableSound(false);
+
+		if (index == 0)
+		{
+			spNes->LoadRomFile(pRomFile);
+		}
+		else
+		{
+			// Blocks and CHR ROM tiles are keyed by host address, so they're only shared once both run the same ROM
+			spNes->LoadRom(m_consoles[0]->GetSharedRom());
+			spNes->GetCpu().ShareDecodedBlocks(m_consoles[0]->GetCpu());
+			spNes->GetPpu().ShareChrRomTiles(m_consoles[0]->GetPpu());
+		}
+
+		m_consoles.push_back(std::move(spNes));
+	}
+
+	m_frameStats.resize(consoleCount);
+	m_runTargetCycles.resize(consoleCount);
+	Reset();
+}
+
+
+void NESBatch::Reset()
+{
+	for (const std::unique_ptr<NES>& spNes : m_consoles)
+		spNes->Reset();
+}
+
+
+const std::vector<FrameStats>& NESBatch::RunFrame(uint32_t framesToSkip)
+{
+	if (m_isLockstepEnabled)
+	{
+		RunFrameInLockstep(framesToSkip);
+		return m_frameStats;
+	}
+
+	for (size_t index = 0; index != m_consoles.size(); ++index)
+	{
+		NES& nes = *m_consoles[index];
+		m_frameStats[index] = nes.RunFrame(framesToSkip);
+
+		// Keeps the APU's cycle count from running away, even with nothing to play
+		nes.GetApu().PushAudio();
+	}
+
+	return m_frameStats;
+}
+
+
+// NES::RunFrame for every console at once, with the CPUs run here a step at a time rather than by RunUntil
+void NESBatch::RunFrameInLockstep(uint32_t framesToSkip)
+{
+	m_runningConsoles.clear();
+	for (uint32_t index = 0; index != m_consoles.size(); ++index)
+	{
+		m_consoles[index]->StartFrame(framesToSkip);
+		BeginRun(index);
+		m_runningConsoles.push_back(index);
+	}
+
+	for (;;)
+	{
+		// Consoles which have run as far as RunUntil would have dispatch their events, then either start the next
+		// run or are done with the frame
+		size_t runningCount = 0;
+		for (uint32_t index : m_runningConsoles)
+		{
+			NES& nes = *m_consoles[index];
+			const int64_t cycle = nes.GetCpu().GetElapsedCycles();
+			if (cycle >= m_runTargetCycles[index] || cycle >= nes.GetScheduler().GetNextEventCycle())
+			{
+				if (nes.EndCpuRun())
+				{
+					m_frameStats[index] = nes.FinishFrame();
+					nes.GetApu().PushAudio();
+					continue;
+				}
+
+				BeginRun(index);
+			}
+
+			m_runningConsoles[runningCount++] = index;
+		}
+
+		m_runningConsoles.resize(runningCount);
+		if (m_runningConsoles.empty())
+			break;
+
+		RunStep();
+	}
+}
+
+
+void NESBatch::BeginRun(uint32_t index)
+{
+	NES& nes = *m_consoles[index];
+	nes.GetCpu().BeginRun();
+	m_runTargetCycles[index] = nes.GetScheduler().GetNextEventCycle();
+}
+
+
+// As RunUntil, from where the console's CPU is to targetCycle (at most the end of its run)
+void NESBatch::RunAlone(uint32_t index, int64_t targetCycle)
+{
+	NES& nes = *m_consoles[index];
+	CPU::Cpu6502& cpu = nes.GetCpu();
+	const Scheduler& scheduler = nes.GetScheduler();
+
+	while (cpu.GetElapsedCycles() < targetCycle && cpu.GetElapsedCycles() < scheduler.GetNextEventCycle())
+		cpu.RunStep(targetCycle);
+}
+
+
+// Moves every running console's CPU on by at least one instruction
+void NESBatch::RunStep()
+{
+	// Sort the consoles by PC (then index), so those at the same PC are next to each other
+	m_consolesByPc.clear();
+	for (uint32_t index : m_runningConsoles)
+		m_consolesByPc.push_back((static_cast<uint64_t>(m_consoles[index]->GetCpu().GetProgramCounter()) << 32) | index);
+	std::sort(m_consolesByPc.begin(), m_consolesByPc.end());
+
+	size_t groupStart = 0;
+	while (groupStart != m_consolesByPc.size())
+	{
+		const uint64_t pc = m_consolesByPc[groupStart] >> 32;
+		size_t groupEnd = groupStart + 1;
+		while (groupEnd != m_consolesByPc.size() && (m_consolesByPc[groupEnd] >> 32) == pc)
+			++groupEnd;
+
+		// A console with no company finishes its run alone, rather than paying for grouping at every step.  Consoles
+		// drifting apart mostly only meet up again where they all stopped for an event (e.g. waiting for vblank).
+		if (groupEnd - groupStart == 1)
+		{
+			const uint32_t index = static_cast<uint32_t>(m_consolesByPc[groupStart]);
+			RunAlone(index, m_runTargetCycles[index]);
+			groupStart = groupEnd;
+			continue;
+		}
+
+		m_groupConsoles.clear();
+		m_groupCpus.clear();
+		m_groupTargetCycles.clear();
+		for (size_t position = groupStart; position != groupEnd; ++position)
+		{
+			const uint32_t index = static_cast<uint32_t>(m_consolesByPc[position]);
+			CPU::Cpu6502& cpu = m_consoles[index]->GetCpu();
+			if (CPU::CpuLockstep::CanRun(cpu))
+			{
+				m_groupConsoles.push_back(index);
+				m_groupCpus.push_back(&cpu);
+				m_groupTargetCycles.push_back(m_runTargetCycles[index]);
+			}
+			else
+			{
+				cpu.RunStep(m_runTargetCycles[index]);
+			}
+		}
+
+		if (m_groupCpus.size() >= 2)
+		{
+			RunGroup();
+		}
+		else
+		{
+			for (size_t cpuIndex = 0; cpuIndex != m_groupCpus.size(); ++cpuIndex)
+				m_groupCpus[cpuIndex]->RunStep(m_groupTargetCycles[cpuIndex]);
+		}
+
+		groupStart = groupEnd;
+	}
+}
+
+
+// Runs the group (at least two consoles, which CanRun and are at the same PC) in lockstep for as long as it stays
+// together
+void NESBatch::RunGroup()
+{
+	const uint32_t cpuCount = static_cast<uint32_t>(m_groupCpus.size());
+	int32_t lastStopPc = -1;
+	for (;;)
+	{
+		const uint32_t instructionCount = m_lockstep.Run(m_groupCpus.data(), m_groupTargetCycles.data(), cpuCount);
+		if (!IsGroupTogether())
+			return;
+
+		// Stopping at the same place again after only a few instructions is a loop on a register (e.g. waiting for
+		// sprite 0).  Lockstep gains little there, and taking turns at every iteration means each console's PPU
+		// has to come back into the cache, so they go their own ways for a while.
+		const uint16_t stopPc = m_groupCpus[0]->GetProgramCounter();
+		if (stopPc == lastStopPc && instructionCount < c_maxRegisterLoopInstructions)
+		{
+			for (uint32_t cpuIndex = 0; cpuIndex != cpuCount; ++cpuIndex)
+			{
+				const int64_t sliceEndCycle = m_groupCpus[cpuIndex]->GetElapsedCycles() + c_registerLoopSliceCycles;
+				RunAlone(m_groupConsoles[cpuIndex], std::min(m_groupTargetCycles[cpuIndex], sliceEndCycle));
+			}
+			return;
+		}
+		lastStopPc = stopPc;
+
+		// The run stopped before something it won't run (e.g. a register access), so each takes that step alone,
+		// then they carry on together if they still can
+		for (uint32_t cpuIndex = 0; cpuIndex != cpuCount; ++cpuIndex)
+			m_groupCpus[cpuIndex]->RunStep(m_groupTargetCycles[cpuIndex]);
+
+		if (!IsGroupTogether())
+			return;
+	}
+}
+
+
+// Whether every console in the group is still at the same PC, able to run in lockstep and short of the end of its run
+bool NESBatch::IsGroupTogether() const
+{
+	const uint16_t pc = m_groupCpus[0]->GetProgramCounter();
+	for (size_t cpuIndex = 0; cpuIndex != m_groupCpus.size(); ++cpuIndex)
+	{
+		const CPU::Cpu6502& cpu = *m_groupCpus[cpuIndex];
+		const int64_t cycle = cpu.GetElapsedCycles();
+		if (cpu.GetProgramCounter() != pc || cycle >= m_groupTargetCycles[cpuIndex] ||
+			cycle >= m_consoles[m_groupConsoles[cpuIndex]]->GetScheduler().GetNextEventCycle() || !CPU::CpuLockstep::CanRun(cpu))
+			return false;
+	}
+
+	return true;
+}
+
+}
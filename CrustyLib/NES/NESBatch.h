@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "NES.h"
+#include "CpuLockstep.h"
+
+// A set of consoles all running the same ROM, for running many copies of a game at once (searching inputs,
+// regression runs, and the like) where what matters is the total frames per second rather than any one console.
+//
+// The consoles share everything about the game that never changes: a single copy of the ROM, and the first
+// console's decoded blocks, which the others reuse as soon as they reach the same code.  Each console still has
+// its own RAM, PPU, APU and mapper state, so they can be given different input and drift apart freely.  Sound is
+// off on all of them; turn it back on for one console if it should be heard.
+//
+// By default RunFrame runs the consoles' CPUs together.  Consoles which are at the same PC run the shared code in
+// lockstep through CpuLockstep, with their registers side by side so each instruction is decoded once for all of
+// them.  Anything CpuLockstep won't run takes its own step as NES::RunFrame would, and a console alone at its PC
+// runs on by itself to its next event.  Each console dispatches its own events (vblank, APU IRQs, DMA) as its CPU
+// reaches them.  With lockstep off, RunFrame instead steps the consoles a frame at a time in turn, so whatever
+// code and data one console warmed up in the cache is still there for the next.  Either way every console runs
+// exactly as it would alone.
+
+namespace NES
+{
+
+class NESBatch
+{
+public:
+	NESBatch(IReadableFile* pRomFile, uint32_t consoleCount);
+
+	NESBatch(const NESBatch&) = delete;
+	NESBatch& operator=(const NESBatch&) = delete;
+
+	uint32_t GetConsoleCount() const { return static_cast<uint32_t>(m_consoles.size()); }
+	NES& GetConsole(uint32_t index) { return *m_consoles[index]; }
+
+	void Reset();
+
+	// Runs every console on to its next vblank, returning each one's stats by console index.  framesToSkip is as
+	// for NES::RunFrame.
+	const std::vector<FrameStats>& RunFrame(uint32_t framesToSkip = 0);
+
+	void EnableLockstep(bool isEnabled) { m_isLockstepEnabled = isEnabled; }
+	bool IsLockstepEnabled() const { return m_isLockstepEnabled; }
+
+private:
+	void RunFrameInLockstep(uint32_t framesToSkip);
+	void BeginRun(uint32_t index);
+	void RunStep();
+	void RunAlone(uint32_t index, int64_t targetCycle);
+	void RunGroup();
+	bool IsGroupTogether() const;
+
+	std::vector<std::unique_ptr<NES>> m_consoles;
+	std::vector<FrameStats> m_frameStats;
+
+	bool m_isLockstepEnabled = true;
+	CPU::CpuLockstep m_lockstep;
+
+	// RunFrameInLockstep's state, by console index
+	std::vector<int64_t> m_runTargetCycles; // Where the CPU's current run (as in one RunUntil) stops
+	std::vector<uint32_t> m_runningConsoles; // Consoles still running the frame
+
+	// Scratch for grouping the consoles by PC, and the group being run
+	std::vector<uint64_t> m_consolesByPc;
+	std::vector<CPU::Cpu6502*> m_groupCpus;
+	std::vector<int64_t> m_groupTargetCycles;
+	std::vector<uint32_t> m_groupConsoles;
+};
+
+}
@@ -0,0 +1,473 @@
+#include "stdafx.h"
+#include "NativeBlockCompiler.h"
+
+#ifdef CPU_NATIVE_BLOCKS
+
+#include "Cpu6502.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace CPU
+{
+
+const uint32_t c_cbNativeCodeBuffer = 4 * 1024 * 1024;
+const uint32_t c_nativeCodeAlignment = 16;
+
+
+NativeCodeBuffer::NativeCodeBuffer()
+{
+#ifdef _WIN32
+	m_pMemory = static_cast<uint8_t*>(VirtualAlloc(nullptr, c_cbNativeCodeBuffer, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READ));
+	if (m_pMemory == nullptr)
+		throw std::runtime_error("Couldn't allocate memory for native code");
+#else
+	void* pMemory = mmap(nullptr, c_cbNativeCodeBuffer, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pMemory == MAP_FAILED)
+		throw std::runtime_error("Couldn't allocate memory for native code");
+	m_pMemory = static_cast<uint8_t*>(pMemory);
+#endif
+}
+
+
+NativeCodeBuffer::~NativeCodeBuffer()
+{
+#ifdef _WIN32
+	VirtualFree(m_pMemory, 0, MEM_RELEASE);
+#else
+	munmap(m_pMemory, c_cbNativeCodeBuffer);
+#endif
+}
+
+
+void NativeCodeBuffer::SetWritable(bool isWritable)
+{
+#ifdef _WIN32
+	DWORD oldProtection;
+	if (!VirtualProtect(m_pMemory, c_cbNativeCodeBuffer, isWritable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &oldProtection))
+		throw std::runtime_error("Couldn't change the protection of native code");
+#else
+	if (mprotect(m_pMemory, c_cbNativeCodeBuffer, isWritable ? (PROT_READ | PROT_WRITE) : (PROT_READ | PROT_EXEC)) != 0)
+		throw std::runtime_error("Couldn't change the protection of native code");
+#endif
+}
+
+
+const void* NativeCodeBuffer::Add(const uint8_t* pCode, uint32_t cbCode)
+{
+	if (cbCode > c_cbNativeCodeBuffer - m_cbUsed)
+		return nullptr;
+
+	uint8_t* pDest = m_pMemory + m_cbUsed;
+
+	SetWritable(true);
+	memcpy(pDest, pCode, cbCode);
+	SetWritable(false);
+
+#ifdef _WIN32
+	FlushInstructionCache(GetCurrentProcess(), pDest, cbCode);
+#endif
+
+	m_cbUsed = std::min(c_cbNativeCodeBuffer, (m_cbUsed + cbCode + c_nativeCodeAlignment - 1) & ~(c_nativeCodeAlignment - 1));
+	return pDest;
+}
+
+
+/*----- x86-64 code generation
+
+ Generated code keeps the Cpu6502 pointer in rbx, and works on the registers in place ([rbx + offset of the
+ member]).  The cycles and instruction count of translated instructions are added up as we go, and only written
+ out (along with the PC) before calling a handler or leaving the block.  -----*/
+
+namespace
+{
+
+// ModRM reg field values
+const uint8_t c_regEax = 0;
+const uint8_t c_regDl = 2;
+
+// Opcode extensions for the 0x80 group (op r/m8, imm8)
+const uint8_t c_aluOr = 1;
+const uint8_t c_aluAnd = 4;
+const uint8_t c_aluXor = 6;
+
+// Condition codes for Jcc
+const uint8_t c_conditionZero = 0x4;
+const uint8_t c_conditionNotZero = 0x5;
+
+class X64Emitter
+{
+public:
+	const std::vector<uint8_t>& GetCode() const { return m_code; }
+
+	void Byte(uint8_t value) { m_code.push_back(value); }
+	void Word(uint16_t value) { Byte(static_cast<uint8_t>(value)); Byte(static_cast<uint8_t>(value >> 8)); }
+	void Dword(uint32_t value) { Word(static_cast<uint16_t>(value)); Word(static_cast<uint16_t>(value >> 16)); }
+	void Qword(uint64_t value) { Dword(static_cast<uint32_t>(value)); Dword(static_cast<uint32_t>(value >> 32)); }
+
+	// [rbx + displacement], with reg (or an opcode extension) in the ModRM reg field
+	void RbxOperand(uint8_t reg, int32_t displacement)
+	{
+		Byte(static_cast<uint8_t>(0x80 | (reg << 3) | 0x3));
+		Dword(static_cast<uint32_t>(displacement));
+	}
+
+	void MovzxEaxFromByte(int32_t displacement) { Byte(0x0F); Byte(0xB6); RbxOperand(c_regEax, displacement); }
+	void StoreAl(int32_t displacement) { Byte(0x88); RbxOperand(c_regEax, displacement); }
+	void StoreByte(int32_t displacement, uint8_t value) { Byte(0xC6); RbxOperand(0, displacement); Byte(value); }
+	void StoreWord(int32_t displacement, uint16_t value) { Byte(0x66); Byte(0xC7); RbxOperand(0, displacement); Word(value); }
+	void AddToQword(int32_t displacement, uint32_t value) { Byte(0x48); Byte(0x81); RbxOperand(0, displacement); Dword(value); }
+	void AluByte(uint8_t aluOp, int32_t displacement, uint8_t value) { Byte(0x80); RbxOperand(aluOp, displacement); Byte(value); }
+	void IncByte(int32_t displacement) { Byte(0xFE); RbxOperand(0, displacement); }
+	void DecByte(int32_t displacement) { Byte(0xFE); RbxOperand(1, displacement); }
+	void OrDlIntoByte(int32_t displacement) { Byte(0x08); RbxOperand(c_regDl, displacement); }
+	void TestByte(int32_t displacement, uint8_t value) { Byte(0xF6); RbxOperand(0, displacement); Byte(value); }
+
+	void CmpAl(uint8_t value) { Byte(0x3C); Byte(value); }
+	void SubAl(uint8_t value) { Byte(0x2C); Byte(value); }
+	void SetaeDl() { Byte(0x0F); Byte(0x93); Byte(0xC2); }
+	void TestAlAl() { Byte(0x84); Byte(0xC0); }
+	void MovEax(uint32_t value) { Byte(0xB8); Dword(value); }
+
+	// Jumps to a label bound later, returning the rel32 to patch
+	size_t Jcc(uint8_t condition) { Byte(0x0F); Byte(static_cast<uint8_t>(0x80 | condition)); return Rel32(); }
+	size_t Jmp() { Byte(0xE9); return Rel32(); }
+
+	void Bind(size_t rel32Offset)
+	{
+		const uint32_t rel = static_cast<uint32_t>(m_code.size() - (rel32Offset + 4));
+		for (size_t iByte = 0; iByte != 4; ++iByte)
+			m_code[rel32Offset + iByte] = static_cast<uint8_t>(rel >> (iByte * 8));
+	}
+
+	void Prologue()
+	{
+		Byte(0x53); // push rbx
+#ifdef _WIN32
+		Byte(0x48); Byte(0x83); Byte(0xEC); Byte(0x20); // sub rsp, 32 (shadow space for the calls we make)
+		Byte(0x48); Byte(0x89); Byte(0xCB);             // mov rbx, rcx
+#else
+		Byte(0x48); Byte(0x89); Byte(0xFB);             // mov rbx, rdi
+#endif
+	}
+
+	void Epilogue()
+	{
+#ifdef _WIN32
+		Byte(0x48); Byte(0x83); Byte(0xC4); Byte(0x20); // add rsp, 32
+#endif
+		Byte(0x5B); // pop rbx
+		Byte(0xC3); // ret
+	}
+
+	// Calls pfn(rbx, arg1, arg2)
+	void Call(const void* pfn, uint32_t arg1, uint32_t arg2)
+	{
+#ifdef _WIN32
+		Byte(0x48); Byte(0x89); Byte(0xD9);     // mov rcx, rbx
+		Byte(0xBA); Dword(arg1);                // mov edx, arg1
+		Byte(0x41); Byte(0xB8); Dword(arg2);    // mov r8d, arg2
+#else
+		Byte(0x48); Byte(0x89); Byte(0xDF);     // mov rdi, rbx
+		Byte(0xBE); Dword(arg1);                // mov esi, arg1
+		Byte(0xBA); Dword(arg2);                // mov edx, arg2
+#endif
+		Byte(0x48); Byte(0xB8); Qword(reinterpret_cast<uint64_t>(pfn)); // mov rax, pfn
+		Byte(0xFF); Byte(0xD0);                                        // call rax
+	}
+
+private:
+	size_t Rel32()
+	{
+		const size_t offset = m_code.size();
+		Dword(0);
+		return offset;
+	}
+
+	std::vector<uint8_t> m_code;
+};
+
+}
+
+
+// Offsets of the CPU's state from the Cpu6502 pointer, which is all generated code needs to know about the class
+struct NativeCpuLayout
+{
+	explicit NativeCpuLayout(const Cpu6502& cpu)
+		: pc(OffsetOf(cpu, &cpu.m_pc))
+		, sp(OffsetOf(cpu, &cpu.m_sp))
+		, acc(OffsetOf(cpu, &cpu.m_acc))
+		, x(OffsetOf(cpu, &cpu.m_x))
+		, y(OffsetOf(cpu, &cpu.m_y))
+		, status(OffsetOf(cpu, &cpu.m_status))
+		, negativeResult(OffsetOf(cpu, &cpu.m_negativeResult))
+		, zeroResult(OffsetOf(cpu, &cpu.m_zeroResult))
+		, totalCycles(OffsetOf(cpu, &cpu.m_totalCycles))
+		, instructionCount(OffsetOf(cpu, &cpu.m_instructionCount))
+		, cpuRam(OffsetOf(cpu, cpu.m_cpuRam))
+		, openBus(OffsetOf(cpu, cpu.m_memoryMap.GetOpenBusAddress()))
+	{
+	}
+
+	static int32_t OffsetOf(const Cpu6502& cpu, const void* pMember)
+	{
+		return static_cast<int32_t>(static_cast<const uint8_t*>(pMember) - reinterpret_cast<const uint8_t*>(&cpu));
+	}
+
+	int32_t pc, sp, acc, x, y, status, negativeResult, zeroResult, totalCycles, instructionCount, cpuRam, openBus;
+};
+
+
+class NativeBlockEmitter
+{
+public:
+	explicit NativeBlockEmitter(const Cpu6502& cpu)
+		: m_layout(cpu)
+	{
+	}
+
+	const std::vector<uint8_t>& GetCode() const { return m_x64.GetCode(); }
+
+	void Emit(const NativeInstruction* pInstructions, uint32_t instructionCount, uint32_t maxCycles);
+
+private:
+	bool EmitTranslated(const NativeInstruction& instruction);
+	bool EmitBlockEnd(const NativeInstruction& instruction);
+	void EmitCall(const NativeInstruction& instruction, uint32_t remainingMaxCycles);
+
+	void SetNZFromAl() { m_x64.StoreAl(m_layout.negativeResult); m_x64.StoreAl(m_layout.zeroResult); }
+	void SetOpenBus(uint8_t value) { m_x64.StoreByte(m_layout.openBus, value); }
+	void CommitPending(uint16_t pc);
+	void StorePc(uint16_t pc) { m_x64.StoreWord(m_layout.pc, pc); }
+	void Leave(uint16_t instructionPc) { m_x64.MovEax(instructionPc); m_epilogueJumps.push_back(m_x64.Jmp()); }
+
+	const NativeCpuLayout m_layout;
+	X64Emitter m_x64;
+	std::vector<size_t> m_epilogueJumps;
+
+	// Translated instructions not yet written out to m_totalCycles/m_instructionCount/m_pc
+	uint32_t m_pendingCycles = 0;
+	uint32_t m_pendingInstructions = 0;
+	bool m_isPcStale = false;
+};
+
+
+void NativeBlockEmitter::Emit(const NativeInstruction* pInstructions, uint32_t instructionCount, uint32_t maxCycles)
+{
+	m_x64.Prologue();
+
+	uint32_t remainingMaxCycles = maxCycles;
+	bool hasLeft = false;
+	for (uint32_t iInstruction = 0; iInstruction != instructionCount && !hasLeft; ++iInstruction)
+	{
+		const NativeInstruction& instruction = pInstructions[iInstruction];
+		remainingMaxCycles -= instruction.baseCycles + NativeBlockCompiler::c_maxExtraCycles;
+
+		if (EmitBlockEnd(instruction))
+		{
+			hasLeft = true;
+		}
+		else if (EmitTranslated(instruction))
+		{
+			m_pendingCycles += instruction.baseCycles;
+			m_pendingInstructions++;
+			m_isPcStale = true;
+		}
+		else
+		{
+			EmitCall(instruction, remainingMaxCycles);
+		}
+	}
+
+	if (!hasLeft)
+	{
+		// Ran off the end of the block (the page, the instruction limit, or something only the interpreter runs)
+		const NativeInstruction& lastInstruction = pInstructions[instructionCount - 1];
+		CommitPending(static_cast<uint16_t>(lastInstruction.pc + lastInstruction.length));
+		Leave(lastInstruction.pc);
+	}
+
+	for (size_t jump : m_epilogueJumps)
+		m_x64.Bind(jump);
+	m_x64.Epilogue();
+}
+
+
+// Writes out the translated instructions run since the last call, with pc as the PC if they've moved it
+void NativeBlockEmitter::CommitPending(uint16_t pc)
+{
+	if (m_pendingCycles != 0)
+	{
+		m_x64.AddToQword(m_layout.totalCycles, m_pendingCycles);
+		m_x64.AddToQword(m_layout.instructionCount, m_pendingInstructions);
+		m_pendingCycles = 0;
+		m_pendingInstructions = 0;
+	}
+
+	if (m_isPcStale)
+	{
+		StorePc(pc);
+		m_isPcStale = false;
+	}
+}
+
+
+void NativeBlockEmitter::EmitCall(const NativeInstruction& instruction, uint32_t remainingMaxCycles)
+{
+	// Everything before this instruction has to be written out, as the handler (or whatever it calls) can look at it
+	CommitPending(instruction.pc);
+
+	m_x64.Call(reinterpret_cast<const void*>(&Cpu6502::RunNativeCalledInstruction), instruction.opCode, remainingMaxCycles);
+
+	// Returns true if the block has to stop here; the handler has left m_pc where it should be
+	m_x64.TestAlAl();
+	const size_t continueJump = m_x64.Jcc(c_conditionZero);
+	Leave(instruction.pc);
+	m_x64.Bind(continueJump);
+}
+
+
+bool NativeBlockEmitter::EmitTranslated(const NativeInstruction& instruction)
+{
+	const NativeCpuLayout& l = m_layout;
+	const uint8_t operand = instruction.operands[0];
+
+	switch (instruction.opCode)
+	{
+	// Loads and logic with an immediate operand
+	case 0xA9: /*LDA*/ m_x64.StoreByte(l.acc, operand); m_x64.StoreByte(l.negativeResult, operand); m_x64.StoreByte(l.zeroResult, operand); break;
+	case 0xA2: /*LDX*/ m_x64.StoreByte(l.x, operand); m_x64.StoreByte(l.negativeResult, operand); m_x64.StoreByte(l.zeroResult, operand); break;
+	case 0xA0: /*LDY*/ m_x64.StoreByte(l.y, operand); m_x64.StoreByte(l.negativeResult, operand); m_x64.StoreByte(l.zeroResult, operand); break;
+	case 0x29: /*AND*/ m_x64.AluByte(c_aluAnd, l.acc, operand); m_x64.MovzxEaxFromByte(l.acc); SetNZFromAl(); break;
+	case 0x09: /*ORA*/ m_x64.AluByte(c_aluOr, l.acc, operand); m_x64.MovzxEaxFromByte(l.acc); SetNZFromAl(); break;
+	case 0x49: /*EOR*/ m_x64.AluByte(c_aluXor, l.acc, operand); m_x64.MovzxEaxFromByte(l.acc); SetNZFromAl(); break;
+
+	// Compares with an immediate operand: N/Z from the difference, C if there was no borrow
+	case 0xC9: /*CMP*/
+	case 0xE0: /*CPX*/
+	case 0xC0: /*CPY*/
+		m_x64.MovzxEaxFromByte((instruction.opCode == 0xC9) ? l.acc : (instruction.opCode == 0xE0) ? l.x : l.y);
+		m_x64.CmpAl(operand);
+		m_x64.SetaeDl();
+		m_x64.SubAl(operand);
+		SetNZFromAl();
+		m_x64.AluByte(c_aluAnd, l.status, static_cast<uint8_t>(~static_cast<uint8_t>(CpuStatusFlag::Carry)));
+		m_x64.OrDlIntoByte(l.status);
+		break;
+
+	// Zero page is always CPU RAM
+	case 0xA5: /*LDA*/ m_x64.MovzxEaxFromByte(l.cpuRam + operand); m_x64.StoreAl(l.acc); SetNZFromAl(); m_x64.StoreAl(l.openBus); return true;
+	case 0xA6: /*LDX*/ m_x64.MovzxEaxFromByte(l.cpuRam + operand); m_x64.StoreAl(l.x); SetNZFromAl(); m_x64.StoreAl(l.openBus); return true;
+	case 0xA4: /*LDY*/ m_x64.MovzxEaxFromByte(l.cpuRam + operand); m_x64.StoreAl(l.y); SetNZFromAl(); m_x64.StoreAl(l.openBus); return true;
+	case 0x85: /*STA*/ m_x64.MovzxEaxFromByte(l.acc); m_x64.StoreAl(l.cpuRam + operand); m_x64.StoreAl(l.openBus); return true;
+	case 0x86: /*STX*/ m_x64.MovzxEaxFromByte(l.x); m_x64.StoreAl(l.cpuRam + operand); m_x64.StoreAl(l.openBus); return true;
+	case 0x84: /*STY*/ m_x64.MovzxEaxFromByte(l.y); m_x64.StoreAl(l.cpuRam + operand); m_x64.StoreAl(l.openBus); return true;
+
+	// Register only
+	case 0xAA: /*TAX*/ m_x64.MovzxEaxFromByte(l.acc); m_x64.StoreAl(l.x); SetNZFromAl(); return true;
+	case 0x8A: /*TXA*/ m_x64.MovzxEaxFromByte(l.x); m_x64.StoreAl(l.acc); SetNZFromAl(); return true;
+	case 0xA8: /*TAY*/ m_x64.MovzxEaxFromByte(l.acc); m_x64.StoreAl(l.y); SetNZFromAl(); return true;
+	case 0x98: /*TYA*/ m_x64.MovzxEaxFromByte(l.y); m_x64.StoreAl(l.acc); SetNZFromAl(); return true;
+	case 0xBA: /*TSX*/ m_x64.MovzxEaxFromByte(l.sp); m_x64.StoreAl(l.x); SetNZFromAl(); return true;
+	case 0x9A: /*TXS*/ m_x64.MovzxEaxFromByte(l.x); m_x64.StoreAl(l.sp); return true;
+	case 0xE8: /*INX*/ m_x64.IncByte(l.x); m_x64.MovzxEaxFromByte(l.x); SetNZFromAl(); return true;
+	case 0xCA: /*DEX*/ m_x64.DecByte(l.x); m_x64.MovzxEaxFromByte(l.x); SetNZFromAl(); return true;
+	case 0xC8: /*INY*/ m_x64.IncByte(l.y); m_x64.MovzxEaxFromByte(l.y); SetNZFromAl(); return true;
+	case 0x88: /*DEY*/ m_x64.DecByte(l.y); m_x64.MovzxEaxFromByte(l.y); SetNZFromAl(); return true;
+	case 0x18: /*CLC*/ m_x64.AluByte(c_aluAnd, l.status, static_cast<uint8_t>(~static_cast<uint8_t>(CpuStatusFlag::Carry))); return true;
+	case 0x38: /*SEC*/ m_x64.AluByte(c_aluOr, l.status, static_cast<uint8_t>(CpuStatusFlag::Carry)); return true;
+	case 0xB8: /*CLV*/ m_x64.AluByte(c_aluAnd, l.status, static_cast<uint8_t>(~static_cast<uint8_t>(CpuStatusFlag::Overflow))); return true;
+	case 0xEA: /*NOP*/ return true;
+
+	default:
+		return false;
+	}
+
+	// The immediate operand was the last thing read
+	SetOpenBus(operand);
+	return true;
+}
+
+
+bool NativeBlockEmitter::EmitBlockEnd(const NativeInstruction& instruction)
+{
+	const NativeCpuLayout& l = m_layout;
+	const uint16_t nextPc = static_cast<uint16_t>(instruction.pc + instruction.length);
+
+	if (instruction.opCode == 0x4C /*JMP*/)
+	{
+		m_pendingCycles += instruction.baseCycles;
+		m_pendingInstructions++;
+		m_isPcStale = false; // Set below
+		CommitPending(nextPc);
+
+		SetOpenBus(instruction.operands[1]);
+		StorePc(static_cast<uint16_t>((instruction.operands[1] << 8) | instruction.operands[0]));
+		Leave(instruction.pc);
+		return true;
+	}
+
+	// Branches are xxy10000, where xx picks the flag and y the value to branch on
+	if ((instruction.opCode & 0x1F) != 0x10)
+		return false;
+
+	m_pendingCycles += instruction.baseCycles;
+	m_pendingInstructions++;
+	m_isPcStale = false; // Set below, depending on the branch
+	CommitPending(nextPc);
+
+	SetOpenBus(instruction.operands[0]);
+
+	const bool branchIfSet = (instruction.opCode & 0x20) != 0;
+	switch (instruction.opCode >> 6)
+	{
+	case 0: m_x64.TestByte(l.negativeResult, static_cast<uint8_t>(CpuStatusFlag::Negative)); break;
+	case 1: m_x64.TestByte(l.status, static_cast<uint8_t>(CpuStatusFlag::Overflow)); break;
+	case 2: m_x64.TestByte(l.status, static_cast<uint8_t>(CpuStatusFlag::Carry)); break;
+	default: m_x64.TestByte(l.zeroResult, 0xFF); break; // Z is set when the result is zero
+	}
+
+	const bool isZeroFlag = (instruction.opCode >> 6) == 3;
+	const bool takenIfNonZero = isZeroFlag ? !branchIfSet : branchIfSet;
+	const size_t takenJump = m_x64.Jcc(takenIfNonZero ? c_conditionNotZero : c_conditionZero);
+
+	StorePc(nextPc);
+	Leave(instruction.pc);
+
+	// Same page crossing test as Helper_ExecuteBranch
+	const int8_t relativeOffset = static_cast<int8_t>(instruction.operands[0]);
+	const bool crossesPage = (nextPc + relativeOffset) >> 8 != nextPc >> 8;
+
+	m_x64.Bind(takenJump);
+	m_x64.AddToQword(l.totalCycles, crossesPage ? 2 : 1);
+	StorePc(static_cast<uint16_t>(nextPc + relativeOffset));
+	Leave(instruction.pc);
+	return true;
+}
+
+
+NativeBlockFunc NativeBlockCompiler::Compile(const Cpu6502& cpu, const NativeInstruction* pInstructions, uint32_t instructionCount,
+	NativeCodeBuffer& buffer, uint32_t* pMaxCycles)
+{
+	uint32_t maxCycles = 0;
+	for (uint32_t iInstruction = 0; iInstruction != instructionCount; ++iInstruction)
+		maxCycles += pInstructions[iInstruction].baseCycles + c_maxExtraCycles;
+
+	NativeBlockEmitter emitter(cpu);
+	emitter.Emit(pInstructions, instructionCount, maxCycles);
+
+	const std::vector<uint8_t>& code = emitter.GetCode();
+	const void* pNativeCode = buffer.Add(code.data(), static_cast<uint32_t>(code.size()));
+
+	*pMaxCycles = maxCycles;
+	return reinterpret_cast<NativeBlockFunc>(const_cast<void*>(pNativeCode));
+}
+
+}
+
+#endif
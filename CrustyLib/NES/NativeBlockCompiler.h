@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+
+// Translates hot blocks of PRG ROM code to x86-64, for CpuBackend::Native.
+//
+// The blocks are the same straight runs of code DecodedBlockCache holds, and the native code for one lives
+// alongside its decoded block.  Instructions which only touch registers, flags and zero page (always CPU RAM)
+// are translated directly, as is the branch or JMP ending the block.  Everything else (other memory accesses,
+// which may be I/O, stack and flow control) calls the instruction's usual handler.  After each call the block
+// exits back to RunUntil wherever RunBlock would have stopped: at the target cycle or next event, when an
+// interrupt is due, or when the memory map changed (a bank switch).  Translated instructions can't cause any of
+// those, so they don't check; RunNativeBlock only enters a block when all of it fits before the target.
+//
+// Only built for x86-64 desktop targets.  UWP apps can't allocate executable memory, and other CPUs (x86, ARM)
+// stay on the decoded blocks.
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(_M_ARM64EC) && !(defined(WINAPI_FAMILY) && (WINAPI_FAMILY == WINAPI_FAMILY_APP))
+#define CPU_NATIVE_BLOCKS
+#endif
+
+#ifdef CPU_NATIVE_BLOCKS
+
+namespace CPU
+{
+
+class Cpu6502;
+
+// Runs a compiled block, returning the PC of the last instruction started (as Cpu6502::RunBlock does)
+typedef uint16_t (*NativeBlockFunc)(Cpu6502* pCpu);
+
+// Executable memory for compiled blocks.  Pages are only writable while new code is copied in.
+class NativeCodeBuffer
+{
+public:
+	NativeCodeBuffer();
+	~NativeCodeBuffer();
+
+	NativeCodeBuffer(const NativeCodeBuffer&) = delete;
+	NativeCodeBuffer& operator=(const NativeCodeBuffer&) = delete;
+
+	// Returns where the code will run from, or null if the buffer is full
+	const void* Add(const uint8_t* pCode, uint32_t cbCode);
+
+private:
+	void SetWritable(bool isWritable);
+
+	uint8_t* m_pMemory = nullptr;
+	uint32_t m_cbUsed = 0;
+};
+
+struct NativeInstruction
+{
+	uint16_t pc;
+	uint8_t opCode;
+	uint8_t operands[2]; // Only as many as the instruction has
+	uint8_t length;
+	uint16_t baseCycles;
+};
+
+class NativeBlockCompiler
+{
+public:
+	// Most cycles any one instruction can take: its base cycles, plus a taken branch to another page
+	static const uint32_t c_maxExtraCycles = 2;
+
+	// Compiles instructions (a block, in order) into buffer.  *pMaxCycles is set to the most cycles the block can
+	// take, not counting anything the called handlers add (DMA, etc.).  Returns null if the buffer is full.
+	static NativeBlockFunc Compile(const Cpu6502& cpu, const NativeInstruction* pInstructions, uint32_t instructionCount,
+		NativeCodeBuffer& buffer, uint32_t* pMaxCycles);
+};
+
+}
+
+#endif
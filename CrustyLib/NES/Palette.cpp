@@ -0,0 +1,190 @@
+#include "stdafx.h"
+#include "Palette.h"
+#include "Ppu.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define PPU_PALETTE_SSSE3
+#include <tmmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PPU_TARGET_SSSE3
+#else
+#define PPU_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
+namespace PPU
+{
+
+// Color table mapping the NES's color table to RGB values
+static const uint32_t c_nesRgbColorTable[c_nesColorCount] = {
+	0x808080, 0x003DA6, 0x0012B0, 0x440096,
+	0xA1005E, 0xC70028, 0xBA0600, 0x8C1700,
+	0x5C2F00, 0x104500, 0x054A00, 0x00472E,
+	0x004166, 0x000000, 0x050505, 0x050505,
+	0xC7C7C7, 0x0077FF, 0x2155FF, 0x8237FA,
+	0xEB2FB5, 0xFF2950, 0xFF2200, 0xD63200,
+	0xC46200, 0x358000, 0x058F00, 0x008A55,
+	0x0099CC, 0x212121, 0x090909, 0x090909,
+	0xFFFFFF, 0x0FD7FF, 0x69A2FF, 0xD480FF,
+	0xFF45F3, 0xFF618B, 0xFF8833, 0xFF9C12,
+	0xFABC20, 0x9FE30E, 0x2BF035, 0x0CF0A4,
+	0x05FBFF, 0x5E5E5E, 0x0D0D0D, 0x0D0D0D,
+	0xFFFFFF, 0xA6FCFF, 0xB3ECFF, 0xDAABEB,
+	0xFFA8F9, 0xFFABB3, 0xFFD2B0, 0xFFEFA6,
+	0xFFF79C, 0xD7E895, 0xA6EDAF, 0xA2F2DA,
+	0x99FFFC, 0xDDDDDD, 0x111111, 0x111111,
+};
+
+// How much emphasis dims the other channels (roughly what an NTSC PPU does)
+const uint32_t c_emphasisDimmingNumerator = 209;
+const uint32_t c_emphasisDimmingDenominator = 256;
+
+
+Palette::Palette(const uint32_t (&baseColors)[c_nesColorCount])
+{
+	// Where each channel sits in 0x00RRGGBB, in emphasis bit order (red, green, blue)
+	const uint32_t c_channelShifts[3] = { 16, 8, 0 };
+
+	for (uint32_t emphasis = 0; emphasis != c_emphasisSettings; ++emphasis)
+	{
+		for (uint32_t color = 0; color != c_nesColorCount; ++color)
+		{
+			uint32_t rgb = baseColors[color];
+			if (emphasis != 0)
+			{
+				for (uint32_t channel = 0; channel != 3; ++channel)
+				{
+					if (emphasis & (1 << channel))
+						continue;
+
+					const uint32_t shift = c_channelShifts[channel];
+					const uint32_t value = (rgb >> shift) & 0xFF;
+					rgb = (rgb & ~(0xFF << shift)) | ((value * c_emphasisDimmingNumerator / c_emphasisDimmingDenominator) << shift);
+				}
+			}
+
+			m_colors[emphasis][color] = rgb;
+		}
+	}
+
+	SplitColorBytes();
+}
+
+
+Palette::Palette(const uint32_t (&colors)[c_emphasisSettings][c_nesColorCount])
+{
+	for (uint32_t emphasis = 0; emphasis != c_emphasisSettings; ++emphasis)
+	{
+		for (uint32_t color = 0; color != c_nesColorCount; ++color)
+			m_colors[emphasis][color] = colors[emphasis][color];
+	}
+
+	SplitColorBytes();
+}
+
+
+const Palette& Palette::GetDefault()
+{
+	static const Palette s_defaultPalette(c_nesRgbColorTable);
+	return s_defaultPalette;
+}
+
+
+void Palette::SplitColorBytes()
+{
+	for (uint32_t emphasis = 0; emphasis != c_emphasisSettings; ++emphasis)
+	{
+		for (uint32_t iByte = 0; iByte != 4; ++iByte)
+		{
+			for (uint32_t color = 0; color != c_nesColorCount; ++color)
+				m_colorBytes[emphasis][iByte][color] = static_cast<uint8_t>(m_colors[emphasis][color] >> (iByte * 8));
+		}
+	}
+}
+
+
+#ifdef PPU_PALETTE_SSSE3
+
+static bool IsSsse3Supported()
+{
+#ifdef _MSC_VER
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 1);
+	return (cpuInfo[2] & (1 << 9)) != 0;
+#else
+	return __builtin_cpu_supports("ssse3") != 0;
+#endif
+}
+
+// A 64 entry lookup, as four 16 entry byte shuffles per byte of output
+PPU_TARGET_SSSE3 static void ConvertScanlineSsse3(const uint8_t* pIndices, const uint8_t (&colorBytes)[4][c_nesColorCount], uint32_t* pPixels)
+{
+	const int c_colorGroups = c_nesColorCount / 16;
+
+	__m128i tables[4][c_colorGroups];
+	for (int iByte = 0; iByte != 4; ++iByte)
+	{
+		for (int iGroup = 0; iGroup != c_colorGroups; ++iGroup)
+			tables[iByte][iGroup] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&colorBytes[iByte][iGroup * 16]));
+	}
+
+	const __m128i selectBias = _mm_set1_epi8(0x70);
+
+	for (int iPixel = 0; iPixel != c_displayWidth; iPixel += 16)
+	{
+		const __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIndices + iPixel));
+
+		__m128i bytes[4] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+		for (int iGroup = 0; iGroup != c_colorGroups; ++iGroup)
+		{
+			// A shuffle zeroes lanes with the top bit set, and otherwise only looks at the low four bits.  Colors in
+			// this group come out as 0x70-0x7F, and colors in any other group as 0x80 or more.
+			const __m128i select = _mm_add_epi8(_mm_xor_si128(indices, _mm_set1_epi8(static_cast<char>(iGroup << 4))), selectBias);
+
+			for (int iByte = 0; iByte != 4; ++iByte)
+				bytes[iByte] = _mm_or_si128(bytes[iByte], _mm_shuffle_epi8(tables[iByte][iGroup], select));
+		}
+
+		// Interleave the bytes back into pixels
+		const __m128i low01 = _mm_unpacklo_epi8(bytes[0], bytes[1]);
+		const __m128i high01 = _mm_unpackhi_epi8(bytes[0], bytes[1]);
+		const __m128i low23 = _mm_unpacklo_epi8(bytes[2], bytes[3]);
+		const __m128i high23 = _mm_unpackhi_epi8(bytes[2], bytes[3]);
+
+		__m128i* pOutput = reinterpret_cast<__m128i*>(pPixels + iPixel);
+		_mm_storeu_si128(pOutput + 0, _mm_unpacklo_epi16(low01, low23));
+		_mm_storeu_si128(pOutput + 1, _mm_unpackhi_epi16(low01, low23));
+		_mm_storeu_si128(pOutput + 2, _mm_unpacklo_epi16(high01, high23));
+		_mm_storeu_si128(pOutput + 3, _mm_unpackhi_epi16(high01, high23));
+	}
+}
+
+#endif
+
+
+void Palette::ConvertScanline(const uint8_t* pIndices, uint8_t emphasis, uint32_t* pPixels) const
+{
+#ifdef PPU_PALETTE_SSSE3
+	static const bool s_isSsse3Supported = IsSsse3Supported();
+	if (s_isSsse3Supported)
+	{
+		ConvertScanlineSsse3(pIndices, m_colorBytes[emphasis], pPixels);
+		return;
+	}
+#endif
+
+	const uint32_t* pColors = m_colors[emphasis];
+	for (int iPixel = 0; iPixel != c_displayWidth; ++iPixel)
+		pPixels[iPixel] = pColors[pIndices[iPixel]];
+}
+
+
+void Palette::ConvertFrame(const uint8_t* pIndices, const uint8_t* pScanlineEmphasis, uint32_t* pPixels, size_t pixelsPerRow) const
+{
+	for (int scanline = 0; scanline != c_displayHeight; ++scanline)
+		ConvertScanline(pIndices + scanline * c_displayWidth, pScanlineEmphasis[scanline], pPixels + scanline * pixelsPerRow);
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Turns the PPU's frames of NES color indices into 32-bit pixels.
+//
+// The PPU stores each pixel as the 6-bit color it picked out of palette RAM, and the color emphasis bits ($2001
+// bits 5-7) once per scanline, since they can only change between scanlines.  A Palette holds the 32-bit pixel
+// for every color under every emphasis setting, in whatever format the consumer wants, so a finished frame can be
+// shown (or re-shown) with any palette without running the emulator again.
+
+namespace PPU
+{
+
+const int c_nesColorCount = 64;
+const int c_emphasisSettings = 8;
+
+class Palette
+{
+public:
+	// From 0x00RRGGBB colors without emphasis.  Emphasis dims whichever channels aren't emphasized.
+	explicit Palette(const uint32_t (&baseColors)[c_nesColorCount]);
+
+	// From a complete table, for consumers who want some other pixel format (or their own take on emphasis)
+	explicit Palette(const uint32_t (&colors)[c_emphasisSettings][c_nesColorCount]);
+
+	// The palette GetDisplayBuffer converts with
+	static const Palette& GetDefault();
+
+	uint32_t GetColor(uint8_t emphasis, uint8_t color) const
+	{
+		return m_colors[emphasis][color];
+	}
+
+	// Converts c_displayWidth color indices (each below c_nesColorCount) to pixels
+	void ConvertScanline(const uint8_t* pIndices, uint8_t emphasis, uint32_t* pPixels) const;
+
+	// Converts a whole frame, as handed out by the PPU, into rows pixelsPerRow apart
+	void ConvertFrame(const uint8_t* pIndices, const uint8_t* pScanlineEmphasis, uint32_t* pPixels, size_t pixelsPerRow) const;
+
+private:
+	void SplitColorBytes();
+
+	uint32_t m_colors[c_emphasisSettings][c_nesColorCount];
+
+	// m_colors split out by byte (least significant first), as tables for the SSSE3 byte shuffles
+	uint8_t m_colorBytes[c_emphasisSettings][4][c_nesColorCount];
+};
+
+}
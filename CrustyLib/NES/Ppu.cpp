@@ -2,8 +2,10 @@
 
 #include "Ppu.h"
 #include "NESRom.h"
-#include "Cpu6502.h"
+#include "InterruptController.h"
 #include "IMapper.h"
+#include "ScanlineCompositor.h"
+#include "Palette.h"
 
 #include <algorithm>
 
@@ -12,79 +14,76 @@ namespace PPU
 
 const int c_tileSize = 8;
 
+const int c_VBlankScanline = 241;
+const int c_maxScanline = 260;
+const int c_cyclesPerScanlines = 341;
+const int c_ppuCyclesPerCpuCycle = 3;
+
 const uint16_t c_paletteBkgOffset = 0x3F00;
 const uint16_t c_paletteSprOffset = 0x3F10;
 
-// Color table mapping the NES's color table to RGB values
-static const uint32_t c_nesRgbColorTable[64] = {
-	0x808080, 0x003DA6, 0x0012B0, 0x440096,
-	0xA1005E, 0xC70028, 0xBA0600, 0x8C1700,
-	0x5C2F00, 0x104500, 0x054A00, 0x00472E,
-	0x004166, 0x000000, 0x050505, 0x050505,
-	0xC7C7C7, 0x0077FF, 0x2155FF, 0x8237FA,
-	0xEB2FB5, 0xFF2950, 0xFF2200, 0xD63200,
-	0xC46200, 0x358000, 0x058F00, 0x008A55,
-	0x0099CC, 0x212121, 0x090909, 0x090909,
-	0xFFFFFF, 0x0FD7FF, 0x69A2FF, 0xD480FF,
-	0xFF45F3, 0xFF618B, 0xFF8833, 0xFF9C12,
-	0xFABC20, 0x9FE30E, 0x2BF035, 0x0CF0A4,
-	0x05FBFF, 0x5E5E5E, 0x0D0D0D, 0x0D0D0D,
-	0xFFFFFF, 0xA6FCFF, 0xB3ECFF, 0xDAABEB,
-	0xFFA8F9, 0xFFABB3, 0xFFD2B0, 0xFFEFA6,
-	0xFFF79C, 0xD7E895, 0xA6EDAF, 0xA2F2DA,
-	0x99FFFC, 0xDDDDDD, 0x111111, 0x111111,
-};
-
-const uint32_t c_nesColorYellow = 0xFFFF00;
-const uint32_t c_nesColorGreen = 0x00FF00;
-const uint32_t c_nesColorGray = 0x808080;
-const uint32_t c_nesColorRed = 0xFF0000;
-
-uint32_t ColorAverage(uint32_t color1, uint32_t color2)
-{
-	return (((((color1 >> 24) & 0xFF) + ((color2 >> 24) & 0xFF)) / 2) << 24) |
-	       (((((color1 >> 16) & 0xFF) + ((color2 >> 16) & 0xFF)) / 2) << 16) |
-	       (((((color1 >>  8) & 0xFF) + ((color2 >>  8) & 0xFF)) / 2) <<  8);
-}
+// Debug overlay colors
+const uint8_t c_nesColorGray = 0x00;
+const uint8_t c_nesColorRed = 0x16;
 
-void AverageInColor(uint32_t& baseColor, uint32_t newColor)
-{
-	baseColor = ColorAverage(baseColor, newColor);
-}
+// What the screen shows before the first frame is rendered
+const uint8_t c_nesColorBlack = 0x0F;
 
-static void DrawRectangle(ppuDisplayBuffer_t displayBuffer, uint32_t nesColor, int drawRow, int left, int right, int top, int bottom)
+static void DrawRectangle(ppuIndexBuffer_t displayBuffer, uint8_t nesColor, int drawRow, int left, int right, int top, int bottom)
 {
 	// Draw top/bottom line
 	for (int iPixelColumn = std::max(0, left); iPixelColumn != right && iPixelColumn < c_displayWidth; ++iPixelColumn)
 	{
 		if (top >= 0 && top < c_displayHeight && top == drawRow)
-			AverageInColor(displayBuffer[top][iPixelColumn], nesColor);
+			displayBuffer[top][iPixelColumn] = nesColor;
 
 		if (top >= 0 && bottom < c_displayHeight && bottom == drawRow)
-			AverageInColor(displayBuffer[bottom][iPixelColumn], nesColor);
+			displayBuffer[bottom][iPixelColumn] = nesColor;
 	}
 
 	// Draw left/right line
 	for (int iPixelRow = std::max(0, top); iPixelRow != bottom && iPixelRow < c_displayHeight; ++iPixelRow)
 	{
 		if (left >= 0 && left < c_displayWidth && iPixelRow == drawRow)
-			AverageInColor(displayBuffer[iPixelRow][left], nesColor);
+			displayBuffer[iPixelRow][left] = nesColor;
 
 		if (right < c_displayWidth && iPixelRow == drawRow)
-			AverageInColor(displayBuffer[iPixelRow][right], nesColor);
+			displayBuffer[iPixelRow][right] = nesColor;
 	}
 }
 
 
-void Ppu::SetCpu(CPU::Cpu6502* pCpu)
+Ppu::Ppu()
+	: m_spChrRomTiles(std::make_shared<ChrTileCache>())
+	, m_spFrameBuffers(std::make_unique<FrameBuffers>())
+{
+	std::fill(&m_spFrameBuffers->indices[0][0], &m_spFrameBuffers->indices[0][0] + c_displayWidth * c_displayHeight, c_nesColorBlack);
+}
+
+
+Ppu::~Ppu() = default;
+
+
+void Ppu::SetInterruptController(NES::InterruptController* pInterrupts)
 {
-	m_pCpu = pCpu;
+	m_pInterrupts = pInterrupts;
 }
 
 
 void Ppu::SetRomMapper(NES::IMapper* pMapper)
 {
-	m_pMapper = pMapper;
+	m_memoryMap.Reset();
+	pMapper->SetPpuMemoryMap(&m_memoryMap);
+
+	// Decoded pages are keyed by the old mapper's memory.  The ROM tiles may be shared with other PPUs, so start a
+	// new cache of our own rather than clearing theirs.
+	m_chrRamTiles.Reset();
+	m_spChrRomTiles = std::make_shared<ChrTileCache>();
+}
+
+void Ppu::ShareChrRomTiles(const Ppu& other)
+{
+	m_spChrRomTiles = other.m_spChrRomTiles;
 }
 
 void Ppu::SetRenderOptions(const RenderOptions& renderOptions)
@@ -92,6 +91,11 @@ void Ppu::SetRenderOptions(const RenderOptions& renderOptions)
 	m_renderOptions = renderOptions;
 }
 
+void Ppu::SetPixelOutput(bool isEnabled)
+{
+	m_isPixelOutputEnabled = isEnabled;
+}
+
 void Ppu::Reset()
 {
 	m_shouldRender = false;
@@ -106,7 +110,7 @@ void Ppu::Reset()
 	// m_scanline
 	m_cycleCount = 0;
 	m_scanline = 241;
-
+	m_syncedCpuCycle = 0;
 }
 
 
@@ -181,6 +185,7 @@ void Ppu::WriteOamAddress(uint8_t value)
 void Ppu::WriteOamData(uint8_t value)
 {
 	m_sprRam[m_cpuOamAddr++] = value;
+	m_spriteEvaluator.Invalidate();
 
 	if (m_cpuOamAddr >= 256)
 		m_cpuOamAddr = 0;
@@ -191,9 +196,9 @@ uint8_t Ppu::ReadOamData() const
 	return m_sprRam[m_cpuOamAddr];
 }
 
-void Ppu::TriggerOamDMA(uint8_t* pData)
+void Ppu::TriggerOamDMA(const uint8_t* pData)
 {
-	// REVIEW: account for cycles taken: (513 or 514)
+	m_spriteEvaluator.Invalidate();
 
 	if (m_cpuOamAddr == 0)
 	{
@@ -212,19 +217,38 @@ void Ppu::TriggerOamDMA(uint8_t* pData)
 }
 
 
+// Palette RAM is mirrored every 32 bytes up to $3FFF, and the sprite palettes' first entries are mirrors of the
+// background palettes' ones.  See: http://wiki.nesdev.com/w/index.php/PPU_palettes
+static uint32_t GetPaletteRamIndex(uint16_t offset)
+{
+	uint32_t index = offset & 0x1F;
+	if ((index & 0x13) == 0x10)
+		index &= 0x0F;
+
+	return index;
+}
+
 uint8_t Ppu::ReadMemory8(uint16_t offset)
 {
-	return m_pMapper->ReadChrAddress(offset);
+	offset &= 0x3FFF;
+	if (offset >= c_paletteBkgOffset)
+		return m_paletteRam[GetPaletteRamIndex(offset)];
+
+	return m_memoryMap.Read(offset);
 }
 
 void Ppu::WriteMemory8(uint16_t offset, uint8_t value)
 {
-	// Certain addresses are actually mirrors, so do this translation before sending the write to the mapper VRAM
-	//  See: http://wiki.nesdev.com/w/index.php/PPU_palettes
-	if ((offset & 0x3FF3) == 0x3F10)
-		offset &= 0x3F0F;
+	offset &= 0x3FFF;
+	if (offset >= c_paletteBkgOffset)
+	{
+		m_paletteRam[GetPaletteRamIndex(offset)] = value;
+		return;
+	}
 
-	m_pMapper->WriteChrAddress(offset, value);
+	// Writes to CHR ROM are dropped, and don't touch the decoded tiles
+	if (m_memoryMap.Write(offset, value) && offset < 0x2000)
+		m_chrRamTiles.Invalidate(m_memoryMap.GetReadPage(offset));
 }
 
 
@@ -250,13 +274,8 @@ void Ppu::WriteMask(uint8_t value)
 
 void Ppu::AddCycles(uint32_t cpuCycles)
 {
-	const int c_VBlankScanline = 241;
-	const int c_minScanline = -1;
-	const int c_maxScanline = 260;
-	const int c_cyclesPerScanlines = 341;
-
-	m_cycleCount += cpuCycles * 3;
-	if (m_cycleCount >= c_cyclesPerScanlines)
+	m_cycleCount += cpuCycles * c_ppuCyclesPerCpuCycle;
+	while (m_cycleCount >= c_cyclesPerScanlines)
 	{
 		m_cycleCount -= c_cyclesPerScanlines;
 		m_scanline++;
@@ -268,7 +287,7 @@ void Ppu::AddCycles(uint32_t cpuCycles)
 			m_ppuStatusFlags.InVBlank = true;
 			if (m_ppuCtrlFlags.nmiFlag == 1)
 			{
-				m_pCpu->GenerateNonMaskableInterrupt();
+				m_pInterrupts->Raise(NES::InterruptSource::Nmi);
 			}
 		}
 		else if (m_scanline > c_maxScanline)
@@ -276,16 +295,41 @@ void Ppu::AddCycles(uint32_t cpuCycles)
 			m_scanline = -1;
 			m_ppuStatusFlags.InVBlank = false;
 			m_ppuStatusFlags.SpriteZeroHit = false;
-			//m_ppuStatusFlags.SPRITEOVERFLOW = false;
+			m_ppuStatusFlags.SpriteOverflow = false;
 		}
 
 		if (m_scanline >= 0 && m_scanline < 240)
 		{
-			RenderScanline(m_scanline);
+			if (m_isPixelOutputEnabled)
+				RenderScanline(m_scanline);
+			else
+				SkipScanline(m_scanline);
 		}
 	}
 }
 
+void Ppu::SyncToCpuCycle(int64_t cpuCycle)
+{
+	if (cpuCycle > m_syncedCpuCycle)
+	{
+		AddCycles(static_cast<uint32_t>(cpuCycle - m_syncedCpuCycle));
+		m_syncedCpuCycle = cpuCycle;
+	}
+}
+
+int64_t Ppu::GetNextVBlankCpuCycle() const
+{
+	const int c_scanlinesPerFrame = c_maxScanline + 2; // Includes the pre-render scanline (-1)
+
+	int scanlinesRemaining = (c_VBlankScanline - m_scanline + c_scanlinesPerFrame) % c_scanlinesPerFrame;
+	if (scanlinesRemaining == 0)
+		scanlinesRemaining = c_scanlinesPerFrame;
+
+	// Round up, as the boundary may fall part way through a CPU cycle
+	const uint32_t ppuCyclesRemaining = (scanlinesRemaining - 1) * c_cyclesPerScanlines + (c_cyclesPerScanlines - m_cycleCount);
+	return m_syncedCpuCycle + (ppuCyclesRemaining + c_ppuCyclesPerCpuCycle - 1) / c_ppuCyclesPerCpuCycle;
+}
+
 uint32_t Ppu::GetCycles() const
 {
 	return m_cycleCount;
@@ -296,6 +340,15 @@ uint32_t Ppu::GetScanline() const
 	return m_scanline;
 }
 
+void Ppu::GetPositionAtCpuCycle(int64_t cpuCycle, uint32_t* pDot, int* pScanline) const
+{
+	const int c_scanlinesPerFrame = c_maxScanline + 2; // Includes the pre-render scanline (-1)
+
+	const int64_t ppuCycles = m_cycleCount + std::max<int64_t>(cpuCycle - m_syncedCpuCycle, 0) * c_ppuCyclesPerCpuCycle;
+	*pDot = static_cast<uint32_t>(ppuCycles % c_cyclesPerScanlines);
+	*pScanline = static_cast<int>((m_scanline + 1 + ppuCycles / c_cyclesPerScanlines) % c_scanlinesPerFrame) - 1;
+}
+
 
 bool Ppu::ShouldRender()
 {
@@ -306,9 +359,32 @@ bool Ppu::ShouldRender()
 }
 
 
+const ppuIndexBuffer_t& Ppu::GetIndexBuffer() const
+{
+	return m_spFrameBuffers->indices;
+}
+
+const uint8_t* Ppu::GetScanlineEmphasis() const
+{
+	return m_spFrameBuffers->emphasis;
+}
+
 const ppuDisplayBuffer_t& Ppu::GetDisplayBuffer() const
 {
-	return m_screenPixels;
+	FrameBuffers& frameBuffers = *m_spFrameBuffers;
+	if (!frameBuffers.spRgb)
+	{
+		frameBuffers.spRgb = std::make_unique<FrameBuffers::RgbPixels>();
+		frameBuffers.isRgbStale = true;
+	}
+
+	if (frameBuffers.isRgbStale)
+	{
+		Palette::GetDefault().ConvertFrame(&frameBuffers.indices[0][0], frameBuffers.emphasis, &frameBuffers.spRgb->pixels[0][0], c_displayWidth);
+		frameBuffers.isRgbStale = false;
+	}
+
+	return frameBuffers.spRgb->pixels;
 }
 
 
@@ -336,39 +412,37 @@ uint16_t Ppu::GetSpriteNametableOffset() const
 }
 
 
-void Ppu::DrawBkgTile(uint8_t tileNumber, uint8_t highOrderPixelData, int iRow, int iColumn, int iPixelRow, uint32_t backgroundColor, uint16_t patternTableOffset, ppuDisplayBuffer_t displayBuffer, ppuPixelOutputTypeBuffer_t outputTypeBuffer)
+// Bank switches and CHR RAM writes only happen between scanlines (the CPU syncs us first), so the decoded
+// pages can be looked up once per scanline
+void Ppu::ResolveChrPages()
 {
-	const uint16_t tileOffsetBase = patternTableOffset + (tileNumber << 4);
-
-	if (iRow + iPixelRow < 0)
-		return;
+	for (uint32_t iPage = 0; iPage != _countof(m_pChrPages); ++iPage)
+	{
+		// Read-only pages never change, so their tiles can be shared with other consoles running the same ROM
+		const uint16_t address = static_cast<uint16_t>(iPage * c_cbChrPage);
+		ChrTileCache& tiles = (m_memoryMap.GetWritePage(address) == nullptr) ? *m_spChrRomTiles : m_chrRamTiles;
+		m_pChrPages[iPage] = &tiles.GetPage(m_memoryMap.GetReadPage(address));
+	}
+}
 
-	if (iRow + iPixelRow >= c_displayHeight)
-		return;
+// address is that of the row's first bit plane byte
+const uint8_t* Ppu::GetDecodedTileRow(uint16_t address, bool flipHorizontally) const
+{
+	const DecodedChrPage& page = *m_pChrPages[(address >> 10) & 0x7];
+	const uint32_t iTile = (address >> 4) & (c_tilesPerChrPage - 1);
+	const uint32_t iRow = address & 0x7;
 
-	const uint8_t colorByte1 = ReadMemory8(tileOffsetBase + iPixelRow);
-	const uint8_t colorByte2 = ReadMemory8(tileOffsetBase + iPixelRow + 8);
-	const int leftEdge = m_ppuMaskFlags.showBackgroundOnLeft ? 0 : c_tileSize;
+	return flipHorizontally ? page.flippedRows[iTile][iRow] : page.rows[iTile][iRow];
+}
 
-	for (uint16_t iPixelColumn = 0; iPixelColumn != c_tileSize; ++iPixelColumn)
-	{
-		if (iColumn + iPixelColumn < leftEdge)
-			continue;
 
-		if (iColumn + iPixelColumn >= c_displayWidth)
-			break;
+void Ppu::DrawBkgTile(uint8_t tileNumber, uint8_t highOrderPixelData, int iPixelRow, uint16_t patternTableOffset, uint8_t* pLine)
+{
+	const uint8_t* pTileRow = GetDecodedTileRow(patternTableOffset + (tileNumber << 4) + iPixelRow, false);
 
-		const uint8_t lowOrderColorBytes = ((colorByte1 & (1 << (7-iPixelColumn))) >> (7-iPixelColumn))
-										 + ((colorByte2 & (1 << (7-iPixelColumn))) >> (7-iPixelColumn) << 1);
-	
-		// All background colors should map to 3F00
-		const uint8_t colorDataOffset = (lowOrderColorBytes == 0) ? backgroundColor
-		                                                          : ReadMemory8(c_paletteBkgOffset + (lowOrderColorBytes | highOrderPixelData));
-
-		displayBuffer[iRow + iPixelRow][iColumn + iPixelColumn] = c_nesRgbColorTable[colorDataOffset];
-		
-		if (lowOrderColorBytes != 0)
-			outputTypeBuffer[iRow + iPixelRow][iColumn + iPixelColumn] = PixelOutputType::Background;
+	for (int iPixelColumn = 0; iPixelColumn != c_tileSize; ++iPixelColumn)
+	{
+		pLine[iPixelColumn] = pTileRow[iPixelColumn] | highOrderPixelData;
 	}
 }
 
@@ -389,57 +463,30 @@ uint16_t Ppu::GetSpriteTileOffset(uint8_t tileNumber, bool is8x8Sprite) const
 }
 
 
-bool Ppu::DrawSprTile(uint8_t tileNumber, uint8_t highOrderPixelData, int iRow, int iColumn, int iPixelRow, bool foregroundSprite, bool flipHorizontally, bool flipVertically, ppuDisplayBuffer_t displayBuffer, ppuPixelOutputTypeBuffer_t outputTypeBuffer)
+// Sprites are drawn front to back, so a pixel already claimed by an earlier sprite is left alone
+void Ppu::DrawSprTile(uint8_t tileNumber, uint8_t spritePixelData, int iPixelRow, bool flipHorizontally, bool flipVertically, uint8_t* pLine)
 {
 	const uint16_t tileOffsetBase = GetSpriteTileOffset(tileNumber, m_ppuCtrlFlags.spriteSize == SpriteSize::Size8x8);
 	const int totalPixelRows = (m_ppuCtrlFlags.spriteSize == SpriteSize::Size8x16) ? 16 : 8;
 
-	if (iRow + iPixelRow >= c_displayHeight)
-		return false;
-
 	const int iSourceRowOffset = flipVertically ? (totalPixelRows - iPixelRow - 1) : (iPixelRow);
 
-	const uint16_t totalTiles = (m_ppuCtrlFlags.spriteSize == SpriteSize::Size8x16) ? 2 : 1;
 	uint16_t iTile = iSourceRowOffset / c_tileSize;
 	uint16_t iTileRow = iSourceRowOffset % c_tileSize;
 
 	const uint16_t c_bytesPerTile = 16;
-	const uint8_t colorByte1 = ReadMemory8(tileOffsetBase + (iTile * c_bytesPerTile) + iTileRow);
-	const uint8_t colorByte2 = ReadMemory8(tileOffsetBase + (iTile * c_bytesPerTile) + iTileRow + 8);
-	const int leftEdge = m_ppuMaskFlags.showSpritesOnLeft ? 0 : c_tileSize;
+	const uint8_t* pTileRow = GetDecodedTileRow(tileOffsetBase + (iTile * c_bytesPerTile) + iTileRow, flipHorizontally);
 
-	bool spriteHit = false;
-	for (uint16_t iPixelColumn = 0; iPixelColumn != c_tileSize; ++iPixelColumn)
+	for (int iPixelColumn = 0; iPixelColumn != c_tileSize; ++iPixelColumn)
 	{
-		const int iPixelColumnOffset = flipHorizontally ? (7 - iPixelColumn) : iPixelColumn;
-		if (iColumn + iPixelColumnOffset < leftEdge || iColumn + iPixelColumnOffset >= c_displayWidth)
-			continue;
-
-		const uint8_t lowOrderColorBytes = ((colorByte1 & (1 << (7 - iPixelColumn))) >> (7 - iPixelColumn))
-			+ ((colorByte2 & (1 << (7 - iPixelColumn))) >> (7 - iPixelColumn) << 1);
-
-		const uint8_t fullPixelBytes = lowOrderColorBytes | highOrderPixelData;
-		const uint8_t colorDataOffset = ReadMemory8(c_paletteSprOffset + fullPixelBytes);
-
-		// TODO: Need to emulate the sprite priority 'bug':  http://wiki.nesdev.com/w/index.php/PPU_sprite_priority
-		if (lowOrderColorBytes != 0 && (outputTypeBuffer[iRow + iPixelRow][iColumn + iPixelColumnOffset] == PixelOutputType::Background))
-		{
-			spriteHit = true;
-		}
-
-		if (lowOrderColorBytes != 0
-			&& ((outputTypeBuffer[iRow + iPixelRow][iColumn + iPixelColumnOffset] == PixelOutputType::None)
-				|| (foregroundSprite && (outputTypeBuffer[iRow + iPixelRow][iColumn + iPixelColumnOffset] == PixelOutputType::Background))))
-		{
-			displayBuffer[iRow + iPixelRow][iColumn + iPixelColumnOffset] = c_nesRgbColorTable[colorDataOffset];
-			outputTypeBuffer[iRow + iPixelRow][iColumn + iPixelColumnOffset] = PixelOutputType::Sprite;
-		}
+		if (pTileRow[iPixelColumn] != 0 && pLine[iPixelColumn] == 0)
+			pLine[iPixelColumn] = pTileRow[iPixelColumn] | spritePixelData;
 	}
-
-	return spriteHit;
 }
 
-void Ppu::RenderScanline(int scanline)
+// Draws tile columns firstColumn to lastColumn (exclusive) of the scanline's background into backgroundLine, where
+// column 0 is the first (partly) visible tile
+void Ppu::DrawBkgColumns(int scanline, int firstColumn, int lastColumn, uint8_t* backgroundLine)
 {
 	const uint16_t nameTableOffset = GetBaseNametableOffset();
 	const uint16_t patternTableOffset = GetPatternTableOffset();
@@ -447,63 +494,71 @@ void Ppu::RenderScanline(int scanline)
 	const int c_rows = 30;
 	const int c_columnsPerRow = 32;
 
-	for (uint32_t iColumn = 0; iColumn != c_displayWidth; ++iColumn)
+	const uint16_t iRowTile = ((scanline + m_verticalScrollOffset) / c_tileSize) % c_rows;
+	const bool rowOverflow = ((scanline + m_verticalScrollOffset) / c_tileSize) >= c_rows;
+	const int pixelRow = (scanline + m_verticalScrollOffset) % c_tileSize;
+
+	for (int iColumn = firstColumn; iColumn != lastColumn; ++iColumn)
 	{
-		m_screenPixelTypes[scanline][iColumn] = PixelOutputType::None;
+		const uint16_t iColumnTile = (iColumn + (m_horizontalScrollOffset / c_tileSize)) % c_columnsPerRow;
+		const bool columnOverflow = (iColumn + (m_horizontalScrollOffset / c_tileSize)) >= c_columnsPerRow;
+		const uint16_t xNametable = nameTableOffset + (columnOverflow ? 0x400 : 0) + (rowOverflow ? 0x800 : 0) & 0x2FFF;
+
+		// Each nametable (with its attribute table) is exactly one page, which is always mapped
+		const uint8_t* pNametable = m_memoryMap.GetReadPage(xNametable);
+
+		const uint8_t tileNumber = pNametable[iRowTile * c_columnsPerRow + iColumnTile];
+		const uint8_t attributeIndex = static_cast<uint8_t>((iRowTile / 4) * 8 + (iColumnTile / 4));
+		const uint8_t attributeData = pNametable[(c_rows * c_columnsPerRow) + attributeIndex];
+		const uint8_t highOrderColorBits = GetHighOrderColorFromAttributeEntry(attributeData, iRowTile, iColumnTile);
+
+		DrawBkgTile(tileNumber, highOrderColorBits, pixelRow, patternTableOffset, backgroundLine + iColumn * c_tileSize);
 	}
+}
+
+void Ppu::RenderScanline(int scanline)
+{
+	const int c_columnsPerRow = 32;
 
 	const int iRowPixelOffset = -(m_verticalScrollOffset % c_tileSize);
 	const int iColPixelOffset = -(m_horizontalScrollOffset % c_tileSize);
 
-	const uint8_t backgroundColor = ReadMemory8(c_paletteBkgOffset);
+	ResolveChrPages();
+
+	// The background is drawn a whole tile at a time from the first (partly) visible one, so the visible line starts
+	// part way into the buffer.  Sprites can hang off the right edge.
+	uint8_t backgroundLine[(c_columnsPerRow + 1) * c_tileSize] = {};
+	uint8_t spriteLine[c_displayWidth + c_tileSize] = {};
+	uint8_t* const pBackground = backgroundLine - iColPixelOffset;
 
 	if (m_ppuMaskFlags.showBackground)
 	{
-		const uint16_t iRowTile = ((scanline + m_verticalScrollOffset) / c_tileSize) % c_rows;
-		const bool rowOverflow = ((scanline + m_verticalScrollOffset) / c_tileSize) >= c_rows;
+		DrawBkgColumns(scanline, 0, c_columnsPerRow + 1, backgroundLine);
 
-		// If we're supressing the left most column, then fill it in with the background color (PaperBoy is a good example of a game that uses this)
+		// If we're supressing the left most column, then it shows the background color (PaperBoy is a good example of a game that uses this)
 		if (!m_ppuMaskFlags.showBackgroundOnLeft)
-		{
-			for (int iPixelColumn = 0; iPixelColumn != c_tileSize + 1; ++iPixelColumn)
-				m_screenPixels[scanline][iPixelColumn] = c_nesRgbColorTable[backgroundColor];
-		}
-
-		for (int iColumn = 0; iColumn != c_columnsPerRow + 1; ++iColumn)
-		{
-			const uint16_t iColumnTile = (iColumn + (m_horizontalScrollOffset / c_tileSize)) % c_columnsPerRow;
-			const bool columnOverflow = (iColumn + (m_horizontalScrollOffset / c_tileSize)) >= c_columnsPerRow;
-			const uint16_t xNametable = nameTableOffset + (columnOverflow ? 0x400 : 0) + (rowOverflow ? 0x800 : 0) & 0x2FFF;
-
-			const uint8_t tileNumber = ReadMemory8(xNametable + iRowTile * c_columnsPerRow + iColumnTile);
-			const uint8_t attributeIndex = static_cast<uint8_t>((iRowTile / 4) * 8 + (iColumnTile / 4));
-			const uint8_t attributeData = ReadMemory8(xNametable + (c_rows * c_columnsPerRow) + attributeIndex);
-			const uint8_t highOrderColorBits = GetHighOrderColorFromAttributeEntry(attributeData, iRowTile, iColumnTile);
-
-			const int pixelRow = (scanline + m_verticalScrollOffset) % c_tileSize;
+			std::fill(pBackground, pBackground + c_tileSize, static_cast<uint8_t>(0));
+	}
 
-			const int tileTop = scanline - pixelRow;
-			DrawBkgTile(tileNumber, highOrderColorBits, tileTop, iColumn * c_tileSize + iColPixelOffset, pixelRow, backgroundColor, patternTableOffset, m_screenPixels, m_screenPixelTypes);
+	const int totalPixelRows = (m_ppuCtrlFlags.spriteSize == SpriteSize::Size8x16) ? 16 : 8;
+	const ScanlineSprites& lineSprites = m_spriteEvaluator.GetScanlineSprites(m_sprRam, totalPixelRows, scanline);
+	const int lineSpriteCount = m_renderOptions.fNoSpriteLimit ? lineSprites.count : std::min<int>(lineSprites.count, c_spritesPerScanline);
 
-			if (m_renderOptions.fDrawBackgroundGrid)
-				DrawRectangle(m_screenPixels, c_nesColorGray, scanline, iColumn*c_tileSize + iColPixelOffset, (iColumn+1)*c_tileSize + iColPixelOffset, tileTop, tileTop + c_tileSize);
-		}
+	// Sprite evaluation only happens while rendering
+	if (lineSprites.IsOverflowed() && (m_ppuMaskFlags.showBackground || m_ppuMaskFlags.showSprites))
+	{
+		m_ppuStatusFlags.SpriteOverflow = true;
 	}
 
 	if (m_ppuMaskFlags.showSprites)
 	{
 		const int c_bytesPerSprite = 4;
-		for (int iSprite = 0; iSprite != 64; ++iSprite)
+		for (int iLineSprite = 0; iLineSprite != lineSpriteCount; ++iLineSprite)
 		{
+			const int iSprite = lineSprites.oamIndices[iLineSprite];
 			const size_t spriteByteOffset = iSprite * c_bytesPerSprite;
-			uint8_t spriteY = m_sprRam[spriteByteOffset + 0];
-			if (spriteY >= PPU::c_displayHeight - 2)
-				continue;
-
-			const int totalPixelRows = (m_ppuCtrlFlags.spriteSize == SpriteSize::Size8x16) ? 16 : 8;
-			if (spriteY > scanline || spriteY + totalPixelRows <= scanline)
-				continue;
 
+			uint8_t spriteY = m_sprRam[spriteByteOffset + 0];
 			uint8_t spriteX = m_sprRam[spriteByteOffset + 3];
 			uint8_t tileNumber = m_sprRam[spriteByteOffset + 1];
 
@@ -513,17 +568,124 @@ void Ppu::RenderScanline(int scanline)
 			const bool flipHorizontally = (thirdByte & 0x40) != 0;
 			const bool flipVertically = (thirdByte & 0x80) != 0;
 
-			const bool spriteHit = DrawSprTile(tileNumber, highOrderColorBits, spriteY, spriteX, scanline - spriteY, isForegroundSprite, flipHorizontally, flipVertically, m_screenPixels, m_screenPixelTypes);
+			const uint8_t spritePixelData = highOrderColorBits
+			                              | (isForegroundSprite ? 0 : c_spritePixelBehindBackground)
+			                              | (iSprite == 0 ? c_spritePixelZero : 0);
 
-			if (iSprite == 0 && spriteHit)
-			{
-				m_ppuStatusFlags.SpriteZeroHit = true;
-			}
+			DrawSprTile(tileNumber, spritePixelData, scanline - spriteY, flipHorizontally, flipVertically, spriteLine + spriteX);
+		}
 
-			if (m_renderOptions.fDrawSpriteOutline)
-			{
-				DrawRectangle(m_screenPixels, c_nesColorRed, scanline, spriteX, spriteX + c_tileSize, spriteY, spriteY + totalPixelRows - 1);
-			}
+		if (!m_ppuMaskFlags.showSpritesOnLeft)
+			std::fill(spriteLine, spriteLine + c_tileSize, static_cast<uint8_t>(0));
+	}
+
+	uint8_t paletteAddresses[c_displayWidth];
+	if (CompositeScanline(pBackground, spriteLine, paletteAddresses))
+	{
+		m_ppuStatusFlags.SpriteZeroHit = true;
+	}
+
+	// The palette can't change mid-scanline, so each entry is only looked up once
+	const uint8_t colorMask = m_ppuMaskFlags.grayScale ? 0x30 : 0x3F;
+	const int c_paletteEntries = 32;
+	uint8_t lineColors[c_paletteEntries];
+	for (int iEntry = 0; iEntry != c_paletteEntries; ++iEntry)
+	{
+		lineColors[iEntry] = m_paletteRam[GetPaletteRamIndex(static_cast<uint16_t>(iEntry))] & colorMask;
+	}
+
+	ppuIndexBuffer_t& pixels = m_spFrameBuffers->indices;
+	if (m_ppuMaskFlags.showBackground)
+	{
+		for (int iPixelColumn = 0; iPixelColumn != c_displayWidth; ++iPixelColumn)
+			pixels[scanline][iPixelColumn] = lineColors[paletteAddresses[iPixelColumn]];
+	}
+	else
+	{
+		// Without a background, only sprites are drawn over whatever the line held before
+		const int c_firstSpritePaletteAddress = 0x10;
+		for (int iPixelColumn = 0; iPixelColumn != c_displayWidth; ++iPixelColumn)
+		{
+			if (paletteAddresses[iPixelColumn] >= c_firstSpritePaletteAddress)
+				pixels[scanline][iPixelColumn] = lineColors[paletteAddresses[iPixelColumn]];
+		}
+	}
+
+	m_spFrameBuffers->emphasis[scanline] = m_ppuMaskByte >> 5;
+	m_spFrameBuffers->isRgbStale = true;
+
+	if (m_renderOptions.fDrawBackgroundGrid && m_ppuMaskFlags.showBackground)
+	{
+		const int tileTop = scanline + iRowPixelOffset;
+		for (int iColumn = 0; iColumn != c_columnsPerRow + 1; ++iColumn)
+			DrawRectangle(pixels, c_nesColorGray, scanline, iColumn*c_tileSize + iColPixelOffset, (iColumn+1)*c_tileSize + iColPixelOffset, tileTop, tileTop + c_tileSize);
+	}
+
+	if (m_renderOptions.fDrawSpriteOutline && m_ppuMaskFlags.showSprites)
+	{
+		for (int iLineSprite = 0; iLineSprite != lineSpriteCount; ++iLineSprite)
+		{
+			const uint8_t* pSprite = &m_sprRam[lineSprites.oamIndices[iLineSprite] * 4];
+			const uint8_t spriteY = pSprite[0];
+			const uint8_t spriteX = pSprite[3];
+			DrawRectangle(pixels, c_nesColorRed, scanline, spriteX, spriteX + c_tileSize, spriteY, spriteY + totalPixelRows - 1);
+		}
+	}
+}
+
+// Everything RenderScanline does which the CPU can see, for frames nobody is going to look at.  That's the sprite
+// overflow and sprite 0 hit flags, and sprite 0 hit only depends on the pixels under sprite 0, so that's all that's
+// drawn (on the few lines it's on, until it hits).
+void Ppu::SkipScanline(int scanline)
+{
+	const int totalPixelRows = (m_ppuCtrlFlags.spriteSize == SpriteSize::Size8x16) ? 16 : 8;
+	const ScanlineSprites& lineSprites = m_spriteEvaluator.GetScanlineSprites(m_sprRam, totalPixelRows, scanline);
+
+	// Sprite evaluation only happens while rendering
+	if (lineSprites.IsOverflowed() && (m_ppuMaskFlags.showBackground || m_ppuMaskFlags.showSprites))
+	{
+		m_ppuStatusFlags.SpriteOverflow = true;
+	}
+
+	// The hit flag stays set until the pre-render line, so once it's set there's nothing left to find
+	if (m_ppuStatusFlags.SpriteZeroHit || !m_ppuMaskFlags.showBackground || !m_ppuMaskFlags.showSprites)
+		return;
+
+	// Sprites are bucketed in OAM order, so sprite 0 comes first if it's on this line at all
+	if (lineSprites.count == 0 || lineSprites.oamIndices[0] != 0)
+		return;
+
+	ResolveChrPages();
+
+	const uint8_t spriteY = m_sprRam[0];
+	const uint8_t tileNumber = m_sprRam[1];
+	const uint8_t thirdByte = m_sprRam[2];
+	const uint8_t spriteX = m_sprRam[3];
+
+	uint8_t spritePixels[c_tileSize] = {};
+	DrawSprTile(tileNumber, c_spritePixelZero, scanline - spriteY, (thirdByte & 0x40) != 0, (thirdByte & 0x80) != 0, spritePixels);
+
+	// The sprite covers at most two background tiles, laid out as in RenderScanline
+	const int c_columnsPerRow = 32;
+	const int iColPixelOffset = -(m_horizontalScrollOffset % c_tileSize);
+	const int firstColumn = (spriteX - iColPixelOffset) / c_tileSize;
+	const int lastColumn = std::min(firstColumn + 2, c_columnsPerRow + 1);
+
+	uint8_t backgroundLine[(c_columnsPerRow + 1) * c_tileSize];
+	DrawBkgColumns(scanline, firstColumn, lastColumn, backgroundLine);
+	const uint8_t* const pBackground = backgroundLine - iColPixelOffset;
+
+	// Either layer being clipped on the left rules out a hit there
+	const int firstPixel = (m_ppuMaskFlags.showBackgroundOnLeft && m_ppuMaskFlags.showSpritesOnLeft) ? 0 : c_tileSize;
+	const int lastPixel = std::min(spriteX + c_tileSize, c_displayWidth);
+
+	const uint8_t c_pixelPatternBits = 0x03;
+	for (int iPixel = std::max<int>(spriteX, firstPixel); iPixel < lastPixel; ++iPixel)
+	{
+		if (spritePixels[iPixel - spriteX] != 0 && (pBackground[iPixel] & c_pixelPatternBits) != 0)
+		{
+			m_ppuStatusFlags.SpriteZeroHit = true;
+			break;
 		}
 	}
 }
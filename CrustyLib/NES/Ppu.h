@@ -1,6 +1,11 @@
 #pragma once
 
 #include <stdint.h>
+#include <memory>
+
+#include "ChrTileCache.h"
+#include "SpriteEvaluator.h"
+#include "PpuMemoryMap.h"
 
 // Right now, our pixel output is stored with blue as the least significant value, so we can't use Window's default RGB macro
 #define PPU_RGB(r,g,b)  ((COLORREF)(((BYTE)(b)|((WORD)((BYTE)(g))<<8))|(((DWORD)(BYTE)(r))<<16)))
@@ -8,10 +13,7 @@
 namespace NES {
 	class NESRom;
 	class IMapper;
-}
-
-namespace CPU {
-	class Cpu6502;
+	class InterruptController;
 }
 
 namespace PPU
@@ -21,6 +23,7 @@ struct RenderOptions
 {
 	bool fDrawBackgroundGrid = false;
 	bool fDrawSpriteOutline = false;
+	bool fNoSpriteLimit = false; // Draw every sprite on a scanline, not just the first 8 (less flicker, not what hardware does)
 };
 
 const int c_displayWidth = 256;
@@ -28,6 +31,9 @@ const int c_displayHeight = 240;
 
 typedef uint32_t ppuDisplayBuffer_t[c_displayHeight][c_displayWidth];
 
+// NES color indices (0-63), as the PPU renders them.  See Palette for turning them into RGB.
+typedef uint8_t ppuIndexBuffer_t[c_displayHeight][c_displayWidth];
+
 
 struct PpuStatusFlag
 {
@@ -36,7 +42,7 @@ struct PpuStatusFlag
 	uint8_t Bit2 : 1;
 	uint8_t Bit3 : 1;
 	uint8_t Bit4 : 1;
-	uint8_t Bit5 : 1;
+	uint8_t SpriteOverflow:1;
 	uint8_t SpriteZeroHit:1;
 	uint8_t InVBlank:1;
 };
@@ -47,13 +53,8 @@ enum class MirroringMode
 	HorizontalMirroring,
 	VerticalMirroring,
 	FourScreen,
-};
-
-enum class PixelOutputType : uint8_t
-{
-	None = 0,
-	Background = 1,
-	Sprite = 2,
+	SingleScreenLower, // Mapper controlled (e.g. MMC1)
+	SingleScreenUpper,
 };
 
 enum SpriteSize : uint8_t
@@ -62,20 +63,30 @@ enum SpriteSize : uint8_t
 	Size8x16 = 1,
 };
 
-typedef PixelOutputType ppuPixelOutputTypeBuffer_t[c_displayHeight][c_displayWidth];
-
 
 class Ppu
 {
 public:
-	Ppu() = default;
+	Ppu();
+	~Ppu();
 
 	Ppu(const Ppu&) = delete;
 	Ppu& operator=(const Ppu&) = delete;
 
 	void SetRomMapper(NES::IMapper* pMapper);
 	void SetRenderOptions(const RenderOptions& renderOptions);
-	void SetCpu(CPU::Cpu6502* pCpu);
+
+	// Uses (and adds to) the other PPU's decoded CHR ROM tiles rather than decoding our own, for consoles running the
+	// same ROM.  Like decoded blocks, pages are keyed by host address, so this only helps once both have loaded the same
+	// NESRom with a mapper which maps its CHR ROM straight from it.  Changing the mapper goes back to a cache of our own.
+	void ShareChrRomTiles(const Ppu& other);
+
+	// With pixel output off, frames still run as far as the CPU can tell (vblank, NMI, status flags including sprite 0
+	// hits), but nothing is drawn and the frame buffer keeps the last frame that was.  That shows through wherever a
+	// later frame is drawn with the background off.  Change it between frames.
+	void SetPixelOutput(bool isEnabled);
+
+	void SetInterruptController(NES::InterruptController* pInterrupts);
 
 	void Reset();
 
@@ -93,16 +104,29 @@ public:
 	void WriteOamAddress(uint8_t value);
 	void WriteOamData(uint8_t value);
 	uint8_t ReadOamData() const;
-	void TriggerOamDMA(uint8_t* pData);
+	void TriggerOamDMA(const uint8_t* pData);
 
 	void AddCycles(uint32_t cpuCycles);
 
+	// The PPU is caught up lazily, whenever the CPU touches something affecting rendering.  The only thing
+	// it does on its own which the CPU can observe without asking is the vblank NMI.
+	void SyncToCpuCycle(int64_t cpuCycle);
+	int64_t GetNextVBlankCpuCycle() const;
+
+	// The last frame as NES colors, along with the color emphasis bits ($2001 bits 5-7) of each scanline
+	const ppuIndexBuffer_t& GetIndexBuffer() const;
+	const uint8_t* GetScanlineEmphasis() const;
+
+	// The last frame in RGB, through the default palette.  It's converted the first time it's asked for after changing.
 	const ppuDisplayBuffer_t& GetDisplayBuffer() const;
 
 	// Logging only
 	uint32_t GetCycles() const;
 	uint32_t GetScanline() const;
 
+	// Where the PPU will be at cpuCycle (at or after the last sync), without catching it up.  For tracing.
+	void GetPositionAtCpuCycle(int64_t cpuCycle, uint32_t* pDot, int* pScanline) const;
+
 private:
 	uint8_t ReadMemory8(uint16_t offset);
 	void WriteMemory8(uint16_t offset, uint8_t value);
@@ -122,8 +146,12 @@ private:
 	uint16_t CpuDataIncrementAmount() const;
 
 	uint16_t GetSpriteTileOffset(uint8_t tileNumber, bool is8x8Sprite) const;
-	void DrawBkgTile(uint8_t tileNumber, uint8_t highOrderPixelData, int iRow, int iColumn, int iPixelRow, uint32_t backgroundColor, uint16_t patternTableOffset, ppuDisplayBuffer_t displayBuffer, ppuPixelOutputTypeBuffer_t outputTypeBuffer);
-	bool DrawSprTile(uint8_t tileNumber, uint8_t highOrderPixelData, int iRow, int iColumn, int iPixelRow, bool foregroundSprite, bool flipHorizontally, bool flipVertically, ppuDisplayBuffer_t displayBuffer, ppuPixelOutputTypeBuffer_t outputTypeBuffer);
+	void ResolveChrPages();
+	const uint8_t* GetDecodedTileRow(uint16_t address, bool flipHorizontally) const;
+	void SkipScanline(int scanline);
+	void DrawBkgColumns(int scanline, int firstColumn, int lastColumn, uint8_t* backgroundLine);
+	void DrawBkgTile(uint8_t tileNumber, uint8_t highOrderPixelData, int iPixelRow, uint16_t patternTableOffset, uint8_t* pLine);
+	void DrawSprTile(uint8_t tileNumber, uint8_t spritePixelData, int iPixelRow, bool flipHorizontally, bool flipVertically, uint8_t* pLine);
 
 	struct PpuControlFlags
 	{
@@ -168,6 +196,7 @@ private:
 	};
 
 	uint8_t m_sprRam[256]; // Sprite RAM
+	uint8_t m_paletteRam[32] = {}; // $3F00-$3F1F, which isn't in the memory map
 
 	uint16_t m_cpuPpuAddr = 0;
 	uint16_t m_cpuOamAddr = 0;
@@ -179,16 +208,40 @@ private:
 
 	uint32_t m_cycleCount = 0;
 	int m_scanline = 241;
+	int64_t m_syncedCpuCycle = 0;
 
 	const uint8_t* m_chrRom;
 
 	bool m_shouldRender = false;
+	bool m_isPixelOutputEnabled = true;
+
+	NES::InterruptController* m_pInterrupts;
+
+	// Everything above is small and touched on every register access, and sits next to the CPU in the NES.  The
+	// frame buffers are only written while rendering, so they're allocated separately.  The RGB copy of the frame
+	// only exists once someone asks for it.
+	struct FrameBuffers
+	{
+		struct RgbPixels
+		{
+			ppuDisplayBuffer_t pixels;
+		};
+
+		ppuIndexBuffer_t indices;
+		uint8_t emphasis[c_displayHeight];
+
+		std::unique_ptr<RgbPixels> spRgb;
+		bool isRgbStale = true;
+	};
+
 	RenderOptions m_renderOptions;
-	ppuDisplayBuffer_t m_screenPixels;
-	ppuPixelOutputTypeBuffer_t m_screenPixelTypes;
 
-	CPU::Cpu6502* m_pCpu;
-	NES::IMapper* m_pMapper;
+	NES::PpuMemoryMap m_memoryMap; // Everything below $3F00
+	ChrTileCache m_chrRamTiles; // Pages the PPU can write to, which are this console's own
+	std::shared_ptr<ChrTileCache> m_spChrRomTiles; // Read-only pages
+	SpriteEvaluator m_spriteEvaluator;
+	const DecodedChrPage* m_pChrPages[8] = {}; // Decoded tiles for each 1KB page of the pattern tables, resolved each scanline
+	std::unique_ptr<FrameBuffers> m_spFrameBuffers;
 };
 
 } // namespace Ppu
@@ -0,0 +1,110 @@
+#include "stdafx.h"
+#include "PpuMemoryMap.h"
+#include "Ppu.h"
+
+#include <stdexcept>
+
+namespace NES
+{
+
+const uint16_t c_patternTableEnd = 0x2000;
+const uint32_t c_firstNametablePage = 0x2000 >> c_ppuPageShift;
+const uint32_t c_firstNametableMirrorPage = 0x3000 >> c_ppuPageShift;
+const uint32_t c_nametableCount = 4;
+const uint32_t c_consoleNametableCount = 2;
+
+
+PpuMemoryMap::PpuMemoryMap()
+	: m_spNametableRam(new uint8_t[c_consoleNametableCount * c_cbPpuPage])
+{
+	Reset();
+}
+
+
+void PpuMemoryMap::Reset()
+{
+	for (uint32_t iPage = 0; iPage != c_ppuPageCount; ++iPage)
+	{
+		m_readPages[iPage] = nullptr;
+		m_writePages[iPage] = nullptr;
+	}
+
+	memset(m_spNametableRam.get(), 0, c_consoleNametableCount * c_cbPpuPage);
+	if (m_spFourScreenRam)
+		memset(m_spFourScreenRam.get(), 0, c_consoleNametableCount * c_cbPpuPage);
+}
+
+
+void PpuMemoryMap::MapChrReadOnly(uint16_t address, uint32_t cbSize, const uint8_t* pData)
+{
+	SetChrPages(address, cbSize, pData, nullptr);
+}
+
+
+void PpuMemoryMap::MapChrReadWrite(uint16_t address, uint32_t cbSize, uint8_t* pData)
+{
+	SetChrPages(address, cbSize, pData, pData);
+}
+
+
+void PpuMemoryMap::UnmapChr(uint16_t address, uint32_t cbSize)
+{
+	SetChrPages(address, cbSize, nullptr, nullptr);
+}
+
+
+void PpuMemoryMap::SetChrPages(uint16_t address, uint32_t cbSize, const uint8_t* pReadData, uint8_t* pWriteData)
+{
+	if ((address & c_ppuPageMask) != 0 || (cbSize & c_ppuPageMask) != 0 || address + cbSize > c_patternTableEnd)
+		throw std::runtime_error("Unaligned PPU memory mapping");
+
+	const uint32_t firstPage = address >> c_ppuPageShift;
+	const uint32_t pageCount = cbSize >> c_ppuPageShift;
+	for (uint32_t iPage = 0; iPage != pageCount; ++iPage)
+	{
+		const uint32_t pageOffset = iPage * c_cbPpuPage;
+		m_readPages[firstPage + iPage] = (pReadData != nullptr) ? pReadData + pageOffset : nullptr;
+		m_writePages[firstPage + iPage] = (pWriteData != nullptr) ? pWriteData + pageOffset : nullptr;
+	}
+}
+
+
+void PpuMemoryMap::SetMirroringMode(PPU::MirroringMode mirroringMode)
+{
+	if (mirroringMode == PPU::MirroringMode::FourScreen && !m_spFourScreenRam)
+		m_spFourScreenRam.reset(new uint8_t[c_consoleNametableCount * c_cbPpuPage]());
+
+	for (uint32_t iNametable = 0; iNametable != c_nametableCount; ++iNametable)
+	{
+		uint32_t iRamPage;
+		if (mirroringMode == PPU::MirroringMode::HorizontalMirroring)
+			iRamPage = iNametable / 2; // 0,1 -> 0;  2,3 -> 1
+		else if (mirroringMode == PPU::MirroringMode::VerticalMirroring)
+			iRamPage = iNametable % 2; // 0,2 -> 0;  1,3 -> 1
+		else if (mirroringMode == PPU::MirroringMode::SingleScreenLower)
+			iRamPage = 0;
+		else if (mirroringMode == PPU::MirroringMode::SingleScreenUpper)
+			iRamPage = 1;
+		else // FourScreen
+			iRamPage = iNametable;
+
+		SetNametable(iNametable, iRamPage);
+	}
+}
+
+
+void PpuMemoryMap::SetNametable(uint32_t iNametable, uint32_t iRamPage)
+{
+	uint8_t* pRam = (iRamPage < c_consoleNametableCount) ?
+		m_spNametableRam.get() + iRamPage * c_cbPpuPage :
+		m_spFourScreenRam.get() + (iRamPage - c_consoleNametableCount) * c_cbPpuPage;
+
+	m_readPages[c_firstNametablePage + iNametable] = pRam;
+	m_writePages[c_firstNametablePage + iNametable] = pRam;
+
+	// $3000-$3EFF mirrors $2000-$2EFF (the last page's palette part is never looked up here)
+	m_readPages[c_firstNametableMirrorPage + iNametable] = pRam;
+	m_writePages[c_firstNametableMirrorPage + iNametable] = pRam;
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+
+// Page table covering the PPU's 16KB address space in 1KB pages.
+//
+// The pattern tables ($0000-$1FFF) are pointed at the cartridge's CHR banks by the mapper, which re-points them
+// whenever it switches banks.  The nametables ($2000-$2FFF, mirrored at $3000-$3EFF) are pointed into the
+// console's nametable RAM according to the mirroring mode, which comes from the ROM header or the mapper.
+// Every page is then a single indexed load away.  Palette RAM ($3F00-$3FFF) is inside the PPU and never goes
+// through the map; the PPU checks for it before looking a page up.
+//
+// Read-only pages (CHR ROM) have no write pointer, and writes to them are dropped.  Unmapped pages read as zero.
+//
+// Only the page table itself is kept inline.  The nametable RAM is allocated separately, so the table doesn't
+// push the PPU's registers away from the CPU in the NES, and the extra 2KB four screen cartridges carry is only
+// allocated for those.
+
+namespace PPU
+{
+	enum class MirroringMode;
+}
+
+namespace NES
+{
+
+const uint32_t c_ppuPageShift = 10;
+const uint32_t c_cbPpuPage = 1 << c_ppuPageShift; // 1KB
+const uint32_t c_ppuPageMask = c_cbPpuPage - 1;
+const uint32_t c_ppuPageCount = 0x4000 >> c_ppuPageShift;
+
+class PpuMemoryMap
+{
+public:
+	PpuMemoryMap();
+
+	PpuMemoryMap(const PpuMemoryMap&) = delete;
+	PpuMemoryMap& operator=(const PpuMemoryMap&) = delete;
+
+	void Reset();
+
+	// Map cbSize bytes of CHR starting at (page aligned) address ($0000-$1FFF) onto pData.  cbSize must be a multiple of c_cbPpuPage.
+	void MapChrReadOnly(uint16_t address, uint32_t cbSize, const uint8_t* pData);
+	void MapChrReadWrite(uint16_t address, uint32_t cbSize, uint8_t* pData);
+	void UnmapChr(uint16_t address, uint32_t cbSize);
+
+	// Points the nametable pages into nametable RAM.  Four screen mode uses the extra 2KB cartridges supply for it.
+	void SetMirroringMode(PPU::MirroringMode mirroringMode);
+
+	// address must be below $4000.  Returns the page containing it, or null if it isn't mapped (or, for writes, is read-only).
+	const uint8_t* GetReadPage(uint16_t address) const { return m_readPages[address >> c_ppuPageShift]; }
+	uint8_t* GetWritePage(uint16_t address) const { return m_writePages[address >> c_ppuPageShift]; }
+
+	uint8_t Read(uint16_t address) const
+	{
+		const uint8_t* pPage = GetReadPage(address);
+		return (pPage != nullptr) ? pPage[address & c_ppuPageMask] : 0;
+	}
+
+	// Returns whether anything was written
+	bool Write(uint16_t address, uint8_t value)
+	{
+		uint8_t* pPage = GetWritePage(address);
+		if (pPage == nullptr)
+			return false;
+
+		pPage[address & c_ppuPageMask] = value;
+		return true;
+	}
+
+private:
+	void SetChrPages(uint16_t address, uint32_t cbSize, const uint8_t* pReadData, uint8_t* pWriteData);
+	void SetNametable(uint32_t iNametable, uint32_t iRamPage);
+
+	const uint8_t* m_readPages[c_ppuPageCount];
+	uint8_t* m_writePages[c_ppuPageCount];
+
+	std::unique_ptr<uint8_t[]> m_spNametableRam; // The console's 2KB
+	std::unique_ptr<uint8_t[]> m_spFourScreenRam; // The cartridge's 2KB, once four screen mirroring is used
+};
+
+}
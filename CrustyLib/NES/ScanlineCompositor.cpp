@@ -0,0 +1,93 @@
+#include "stdafx.h"
+#include "ScanlineCompositor.h"
+#include "Ppu.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define PPU_COMPOSITOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace PPU
+{
+
+const uint8_t c_pixelPatternBits = 0x03;
+const uint8_t c_pixelPaletteEntry = 0x0F;
+const uint8_t c_spritePaletteBase = 0x10;
+
+
+bool CompositeScanlineScalar(const uint8_t* pBackground, const uint8_t* pSprites, uint8_t* pPaletteAddresses)
+{
+	bool spriteZeroHit = false;
+	for (int iPixel = 0; iPixel != c_displayWidth; ++iPixel)
+	{
+		const uint8_t background = pBackground[iPixel];
+		const uint8_t sprite = pSprites[iPixel];
+
+		const bool isBackgroundOpaque = (background & c_pixelPatternBits) != 0;
+		const bool isSpriteOpaque = (sprite & c_pixelPatternBits) != 0;
+
+		if (isSpriteOpaque && isBackgroundOpaque && (sprite & c_spritePixelZero))
+			spriteZeroHit = true;
+
+		if (isSpriteOpaque && !(isBackgroundOpaque && (sprite & c_spritePixelBehindBackground)))
+			pPaletteAddresses[iPixel] = c_spritePaletteBase | (sprite & c_pixelPaletteEntry);
+		else
+			pPaletteAddresses[iPixel] = isBackgroundOpaque ? (background & c_pixelPaletteEntry) : 0;
+	}
+
+	return spriteZeroHit;
+}
+
+
+#ifdef PPU_COMPOSITOR_SSE2
+
+bool CompositeScanline(const uint8_t* pBackground, const uint8_t* pSprites, uint8_t* pPaletteAddresses)
+{
+	static_assert(c_displayWidth % 16 == 0, "Scanline must be a whole number of vectors");
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i patternBits = _mm_set1_epi8(c_pixelPatternBits);
+	const __m128i paletteEntry = _mm_set1_epi8(c_pixelPaletteEntry);
+	const __m128i spritePaletteBase = _mm_set1_epi8(c_spritePaletteBase);
+	const __m128i behindBackground = _mm_set1_epi8(c_spritePixelBehindBackground);
+	const __m128i spriteZero = _mm_set1_epi8(c_spritePixelZero);
+
+	__m128i spriteZeroHits = zero;
+	for (int iPixel = 0; iPixel != c_displayWidth; iPixel += 16)
+	{
+		const __m128i background = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBackground + iPixel));
+		const __m128i sprite = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSprites + iPixel));
+
+		// All ones in each lane where the condition holds
+		const __m128i isBackgroundTransparent = _mm_cmpeq_epi8(_mm_and_si128(background, patternBits), zero);
+		const __m128i isSpriteTransparent = _mm_cmpeq_epi8(_mm_and_si128(sprite, patternBits), zero);
+		const __m128i isBehindBackground = _mm_cmpeq_epi8(_mm_and_si128(sprite, behindBackground), behindBackground);
+		const __m128i isSpriteZero = _mm_cmpeq_epi8(_mm_and_si128(sprite, spriteZero), spriteZero);
+
+		// Both opaque, and the sprite pixel is sprite 0's
+		spriteZeroHits = _mm_or_si128(spriteZeroHits,
+			_mm_andnot_si128(_mm_or_si128(isBackgroundTransparent, isSpriteTransparent), isSpriteZero));
+
+		// The background shows where the sprite is transparent, or behind an opaque background pixel
+		const __m128i showBackground = _mm_or_si128(isSpriteTransparent, _mm_andnot_si128(isBackgroundTransparent, isBehindBackground));
+
+		const __m128i backgroundAddress = _mm_andnot_si128(isBackgroundTransparent, _mm_and_si128(background, paletteEntry));
+		const __m128i spriteAddress = _mm_or_si128(_mm_and_si128(sprite, paletteEntry), spritePaletteBase);
+
+		const __m128i paletteAddress = _mm_or_si128(_mm_and_si128(showBackground, backgroundAddress), _mm_andnot_si128(showBackground, spriteAddress));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pPaletteAddresses + iPixel), paletteAddress);
+	}
+
+	return _mm_movemask_epi8(spriteZeroHits) != 0;
+}
+
+#else
+
+bool CompositeScanline(const uint8_t* pBackground, const uint8_t* pSprites, uint8_t* pPaletteAddresses)
+{
+	return CompositeScanlineScalar(pBackground, pSprites, pPaletteAddresses);
+}
+
+#endif
+
+}
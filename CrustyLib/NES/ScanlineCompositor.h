@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// Merges a scanline's background and sprites into palette addresses.
+//
+// The background line holds each pixel's palette entry (attribute bits << 2 | pattern bits), where pattern
+// bits of 0 are transparent.  The sprite line holds the front-most opaque sprite pixel in OAM order (0 where
+// there isn't one) as its palette entry plus the flags below.  As on hardware, that sprite pixel is hidden
+// by an opaque background pixel if it's flagged as behind the background, even when a later sprite would
+// have been in front.
+
+namespace PPU
+{
+
+const uint8_t c_spritePixelBehindBackground = 0x20;
+const uint8_t c_spritePixelZero = 0x40;
+
+// Writes the palette address (0-31, with 0 for the backdrop) of each of c_displayWidth pixels to
+// pPaletteAddresses, and returns whether an opaque sprite 0 pixel landed on an opaque background pixel.
+bool CompositeScanline(const uint8_t* pBackground, const uint8_t* pSprites, uint8_t* pPaletteAddresses);
+
+// Same as CompositeScanline, a pixel at a time.  Used where SSE2 isn't available, and as its reference.
+bool CompositeScanlineScalar(const uint8_t* pBackground, const uint8_t* pSprites, uint8_t* pPaletteAddresses);
+
+}
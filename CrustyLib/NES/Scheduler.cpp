@@ -0,0 +1,62 @@
+#include "stdafx.h"
+#include "Scheduler.h"
+
+namespace NES
+{
+
+Scheduler::Scheduler()
+{
+	Reset();
+}
+
+
+void Scheduler::Reset()
+{
+	for (int64_t& eventCycle : m_eventCycles)
+	{
+		eventCycle = c_never;
+	}
+
+	UpdateNextEvent();
+}
+
+
+void Scheduler::Schedule(SchedulerEvent event, int64_t cycle)
+{
+	m_eventCycles[static_cast<int>(event)] = cycle;
+	UpdateNextEvent();
+}
+
+
+void Scheduler::Cancel(SchedulerEvent event)
+{
+	Schedule(event, c_never);
+}
+
+
+bool Scheduler::PopDueEvent(int64_t currentCycle, SchedulerEvent* pEvent)
+{
+	if (m_nextEventCycle > currentCycle)
+		return false;
+
+	*pEvent = m_nextEvent;
+	Cancel(m_nextEvent);
+	return true;
+}
+
+
+void Scheduler::UpdateNextEvent()
+{
+	// Only a handful of event sources, so a linear scan beats maintaining a heap
+	m_nextEventCycle = c_never;
+	for (int iEvent = 0; iEvent != static_cast<int>(SchedulerEvent::Count); ++iEvent)
+	{
+		if (m_eventCycles[iEvent] < m_nextEventCycle)
+		{
+			m_nextEventCycle = m_eventCycles[iEvent];
+			m_nextEvent = static_cast<SchedulerEvent>(iEvent);
+		}
+	}
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+// Master clock scheduler.
+//
+// Everything is timed in CPU cycles.  The CPU runs uninterrupted until the earliest scheduled event,
+// and the owner of an event is then caught up and asked when it next needs attention.  Anything that
+// happens between events (PPU/APU register accesses) syncs the component lazily at the point of access.
+
+namespace NES
+{
+
+enum class SchedulerEvent
+{
+	PpuVBlank,    // Start of vblank (NMI and end of frame)
+	ApuFrameIrq,  // APU frame counter IRQ
+	MapperIrq,    // Scanline/cycle counting mapper IRQ
+	DmcDma,       // APU DMC sample fetches to charge to the CPU
+	Count,
+};
+
+class Scheduler
+{
+public:
+	static const int64_t c_never = INT64_MAX;
+
+	Scheduler();
+
+	Scheduler(const Scheduler&) = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+
+	void Reset();
+
+	void Schedule(SchedulerEvent event, int64_t cycle);
+	void Cancel(SchedulerEvent event);
+
+	int64_t GetNextEventCycle() const { return m_nextEventCycle; }
+
+	// Removes and returns the earliest event due at or before currentCycle, if any
+	bool PopDueEvent(int64_t currentCycle, SchedulerEvent* pEvent);
+
+private:
+	void UpdateNextEvent();
+
+	int64_t m_eventCycles[static_cast<int>(SchedulerEvent::Count)];
+	int64_t m_nextEventCycle = c_never;
+	SchedulerEvent m_nextEvent = SchedulerEvent::PpuVBlank;
+};
+
+}
@@ -0,0 +1,40 @@
+#include "stdafx.h"
+#include "SpriteEvaluator.h"
+#include "Ppu.h"
+
+#include <algorithm>
+
+namespace PPU
+{
+
+SpriteEvaluator::SpriteEvaluator()
+	: m_spScanlines(std::make_unique<ScanlineSprites[]>(c_displayHeight))
+{
+}
+
+
+void SpriteEvaluator::Evaluate(const uint8_t* pOam, int spriteHeight)
+{
+	for (int scanline = 0; scanline != c_displayHeight; ++scanline)
+		m_spScanlines[scanline].count = 0;
+
+	const int c_bytesPerSprite = 4;
+	for (int iSprite = 0; iSprite != c_oamSpriteCount; ++iSprite)
+	{
+		const int spriteY = pOam[iSprite * c_bytesPerSprite + 0];
+		if (spriteY >= c_displayHeight - 2)
+			continue;
+
+		const int lastScanline = std::min(spriteY + spriteHeight, c_displayHeight);
+		for (int scanline = spriteY; scanline != lastScanline; ++scanline)
+		{
+			ScanlineSprites& scanlineSprites = m_spScanlines[scanline];
+			scanlineSprites.oamIndices[scanlineSprites.count++] = static_cast<uint8_t>(iSprite);
+		}
+	}
+
+	m_spriteHeight = spriteHeight;
+	m_isStale = false;
+}
+
+}
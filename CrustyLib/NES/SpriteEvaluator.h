@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+
+// Works out which sprites are on each scanline, the way the PPU fills secondary OAM.
+//
+// Rather than scanning all 64 sprites on every scanline, every scanline's sprites are bucketed in one pass over
+// OAM, and the buckets are reused until OAM (or the sprite height) changes.  Games rewrite OAM about once a frame,
+// so that's roughly one pass a frame.  Buckets keep every sprite in range, not just the first eight, so the
+// renderer can choose to lift the hardware limit.
+
+namespace PPU
+{
+
+const int c_oamSpriteCount = 64;
+const int c_spritesPerScanline = 8; // How many sprites the PPU can show on a scanline
+
+struct ScanlineSprites
+{
+	uint8_t count;                      // Sprites in range, which can be more than c_spritesPerScanline
+	uint8_t oamIndices[c_oamSpriteCount]; // In OAM order, which is also front to back
+
+	bool IsOverflowed() const { return count > c_spritesPerScanline; }
+};
+
+class SpriteEvaluator
+{
+public:
+	SpriteEvaluator();
+
+	SpriteEvaluator(const SpriteEvaluator&) = delete;
+	SpriteEvaluator& operator=(const SpriteEvaluator&) = delete;
+
+	// Call whenever OAM is written
+	void Invalidate()
+	{
+		m_isStale = true;
+	}
+
+	// The sprites in pOam (256 bytes) covering scanline, with sprites spriteHeight pixels tall
+	const ScanlineSprites& GetScanlineSprites(const uint8_t* pOam, int spriteHeight, int scanline)
+	{
+		if (m_isStale || spriteHeight != m_spriteHeight)
+			Evaluate(pOam, spriteHeight);
+
+		return m_spScanlines[scanline];
+	}
+
+private:
+	void Evaluate(const uint8_t* pOam, int spriteHeight);
+
+	std::unique_ptr<ScanlineSprites[]> m_spScanlines;
+	int m_spriteHeight = 0;
+	bool m_isStale = true;
+};
+
+}
@@ -0,0 +1,1100 @@
+// CrustyTool.cpp : Headless command line tools for working on the emulator core
+//
+//  CrustyTool pairstats [--frames N] <rom>...
+//    Runs each ROM and reports how often each opcode is followed by another in straight line code, which is what
+//    Cpu6502's table of fused instruction pairs is picked from, along with the dispatches per frame with and
+//    without fusion.  Pairs are ranked by how many of the ROMs they're hot in (at least 0.25% of the ROM's
+//    instructions), then by their average share, so one game's inner loop doesn't crowd out common idioms.
+//
+//  CrustyTool trace [--frames N] [--backend B] [--pc XXXX] <rom> <trace file>
+//    Runs the ROM, recording every instruction to a binary trace file (as CrustyWin32's logging does).  With
+//    --backend (interpreter, blocks or native) the ROM runs on that CPU backend, and only the state between the
+//    backend's steps is recorded (see CpuTraceDetail).  --pc starts at that address rather than the reset vector.
+//
+//  CrustyTool tracefmt <trace file>
+//    Prints a trace in the format of nestest.log.
+//
+//  CrustyTool tracediff [--cpu-only] [--frames N] [--backend B] [--pc XXXX] <trace file | rom> <reference log>
+//    Compares a trace against a log in nestest.log format, stopping at the first difference.  Cycle counts and PPU
+//    positions are compared relative to the first line, so logs which start from a different reset state still
+//    match; --cpu-only ignores them altogether.  Given a ROM, it's traced as it runs (as trace would).  Records of a
+//    backend's steps are lined up with the log by cycle, skipping the lines run inside blocks, so they need a log
+//    with CPU cycles.  E.g. to check the native backend against nestest's automated mode, or the interpreter:
+//      CrustyTool tracediff --backend native --pc C000 nestest.nes nestest.log
+//      CrustyTool trace --backend interpreter game.nes game.trace && CrustyTool tracefmt game.trace > game.log
+//      CrustyTool tracediff --backend native game.nes game.log
+//
+//  CrustyTool profile [--frames N] [--top N] <rom> <report.json | report.csv>
+//    Profiles where the game spends its cycles, printing the hottest addresses and loops and writing the full
+//    report.  For a .csv report the tables go to report.addresses.csv, report.loops.csv and report.frames.csv.
+//
+//  CrustyTool batch [--frames N] [--consoles N] [--backend B] <rom>
+//    Runs N copies of the ROM side by side in an NESBatch, each tapping Start at a different time so they don't all
+//    do the same thing, and reports the total frames per second against a single console running alone, with the
+//    consoles run one after another and in lockstep.  Lockstep needs the blocks or native backend.
+//
+//  CrustyTool framehash [--frames N] [--every N] <rom>
+//    Prints a hash of the ROM file, then a hash of the pixels of every Nth frame.  It only needs NES's public
+//    interface, so it can be built against older versions of the core to record what their renderer drew.
+//
+//  CrustyTool rendercheck [--lines N] [<rom>]
+//    Checks the PPU's scanline compositor.  N random background and sprite lines (100000 by default) go through
+//    both CompositeScanline and CompositeScanlineScalar, which have to agree on every palette address and on
+//    sprite 0 hits.  Then a built-in scene of overlapping sprites checks the sprite priority quirk, where the
+//    first sprite wins priority even when it's behind the background.  Given a ROM with recorded frame hashes
+//    (CrustyUWP's Donkey Kong Jr.), it's run and compared with what the renderer before compositing drew.
+
+#include "stdafx.h"
+#include "NES\NES.h"
+#include "NES\CpuTrace.h"
+#include "NES\CpuProfiler.h"
+#include "NES\NESBatch.h"
+#include "NES\ScanlineCompositor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string.h>
+
+
+class CStdioReadOnlyFile : public IReadableFile
+{
+public:
+	CStdioReadOnlyFile(const char* szFileName)
+	{
+		if (fopen_s(&m_pFile, szFileName, "rb") != 0)
+			m_pFile = nullptr;
+	}
+
+	virtual ~CStdioReadOnlyFile() override
+	{
+		if (m_pFile != nullptr)
+			fclose(m_pFile);
+	}
+
+	virtual void Read(uint32_t cbRead, _Out_writes_bytes_(cbRead) byte* pBuffer) override
+	{
+		if (fread(pBuffer, 1, cbRead, m_pFile) != cbRead)
+			throw std::runtime_error("File Read fatal error");
+	}
+
+	bool IsValid() const
+	{
+		return (m_pFile != nullptr);
+	}
+
+private:
+	FILE* m_pFile = nullptr;
+};
+
+
+const int c_defaultFrameCount = 3600; // A minute of play
+const int c_startPressInterval = 240; // Frames between presses of Start, to get past title screens
+const int c_topPairCount = 40;
+const double c_hotPairShare = 0.0025; // Of a ROM's instructions
+const size_t c_traceRecordsPerRead = 64 * 1024;
+const int c_ppuCyclesPerScanline = 341;
+const int c_ppuCyclesPerFrame = 262 * c_ppuCyclesPerScanline;
+const int c_maxStepInstructions = 64; // A decoded block of 32 fused pairs, the most a backend step runs
+const int c_defaultProfileTopCount = 100; // Rows of each table in the report
+const size_t c_profileSummaryCount = 10;  // Rows of each table printed
+const int c_defaultBatchFrameCount = 600;
+const int c_defaultBatchConsoleCount = 16;
+const int c_defaultRenderCheckLineCount = 100000;
+
+
+// How trace, tracediff and batch run the ROM
+struct RunOptions
+{
+	bool isBackendSet = false;
+	CPU::CpuBackend backend = CPU::CpuBackend::DecodedBlocks;
+	int startPc = -1; // Or the reset vector
+};
+
+
+bool ParseBackend(const std::string& name, CPU::CpuBackend* pBackend)
+{
+	if (name == "interpreter")
+		*pBackend = CPU::CpuBackend::Interpreter;
+	else if (name == "blocks")
+		*pBackend = CPU::CpuBackend::DecodedBlocks;
+	else if (name == "native")
+		*pBackend = CPU::CpuBackend::Native;
+	else
+		return false;
+
+	return true;
+}
+
+
+std::unique_ptr<NES::NES> LoadRom(const char* szRomFile)
+{
+	CStdioReadOnlyFile romFile(szRomFile);
+	if (!romFile.IsValid())
+		throw std::runtime_error(std::string("Couldn't open ") + szRomFile);
+
+	auto spNes = std::make_unique<NES::NES>();
+	spNes->GetApu().EnableSound(false);
+	spNes->LoadRomFile(&romFile);
+	spNes->Reset();
+	return spNes;
+}
+
+
+// After a reset (which LoadRom does)
+void ApplyRunOptions(NES::NES& nes, const RunOptions& options)
+{
+	if (options.isBackendSet)
+		nes.GetCpu().SetBackend(options.backend);
+	if (options.startPc != -1)
+		nes.GetCpu().SetProgramCounter(static_cast<uint16_t>(options.startPc));
+}
+
+
+CPU::CpuTraceDetail GetTraceDetail(const RunOptions& options)
+{
+	return options.isBackendSet ? CPU::CpuTraceDetail::BackendSteps : CPU::CpuTraceDetail::EveryInstruction;
+}
+
+
+bool IsStartPressed(int frame)
+{
+	return (frame % c_startPressInterval) >= c_startPressInterval - 4;
+}
+
+
+// Runs frameCount frames with no input other than tapping Start now and then, returning the total dispatches.
+// firstFrame is how many frames have already been run, when running a few at a time.
+uint64_t RunFrames(NES::NES& nes, int frameCount, int firstFrame = 0)
+{
+	uint64_t dispatches = 0;
+	for (int frame = firstFrame; frame != firstFrame + frameCount; ++frame)
+	{
+		nes.UseController1().SetInputStatus(NES::ControllerInput::Start, IsStartPressed(frame));
+
+		dispatches += nes.RunFrame().dispatches;
+		nes.GetApu().PushAudio();
+	}
+
+	return dispatches;
+}
+
+
+/*----- pairstats -----*/
+
+int RunPairStats(const std::vector<const char*>& romFiles, int frameCount)
+{
+	std::vector<uint64_t> pairCounts(256 * 256, 0);
+	std::vector<double> pairShares(256 * 256, 0.0); // Summed over the ROMs, each as a share of that ROM's instructions
+	std::vector<uint32_t> hotRomCounts(256 * 256, 0);
+	uint64_t totalInstructions = 0;
+
+	printf("%-40s %12s %12s %12s\n", "ROM", "instr/frame", "dispatches", "fused");
+	for (const char* szRomFile : romFiles)
+	{
+		// Gather the pairs from the interpreter...
+		std::unique_ptr<NES::NES> spNes = LoadRom(szRomFile);
+		CPU::Cpu6502& cpu = spNes->GetCpu();
+		cpu.EnableOpCodePairProfiling(true);
+		RunFrames(*spNes, frameCount);
+
+		for (uint32_t pair = 0; pair != pairCounts.size(); ++pair)
+		{
+			const uint64_t count = cpu.GetOpCodePairCount(static_cast<uint8_t>(pair >> 8), static_cast<uint8_t>(pair));
+			const double share = (cpu.GetInstructionCount() != 0) ? static_cast<double>(count) / cpu.GetInstructionCount() : 0.0;
+
+			pairCounts[pair] += count;
+			pairShares[pair] += share;
+			if (share >= c_hotPairShare)
+				hotRomCounts[pair]++;
+		}
+		totalInstructions += cpu.GetInstructionCount();
+
+		// ...then compare the dispatches it takes with and without fusing them
+		const double instructionsPerFrame = static_cast<double>(cpu.GetInstructionCount()) / frameCount;
+
+		spNes = LoadRom(szRomFile);
+		spNes->GetCpu().EnableInstructionFusion(false);
+		const double unfusedDispatchesPerFrame = static_cast<double>(RunFrames(*spNes, frameCount)) / frameCount;
+
+		spNes = LoadRom(szRomFile);
+		const double fusedDispatchesPerFrame = static_cast<double>(RunFrames(*spNes, frameCount)) / frameCount;
+
+		printf("%-40s %12.0f %12.0f %12.0f\n", szRomFile, instructionsPerFrame, unfusedDispatchesPerFrame, fusedDispatchesPerFrame);
+	}
+
+	std::vector<uint32_t> sortedPairs;
+	for (uint32_t pair = 0; pair != pairCounts.size(); ++pair)
+	{
+		if (pairCounts[pair] != 0)
+			sortedPairs.push_back(pair);
+	}
+
+	std::sort(sortedPairs.begin(), sortedPairs.end(), [&](uint32_t left, uint32_t right)
+	{
+		if (hotRomCounts[left] != hotRomCounts[right])
+			return hotRomCounts[left] > hotRomCounts[right];
+		return pairShares[left] > pairShares[right];
+	});
+	if (sortedPairs.size() > c_topPairCount)
+		sortedPairs.resize(c_topPairCount);
+
+	printf("\n%-8s %14s %8s %8s %6s\n", "pair", "count", "% instr", "avg %", "hot in");
+	for (uint32_t pair : sortedPairs)
+	{
+		printf("%02X %02X    %14llu %7.2f%% %7.2f%% %6u\n", pair >> 8, pair & 0xFF, pairCounts[pair], 100.0 * pairCounts[pair] / totalInstructions,
+			100.0 * pairShares[pair] / romFiles.size(), hotRomCounts[pair]);
+	}
+
+	return 0;
+}
+
+
+/*----- trace, tracefmt, tracediff
+
+ Trace files are just CpuTraceRecords back to back. -----*/
+
+class TraceFileReader
+{
+public:
+	TraceFileReader(const char* szTraceFile)
+		: m_spRecords(std::make_unique<CPU::CpuTraceRecord[]>(c_traceRecordsPerRead))
+	{
+		if (fopen_s(&m_pFile, szTraceFile, "rb") != 0)
+			throw std::runtime_error(std::string("Couldn't open ") + szTraceFile);
+	}
+
+	~TraceFileReader()
+	{
+		fclose(m_pFile);
+	}
+
+	bool ReadNext(CPU::CpuTraceRecord* pRecord)
+	{
+		if (m_nextRecord == m_recordCount)
+		{
+			m_recordCount = fread(m_spRecords.get(), sizeof(CPU::CpuTraceRecord), c_traceRecordsPerRead, m_pFile);
+			m_nextRecord = 0;
+			if (m_recordCount == 0)
+				return false;
+		}
+
+		*pRecord = m_spRecords[m_nextRecord++];
+		return true;
+	}
+
+private:
+	FILE* m_pFile = nullptr;
+	std::unique_ptr<CPU::CpuTraceRecord[]> m_spRecords;
+	size_t m_recordCount = 0;
+	size_t m_nextRecord = 0;
+};
+
+
+// Runs a ROM with tracing on, a frame at a time as its records are read
+class RomTracer
+{
+public:
+	RomTracer(const char* szRomFile, int frameCount, const RunOptions& options)
+		: m_spNes(LoadRom(szRomFile))
+		, m_spRecords(std::make_unique<CPU::CpuTraceRecord[]>(c_traceRecordsPerRead))
+		, m_framesLeft(frameCount)
+	{
+		ApplyRunOptions(*m_spNes, options);
+		m_spNes->GetCpu().SetTraceBuffer(&m_traceBuffer, GetTraceDetail(options));
+	}
+
+	~RomTracer()
+	{
+		m_spNes->GetCpu().SetTraceBuffer(nullptr);
+	}
+
+	bool ReadNext(CPU::CpuTraceRecord* pRecord)
+	{
+		while (m_nextRecord == m_recordCount)
+		{
+			m_recordCount = m_traceBuffer.Read(m_spRecords.get(), c_traceRecordsPerRead);
+			m_nextRecord = 0;
+			if (m_recordCount != 0)
+				break;
+
+			if (m_framesLeft == 0)
+				return false;
+
+			// Whatever the game hits that the CPU can't run (an unofficial opcode, say) ends the trace there
+			try
+			{
+				RunFrames(*m_spNes, 1);
+				m_framesLeft--;
+			}
+			catch (const std::exception& ex)
+			{
+				printf("the ROM stopped running: %s\n", ex.what());
+				m_framesLeft = 0;
+				m_hasStopped = true;
+			}
+
+			if (m_traceBuffer.GetDroppedCount() != 0)
+				throw std::runtime_error("The trace buffer overflowed");
+		}
+
+		*pRecord = m_spRecords[m_nextRecord++];
+		return true;
+	}
+
+	// Whether the ROM hit something the CPU couldn't run before the frames were up
+	bool HasStopped() const { return m_hasStopped; }
+
+private:
+	std::unique_ptr<NES::NES> m_spNes;
+	CPU::CpuTraceBuffer m_traceBuffer;
+	std::unique_ptr<CPU::CpuTraceRecord[]> m_spRecords;
+	size_t m_recordCount = 0;
+	size_t m_nextRecord = 0;
+	int m_framesLeft;
+	bool m_hasStopped = false;
+};
+
+
+int RunTrace(const char* szRomFile, const char* szTraceFile, int frameCount, const RunOptions& options)
+{
+	FILE* pTraceFile;
+	if (fopen_s(&pTraceFile, szTraceFile, "wb") != 0)
+		throw std::runtime_error(std::string("Couldn't create ") + szTraceFile);
+
+	CPU::CpuTraceBuffer traceBuffer;
+	auto spRecords = std::make_unique<CPU::CpuTraceRecord[]>(c_traceRecordsPerRead);
+	uint64_t recordCount = 0;
+
+	std::unique_ptr<NES::NES> spNes = LoadRom(szRomFile);
+	ApplyRunOptions(*spNes, options);
+	spNes->GetCpu().SetTraceBuffer(&traceBuffer, GetTraceDetail(options));
+
+	for (int frame = 0; frame != frameCount; ++frame)
+	{
+		RunFrames(*spNes, 1);
+
+		for (;;)
+		{
+			const size_t readCount = traceBuffer.Read(spRecords.get(), c_traceRecordsPerRead);
+			if (readCount == 0)
+				break;
+
+			fwrite(spRecords.get(), sizeof(CPU::CpuTraceRecord), readCount, pTraceFile);
+			recordCount += readCount;
+		}
+	}
+
+	fclose(pTraceFile);
+
+	printf("%llu %s traced, %llu dropped\n", recordCount, options.isBackendSet ? "steps" : "instructions", traceBuffer.GetDroppedCount());
+	return (traceBuffer.GetDroppedCount() == 0) ? 0 : 1;
+}
+
+
+int RunTraceFormat(const char* szTraceFile)
+{
+	TraceFileReader reader(szTraceFile);
+
+	CPU::CpuTraceRecord record;
+	while (reader.ReadNext(&record))
+		printf("%s\n", CPU::FormatTraceRecord(record).c_str());
+
+	return 0;
+}
+
+
+int GetPpuPosition(const CPU::CpuTraceRecord& record)
+{
+	return (record.ppuScanline + 1) * c_ppuCyclesPerScanline + record.ppuDot;
+}
+
+
+bool IsRomFile(const std::string& fileName)
+{
+	const size_t extensionOffset = fileName.rfind('.');
+	if (extensionOffset == std::string::npos)
+		return false;
+
+	std::string extension = fileName.substr(extensionOffset);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+	return extension == ".nes";
+}
+
+
+int RunTraceDiff(const std::function<bool(CPU::CpuTraceRecord*)>& readTrace, const char* szReferenceLog, bool isCpuOnly)
+{
+	FILE* pReferenceLog;
+	if (fopen_s(&pReferenceLog, szReferenceLog, "r") != 0)
+		throw std::runtime_error(std::string("Couldn't open ") + szReferenceLog);
+
+	std::string previousLine;
+	CPU::CpuTraceRecord firstActual = {};
+	CPU::CpuTraceRecord firstExpected = {};
+	CPU::CpuTraceRecord traced = {};
+	bool hasTraced = false;
+	char szReferenceLine[256];
+	int lineNumber = 0;
+	int tracedCount = 0;
+	int untracedTailCount = 0; // Lines after the end of a trace of the backend's steps
+	int result = 0;
+
+	while (fgets(szReferenceLine, _countof(szReferenceLine), pReferenceLog) != nullptr)
+	{
+		lineNumber++;
+		szReferenceLine[strcspn(szReferenceLine, "\r\n")] = '\0';
+
+		CPU::CpuTraceRecord expected;
+		if (!CPU::ParseTraceLine(szReferenceLine, &expected))
+		{
+			printf("line %d: can't parse reference log: %s\n", lineNumber, szReferenceLine);
+			result = 1;
+			break;
+		}
+
+		if (untracedTailCount != 0 || (!hasTraced && !readTrace(&traced)))
+		{
+			// The last step's block may have run on past the last record
+			if (traced.detail == CPU::CpuTraceDetail::BackendSteps && untracedTailCount < c_maxStepInstructions)
+			{
+				untracedTailCount++;
+				continue;
+			}
+
+			printf("line %d: trace ends before the reference log\n", lineNumber - untracedTailCount);
+			result = 1;
+			break;
+		}
+		hasTraced = true;
+
+		// Round trip through the text format, so only the instruction bytes shown in the log are compared
+		const std::string actualLine = CPU::FormatTraceRecord(traced);
+		CPU::CpuTraceRecord actual;
+		CPU::ParseTraceLine(actualLine.c_str(), &actual);
+
+		if (lineNumber == 1)
+		{
+			firstActual = actual;
+			firstExpected = expected;
+		}
+		else if (traced.detail == CPU::CpuTraceDetail::BackendSteps)
+		{
+			// The instructions since the last step ran inside a block, so skip their lines to the one this step is at
+			if (expected.cycle == -1)
+			{
+				printf("line %d: the reference log has no CPU cycles to line the backend's steps up with\n", lineNumber);
+				result = 1;
+				break;
+			}
+
+			if (actual.cycle - firstActual.cycle > expected.cycle - firstExpected.cycle)
+				continue;
+		}
+
+		bool isMatch = (actual.pc == expected.pc) && (actual.opCode == expected.opCode) &&
+			(actual.operands[0] == expected.operands[0]) && (actual.operands[1] == expected.operands[1]) &&
+			(actual.a == expected.a) && (actual.x == expected.x) && (actual.y == expected.y) &&
+			(actual.p == expected.p) && (actual.sp == expected.sp);
+
+		if (!isCpuOnly)
+		{
+			if (expected.cycle != -1)
+				isMatch &= (actual.cycle - firstActual.cycle == expected.cycle - firstExpected.cycle);
+
+			const int ppuDelta = GetPpuPosition(actual) - GetPpuPosition(firstActual) - (GetPpuPosition(expected) - GetPpuPosition(firstExpected));
+			isMatch &= (ppuDelta % c_ppuCyclesPerFrame == 0);
+		}
+
+		if (!isMatch)
+		{
+			printf("line %d differs\n", lineNumber);
+			if (!previousLine.empty())
+				printf("  previous: %s\n", previousLine.c_str());
+			printf("  expected: %s\n", szReferenceLine);
+			printf("  actual:   %s\n", actualLine.c_str());
+			result = 1;
+			break;
+		}
+
+		previousLine = actualLine;
+		hasTraced = false;
+		tracedCount++;
+	}
+
+	fclose(pReferenceLog);
+
+	if (result == 0 && tracedCount == lineNumber)
+		printf("%d lines match\n", lineNumber);
+	else if (result == 0)
+		printf("%d lines match (%d of them traced, the rest ran inside blocks)\n", lineNumber - untracedTailCount, tracedCount);
+	return result;
+}
+
+
+int RunTraceDiff(const char* szTraceOrRomFile, const char* szReferenceLog, bool isCpuOnly, int frameCount, const RunOptions& options)
+{
+	if (IsRomFile(szTraceOrRomFile))
+	{
+		RomTracer tracer(szTraceOrRomFile, frameCount, options);
+		const int result = RunTraceDiff([&](CPU::CpuTraceRecord* pRecord) { return tracer.ReadNext(pRecord); }, szReferenceLog, isCpuOnly);
+		return tracer.HasStopped() ? 1 : result;
+	}
+
+	TraceFileReader reader(szTraceOrRomFile);
+	return RunTraceDiff([&](CPU::CpuTraceRecord* pRecord) { return reader.ReadNext(pRecord); }, szReferenceLog, isCpuOnly);
+}
+
+
+/*----- profile -----*/
+
+void WriteProfileFile(const std::string& fileName, const std::function<void(std::ostream&)>& write)
+{
+	std::ofstream output(fileName);
+	if (!output)
+		throw std::runtime_error("Couldn't create " + fileName);
+
+	write(output);
+}
+
+
+int RunProfile(const char* szRomFile, const std::string& reportFile, int frameCount, int topCount)
+{
+	std::unique_ptr<NES::NES> spNes = LoadRom(szRomFile);
+	const NES::NESRom& rom = spNes->GetRom();
+	CPU::CpuProfiler profiler(rom.GetPrgRom(), rom.GetCbPrgRom());
+	spNes->GetCpu().SetProfiler(&profiler);
+
+	for (int frame = 0; frame != frameCount; ++frame)
+	{
+		RunFrames(*spNes, 1);
+		profiler.EndFrame();
+	}
+
+	const double totalCycles = static_cast<double>(profiler.GetTotalCycles());
+
+	printf("%-8s %-6s %-6s %14s %14s %8s\n", "prg", "bank", "pc", "executions", "cycles", "% cycles");
+	for (const CPU::ProfiledAddress& address : profiler.GetHotAddresses(c_profileSummaryCount))
+	{
+		char szPrgOffset[16] = "-";
+		if (address.prgOffset != CPU::CpuProfiler::c_notInPrgRom)
+			sprintf_s(szPrgOffset, _countof(szPrgOffset), "%06X", address.prgOffset);
+
+		printf("%-8s %-6u %04X   %14llu %14llu %7.2f%%\n", szPrgOffset, address.bank, address.pc, address.executions, address.cycles,
+			100.0 * address.cycles / totalCycles);
+	}
+
+	printf("\n%-6s %-11s %14s %14s %8s\n", "bank", "loop", "iterations", "cycles", "% cycles");
+	for (const CPU::ProfiledLoop& loop : profiler.GetHotLoops(c_profileSummaryCount))
+	{
+		printf("%-6u %04X-%04X  %14llu %14llu %7.2f%%\n", loop.bank, loop.startPc, loop.endPc, loop.iterations, loop.cycles,
+			100.0 * loop.cycles / totalCycles);
+	}
+
+	const size_t extensionOffset = reportFile.rfind('.');
+	const std::string extension = (extensionOffset != std::string::npos) ? reportFile.substr(extensionOffset) : "";
+	const std::string baseName = reportFile.substr(0, extensionOffset);
+
+	if (extension == ".csv")
+	{
+		WriteProfileFile(baseName + ".addresses.csv", [&](std::ostream& output) { profiler.WriteCsv(CPU::ProfileTable::HotAddresses, output, topCount); });
+		WriteProfileFile(baseName + ".loops.csv", [&](std::ostream& output) { profiler.WriteCsv(CPU::ProfileTable::Loops, output, topCount); });
+		WriteProfileFile(baseName + ".frames.csv", [&](std::ostream& output) { profiler.WriteCsv(CPU::ProfileTable::Frames, output, topCount); });
+	}
+	else
+	{
+		WriteProfileFile(reportFile, [&](std::ostream& output) { profiler.WriteJson(output, topCount); });
+	}
+
+	return 0;
+}
+
+
+/*----- batch -----*/
+
+double GetSecondsSince(std::chrono::steady_clock::time_point startTime)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+
+int RunBatch(const char* szRomFile, int frameCount, int consoleCount, const RunOptions& options)
+{
+	// A single console first, for comparison
+	std::unique_ptr<NES::NES> spNes = LoadRom(szRomFile);
+	ApplyRunOptions(*spNes, options);
+	auto startTime = std::chrono::steady_clock::now();
+	RunFrames(*spNes, frameCount);
+	const double singleFps = frameCount / GetSecondsSince(startTime);
+
+	CStdioReadOnlyFile romFile(szRomFile);
+	if (!romFile.IsValid())
+		throw std::runtime_error(std::string("Couldn't open ") + szRomFile);
+
+	NES::NESBatch batch(&romFile, static_cast<uint32_t>(consoleCount));
+	for (int console = 0; console != consoleCount; ++console)
+		ApplyRunOptions(batch.GetConsole(console), options);
+
+	// Each way of running the batch starts over from a reset, with the same input
+	auto runBatch = [&](bool isLockstepEnabled, uint64_t* pInstructions) -> double
+	{
+		batch.Reset();
+		batch.EnableLockstep(isLockstepEnabled);
+
+		*pInstructions = 0;
+		const auto batchStartTime = std::chrono::steady_clock::now();
+		for (int frame = 0; frame != frameCount; ++frame)
+		{
+			for (int console = 0; console != consoleCount; ++console)
+				batch.GetConsole(console).UseController1().SetInputStatus(NES::ControllerInput::Start, IsStartPressed(frame + console * 7));
+
+			for (const NES::FrameStats& stats : batch.RunFrame())
+				*pInstructions += stats.instructions;
+		}
+		return GetSecondsSince(batchStartTime);
+	};
+
+	uint64_t independentInstructions = 0;
+	const double independentSeconds = runBatch(false, &independentInstructions);
+	const double independentFps = static_cast<double>(frameCount) * consoleCount / independentSeconds;
+
+	uint64_t instructions = 0;
+	const double batchSeconds = runBatch(true, &instructions);
+	const double batchFps = static_cast<double>(frameCount) * consoleCount / batchSeconds;
+
+	printf("%-24s %12s %14s\n", "", "frames/sec", "instr/sec");
+	printf("%-24s %12.1f\n", "single console", singleFps);
+	printf("%-24s %12.1f %14.0f\n", (std::to_string(consoleCount) + " consoles").c_str(), independentFps, independentInstructions / independentSeconds);
+	printf("%-24s %12.1f %14.0f\n", (std::to_string(consoleCount) + " consoles, lockstep").c_str(), batchFps, instructions / batchSeconds);
+	printf("\n%.2fx a single console's throughput (%.2fx without lockstep)\n", batchFps / singleFps, independentFps / singleFps);
+	printf("%zu bytes of CPU/PPU state per console (the APU, mapper and frame buffers are allocated separately)\n", sizeof(NES::NES));
+	return 0;
+}
+
+
+/*----- framehash, rendercheck
+
+ Frame hashes are FNV-1a over the RGB frame buffer, which every version of the PPU has had, so hashes recorded
+ from an older renderer can be compared with the current one. -----*/
+
+const int c_recordedFrameInterval = 100;
+const int c_spritePrioritySceneFrame = 8; // Once the scene is set up and a whole frame has been drawn
+
+// What the current renderer draws.  The renderer from before scanline compositing drew sprite 1 over the
+// overlap on the background (A41177BA3AB6F7E5); hardware, and now the compositor, show the background there.
+const uint64_t c_spritePrioritySceneHash = 0x158E49CFF921A165ull;
+
+struct RecordedFrameHashes
+{
+	const char* szName;
+	uint64_t romHash; // Of the whole .nes file
+	uint64_t frameHashes[10]; // Every c_recordedFrameInterval frames, run as RunFrames does
+};
+
+// Recorded with framehash built against the renderer from before scanline compositing, with the later OAM DMA
+// timing fix applied to that core so the frames can only differ where the renderers do.  Re-record them the same
+// way when emulation changes on purpose.
+const RecordedFrameHashes c_recordedFrameHashes[] = {
+	{ "Donkey Kong Jr.", 0x478E881AB8580946ull, {
+		0xBFF1AE513367D338ull, 0xBFF1AE513367D338ull,
+		0xBFF1AE513367D338ull, 0x6CEB6D0E204EA325ull,
+		0x8860439B06CC22ABull, 0x8E633D3678A5A1C5ull,
+		0x8E633D3678A5A1C5ull, 0xF1B8F2F96562C83Dull,
+		0x48D2E6F24562883Cull, 0xE9CD0644B335930Bull } },
+};
+
+
+class CMemoryReadOnlyFile : public IReadableFile
+{
+public:
+	CMemoryReadOnlyFile(const std::vector<uint8_t>& data)
+		: m_data(data)
+	{
+	}
+
+	virtual void Read(uint32_t cbRead, _Out_writes_bytes_(cbRead) byte* pBuffer) override
+	{
+		if (m_offset + cbRead > m_data.size())
+			throw std::runtime_error("File Read fatal error");
+
+		memcpy(pBuffer, m_data.data() + m_offset, cbRead);
+		m_offset += cbRead;
+	}
+
+private:
+	const std::vector<uint8_t>& m_data;
+	size_t m_offset = 0;
+};
+
+
+uint64_t HashBytes(const void* pData, size_t cbData)
+{
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (size_t offset = 0; offset != cbData; ++offset)
+		hash = (hash ^ pBytes[offset]) * 0x100000001B3ull;
+
+	return hash;
+}
+
+
+uint64_t HashFrame(NES::NES& nes)
+{
+	const PPU::ppuDisplayBuffer_t& frame = nes.GetPpu().GetDisplayBuffer();
+	return HashBytes(&frame[0][0], sizeof(frame));
+}
+
+
+uint64_t HashRomFile(const char* szRomFile)
+{
+	std::ifstream romFile(szRomFile, std::ios::binary);
+	if (!romFile)
+		throw std::runtime_error(std::string("Couldn't open ") + szRomFile);
+
+	const std::vector<char> data((std::istreambuf_iterator<char>(romFile)), std::istreambuf_iterator<char>());
+	return HashBytes(data.data(), data.size());
+}
+
+
+// Runs the ROM as RunFrames does, calling onFrame with the hash of every interval'th frame
+void HashFrames(const char* szRomFile, int frameCount, int interval, const std::function<void(int, uint64_t)>& onFrame)
+{
+	std::unique_ptr<NES::NES> spNes = LoadRom(szRomFile);
+	for (int frame = 0; frame != frameCount; ++frame)
+	{
+		RunFrames(*spNes, 1, frame);
+		if ((frame + 1) % interval == 0)
+			onFrame(frame + 1, HashFrame(*spNes));
+	}
+}
+
+
+int RunFrameHash(const char* szRomFile, int frameCount, int interval)
+{
+	printf("rom %016llx\n", HashRomFile(szRomFile));
+	HashFrames(szRomFile, frameCount, interval, [](int frame, uint64_t hash) { printf("frame %d %016llx\n", frame, hash); });
+	return 0;
+}
+
+
+// Random background and sprite lines, as RenderScanline builds them, must composite the same both ways
+int CheckCompositorLines(int lineCount)
+{
+	std::mt19937 random(1);
+	uint8_t backgroundLine[PPU::c_displayWidth];
+	uint8_t spriteLine[PPU::c_displayWidth];
+	uint8_t vectorAddresses[PPU::c_displayWidth];
+	uint8_t scalarAddresses[PPU::c_displayWidth];
+	int spriteZeroHitCount = 0;
+
+	for (int line = 0; line != lineCount; ++line)
+	{
+		// Palette entries, with sprites over about half the line
+		for (int x = 0; x != PPU::c_displayWidth; ++x)
+		{
+			const uint32_t bits = random();
+			backgroundLine[x] = static_cast<uint8_t>(bits & 0x0F);
+			spriteLine[x] = (bits & 0x100) ? static_cast<uint8_t>((bits >> 4) & (0x0F | PPU::c_spritePixelBehindBackground)) : 0;
+		}
+
+		// Sprite 0 is in front on about half the lines, covering up to 8 pixels
+		if (random() & 1)
+		{
+			const int spriteX = static_cast<int>(random() % PPU::c_displayWidth);
+			for (int x = spriteX; x != std::min(spriteX + 8, PPU::c_displayWidth); ++x)
+			{
+				if (spriteLine[x] != 0)
+					spriteLine[x] |= PPU::c_spritePixelZero;
+			}
+		}
+
+		const bool vectorHit = PPU::CompositeScanline(backgroundLine, spriteLine, vectorAddresses);
+		const bool scalarHit = PPU::CompositeScanlineScalar(backgroundLine, spriteLine, scalarAddresses);
+		if (vectorHit != scalarHit)
+		{
+			printf("random line %d: sprite 0 hit is %d, the scalar compositor says %d\n", line, vectorHit, scalarHit);
+			return 1;
+		}
+
+		const int mismatchX = static_cast<int>(std::mismatch(vectorAddresses, std::end(vectorAddresses), scalarAddresses).first - vectorAddresses);
+		if (mismatchX != PPU::c_displayWidth)
+		{
+			printf("random line %d: pixel %d has palette address %d, the scalar compositor says %d\n", line, mismatchX,
+				vectorAddresses[mismatchX], scalarAddresses[mismatchX]);
+			return 1;
+		}
+
+		spriteZeroHitCount += scalarHit ? 1 : 0;
+	}
+
+	printf("%d random lines composite the same (%d with a sprite 0 hit)\n", lineCount, spriteZeroHitCount);
+	return 0;
+}
+
+
+/* An NROM cartridge which draws a scene showing the sprite priority quirk: sprite 0, flagged as behind the
+   background, overlaps sprite 1, which is in front.  Where both cover an opaque background pixel, the first
+   sprite wins priority and then hides behind the background, so the background shows through sprite 1.  The
+   upper half of the screen is opaque background and the lower half transparent, with a pair of sprites in each. */
+std::vector<uint8_t> BuildSpritePriorityRom()
+{
+	const uint32_t c_cbPrgRom = 16 * 1024;
+	const uint16_t c_prgRomBase = 0xC000;
+
+	static const uint8_t c_header[16] = { 'N', 'E', 'S', 0x1A, 1 /*16K PRG*/, 1 /*8K CHR*/ };
+
+	static const uint8_t c_code[] = {
+		0x78,                   // C000 SEI
+		0xD8,                   // C001 CLD
+		0xA2, 0xFF,             // C002 LDX #$FF
+		0x9A,                   // C004 TXS
+		0x2C, 0x02, 0x20,       // C005 BIT $2002   ; Wait for the PPU to warm up
+		0x10, 0xFB,             // C008 BPL $C005
+		0x2C, 0x02, 0x20,       // C00A BIT $2002
+		0x10, 0xFB,             // C00D BPL $C00A
+		0xA9, 0x3F,             // C00F LDA #$3F    ; Palettes from $C080
+		0x8D, 0x06, 0x20,       // C011 STA $2006
+		0xA9, 0x00,             // C014 LDA #$00
+		0x8D, 0x06, 0x20,       // C016 STA $2006
+		0xA2, 0x00,             // C019 LDX #$00
+		0xBD, 0x80, 0xC0,       // C01B LDA $C080,X
+		0x8D, 0x07, 0x20,       // C01E STA $2007
+		0xE8,                   // C021 INX
+		0xE0, 0x20,             // C022 CPX #$20
+		0xD0, 0xF5,             // C024 BNE $C01B
+		0xA9, 0x20,             // C026 LDA #$20    ; Nametable 0: 16 rows of tile 1, then tile 0 and attributes
+		0x8D, 0x06, 0x20,       // C028 STA $2006
+		0xA9, 0x00,             // C02B LDA #$00
+		0x8D, 0x06, 0x20,       // C02D STA $2006
+		0xA2, 0x00,             // C030 LDX #$00
+		0xA9, 0x01,             // C032 LDA #$01
+		0xA0, 0x02,             // C034 LDY #$02
+		0x8D, 0x07, 0x20,       // C036 STA $2007
+		0xCA,                   // C039 DEX
+		0xD0, 0xFA,             // C03A BNE $C036
+		0x88,                   // C03C DEY
+		0xD0, 0xF7,             // C03D BNE $C036
+		0xA9, 0x00,             // C03F LDA #$00
+		0xA0, 0x02,             // C041 LDY #$02
+		0x8D, 0x07, 0x20,       // C043 STA $2007
+		0xCA,                   // C046 DEX
+		0xD0, 0xFA,             // C047 BNE $C043
+		0x88,                   // C049 DEY
+		0xD0, 0xF7,             // C04A BNE $C043
+		0xA9, 0x00,             // C04C LDA #$00    ; Sprites from $C100
+		0x8D, 0x03, 0x20,       // C04E STA $2003
+		0xA9, 0xC1,             // C051 LDA #$C1
+		0x8D, 0x14, 0x40,       // C053 STA $4014
+		0xA9, 0x00,             // C056 LDA #$00
+		0x8D, 0x05, 0x20,       // C058 STA $2005
+		0x8D, 0x05, 0x20,       // C05B STA $2005
+		0x8D, 0x00, 0x20,       // C05E STA $2000
+		0xA9, 0x1E,             // C061 LDA #$1E    ; Background and sprites on, including the left column
+		0x8D, 0x01, 0x20,       // C063 STA $2001
+		0x4C, 0x66, 0xC0,       // C066 JMP $C066
+	};
+
+	static const uint8_t c_palettes[32] = {
+		0x0F, 0x16, 0x16, 0x16,  0x0F, 0x16, 0x16, 0x16,  0x0F, 0x16, 0x16, 0x16,  0x0F, 0x16, 0x16, 0x16, // Red background
+		0x0F, 0x2A, 0x2A, 0x2A,  0x0F, 0x12, 0x12, 0x12,  0x0F, 0x2A, 0x2A, 0x2A,  0x0F, 0x12, 0x12, 0x12, // Green and blue sprites
+	};
+
+	// Y, tile, attributes, X
+	static const uint8_t c_sprites[] = {
+		 50, 2, 0x20 /*behind, green*/, 100,
+		 50, 2, 0x01 /*in front, blue*/, 104,
+		150, 2, 0x20 /*behind, green*/, 100,
+		150, 2, 0x01 /*in front, blue*/, 104,
+	};
+
+	std::vector<uint8_t> rom(std::begin(c_header), std::end(c_header));
+	rom.resize(sizeof(c_header) + c_cbPrgRom + 8 * 1024, 0);
+	uint8_t* const pPrgRom = rom.data() + sizeof(c_header);
+	uint8_t* const pChrRom = pPrgRom + c_cbPrgRom;
+
+	memcpy(pPrgRom, c_code, sizeof(c_code));
+	memcpy(pPrgRom + 0x80, c_palettes, sizeof(c_palettes));
+	memset(pPrgRom + 0x100, 0xFF, 256); // The other sprites are below the screen
+	memcpy(pPrgRom + 0x100, c_sprites, sizeof(c_sprites));
+
+	// Vectors: NMI and IRQ (neither is enabled) go to the final loop
+	const uint16_t c_vectors[3] = { 0xC066, c_prgRomBase, 0xC066 };
+	for (int iVector = 0; iVector != 3; ++iVector)
+	{
+		pPrgRom[c_cbPrgRom - 6 + iVector * 2] = static_cast<uint8_t>(c_vectors[iVector]);
+		pPrgRom[c_cbPrgRom - 5 + iVector * 2] = static_cast<uint8_t>(c_vectors[iVector] >> 8);
+	}
+
+	// Tile 1 is solid color 1, tile 2 solid color 3
+	memset(pChrRom + 16, 0xFF, 8);
+	memset(pChrRom + 32, 0xFF, 16);
+	return rom;
+}
+
+
+int CheckSpritePriorityScene()
+{
+	const std::vector<uint8_t> romData = BuildSpritePriorityRom();
+	CMemoryReadOnlyFile romFile(romData);
+
+	NES::NES nes;
+	nes.GetApu().EnableSound(false);
+	nes.LoadRomFile(&romFile);
+	nes.Reset();
+	RunFrames(nes, c_spritePrioritySceneFrame);
+
+	const uint64_t hash = HashFrame(nes);
+	if (hash != c_spritePrioritySceneHash)
+	{
+		printf("sprite priority scene: frame hash %016llx, expected %016llx\n", hash, c_spritePrioritySceneHash);
+		return 1;
+	}
+
+	printf("sprite priority scene matches\n");
+	return 0;
+}
+
+
+int CheckRecordedFrameHashes(const char* szRomFile)
+{
+	const uint64_t romHash = HashRomFile(szRomFile);
+	const RecordedFrameHashes* pRecorded = nullptr;
+	for (const RecordedFrameHashes& recorded : c_recordedFrameHashes)
+	{
+		if (recorded.romHash == romHash)
+			pRecorded = &recorded;
+	}
+
+	if (pRecorded == nullptr)
+	{
+		printf("%s: no frame hashes are recorded for this ROM (%016llx)\n", szRomFile, romHash);
+		return 1;
+	}
+
+	const int frameCount = c_recordedFrameInterval * static_cast<int>(_countof(pRecorded->frameHashes));
+	int result = 0;
+	HashFrames(szRomFile, frameCount, c_recordedFrameInterval, [&](int frame, uint64_t hash)
+	{
+		const uint64_t expected = pRecorded->frameHashes[frame / c_recordedFrameInterval - 1];
+		if (result == 0 && hash != expected)
+		{
+			printf("%s: frame %d hash %016llx, expected %016llx\n", pRecorded->szName, frame, hash, expected);
+			result = 1;
+		}
+	});
+
+	if (result == 0)
+		printf("%s: %d frames match the renderer before scanline compositing\n", pRecorded->szName, frameCount);
+	return result;
+}
+
+
+int RunRenderCheck(int lineCount, const char* szRomFile)
+{
+	int result = CheckCompositorLines(lineCount);
+	result |= CheckSpritePriorityScene();
+	if (szRomFile != nullptr)
+		result |= CheckRecordedFrameHashes(szRomFile);
+
+	return result;
+}
+
+
+void PrintUsage()
+{
+	printf("usage: CrustyTool pairstats [--frames N] <rom>...\n");
+	printf("       CrustyTool trace [--frames N] [--backend B] [--pc XXXX] <rom> <trace file>\n");
+	printf("       CrustyTool tracefmt <trace file>\n");
+	printf("       CrustyTool tracediff [--cpu-only] [--frames N] [--backend B] [--pc XXXX] <trace file | rom> <reference log>\n");
+	printf("       CrustyTool profile [--frames N] [--top N] <rom> <report.json | report.csv>\n");
+	printf("       CrustyTool batch [--frames N] [--consoles N] [--backend B] <rom>\n");
+	printf("       CrustyTool framehash [--frames N] [--every N] <rom>\n");
+	printf("       CrustyTool rendercheck [--lines N] [<rom>]\n");
+	printf("  B is interpreter, blocks or native\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const std::string command = argv[1];
+
+	int frameCount = c_defaultFrameCount;
+	int topCount = c_defaultProfileTopCount;
+	int consoleCount = c_defaultBatchConsoleCount;
+	int frameInterval = 1;
+	int lineCount = c_defaultRenderCheckLineCount;
+	bool isFrameCountSet = false;
+	bool isCpuOnly = false;
+	RunOptions runOptions;
+	std::vector<const char*> files;
+	for (int iArg = 2; iArg < argc; ++iArg)
+	{
+		const std::string arg = argv[iArg];
+		if (arg == "--frames" && iArg + 1 < argc)
+		{
+			frameCount = std::max(1, atoi(argv[++iArg]));
+			isFrameCountSet = true;
+		}
+		else if (arg == "--top" && iArg + 1 < argc)
+			topCount = std::max(1, atoi(argv[++iArg]));
+		else if (arg == "--consoles" && iArg + 1 < argc)
+			consoleCount = std::max(1, atoi(argv[++iArg]));
+		else if (arg == "--every" && iArg + 1 < argc)
+			frameInterval = std::max(1, atoi(argv[++iArg]));
+		else if (arg == "--lines" && iArg + 1 < argc)
+			lineCount = std::max(0, atoi(argv[++iArg]));
+		else if (arg == "--cpu-only")
+			isCpuOnly = true;
+		else if (arg == "--backend" && iArg + 1 < argc)
+		{
+			if (!ParseBackend(argv[++iArg], &runOptions.backend))
+			{
+				PrintUsage();
+				return 1;
+			}
+			runOptions.isBackendSet = true;
+		}
+		else if (arg == "--pc" && iArg + 1 < argc)
+			runOptions.startPc = static_cast<int>(strtoul(argv[++iArg], nullptr, 16) & 0xFFFF);
+		else
+			files.push_back(argv[iArg]);
+	}
+
+	try
+	{
+		if (command == "pairstats" && !files.empty())
+			return RunPairStats(files, frameCount);
+		else if (command == "trace" && files.size() == 2)
+			return RunTrace(files[0], files[1], frameCount, runOptions);
+		else if (command == "tracefmt" && files.size() == 1)
+			return RunTraceFormat(files[0]);
+		else if (command == "tracediff" && files.size() == 2)
+			return RunTraceDiff(files[0], files[1], isCpuOnly, frameCount, runOptions);
+		else if (command == "profile" && files.size() == 2)
+			return RunProfile(files[0], files[1], frameCount, topCount);
+		else if (command == "batch" && files.size() == 1)
+			return RunBatch(files[0], isFrameCountSet ? frameCount : c_defaultBatchFrameCount, consoleCount, runOptions);
+		else if (command == "framehash" && files.size() == 1)
+			return RunFrameHash(files[0], frameCount, frameInterval);
+		else if (command == "rendercheck" && files.size() <= 1)
+			return RunRenderCheck(lineCount, files.empty() ? nullptr : files[0]);
+	}
+	catch (const std::exception& ex)
+	{
+		fprintf(stderr, "error: %s\n", ex.what());
+		return 1;
+	}
+
+	PrintUsage();
+	return 1;
+}
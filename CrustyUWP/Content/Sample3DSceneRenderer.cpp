@@ -151,12 +151,7 @@ void Sample3DSceneRenderer::Render()
 		return;
 	}
 
-	for (;;)
-	{
-		m_nes.RunCycle();
-		if (m_nes.GetPpu().ShouldRender())
-			break;
-	}
+	m_nes.RunFrame();
 
 	m_nes.GetApu().PushAudio();
 
@@ -32,6 +32,8 @@ enum
 	TIMER_TESTRENDER
 };
 
+const size_t c_traceRecordsPerWrite = 64 * 1024;
+
 void ValidateBool(bool result)
 {
 	if (!result)
@@ -253,12 +255,33 @@ void CCrustyWin32Dlg::StartLogging()
 
 	CreateDirectoryW(logFileDirectory.c_str(), nullptr);
 
-	std::wstring logFilePath = logFileDirectory + L"\\Cpu.log";
+	std::wstring logFilePath = logFileDirectory + L"\\Cpu.trace";
 
 	if (m_debugFileOutput)
 		m_debugFileOutput.close();
 
-	m_debugFileOutput.open(logFilePath.c_str());
+	m_debugFileOutput.open(logFilePath.c_str(), std::ios::binary);
+
+	if (!m_spTraceBuffer)
+	{
+		m_spTraceBuffer = std::make_unique<CPU::CpuTraceBuffer>();
+		m_spTraceRecords = std::make_unique<CPU::CpuTraceRecord[]>(c_traceRecordsPerWrite);
+	}
+
+	m_nes.GetCpu().SetTraceBuffer(m_spTraceBuffer.get());
+}
+
+
+void CCrustyWin32Dlg::DrainTrace()
+{
+	for (;;)
+	{
+		const size_t recordCount = m_spTraceBuffer->Read(m_spTraceRecords.get(), c_traceRecordsPerWrite);
+		if (recordCount == 0)
+			break;
+
+		m_debugFileOutput.write(reinterpret_cast<const char*>(m_spTraceRecords.get()), recordCount * sizeof(CPU::CpuTraceRecord));
+	}
 }
 
 
@@ -379,32 +402,21 @@ void CCrustyWin32Dlg::RenderFrame()
 
 	try
 	{
-		for (;;)
+		m_nes.RunFrame();
+
+		if (m_loggingEnabled)
+			DrainTrace();
+
+		m_nes.GetApu().PushAudio();
+
+		if (m_eRenderMode == ERenderMode::DirectX)
+		{
+			ValidateBool(m_d3dRenderer.Render(m_nes.GetPpu().GetDisplayBuffer()));
+		}
+		else
 		{
-			if (m_loggingEnabled)
-			{
-				const char* pszDebugString = m_nes.GetCpu().GetDebugState();
-				m_debugFileOutput.write(pszDebugString, strlen(pszDebugString));
-			}
-
-			m_nes.RunCycle();
-
-			if (m_nes.GetPpu().ShouldRender())
-			{
-				m_nes.GetApu().PushAudio();
-
-				if (m_eRenderMode == ERenderMode::DirectX)
-				{
-					ValidateBool(m_d3dRenderer.Render(m_nes.GetPpu().GetDisplayBuffer()));
-				}
-				else
-				{
-					CClientDC clientDC(this);
-					PaintNESFrame(&clientDC);
-				}
-
-				break;
-			}
+			CClientDC clientDC(this);
+			PaintNESFrame(&clientDC);
 		}
 	}
 	catch (std::exception& e)
@@ -412,10 +424,9 @@ void CCrustyWin32Dlg::RenderFrame()
 		char errorString[256];
 		sprintf_s(errorString, "Exception encountered: %s", e.what());
 
+		// Keep the instructions leading up to the failure
 		if (m_loggingEnabled)
-		{
-			m_debugFileOutput.write(errorString, strlen(errorString));
-		}
+			DrainTrace();
 
 		StopTimer();
 
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "NES/NES.h"
+#include "NES/CpuTrace.h"
 #include "Util/MovingAverage.h"
 #include "Util/Stopwatch.h"
 #include "UserController.h"
@@ -72,9 +73,13 @@ private:
 	void PauseRom();
 
 	void StartLogging();
+	void DrainTrace();
 
+	// Logging writes a binary CPU trace, which CrustyTool's tracefmt turns into text
 	bool m_loggingEnabled = false;
 	std::ofstream m_debugFileOutput;
+	std::unique_ptr<CPU::CpuTraceBuffer> m_spTraceBuffer;
+	std::unique_ptr<CPU::CpuTraceRecord[]> m_spTraceRecords;
 
 	bool m_isRomLoaded = false;
 	NES::NES m_nes;